@@ -486,6 +486,39 @@ namespace ctsUnitTest
             Assert::IsTrue(this->ioPatternState->is_completed());
         }
 
+        TEST_METHOD(TestFastOpenServerReceivesConnectionId)
+        {
+            ctsConfig::Settings->Options = ctsConfig::OptionType::FAST_OPEN;
+            this->InitGracefulShutdownTest(100, Server);
+            Assert::AreEqual(ctsIOPatternProtocolTask::RecvConnectionId, this->ioPatternState->get_next_task());
+
+            ctsIOTask test_task;
+            test_task.ioAction = IOTaskAction::Recv;
+            test_task.track_io = false;
+            test_task.buffer_length = ctsStatistics::ConnectionIdLength;
+            this->ioPatternState->notify_next_task(test_task);
+            this->VerifyNoMoreIo();
+
+            Assert::AreEqual(ctsIOPatternProtocolError::TooFewBytes, this->ioPatternState->completed_task(test_task, ctsStatistics::ConnectionIdLength - 1));
+            Assert::IsTrue(this->ioPatternState->is_completed());
+
+            this->InitGracefulShutdownTest(100, Server);
+            Assert::AreEqual(ctsIOPatternProtocolTask::RecvConnectionId, this->ioPatternState->get_next_task());
+            this->ioPatternState->notify_next_task(test_task);
+            Assert::AreEqual(ctsIOPatternProtocolError::NoError, this->ioPatternState->completed_task(test_task, ctsStatistics::ConnectionIdLength));
+            Assert::AreEqual(ctsIOPatternProtocolTask::MoreIo, this->ioPatternState->get_next_task());
+            ctsConfig::Settings->Options = ctsConfig::OptionType::NoOptionSet;
+        }
+
+        TEST_METHOD(TestFastOpenClientStartsWithIo)
+        {
+            ctsConfig::Settings->Options = ctsConfig::OptionType::FAST_OPEN;
+            // the client sent its connection id with the SYN
+            this->InitGracefulShutdownTest(100, Client);
+            Assert::AreEqual(ctsIOPatternProtocolTask::MoreIo, this->ioPatternState->get_next_task());
+            ctsConfig::Settings->Options = ctsConfig::OptionType::NoOptionSet;
+        }
+
         TEST_METHOD(TestClientFailIo)
         {
             this->InitGracefulShutdownTest(100, Client);
@@ -15,6 +15,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include "CppUnitTest.h"
 // cpp headers
 #include <memory>
+#include <thread>
 // OS headers
 #include <windows.h>
 // ctl headers
@@ -99,13 +100,16 @@ namespace ctsTraffic::ctsConfig
     void PrintConnectionResults(const ctl::ctSockaddr&, const ctl::ctSockaddr&, unsigned long, const ctsUdpStatistics&) noexcept
     {
     }
+    void PrintTimeSeries(const char*, const ctsConnectionTimeSeries&) noexcept
+    {
+    }
     void PrintDebug(_In_z_ _Printf_format_string_ PCWSTR, ...) noexcept
     {
     }
     void PrintException(const std::exception&) noexcept
     {
     }
-    void PrintJitterUpdate(const JitterFrameEntry&, const JitterFrameEntry&) noexcept
+    void PrintJitterUpdate(unsigned long, const JitterFrameEntry&, const JitterFrameEntry&) noexcept
     {
     }
     void PrintErrorInfo(_In_ PCSTR) noexcept
@@ -770,6 +774,49 @@ namespace ctsUnitTest
             Logger::WriteMessage(ToString<ctsTraffic::ctsIOTask>(test_task).c_str());
             Assert::AreEqual(ctsIOStatus::CompletedIo, test_pattern->complete_io(test_task, 0, 0));
         }
+        TEST_METHOD(PushClient_SingleOwner_CompletesOnAnotherThread)
+        {
+            this->SetTestBaseClassDefaults(Client, Graceful);
+            ctsConfig::Settings->SingleOwnerIoPattern = true;
+            s_TransferSize = 1024 * 10;
+
+            std::shared_ptr<ctsIOPattern> test_pattern(ctsIOPattern::MakeIOPattern());
+            ctsConfig::Settings->SingleOwnerIoPattern = false;
+
+            // mirror the IO functions: each IO is initiated on one thread and completed on another
+            auto complete_on_another_thread = [&](const ctsIOTask& _task, unsigned long _transferred) {
+                ctsIOStatus status{};
+                std::thread completion_thread([&]() { status = test_pattern->complete_io(_task, _transferred, 0); });
+                completion_thread.join();
+                return status;
+            };
+
+            ctsIOTask test_task = test_pattern->initiate_io();
+            Assert::AreEqual(IOTaskAction::Recv, test_task.ioAction);
+            Assert::AreEqual(ctsIOStatus::ContinueIo, complete_on_another_thread(test_task, ctsStatistics::ConnectionIdLength));
+
+            for (unsigned long io_count = 0; io_count < 10; ++io_count)
+            {
+                test_task = test_pattern->initiate_io();
+                Assert::AreEqual(1024UL, test_task.buffer_length);
+                Assert::AreEqual(IOTaskAction::Send, test_task.ioAction);
+                // with one IO in flight, the pattern offers no more IO until it completes
+                Assert::AreEqual(IOTaskAction::None, test_pattern->initiate_io().ioAction);
+                Assert::AreEqual(ctsIOStatus::ContinueIo, complete_on_another_thread(test_task, 1024));
+            }
+
+            test_task = test_pattern->initiate_io();
+            Assert::AreEqual(IOTaskAction::Recv, test_task.ioAction);
+            Assert::AreEqual(ctsIOStatus::ContinueIo, complete_on_another_thread(test_task, 4));
+
+            test_task = test_pattern->initiate_io();
+            Assert::AreEqual(IOTaskAction::GracefulShutdown, test_task.ioAction);
+            Assert::AreEqual(ctsIOStatus::ContinueIo, complete_on_another_thread(test_task, 0));
+
+            test_task = test_pattern->initiate_io();
+            Assert::AreEqual(IOTaskAction::Recv, test_task.ioAction);
+            Assert::AreEqual(ctsIOStatus::CompletedIo, complete_on_another_thread(test_task, 0));
+        }
         TEST_METHOD(PushClient_NotVerifyingBuffersNotUsingSharedBuffer_Rude)
         {
             ctsConfig::Settings->IoPattern = ctsConfig::IoPatternType::Push;
@@ -94,13 +94,16 @@ namespace ctsTraffic::ctsConfig
     void PrintConnectionResults(const ctl::ctSockaddr&, const ctl::ctSockaddr&, unsigned long, const ctsUdpStatistics&) noexcept
     {
     }
+    void PrintTimeSeries(const char*, const ctsConnectionTimeSeries&) noexcept
+    {
+    }
     void PrintDebug(_In_z_ _Printf_format_string_ PCWSTR, ...) noexcept
     {
     }
     void PrintException(const std::exception&) noexcept
     {
     }
-    void PrintJitterUpdate(const JitterFrameEntry&, const JitterFrameEntry&) noexcept
+    void PrintJitterUpdate(unsigned long, const JitterFrameEntry&, const JitterFrameEntry&) noexcept
     {
     }
     void PrintErrorInfo(_In_ PCSTR) noexcept
@@ -931,5 +934,27 @@ namespace ctsUnitTest
 
             Assert::AreEqual(ctsIOStatus::CompletedIo, test_pattern->complete_io(test_task, 0, 0));
         }
+
+        TEST_METHOD(MediaStreamGopFrameModel)
+        {
+            ctsConfig::MediaStreamSettings media_stream;
+            media_stream.FramesPerSecond = 30;
+            media_stream.StreamLengthSeconds = 1;
+            media_stream.IFrameSizeBytes = 60000;
+            media_stream.PFrameSizeBytes = 4000;
+            media_stream.GopLengthFrames = 12;
+
+            // 30 frames: 2 full GOPs and a partial GOP of 6 frames, each GOP starting with an I-frame
+            const unsigned long long transfer_size = media_stream.CalculateTransferSize();
+            Assert::AreEqual(3ULL * 60000ULL + 27ULL * 4000ULL, transfer_size);
+            Assert::AreEqual(60000UL, static_cast<unsigned long>(media_stream.FrameSizeBytes));
+            Assert::AreEqual(30UL, static_cast<unsigned long>(media_stream.StreamLengthFrames));
+
+            Assert::IsTrue(media_stream.IsKeyFrame(1));
+            Assert::IsFalse(media_stream.IsKeyFrame(12));
+            Assert::IsTrue(media_stream.IsKeyFrame(13));
+            Assert::AreEqual(60000UL, media_stream.FrameSize(25));
+            Assert::AreEqual(4000UL, media_stream.FrameSize(26));
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,169 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "ctsLocalPortAllocator.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ctsTraffic;
+
+namespace ctsUnitTest
+{
+    TEST_CLASS(ctsLocalPortAllocatorUnitTest)
+    {
+    public:
+        TEST_METHOD(AcquiresEveryPortOnce)
+        {
+            ctsLocalPortAllocator allocator(5000, 5099, 1, 0, 0);
+
+            std::set<unsigned short> ports;
+            unsigned short port;
+            while (allocator.acquire(0, port))
+            {
+                Assert::IsTrue(port >= 5000 && port <= 5099);
+                Assert::IsTrue(ports.insert(port).second);
+            }
+            Assert::AreEqual(static_cast<size_t>(100), ports.size());
+            Assert::AreEqual(0, static_cast<int>(port));
+            Assert::AreEqual(100LL, allocator.acquired());
+            Assert::AreEqual(1LL, allocator.exhausted());
+        }
+
+        TEST_METHOD(AddressesHaveSeparateRanges)
+        {
+            ctsLocalPortAllocator allocator(6000, 6000, 2, 0, 0);
+
+            unsigned short port;
+            Assert::IsTrue(allocator.acquire(0, port));
+            Assert::AreEqual(6000, static_cast<int>(port));
+            Assert::IsFalse(allocator.acquire(0, port));
+
+            Assert::IsTrue(allocator.acquire(1, port));
+            Assert::AreEqual(6000, static_cast<int>(port));
+            Assert::IsFalse(allocator.acquire(1, port));
+        }
+
+        TEST_METHOD(ReleasedPortsWaitForTimeWait)
+        {
+            // an hour is longer than the test could run
+            constexpr unsigned long ReuseDelay = 60 * 60 * 1000;
+            ctsLocalPortAllocator allocator(7000, 7001, 1, ReuseDelay, ReuseDelay);
+
+            unsigned short first;
+            unsigned short second;
+            Assert::IsTrue(allocator.acquire(0, first));
+            Assert::IsTrue(allocator.acquire(0, second));
+
+            // the only free port is still waiting, but is handed out rather than failing
+            allocator.release(0, first, false);
+            unsigned short reused;
+            Assert::IsTrue(allocator.acquire(0, reused));
+            Assert::AreEqual(first, reused);
+            Assert::AreEqual(1LL, allocator.early_reuses());
+        }
+
+        TEST_METHOD(ConflictedPortsMoveBehindFreePorts)
+        {
+            constexpr unsigned long ConflictDelay = 60 * 60 * 1000;
+            ctsLocalPortAllocator allocator(8000, 8001, 1, 0, ConflictDelay);
+
+            unsigned short conflicted;
+            Assert::IsTrue(allocator.acquire(0, conflicted));
+            allocator.release(0, conflicted, true);
+            Assert::AreEqual(1LL, allocator.conflicts());
+
+            // the other port is preferred over the port which failed to bind
+            unsigned short next;
+            Assert::IsTrue(allocator.acquire(0, next));
+            Assert::AreNotEqual(conflicted, next);
+            Assert::AreEqual(0LL, allocator.early_reuses());
+        }
+
+        TEST_METHOD(ConflictedPortsDoNotHideReadyPorts)
+        {
+            constexpr unsigned long ConflictDelay = 60 * 60 * 1000;
+            ctsLocalPortAllocator allocator(9000, 9002, 1, 0, ConflictDelay);
+
+            unsigned short conflicted;
+            unsigned short first;
+            unsigned short second;
+            Assert::IsTrue(allocator.acquire(0, conflicted));
+            Assert::IsTrue(allocator.acquire(0, first));
+            Assert::IsTrue(allocator.acquire(0, second));
+
+            // the conflicted port is released first, ahead of the ports released when their sockets closed
+            allocator.release(0, conflicted, true);
+            allocator.release(0, first, false);
+            allocator.release(0, second, false);
+
+            unsigned short port;
+            Assert::IsTrue(allocator.acquire(0, port));
+            Assert::AreNotEqual(conflicted, port);
+            Assert::IsTrue(allocator.acquire(0, port));
+            Assert::AreNotEqual(conflicted, port);
+            Assert::AreEqual(0LL, allocator.early_reuses());
+
+            // only once no other port is free is the conflicted port handed out early
+            Assert::IsTrue(allocator.acquire(0, port));
+            Assert::AreEqual(conflicted, port);
+            Assert::AreEqual(1LL, allocator.early_reuses());
+        }
+
+        TEST_METHOD(ConcurrentLeasesAreUnique)
+        {
+            constexpr unsigned short LowPort = 10000;
+            constexpr unsigned short HighPort = 10999;
+            constexpr size_t ThreadCount = 8;
+            constexpr size_t Iterations = 10000;
+            ctsLocalPortAllocator allocator(LowPort, HighPort, 1, 0, 0);
+
+            // each port is leased to at most one thread at a time
+            std::vector<long> leased(HighPort - LowPort + 1);
+            long duplicates = 0;
+
+            std::vector<std::thread> threads;
+            for (size_t thread = 0; thread < ThreadCount; ++thread)
+            {
+                threads.emplace_back([&]() {
+                    for (size_t count = 0; count < Iterations; ++count)
+                    {
+                        unsigned short port;
+                        if (allocator.acquire(0, port))
+                        {
+                            if (::InterlockedIncrement(&leased[port - LowPort]) != 1)
+                            {
+                                ::InterlockedIncrement(&duplicates);
+                            }
+                            ::InterlockedDecrement(&leased[port - LowPort]);
+                            allocator.release(0, port, false);
+                        }
+                    }
+                });
+            }
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+
+            Assert::AreEqual(0L, duplicates);
+            Assert::AreEqual(static_cast<long long>(ThreadCount * Iterations), allocator.acquired());
+            Assert::AreEqual(0LL, allocator.exhausted());
+        }
+    };
+}
@@ -0,0 +1,157 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include "ctsMediaStreamFrameRing.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ctsTraffic;
+
+namespace ctsUnitTest
+{
+    TEST_CLASS(ctsMediaStreamFrameRingUnitTest)
+    {
+        static constexpr long long Qpf = 10000000LL;
+
+    public:
+        TEST_METHOD(FindsFramesFromTheHead)
+        {
+            ctsMediaStreamFrameRing frames(Qpf);
+            frames.resize(4, false);
+
+            Assert::AreEqual(1LL, frames.head_sequence_number());
+            Assert::AreEqual(static_cast<size_t>(0), frames.find(1));
+            Assert::AreEqual(static_cast<size_t>(3), frames.find(4));
+            Assert::AreEqual(ctsMediaStreamFrameRing::NotFound, frames.find(0));
+            Assert::AreEqual(ctsMediaStreamFrameRing::NotFound, frames.find(5));
+
+            // after rendering 3 frames, frames 4 through 7 are held, wrapping around the end
+            frames.advance_head();
+            frames.advance_head();
+            frames.advance_head();
+            Assert::AreEqual(4LL, frames.head_sequence_number());
+            Assert::AreEqual(static_cast<size_t>(3), frames.head());
+            Assert::AreEqual(static_cast<size_t>(3), frames.find(4));
+            Assert::AreEqual(static_cast<size_t>(0), frames.find(5));
+            Assert::AreEqual(static_cast<size_t>(2), frames.find(7));
+            Assert::AreEqual(ctsMediaStreamFrameRing::NotFound, frames.find(3));
+            Assert::AreEqual(ctsMediaStreamFrameRing::NotFound, frames.find(8));
+        }
+
+        TEST_METHOD(CountsBytesUntilTheFrameIsRendered)
+        {
+            ctsMediaStreamFrameRing frames(Qpf);
+            frames.resize(2, true);
+            Assert::IsFalse(frames.received_any());
+
+            frames.record_datagram(frames.find(1), 100, false, 1000, Qpf, 5000);
+            frames.record_datagram(frames.find(1), 50, true, 1000, Qpf, 5000);
+            frames.set_retransmit_requested(frames.find(1));
+            Assert::IsTrue(frames.received_any());
+            Assert::IsTrue(frames.arrived(0));
+            Assert::AreEqual(100UL, frames.bytes_received(0));
+            Assert::AreEqual(50UL, frames.retransmitted_bytes(0));
+            Assert::IsTrue(frames.retransmit_requested(0));
+
+            // the slot is cleared for frame 3
+            frames.advance_head();
+            Assert::AreEqual(static_cast<size_t>(0), frames.find(3));
+            Assert::IsFalse(frames.arrived(0));
+            Assert::AreEqual(0UL, frames.retransmitted_bytes(0));
+            Assert::IsFalse(frames.retransmit_requested(0));
+        }
+
+        TEST_METHOD(RetransmitsCountAsBytesWhenNotTracked)
+        {
+            ctsMediaStreamFrameRing frames(Qpf);
+            frames.resize(2, false);
+
+            frames.record_datagram(0, 100, true, 1000, Qpf, 5000);
+            frames.set_retransmit_requested(0);
+            Assert::AreEqual(100UL, frames.bytes_received(0));
+            Assert::AreEqual(0UL, frames.retransmitted_bytes(0));
+            Assert::IsFalse(frames.retransmit_requested(0));
+        }
+
+        TEST_METHOD(RestoresTimestampsToTheMicrosecond)
+        {
+            ctsMediaStreamFrameRing frames(Qpf);
+            frames.resize(2, false);
+
+            // the sender's clock runs at a different frequency than the receiver's
+            constexpr long long SenderQpf = 3000000LL;
+            frames.record_datagram(0, 1, false, 123456789LL, SenderQpf, 987654321LL);
+            frames.record_datagram(1, 1, false, 123456789LL + SenderQpf / 50, SenderQpf, 987654321LL + 200007LL);
+
+            Assert::AreEqual(SenderQpf, frames.sender_qpf());
+            Assert::AreEqual(Qpf, frames.receiver_qpf());
+            Assert::AreEqual(123456789LL, frames.sender_qpc(0));
+            Assert::AreEqual(987654321LL, frames.receiver_qpc(0));
+            Assert::AreEqual(123456789LL + SenderQpf / 50, frames.sender_qpc(1));
+            // 10 receiver ticks to the microsecond: the remaining 7 ticks are truncated
+            Assert::AreEqual(987654321LL + 200000LL, frames.receiver_qpc(1));
+        }
+
+        TEST_METHOD(RestoresTimestampsPastThe32BitWrap)
+        {
+            ctsMediaStreamFrameRing frames(Qpf);
+            frames.resize(2, false);
+
+            // a little over 4295 seconds into the stream, 32 bits of microseconds have wrapped
+            constexpr long long Start = 1000000LL;
+            constexpr long long Elapsed = 4300LL * Qpf;
+            frames.record_datagram(0, 1, false, Start, Qpf, Start);
+            frames.advance_head();
+            for (long long second = 1; second <= 4300; ++second)
+            {
+                frames.record_datagram(1, 1, false, Start + second * Qpf, Qpf, Start + second * Qpf);
+            }
+            frames.record_datagram(0, 1, false, Start + Elapsed + Qpf / 2, Qpf, Start + Elapsed + Qpf / 2);
+
+            Assert::AreEqual(Start + Elapsed, frames.sender_qpc(1));
+            Assert::AreEqual(Start + Elapsed, frames.receiver_qpc(1));
+            Assert::AreEqual(Start + Elapsed + Qpf / 2, frames.receiver_qpc(0));
+        }
+
+        TEST_METHOD(RestoresKernelTimestampsBeforeTheFirstDatagram)
+        {
+            ctsMediaStreamFrameRing frames(Qpf);
+            frames.resize(2, false, true);
+
+            // the kernel receives each datagram before its completion is processed
+            // - the first by 150 microseconds, earlier than any receive time recorded
+            constexpr long long Start = 5000000LL;
+            frames.record_datagram(0, 1, false, 1000LL, Qpf, Start);
+            frames.record_kernel_timestamp(0, Start - 1500LL);
+            frames.record_datagram(1, 1, false, 2000LL, Qpf, Start + 100000LL);
+            frames.record_kernel_timestamp(1, Start + 100000LL - 40LL);
+
+            Assert::AreEqual(Start - 1500LL, frames.receiver_kernel_qpc(0));
+            Assert::AreEqual(Start + 100000LL - 40LL, frames.receiver_kernel_qpc(1));
+            Assert::AreEqual(Start + 100000LL, frames.receiver_qpc(1));
+        }
+
+        TEST_METHOD(KernelTimestampsAreTheReceiveTimeWhenNotTracked)
+        {
+            ctsMediaStreamFrameRing frames(Qpf);
+            frames.resize(2, false);
+
+            frames.record_datagram(0, 1, false, 1000LL, Qpf, 5000000LL);
+            frames.record_kernel_timestamp(0, 5000000LL - 1500LL);
+
+            Assert::AreEqual(5000000LL, frames.receiver_kernel_qpc(0));
+        }
+    };
+}
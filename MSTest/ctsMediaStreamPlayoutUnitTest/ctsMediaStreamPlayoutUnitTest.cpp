@@ -0,0 +1,154 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include "ctsMediaStreamPlayout.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ctsTraffic;
+
+namespace ctsUnitTest
+{
+    TEST_CLASS(ctsMediaStreamPlayoutUnitTest)
+    {
+        static constexpr double FrameMs = 10.0;
+
+    public:
+        TEST_METHOD(FramesAreDueTheDelayAfterTheTimerWheel)
+        {
+            ctsMediaStreamPlayout playout;
+            playout.reset(3, 10, FrameMs);
+            Assert::AreEqual(3UL, playout.delay_frames());
+            Assert::AreEqual(10UL, playout.max_delay_frames());
+
+            Assert::IsFalse(playout.frame_due(1, 3));
+            Assert::IsTrue(playout.frame_due(1, 4));
+            Assert::IsTrue(playout.frame_due(2, 5));
+            Assert::IsFalse(playout.frame_due(3, 5));
+        }
+
+        TEST_METHOD(JitterFollowsRfc3550)
+        {
+            ctsMediaStreamPlayout playout;
+            playout.reset(3, 10, FrameMs);
+
+            // the first frame only sets the transit to measure against: the clocks are not synchronized
+            playout.frame_rendered(1000.0, 5.0);
+            Assert::AreEqual(0.0, playout.jitter_ms());
+            Assert::AreEqual(5.0, playout.average_wait_ms());
+
+            // J += (|D| - J) / 16
+            playout.frame_rendered(1016.0, 5.0);
+            Assert::AreEqual(1.0, playout.jitter_ms());
+            playout.frame_rendered(1016.0, 5.0);
+            Assert::AreEqual(1.0 - 1.0 / 16.0, playout.jitter_ms());
+        }
+
+        TEST_METHOD(LateFramesGrowTheDelay)
+        {
+            ctsMediaStreamPlayout playout;
+            playout.reset(3, 10, FrameMs);
+            playout.frame_rendered(1000.0, 5.0);
+
+            playout.frame_late();
+            Assert::AreEqual(4UL, playout.delay_frames());
+            // frames now wait a frame longer before being rendered
+            Assert::AreEqual(5.0 + FrameMs, playout.average_wait_ms());
+            Assert::IsFalse(playout.frame_due(1, 4));
+
+            playout.frame_late();
+            playout.frame_late();
+            Assert::AreEqual(6UL, playout.delay_frames());
+        }
+
+        TEST_METHOD(JitterAboveTheWaitGrowsTheDelay)
+        {
+            ctsMediaStreamPlayout playout;
+            playout.reset(4, 10, FrameMs);
+
+            // transit alternating by 16ms settles the jitter at 16ms: frames should wait 64ms, not 20ms
+            unsigned long previous_delay = playout.delay_frames();
+            bool grew = false;
+            for (unsigned long frame = 0; frame < 40; ++frame)
+            {
+                playout.frame_rendered(frame % 2 == 0 ? 1000.0 : 1016.0, 20.0);
+                Assert::IsTrue(playout.delay_frames() + 1 >= previous_delay);
+                grew = grew || playout.delay_frames() > previous_delay;
+                previous_delay = playout.delay_frames();
+            }
+            Assert::IsTrue(grew);
+            Assert::IsTrue(playout.delay_frames() > 4);
+        }
+
+        TEST_METHOD(ShrinksOnceTheWaitExceedsTheJitterMargin)
+        {
+            ctsMediaStreamPlayout playout;
+            playout.reset(4, 10, FrameMs);
+
+            // no jitter: a 50ms wait would still be 40ms with one frame less of buffering
+            playout.frame_rendered(1000.0, 50.0);
+            Assert::AreEqual(3UL, playout.delay_frames());
+            // the average wait moves with the delay
+            Assert::AreEqual(40.0, playout.average_wait_ms());
+
+            playout.frame_rendered(1000.0, 50.0);
+            Assert::AreEqual(2UL, playout.delay_frames());
+            playout.frame_rendered(1000.0, 50.0);
+            Assert::AreEqual(1UL, playout.delay_frames());
+
+            // never shrinks below one frame
+            for (unsigned long frame = 0; frame < 20; ++frame)
+            {
+                playout.frame_rendered(1000.0, 50.0);
+            }
+            Assert::AreEqual(1UL, playout.delay_frames());
+        }
+
+        TEST_METHOD(HoldsWithinAFrameOfTheJitterMargin)
+        {
+            ctsMediaStreamPlayout playout;
+            playout.reset(4, 10, FrameMs);
+
+            // a 5ms wait is above the (zero) margin, but would fall below it with one frame less
+            for (unsigned long frame = 0; frame < 50; ++frame)
+            {
+                playout.frame_rendered(1000.0, 5.0);
+                Assert::AreEqual(4UL, playout.delay_frames());
+            }
+        }
+
+        TEST_METHOD(DelayIsCappedAtMaxPlayoutDelay)
+        {
+            ctsMediaStreamPlayout playout;
+            playout.reset(3, 5, FrameMs);
+
+            for (unsigned long late = 0; late < 10; ++late)
+            {
+                playout.frame_late();
+            }
+            Assert::AreEqual(5UL, playout.delay_frames());
+
+            // growth from jitter stops at the cap as well
+            ctsMediaStreamPlayout jittered;
+            jittered.reset(3, 5, FrameMs);
+            for (unsigned long frame = 0; frame < 200; ++frame)
+            {
+                jittered.frame_rendered(frame % 2 == 0 ? 1000.0 : 1016.0, 0.0);
+                Assert::IsTrue(jittered.delay_frames() <= 5);
+            }
+            Assert::AreEqual(5UL, jittered.delay_frames());
+        }
+    };
+}
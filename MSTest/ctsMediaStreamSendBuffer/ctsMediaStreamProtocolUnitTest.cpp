@@ -15,6 +15,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include "CppUnitTest.h"
 
 #include <string>
+#include <vector>
 #include <ctString.hpp>
 #include "ctsMediaStreamProtocol.hpp"
 
@@ -32,6 +33,8 @@ std::wstring __cdecl Microsoft::VisualStudio::CppUnitTestFramework::ToString<cts
     switch (_message) {
         case ctsTraffic::MediaStreamAction::START:
             return L"START";
+        case ctsTraffic::MediaStreamAction::NACK:
+            return L"NACK";
     }
     return ctl::ctString::ctFormatString(L"Unknown Message (0x%x)", _message);
 }
@@ -57,10 +60,10 @@ namespace ctsUnitTest
             const auto ending = std::end(testbuffer);
             while (starting != ending) {
                 // verify operator->
-                Assert::AreEqual(static_cast<size_t>(5), starting->size());
+                Assert::AreEqual(static_cast<size_t>(ctsMediaStreamSendRequests::BufferArraySize), starting->size());
                 // verify operator*
                 auto deref = *starting;
-                Assert::AreEqual(static_cast<size_t>(5), deref.size());
+                Assert::AreEqual(static_cast<size_t>(ctsMediaStreamSendRequests::BufferArraySize), deref.size());
                 ++starting;
             }
         }
@@ -76,10 +79,10 @@ namespace ctsUnitTest
             const auto ending = std::end(testbuffer);
             while (starting != ending) {
                 // verify operator->
-                Assert::AreEqual(static_cast<size_t>(5), starting->size());
+                Assert::AreEqual(static_cast<size_t>(ctsMediaStreamSendRequests::BufferArraySize), starting->size());
                 // verify operator*
                 auto deref = *starting;
-                Assert::AreEqual(static_cast<size_t>(5), deref.size());
+                Assert::AreEqual(static_cast<size_t>(ctsMediaStreamSendRequests::BufferArraySize), deref.size());
                 ++starting;
             }
         }
@@ -155,6 +158,36 @@ namespace ctsUnitTest
             Assert::AreEqual(expected_datagram_count, dgrams_returned);
         }
 
+        TEST_METHOD(SendTimeStampedInEveryHeader)
+        {
+            ctsMediaStreamSendRequests testbuffer(3 * UdpDatagramMaximumSizeBytes, SequenceNumber, BufferPtr);
+            testbuffer.stamp_send_time();
+
+            long long first_qpc = 0;
+            for (auto& buffer_array : testbuffer) {
+                long long qpc;
+                ::memcpy(&qpc, buffer_array[0].buf + ctsMediaStreamSendRequests::HeaderQPCOffset, UdpDatagramQPCLength);
+                Assert::AreNotEqual(0LL, qpc);
+                if (0 == first_qpc) {
+                    first_qpc = qpc;
+                }
+                Assert::AreEqual(first_qpc, qpc);
+            }
+        }
+
+        TEST_METHOD(ReusedForSmallerFrame)
+        {
+            ctsMediaStreamSendRequests testbuffer;
+            testbuffer.encode(2 * UdpDatagramMaximumSizeBytes, SequenceNumber, BufferPtr);
+            Assert::AreEqual(static_cast<size_t>(2), testbuffer.size());
+
+            static const unsigned long buffer_size = UdpDatagramDataHeaderLength + 1;
+            testbuffer.encode(buffer_size, SequenceNumber, BufferPtr);
+            this->verify_protocol_header(testbuffer);
+            const auto dgrams_returned = this->verify_byte_count(testbuffer, buffer_size);
+            Assert::AreEqual(1UL, dgrams_returned);
+        }
+
         TEST_METHOD(ConstructStart)
         {
             Assert::AreEqual(UdpDatagramStartStringLength, static_cast<unsigned long>(::strlen(UdpDatagramStartString)));
@@ -166,12 +199,124 @@ namespace ctsUnitTest
             Assert::AreEqual(MediaStreamAction::START, round_trip.action);
         }
 
+        TEST_METHOD(ConstructNack)
+        {
+            char nack_buffer[UdpDatagramNackMaximumLength]{};
+            ctsMediaStreamNackRange ranges[2];
+            ranges[0].first_sequence_number = 10;
+            ranges[0].frame_count = 1;
+            ranges[1].first_sequence_number = 0x100000000LL;
+            ranges[1].frame_count = 3;
+
+            const ctsIOTask test_task(ctsMediaStreamMessage::MakeNackTask(nack_buffer, ranges, 2));
+            Assert::AreEqual(UdpDatagramNackStringLength + 2 * UdpDatagramNackRangeLength, test_task.buffer_length);
+
+            const ctsMediaStreamMessage round_trip(ctsMediaStreamMessage::Extract(test_task.buffer, test_task.buffer_length));
+            Assert::AreEqual(MediaStreamAction::NACK, round_trip.action);
+            Assert::AreEqual(2UL, round_trip.nack_range_count);
+            Assert::AreEqual(10LL, round_trip.nack_ranges[0].first_sequence_number);
+            Assert::AreEqual(1UL, round_trip.nack_ranges[0].frame_count);
+            Assert::AreEqual(0x100000000LL, round_trip.nack_ranges[1].first_sequence_number);
+            Assert::AreEqual(3UL, round_trip.nack_ranges[1].frame_count);
+        }
+
+        TEST_METHOD(RetransmitFlagInEveryHeader)
+        {
+            ctsMediaStreamSendRequests testbuffer;
+            testbuffer.encode(2 * UdpDatagramMaximumSizeBytes, SequenceNumber, BufferPtr, UdpDatagramProtocolHeaderFlagRetransmit);
+            for (auto& buffer_array : testbuffer) {
+                Assert::AreEqual(UdpDatagramProtocolHeaderFlagRetransmit, *reinterpret_cast<unsigned short*>(buffer_array[0].buf));
+            }
+        }
+
+        TEST_METHOD(FecParityFollowsDataDatagrams)
+        {
+            // 5 datagrams with 2 parity for each group of 4: the last group of 1 has a single parity datagram
+            std::vector<char> frame(5 * UdpDatagramMaximumSizeBytes - 100);
+            ctsMediaStreamSendRequests testbuffer;
+            testbuffer.encode(static_cast<unsigned long>(frame.size()), SequenceNumber, frame.data());
+            testbuffer.add_parity(4, 2);
+            Assert::AreEqual(static_cast<size_t>(5), testbuffer.data_size());
+            Assert::AreEqual(static_cast<size_t>(8), testbuffer.size());
+
+            unsigned long datagram = 0;
+            for (auto& buffer_array : testbuffer) {
+                const auto expected_flag = datagram < 5 ?
+                    static_cast<unsigned short>(UdpDatagramProtocolHeaderFlagFecData | datagram) :
+                    static_cast<unsigned short>(UdpDatagramProtocolHeaderFlagFecParity | (datagram - 5));
+                Assert::AreEqual(expected_flag, *reinterpret_cast<unsigned short*>(buffer_array[0].buf));
+                long long sequence_number;
+                ::memcpy(&sequence_number, buffer_array[0].buf + ctsMediaStreamSendRequests::HeaderSequenceNumberOffset, UdpDatagramSequenceNumberLength);
+                Assert::AreEqual(SequenceNumber, sequence_number);
+                ++datagram;
+            }
+
+            // each parity payload is as long as the first datagram of its stripe
+            const auto* const parity_datagrams = testbuffer.data() + testbuffer.data_size();
+            Assert::AreEqual(ctsMediaStreamFec::ParityHeaderLength + testbuffer.data()[0][1].len, parity_datagrams[0][1].len);
+            Assert::AreEqual(ctsMediaStreamFec::ParityHeaderLength + testbuffer.data()[4][1].len, parity_datagrams[2][1].len);
+        }
+
+        TEST_METHOD(FecRecoversOneDatagramPerStripe)
+        {
+            std::vector<char> frame(5 * UdpDatagramMaximumSizeBytes - 100);
+            for (size_t offset = 0; offset < frame.size(); ++offset) {
+                frame[offset] = static_cast<char>(offset * 7);
+            }
+            ctsMediaStreamSendRequests testbuffer;
+            testbuffer.encode(static_cast<unsigned long>(frame.size()), SequenceNumber, frame.data());
+            testbuffer.add_parity(4, 2);
+
+            ctsMediaStreamFecDecoder decoder(
+                4,
+                2,
+                ctsMediaStreamSendRequests::DatagramCount(static_cast<long long>(frame.size())),
+                UdpDatagramMaximumSizeBytes - UdpDatagramDataHeaderLength,
+                UdpDatagramDataHeaderLength);
+
+            // stripe 0 is datagrams 0 and 2, stripe 1 is datagrams 1 and 3, stripe 2 is datagram 4
+            // - lose one datagram from each, with stripe 1's parity arriving before its remaining datagram
+            const auto* const datagrams = testbuffer.data();
+            unsigned long frame_bytes = 0;
+            frame_bytes += decoder.parity_received(SequenceNumber, 1, datagrams[6][1].buf, datagrams[6][1].len);
+            frame_bytes += decoder.data_received(SequenceNumber, 1, datagrams[1][1].buf, datagrams[1][1].len);
+            frame_bytes += decoder.data_received(SequenceNumber, 2, datagrams[2][1].buf, datagrams[2][1].len);
+            frame_bytes += decoder.parity_received(SequenceNumber, 0, datagrams[5][1].buf, datagrams[5][1].len);
+            frame_bytes += decoder.parity_received(SequenceNumber, 2, datagrams[7][1].buf, datagrams[7][1].len);
+
+            Assert::AreEqual(static_cast<unsigned long>(frame.size()), frame_bytes);
+            Assert::AreEqual(3LL, decoder.recovered_datagrams());
+
+            // a datagram arriving after it was rebuilt is not counted again
+            Assert::AreEqual(0UL, decoder.data_received(SequenceNumber, 0, datagrams[0][1].buf, datagrams[0][1].len));
+            // nor is parity for a stripe which has already seen its parity
+            Assert::AreEqual(0UL, decoder.parity_received(SequenceNumber, 0, datagrams[5][1].buf, datagrams[5][1].len));
+        }
+
+        TEST_METHOD(FecXorMatchesBytewiseXor)
+        {
+            // long enough to cover the unrolled loop, the 16-byte loop and the byte tail
+            std::vector<char> source(211);
+            std::vector<char> target(211);
+            std::vector<char> expected(211);
+            for (size_t offset = 0; offset < source.size(); ++offset) {
+                source[offset] = static_cast<char>(offset * 13);
+                target[offset] = static_cast<char>(offset * 5 + 1);
+                expected[offset] = static_cast<char>(source[offset] ^ target[offset]);
+            }
+            ctsMediaStreamFec::XorInto(target.data(), source.data(), target.size());
+            Assert::IsTrue(expected == target);
+        }
+
     private:
         void verify_protocol_header(ctsMediaStreamSendRequests& _testbuffer) const
         {
             for (auto& buffer_array : _testbuffer) {
-                Assert::AreEqual(UdpDatagramProtocolHeaderFlagLength, buffer_array[0].len);
+                Assert::AreEqual(UdpDatagramDataHeaderLength, buffer_array[0].len);
                 Assert::AreEqual(UdpDatagramProtocolHeaderFlagData, *reinterpret_cast<unsigned short*>(buffer_array[0].buf));
+                long long sequence_number;
+                ::memcpy(&sequence_number, buffer_array[0].buf + ctsMediaStreamSendRequests::HeaderSequenceNumberOffset, UdpDatagramSequenceNumberLength);
+                Assert::AreEqual(SequenceNumber, sequence_number);
             }
         }
         unsigned long verify_byte_count(ctsMediaStreamSendRequests& _testbuffer, unsigned long _buffer_size) const
@@ -0,0 +1,128 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <thread>
+
+#include <wil/resource.h>
+#include <ctTimer.hpp>
+#include <ctMemoryGuard.hpp>
+
+#include "ctsMediaStreamSendScheduler.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ctsTraffic;
+
+namespace ctsUnitTest
+{
+    TEST_CLASS(ctsMediaStreamSendSchedulerUnitTest)
+    {
+        // the stream's context: counts callbacks, optionally blocking each one and scheduling the next frame
+        struct TestStream
+        {
+            explicit TestStream(ctsMediaStreamSendScheduler::Worker& _worker) :
+                worker(_worker),
+                stream(Callback, this)
+            {
+            }
+
+            ctsMediaStreamSendScheduler::Worker& worker;
+            ctsMediaStreamSendScheduler::Stream stream;
+            long callback_count = 0;
+            bool block_callback = false;
+            bool reschedule = false;
+            wil::unique_event callback_started{ wil::EventOptions::ManualReset };
+            wil::unique_event callback_released{ wil::EventOptions::ManualReset };
+
+            static void Callback(_In_ PVOID _context) noexcept
+            {
+                auto* const this_ptr = static_cast<TestStream*>(_context);
+                ctl::ctMemoryGuardIncrement(&this_ptr->callback_count);
+                this_ptr->callback_started.SetEvent();
+                if (this_ptr->block_callback)
+                {
+                    this_ptr->callback_released.wait();
+                }
+                if (this_ptr->reschedule)
+                {
+                    // the media stream server schedules its next frame from within the send callback
+                    this_ptr->worker.schedule(this_ptr->stream, ctl::ctTimer::ctSnapQpcInMillis());
+                }
+            }
+        };
+
+    public:
+        TEST_METHOD(CallbackRunsWhenDue)
+        {
+            ctsMediaStreamSendScheduler::Worker worker(nullptr);
+            TestStream test_stream(worker);
+
+            worker.schedule(test_stream.stream, ctl::ctTimer::ctSnapQpcInMillis() + 10);
+            Assert::IsTrue(test_stream.callback_started.wait(5000));
+            worker.cancel(test_stream.stream);
+            Assert::AreEqual(1L, ctl::ctMemoryGuardRead(&test_stream.callback_count));
+        }
+
+        TEST_METHOD(CancelRemovesAScheduledStream)
+        {
+            ctsMediaStreamSendScheduler::Worker worker(nullptr);
+            TestStream test_stream(worker);
+
+            worker.schedule(test_stream.stream, ctl::ctTimer::ctSnapQpcInMillis() + 100);
+            worker.cancel(test_stream.stream);
+            Assert::IsFalse(test_stream.callback_started.wait(300));
+            Assert::AreEqual(0L, ctl::ctMemoryGuardRead(&test_stream.callback_count));
+        }
+
+        TEST_METHOD(ScheduleAfterCancelIsIgnored)
+        {
+            ctsMediaStreamSendScheduler::Worker worker(nullptr);
+            TestStream test_stream(worker);
+
+            worker.cancel(test_stream.stream);
+            worker.schedule(test_stream.stream, ctl::ctTimer::ctSnapQpcInMillis());
+            Assert::IsFalse(test_stream.callback_started.wait(200));
+            Assert::AreEqual(0L, ctl::ctMemoryGuardRead(&test_stream.callback_count));
+        }
+
+        TEST_METHOD(CancelDuringRunningTickIsNotRescheduled)
+        {
+            ctsMediaStreamSendScheduler::Worker worker(nullptr);
+            TestStream test_stream(worker);
+            test_stream.block_callback = true;
+            test_stream.reschedule = true;
+
+            worker.schedule(test_stream.stream, ctl::ctTimer::ctSnapQpcInMillis());
+            Assert::IsTrue(test_stream.callback_started.wait(5000));
+
+            // cancel must wait for the running callback, which then schedules its next frame
+            wil::unique_event cancel_returned{ wil::EventOptions::ManualReset };
+            std::thread cancel_thread([&]() noexcept {
+                worker.cancel(test_stream.stream);
+                cancel_returned.SetEvent();
+            });
+            Assert::IsFalse(cancel_returned.wait(100));
+
+            test_stream.callback_released.SetEvent();
+            Assert::IsTrue(cancel_returned.wait(5000));
+            cancel_thread.join();
+
+            // the frame scheduled by the running callback was due immediately: it must not be sent once canceled
+            test_stream.callback_started.ResetEvent();
+            Assert::IsFalse(test_stream.callback_started.wait(300));
+            Assert::AreEqual(1L, ctl::ctMemoryGuardRead(&test_stream.callback_count));
+        }
+    };
+}
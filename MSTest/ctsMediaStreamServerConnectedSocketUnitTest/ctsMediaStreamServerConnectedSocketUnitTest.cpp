@@ -219,7 +219,7 @@ namespace ctsTraffic
 
     void ctsSocket::set_socket(SOCKET _s) noexcept
     {
-        this->socket.reset(_s);
+        this->socket_handle = _s;
     }
 
     void ctsSocket::complete_state(unsigned long) noexcept
@@ -227,7 +227,7 @@ namespace ctsTraffic
         ::SetEvent(s_RemovedSocketEvent);
     }
 
-    std::shared_ptr<ctsIOPattern> ctsSocket::io_pattern() const noexcept
+    const std::shared_ptr<ctsIOPattern>& ctsSocket::io_pattern() const noexcept
     {
         return this->pattern;
     }
@@ -0,0 +1,257 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <vector>
+
+#include "ctsPatternSegments.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ctsTraffic;
+
+namespace ctsUnitTest
+{
+    TEST_CLASS(ctsPatternSegmentsUnitTest)
+    {
+        static std::vector<char> MakePattern(unsigned long pattern_size)
+        {
+            std::vector<char> pattern(pattern_size);
+            for (unsigned long offset = 0; offset < pattern_size; ++offset)
+            {
+                pattern[offset] = static_cast<char>(offset * 7 + 1);
+            }
+            return pattern;
+        }
+
+        static ctsIOTask MakeSendTask(std::vector<char>& pattern, unsigned long pattern_offset, unsigned long length)
+        {
+            ctsIOTask task;
+            task.ioAction = IOTaskAction::Send;
+            task.buffer = pattern.data();
+            task.buffer_offset = pattern_offset;
+            task.buffer_length = length;
+            task.expected_pattern_offset = pattern_offset;
+            ctsPatternSegments::SegmentSend(task, pattern.data(), static_cast<unsigned long>(pattern.size()), pattern_offset, length);
+            return task;
+        }
+
+        // copies the bytes the task would send into one contiguous buffer, as the receiver would see them
+        static std::vector<char> Flatten(const ctsIOTask& task)
+        {
+            WSABUF segments[ctsIOTask::MaxBufferSegments];
+            const auto segment_count = task.fill_wsabufs(segments);
+
+            std::vector<char> flattened;
+            for (unsigned long segment = 0; segment < segment_count; ++segment)
+            {
+                flattened.insert(flattened.end(), segments[segment].buf, segments[segment].buf + segments[segment].len);
+            }
+            return flattened;
+        }
+
+        static ctsIOTask MakeRecvTask(std::vector<char>& received, unsigned long expected_pattern_offset)
+        {
+            ctsIOTask task;
+            task.ioAction = IOTaskAction::Recv;
+            task.buffer = received.data();
+            task.buffer_offset = 0;
+            task.buffer_length = static_cast<unsigned long>(received.size());
+            task.expected_pattern_offset = expected_pattern_offset;
+            return task;
+        }
+
+    public:
+        TEST_METHOD(SendWithinThePatternIsNotSegmented)
+        {
+            auto pattern = MakePattern(16);
+            const auto task = MakeSendTask(pattern, 4, 12);
+            Assert::AreEqual(0UL, task.buffer_segment_count);
+
+            WSABUF segments[ctsIOTask::MaxBufferSegments];
+            Assert::AreEqual(1UL, task.fill_wsabufs(segments));
+            Assert::IsTrue(pattern.data() + 4 == segments[0].buf);
+            Assert::AreEqual(12UL, segments[0].len);
+        }
+
+        TEST_METHOD(SendSpanningTwoCopiesWrapsToTheStart)
+        {
+            auto pattern = MakePattern(16);
+            const auto task = MakeSendTask(pattern, 10, 16);
+            Assert::AreEqual(2UL, task.buffer_segment_count);
+
+            Assert::IsTrue(pattern.data() + 10 == task.buffer_segments[0].buf);
+            Assert::AreEqual(6UL, task.buffer_segments[0].len);
+            Assert::IsTrue(pattern.data() == task.buffer_segments[1].buf);
+            Assert::AreEqual(10UL, task.buffer_segments[1].len);
+
+            const auto sent = Flatten(task);
+            Assert::AreEqual(static_cast<size_t>(16), sent.size());
+            for (size_t offset = 0; offset < sent.size(); ++offset)
+            {
+                Assert::AreEqual(pattern[(10 + offset) % 16], sent[offset]);
+            }
+        }
+
+        TEST_METHOD(SendSpanningFourCopiesUsesEverySegment)
+        {
+            auto pattern = MakePattern(16);
+            // the longest send which can be segmented, starting on the last byte of the pattern
+            const auto task = MakeSendTask(pattern, 15, 3 * 16);
+            Assert::AreEqual(ctsIOTask::MaxBufferSegments, task.buffer_segment_count);
+
+            Assert::IsTrue(pattern.data() + 15 == task.buffer_segments[0].buf);
+            Assert::AreEqual(1UL, task.buffer_segments[0].len);
+            Assert::IsTrue(pattern.data() == task.buffer_segments[1].buf);
+            Assert::AreEqual(16UL, task.buffer_segments[1].len);
+            Assert::IsTrue(pattern.data() == task.buffer_segments[2].buf);
+            Assert::AreEqual(16UL, task.buffer_segments[2].len);
+            Assert::IsTrue(pattern.data() == task.buffer_segments[3].buf);
+            Assert::AreEqual(15UL, task.buffer_segments[3].len);
+
+            const auto sent = Flatten(task);
+            Assert::AreEqual(static_cast<size_t>(3 * 16), sent.size());
+            for (size_t offset = 0; offset < sent.size(); ++offset)
+            {
+                Assert::AreEqual(pattern[(15 + offset) % 16], sent[offset]);
+            }
+        }
+
+        TEST_METHOD(SendSpanningThreeCopiesAtTheFullPatternSize)
+        {
+            auto pattern = MakePattern(ctsPatternSegments::BufferPatternSize);
+            const auto task = MakeSendTask(pattern, ctsPatternSegments::BufferPatternSize / 2, 2 * ctsPatternSegments::BufferPatternSize);
+            Assert::AreEqual(3UL, task.buffer_segment_count);
+            Assert::AreEqual(ctsPatternSegments::BufferPatternSize / 2, task.buffer_segments[0].len);
+            Assert::AreEqual(ctsPatternSegments::BufferPatternSize, task.buffer_segments[1].len);
+            Assert::AreEqual(ctsPatternSegments::BufferPatternSize / 2, task.buffer_segments[2].len);
+        }
+
+        TEST_METHOD(MaxBufferSizeBoundary)
+        {
+            constexpr unsigned long largest_segmented_send = (ctsIOTask::MaxBufferSegments - 1) * ctsPatternSegments::BufferPatternSize;
+            Assert::AreEqual(3UL * 0x10000UL, largest_segmented_send);
+
+            Assert::IsTrue(ctsPatternSegments::CanSegmentSends(ctsPatternSegments::BufferPatternSize));
+            Assert::IsTrue(ctsPatternSegments::CanSegmentSends(largest_segmented_send));
+            Assert::IsFalse(ctsPatternSegments::CanSegmentSends(largest_segmented_send + 1));
+
+            // the largest send from the worst offset still fits in MaxBufferSegments
+            auto pattern = MakePattern(ctsPatternSegments::BufferPatternSize);
+            const auto task = MakeSendTask(pattern, ctsPatternSegments::BufferPatternSize - 1, largest_segmented_send);
+            Assert::AreEqual(ctsIOTask::MaxBufferSegments, task.buffer_segment_count);
+
+            unsigned long total = 0;
+            for (unsigned long segment = 0; segment < task.buffer_segment_count; ++segment)
+            {
+                total += task.buffer_segments[segment].len;
+            }
+            Assert::AreEqual(largest_segmented_send, total);
+        }
+
+        TEST_METHOD(CompareMatchesAcrossTheWrap)
+        {
+            const auto pattern = MakePattern(16);
+            std::vector<char> received(40);
+            for (size_t offset = 0; offset < received.size(); ++offset)
+            {
+                received[offset] = pattern[(12 + offset) % 16];
+            }
+
+            ctsPatternSegments::Mismatch mismatch;
+            const auto task = MakeRecvTask(received, 12);
+            Assert::IsTrue(ctsPatternSegments::Compare(task, 40, pattern.data(), 16, mismatch));
+            Assert::IsNull(mismatch.received);
+
+            // expected_pattern_offset keeps counting past the pattern size
+            const auto later_task = MakeRecvTask(received, 12 + 5 * 16);
+            Assert::IsTrue(ctsPatternSegments::Compare(later_task, 40, pattern.data(), 16, mismatch));
+        }
+
+        TEST_METHOD(CompareReportsAMismatchAfterTheWrap)
+        {
+            const auto pattern = MakePattern(16);
+            std::vector<char> received(20);
+            for (size_t offset = 0; offset < received.size(); ++offset)
+            {
+                received[offset] = pattern[(12 + offset) % 16];
+            }
+            // 4 bytes before the wrap, then 3 matching bytes of the next copy
+            received[7] = static_cast<char>(~received[7]);
+
+            ctsPatternSegments::Mismatch mismatch;
+            const auto task = MakeRecvTask(received, 12);
+            Assert::IsFalse(ctsPatternSegments::Compare(task, 20, pattern.data(), 16, mismatch));
+            Assert::IsTrue(received.data() + 4 == mismatch.received);
+            Assert::IsTrue(pattern.data() == mismatch.expected);
+            Assert::AreEqual(static_cast<size_t>(3), mismatch.matched_length);
+        }
+
+        TEST_METHOD(CompareOnlyChecksTransferredBytes)
+        {
+            const auto pattern = MakePattern(16);
+            std::vector<char> received(20);
+            for (size_t offset = 0; offset < received.size(); ++offset)
+            {
+                received[offset] = pattern[offset % 16];
+            }
+            received[19] = static_cast<char>(~received[19]);
+
+            ctsPatternSegments::Mismatch mismatch;
+            const auto task = MakeRecvTask(received, 0);
+            Assert::IsTrue(ctsPatternSegments::Compare(task, 19, pattern.data(), 16, mismatch));
+            Assert::IsFalse(ctsPatternSegments::Compare(task, 20, pattern.data(), 16, mismatch));
+        }
+
+        TEST_METHOD(CompareWalksSegmentedBuffers)
+        {
+            auto pattern = MakePattern(16);
+            // a segmented send verifies against its own pattern
+            auto task = MakeSendTask(pattern, 15, 3 * 16);
+
+            ctsPatternSegments::Mismatch mismatch;
+            Assert::IsTrue(ctsPatternSegments::Compare(task, 3 * 16, pattern.data(), 16, mismatch));
+
+            // segments of a recv don't have to line up with the pattern
+            std::vector<char> first(5);
+            std::vector<char> second(30);
+            for (size_t offset = 0; offset < first.size(); ++offset)
+            {
+                first[offset] = pattern[(9 + offset) % 16];
+            }
+            for (size_t offset = 0; offset < second.size(); ++offset)
+            {
+                second[offset] = pattern[(9 + first.size() + offset) % 16];
+            }
+
+            ctsIOTask recv_task;
+            recv_task.ioAction = IOTaskAction::Recv;
+            recv_task.buffer = first.data();
+            recv_task.buffer_length = 35;
+            recv_task.expected_pattern_offset = 9;
+            recv_task.buffer_segment_count = 2;
+            recv_task.buffer_segments[0].buf = first.data();
+            recv_task.buffer_segments[0].len = 5;
+            recv_task.buffer_segments[1].buf = second.data();
+            recv_task.buffer_segments[1].len = 30;
+            Assert::IsTrue(ctsPatternSegments::Compare(recv_task, 35, pattern.data(), 16, mismatch));
+
+            second[29] = static_cast<char>(~second[29]);
+            Assert::IsFalse(ctsPatternSegments::Compare(recv_task, 35, pattern.data(), 16, mismatch));
+            // the second segment starts 2 bytes before the wrap: compared as 2, 16, then 12 bytes
+            Assert::IsTrue(second.data() + 18 == mismatch.received);
+            Assert::AreEqual(static_cast<size_t>(11), mismatch.matched_length);
+        }
+    };
+}
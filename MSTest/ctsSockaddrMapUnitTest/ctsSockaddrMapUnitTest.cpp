@@ -0,0 +1,182 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include <memory>
+
+#include <ctSockaddr.hpp>
+
+#include "ctsSockaddrMap.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ctsTraffic;
+
+namespace ctsUnitTest
+{
+    TEST_CLASS(ctsSockaddrMapUnitTest)
+    {
+        static ctl::ctSockaddr MakeAddress(PCWSTR address, unsigned short port)
+        {
+            ctl::ctSockaddr sockaddr;
+            Assert::IsTrue(sockaddr.SetAddress(address));
+            sockaddr.SetPort(port);
+            return sockaddr;
+        }
+
+    public:
+        TEST_CLASS_INITIALIZE(Setup)
+        {
+            WSADATA wsa;
+            const int startup = ::WSAStartup(WINSOCK_VERSION, &wsa);
+            Assert::AreEqual(0, startup);
+        }
+        TEST_CLASS_CLEANUP(Cleanup)
+        {
+            ::WSACleanup();
+        }
+
+        TEST_METHOD(FindReturnsNullWhenEmpty)
+        {
+            ctsSockaddrMap<int> map;
+            Assert::IsNull(map.find(MakeAddress(L"10.0.0.1", 5000)).get());
+            Assert::IsNull(map.remove(MakeAddress(L"10.0.0.1", 5000)).get());
+        }
+
+        TEST_METHOD(InsertFindRemoveV4)
+        {
+            ctsSockaddrMap<int> map;
+            const auto address = MakeAddress(L"10.0.0.1", 5000);
+
+            Assert::IsTrue(map.insert(address, std::make_shared<int>(1)));
+            const auto found = map.find(address);
+            Assert::IsNotNull(found.get());
+            Assert::AreEqual(1, *found);
+
+            const auto removed = map.remove(address);
+            Assert::IsTrue(found == removed);
+            Assert::IsNull(map.find(address).get());
+            Assert::IsNull(map.remove(address).get());
+        }
+
+        TEST_METHOD(InsertFindRemoveV6)
+        {
+            ctsSockaddrMap<int> map;
+            const auto address = MakeAddress(L"fe80::1:2:3:4", 5000);
+
+            Assert::IsTrue(map.insert(address, std::make_shared<int>(1)));
+            const auto found = map.find(address);
+            Assert::IsNotNull(found.get());
+            Assert::AreEqual(1, *found);
+
+            const auto removed = map.remove(address);
+            Assert::IsTrue(found == removed);
+            Assert::IsNull(map.find(address).get());
+        }
+
+        TEST_METHOD(InsertDoesNotReplaceAnExistingEntry)
+        {
+            ctsSockaddrMap<int> map;
+            const auto address = MakeAddress(L"10.0.0.1", 5000);
+
+            Assert::IsTrue(map.insert(address, std::make_shared<int>(1)));
+            Assert::IsFalse(map.insert(address, std::make_shared<int>(2)));
+            Assert::AreEqual(1, *map.find(address));
+        }
+
+        TEST_METHOD(AddressesDifferingOnlyInPortAreSeparateV4)
+        {
+            ctsSockaddrMap<int> map;
+            const auto first = MakeAddress(L"10.0.0.1", 5000);
+            const auto second = MakeAddress(L"10.0.0.1", 5001);
+
+            Assert::IsTrue(map.insert(first, std::make_shared<int>(1)));
+            Assert::IsNull(map.find(second).get());
+            Assert::IsTrue(map.insert(second, std::make_shared<int>(2)));
+            Assert::AreEqual(1, *map.find(first));
+            Assert::AreEqual(2, *map.find(second));
+
+            Assert::AreEqual(1, *map.remove(first));
+            Assert::IsNull(map.find(first).get());
+            Assert::AreEqual(2, *map.find(second));
+        }
+
+        TEST_METHOD(AddressesDifferingOnlyInPortAreSeparateV6)
+        {
+            ctsSockaddrMap<int> map;
+            const auto first = MakeAddress(L"2001:db8::1", 5000);
+            const auto second = MakeAddress(L"2001:db8::1", 5001);
+
+            Assert::IsTrue(map.insert(first, std::make_shared<int>(1)));
+            Assert::IsNull(map.find(second).get());
+            Assert::IsTrue(map.insert(second, std::make_shared<int>(2)));
+            Assert::AreEqual(1, *map.find(first));
+            Assert::AreEqual(2, *map.find(second));
+
+            Assert::AreEqual(2, *map.remove(second));
+            Assert::AreEqual(1, *map.find(first));
+            Assert::IsNull(map.find(second).get());
+        }
+
+        TEST_METHOD(V4AndV6KeysAreSeparate)
+        {
+            ctsSockaddrMap<int> map;
+            const auto v4 = MakeAddress(L"10.0.0.1", 5000);
+            const auto v4_mapped = MakeAddress(L"::ffff:10.0.0.1", 5000);
+
+            Assert::IsTrue(map.insert(v4, std::make_shared<int>(4)));
+            Assert::IsTrue(map.insert(v4_mapped, std::make_shared<int>(6)));
+            Assert::AreEqual(4, *map.find(v4));
+            Assert::AreEqual(6, *map.find(v4_mapped));
+        }
+
+        TEST_METHOD(ManyEntriesAcrossShards)
+        {
+            ctsSockaddrMap<int> map;
+            for (int port = 1; port <= 2000; ++port)
+            {
+                Assert::IsTrue(map.insert(MakeAddress(L"10.0.0.1", static_cast<unsigned short>(port)), std::make_shared<int>(port)));
+                Assert::IsTrue(map.insert(MakeAddress(L"2001:db8::1", static_cast<unsigned short>(port)), std::make_shared<int>(-port)));
+            }
+
+            for (int port = 1; port <= 2000; ++port)
+            {
+                Assert::AreEqual(port, *map.find(MakeAddress(L"10.0.0.1", static_cast<unsigned short>(port))));
+                Assert::AreEqual(-port, *map.find(MakeAddress(L"2001:db8::1", static_cast<unsigned short>(port))));
+            }
+
+            // remove every other port: the rest must still be found
+            for (int port = 1; port <= 2000; port += 2)
+            {
+                Assert::AreEqual(port, *map.remove(MakeAddress(L"10.0.0.1", static_cast<unsigned short>(port))));
+                Assert::AreEqual(-port, *map.remove(MakeAddress(L"2001:db8::1", static_cast<unsigned short>(port))));
+            }
+            for (int port = 1; port <= 2000; ++port)
+            {
+                const auto v4 = map.find(MakeAddress(L"10.0.0.1", static_cast<unsigned short>(port)));
+                const auto v6 = map.find(MakeAddress(L"2001:db8::1", static_cast<unsigned short>(port)));
+                if (port % 2 == 1)
+                {
+                    Assert::IsNull(v4.get());
+                    Assert::IsNull(v6.get());
+                }
+                else
+                {
+                    Assert::AreEqual(port, *v4);
+                    Assert::AreEqual(-port, *v6);
+                }
+            }
+        }
+    };
+}
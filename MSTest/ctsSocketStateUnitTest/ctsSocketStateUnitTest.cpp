@@ -84,6 +84,13 @@ namespace ctsTraffic {
         {
             return false;
         }
+        void ReleaseLocalPort(const LocalPortLease&, bool) noexcept
+        {
+        }
+        PTP_CALLBACK_ENVIRON NextConnectionThreadpoolEnvironment() noexcept
+        {
+            return Settings->PTPEnvironment;
+        }
         bool ShutdownCalled() noexcept
         {
             return false;
@@ -110,6 +117,9 @@ namespace ctsTraffic {
 using namespace ctsTraffic;
 
 static long s_CallbackCount = 0L;
+// tracks which threads ran the hooks: inline completions should never hop threads
+static long s_FirstCallbackThreadId = 0L;
+static long s_CallbacksOnOtherThreads = 0L;
 
 static DWORD s_CreateReturnCode = 0UL;
 static DWORD s_ConnectReturnCode = 0UL;
@@ -118,11 +128,23 @@ static DWORD s_ShouldNeverHitErrorCode = 0xffffffffUL;
 void ResetStatics(DWORD _create = s_ShouldNeverHitErrorCode, DWORD _connect = s_ShouldNeverHitErrorCode, DWORD _io = s_ShouldNeverHitErrorCode)
 {
     s_CallbackCount = 0L;
+    s_FirstCallbackThreadId = 0L;
+    s_CallbacksOnOtherThreads = 0L;
     s_CreateReturnCode = _create;
     s_ConnectReturnCode = _connect;
     s_IOReturnCode = _io;
 }
 
+void TrackCallbackThread() noexcept
+{
+    const auto current_thread = static_cast<long>(::GetCurrentThreadId());
+    const long first_thread = ::InterlockedCompareExchange(&s_FirstCallbackThreadId, current_thread, 0L);
+    if (first_thread != 0L && first_thread != current_thread)
+    {
+        ctl::ctMemoryGuardIncrement(&s_CallbacksOnOtherThreads);
+    }
+}
+
 void CreateFunctionHook(std::weak_ptr<ctsSocket> _socket) noexcept
 {
     auto shared_socket(_socket.lock());
@@ -131,6 +153,7 @@ void CreateFunctionHook(std::weak_ptr<ctsSocket> _socket) noexcept
     Assert::AreNotEqual(s_ShouldNeverHitErrorCode, s_CreateReturnCode);
 
     ctl::ctMemoryGuardIncrement(&s_CallbackCount);
+    TrackCallbackThread();
     if (shared_socket) {
         shared_socket->complete_state(s_CreateReturnCode);
     }
@@ -148,6 +171,7 @@ void ConnectFunctionHook(std::weak_ptr<ctsSocket> _socket) noexcept
     shared_socket->set_socket(s);
 
     ctl::ctMemoryGuardIncrement(&s_CallbackCount);
+    TrackCallbackThread();
     if (shared_socket) {
         shared_socket->complete_state(s_ConnectReturnCode);
     }
@@ -161,6 +185,7 @@ void IoFunctionHook(std::weak_ptr<ctsSocket> _socket) noexcept
     Assert::AreNotEqual(s_ShouldNeverHitErrorCode, s_IOReturnCode);
 
     ctl::ctMemoryGuardIncrement(&s_CallbackCount);
+    TrackCallbackThread();
     if (shared_socket) {
         shared_socket->complete_state(s_IOReturnCode);
     }
@@ -203,6 +228,23 @@ namespace ctsUnitTest {
             Assert::AreEqual(3L, ctl::ctMemoryGuardRead(&s_CallbackCount));
         }
 
+        TEST_METHOD(InlineCompletionsStayOnOneThread)
+        {
+            // every hook completes inline - the state machine should run each following state
+            // from the same threadpool callback instead of submitting new work per state
+            ResetStatics(0, 0, 0);
+
+            std::shared_ptr<ctsSocketState> test(std::make_shared<ctsSocketState>(std::weak_ptr<ctsSocketBroker>()));
+            test->start();
+
+            do {
+                ::Sleep(100);
+            } while (ctsSocketState::InternalState::Closed != test->current_state());
+
+            Assert::AreEqual(3L, ctl::ctMemoryGuardRead(&s_CallbackCount));
+            Assert::AreEqual(0L, ctl::ctMemoryGuardRead(&s_CallbacksOnOtherThreads));
+        }
+
         TEST_METHOD(CreateFails)
         {
             // create should fail, the others never invoked
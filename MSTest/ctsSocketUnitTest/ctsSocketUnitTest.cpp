@@ -103,6 +103,9 @@ namespace ctsTraffic
                 ctl::ctString::ctFormatString(L"ctsConfig::PrintException(%ws)",
                     ctl::ctString::ctFormatException(e).c_str()).c_str());
         }
+        void ReleaseLocalPort(const LocalPortLease&, bool) noexcept
+        {
+        }
         bool ShutdownCalled() noexcept
         {
             return false;
@@ -214,6 +217,36 @@ namespace ctsUnitTest
             Assert::AreEqual(static_cast<int>(WSAENOTSOCK), gle);
         }
 
+        TEST_METHOD(CloseSocketWaitsForReferences)
+        {
+            const auto socket_value(this->create_socket());
+
+            shared_ptr<ctsSocketState> default_socket_state_object;
+            shared_ptr<ctsSocket> test(make_shared<ctsSocket>(default_socket_state_object));
+
+            test->set_socket(socket_value);
+            ctl::ctSockaddr local_addr(AF_INET, ctl::ctSockaddr::AddressType::Loopback);
+            {
+                const auto socket_guard(test->socket_reference());
+                test->close_socket();
+
+                // new references no longer see the socket
+                {
+                    const auto closed_guard(test->socket_reference());
+                    Assert::AreEqual(INVALID_SOCKET, closed_guard.socket());
+                }
+
+                // but the socket is still open for the reference taken before close_socket
+                Assert::AreEqual(0, ::bind(socket_guard.socket(), local_addr.sockaddr(), local_addr.length()));
+            }
+
+            // releasing the last reference closed the socket
+            const auto error = ::bind(socket_value, local_addr.sockaddr(), local_addr.length());
+            const auto gle = ::WSAGetLastError();
+            Assert::AreEqual(SOCKET_ERROR, error);
+            Assert::AreEqual(static_cast<int>(WSAENOTSOCK), gle);
+        }
+
         TEST_METHOD(ThreadPool)
         {
             const auto socket_value(this->create_socket());
@@ -14,7 +14,10 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <SDKDDKVer.h>
 #include "CppUnitTest.h"
 
+#include <algorithm>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include <ctString.hpp>
 
@@ -119,5 +122,175 @@ namespace ctsUnitTest
             ctsUdpStatistics udp_stats;
             ctsConnectionStatistics conn_stats;
         }
+
+        TEST_METHOD(ShardedTrackingSumsAcrossThreads)
+        {
+            ctStatsShardedTracking sharded_stats;
+            Assert::AreEqual(0LL, sharded_stats.get());
+
+            constexpr long long thread_count = 8;
+            constexpr long long adds_per_thread = 10000;
+            std::vector<std::thread> threads;
+            for (auto count = 0; count < thread_count; ++count)
+            {
+                threads.emplace_back([&sharded_stats] {
+                    for (auto add = 0; add < adds_per_thread; ++add)
+                    {
+                        sharded_stats.add(2);
+                        sharded_stats.increment();
+                    }
+                });
+            }
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+
+            Assert::AreEqual(thread_count * adds_per_thread * 3, sharded_stats.get());
+        }
+
+        TEST_METHOD(CurrentProcessorIndexIsUniqueAcrossGroups)
+        {
+            std::vector<unsigned long> indexes;
+            GROUP_AFFINITY original_affinity{};
+            Assert::IsTrue(!!GetThreadGroupAffinity(GetCurrentThread(), &original_affinity));
+
+            // run on every active processor of every group in turn
+            const WORD group_count = GetActiveProcessorGroupCount();
+            for (WORD group = 0; group < group_count; ++group)
+            {
+                for (BYTE number = 0; number < 64; ++number)
+                {
+                    GROUP_AFFINITY affinity{};
+                    affinity.Group = group;
+                    affinity.Mask = static_cast<KAFFINITY>(1) << number;
+                    if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr))
+                    {
+                        // not an active processor
+                        continue;
+                    }
+                    indexes.push_back(ctsStatistics::CurrentProcessorIndex());
+                }
+            }
+            Assert::IsTrue(!!SetThreadGroupAffinity(GetCurrentThread(), &original_affinity, nullptr));
+
+            Assert::AreEqual(static_cast<size_t>(GetActiveProcessorCount(ALL_PROCESSOR_GROUPS)), indexes.size());
+            std::sort(indexes.begin(), indexes.end());
+            Assert::IsTrue(std::adjacent_find(indexes.begin(), indexes.end()) == indexes.end());
+        }
+
+        TEST_METHOD(ShardedTrackingValueDifference)
+        {
+            ctStatsShardedTracking sharded_stats;
+            sharded_stats.add(100);
+            Assert::AreEqual(100LL, sharded_stats.read_value_difference());
+            Assert::AreEqual(100LL, sharded_stats.snap_value_difference());
+            Assert::AreEqual(0LL, sharded_stats.read_value_difference());
+
+            sharded_stats.add(50);
+            Assert::AreEqual(50LL, sharded_stats.snap_value_difference());
+            Assert::AreEqual(150LL, sharded_stats.get());
+        }
+
+        TEST_METHOD(GlobalTcpSnapView)
+        {
+            ctsGlobalTcpStatistics global_stats;
+            global_stats.bytes_sent.add(1000);
+            global_stats.bytes_recv.add(2000);
+
+            const ctsTcpStatistics first_view(global_stats.snap_view(true));
+            Assert::AreEqual(1000LL, first_view.bytes_sent.get());
+            Assert::AreEqual(2000LL, first_view.bytes_recv.get());
+
+            global_stats.bytes_sent.add(10);
+            const ctsTcpStatistics second_view(global_stats.snap_view(false));
+            Assert::AreEqual(10LL, second_view.bytes_sent.get());
+            Assert::AreEqual(0LL, second_view.bytes_recv.get());
+        }
+
+        TEST_METHOD(TimeSeriesTracksIntervals)
+        {
+            ctsConnectionTimeSeries time_series(100, 4);
+            Assert::AreEqual(0UL, time_series.sample_count());
+
+            // the first IO starts the clock and opens interval 0
+            Assert::IsTrue(time_series.add_bytes(1000, 10));
+            Assert::IsFalse(time_series.add_bytes(1050, 20));
+            time_series.set_rtt(250);
+            // nothing completes in interval 1 : a stall is a gap in the interval index
+            Assert::IsTrue(time_series.add_bytes(1250, 5));
+
+            Assert::AreEqual(2UL, time_series.sample_count());
+            Assert::AreEqual(0ULL, time_series.overwritten_samples());
+
+            std::vector<ctsTimeSeriesSample> samples;
+            time_series.for_each_sample([&](const ctsTimeSeriesSample& _sample) { samples.push_back(_sample); });
+            Assert::AreEqual(size_t(2), samples.size());
+            Assert::AreEqual(0UL, samples[0].interval);
+            Assert::AreEqual(30LL, samples[0].bytes);
+            Assert::AreEqual(250UL, samples[0].rtt_microseconds);
+            Assert::AreEqual(2UL, samples[1].interval);
+            Assert::AreEqual(5LL, samples[1].bytes);
+            Assert::AreEqual(0UL, samples[1].rtt_microseconds);
+        }
+
+        TEST_METHOD(TimeSeriesOverwritesOldestSamples)
+        {
+            ctsConnectionTimeSeries time_series(10, 4);
+            for (long long interval = 0; interval < 6; ++interval)
+            {
+                Assert::IsTrue(time_series.add_bytes(1 + interval * 10, interval + 1));
+            }
+
+            Assert::AreEqual(4UL, time_series.sample_count());
+            Assert::AreEqual(2ULL, time_series.overwritten_samples());
+
+            unsigned long expected_interval = 2;
+            time_series.for_each_sample([&](const ctsTimeSeriesSample& _sample) {
+                Assert::AreEqual(expected_interval, _sample.interval);
+                Assert::AreEqual(static_cast<long long>(expected_interval + 1), _sample.bytes);
+                ++expected_interval;
+            });
+            Assert::AreEqual(6UL, expected_interval);
+        }
+
+        TEST_METHOD(ConnectionSnapViewIsConsistent)
+        {
+            ctsConnectionStatistics connection_stats;
+            constexpr long long thread_count = 4;
+            constexpr long long connections_per_thread = 10000;
+            connection_stats.active_connection_count.set(thread_count * connections_per_thread);
+
+            std::vector<std::thread> threads;
+            for (auto count = 0; count < thread_count; ++count)
+            {
+                threads.emplace_back([&connection_stats] {
+                    for (auto connection = 0; connection < connections_per_thread; ++connection)
+                    {
+                        {
+                            const auto stats_update = connection_stats.snapshot_guard.begin_update();
+                            connection_stats.active_connection_count.decrement();
+                            connection_stats.successful_completion_count.increment();
+                        }
+                        // leave windows with no writers in flight, as real connection closes do
+                        std::this_thread::yield();
+                    }
+                });
+            }
+
+            for (auto snap = 0; snap < 1000; ++snap)
+            {
+                const ctsConnectionStatistics view(connection_stats.snap_view(false));
+                Assert::AreEqual(
+                    thread_count * connections_per_thread,
+                    view.active_connection_count.get() + view.successful_completion_count.get());
+            }
+
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+            Assert::AreEqual(0LL, connection_stats.active_connection_count.get());
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#include <SDKDDKVer.h>
+#include "CppUnitTest.h"
+
+#include "ctsUdpBlastProtocol.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ctsTraffic;
+
+namespace ctsUnitTest
+{
+    TEST_CLASS(ctsUdpBlastSequenceTrackerUnitTest)
+    {
+        static ctsUdpBlastHeader MakeHeader(unsigned long long stream_id, long long sequence_number, long long datagram_count)
+        {
+            ctsUdpBlastHeader header;
+            header.stream_id = stream_id;
+            header.sequence_number = sequence_number;
+            header.datagram_count = datagram_count;
+            return header;
+        }
+
+    public:
+        TEST_METHOD(HeaderRoundTrips)
+        {
+            char buffer[UdpBlastHeaderLength]{};
+            MakeHeader(0x0123456789abcdefULL, 42, 1000).write(buffer);
+
+            const auto header = ctsUdpBlastHeader::Read(buffer);
+            Assert::AreEqual(0x0123456789abcdefULL, header.stream_id);
+            Assert::AreEqual(42LL, header.sequence_number);
+            Assert::AreEqual(1000LL, header.datagram_count);
+        }
+
+        TEST_METHOD(CountsGapsAsDropped)
+        {
+            ctsUdpBlastSequenceTracker tracker;
+            Assert::AreEqual(0LL, tracker.record(MakeHeader(1, 0, 10)).dropped_change);
+            Assert::AreEqual(0LL, tracker.record(MakeHeader(1, 1, 10)).dropped_change);
+
+            const auto result = tracker.record(MakeHeader(1, 4, 10));
+            Assert::IsTrue(result.valid);
+            Assert::IsFalse(result.late);
+            Assert::AreEqual(2LL, result.dropped_change);
+        }
+
+        TEST_METHOD(LateDatagramFillsAGap)
+        {
+            ctsUdpBlastSequenceTracker tracker;
+            tracker.record(MakeHeader(1, 0, 10));
+            tracker.record(MakeHeader(1, 3, 10));
+
+            const auto result = tracker.record(MakeHeader(1, 1, 10));
+            Assert::IsTrue(result.valid);
+            Assert::IsTrue(result.late);
+            Assert::AreEqual(-1LL, result.dropped_change);
+        }
+
+        TEST_METHOD(DuplicateWithoutGapsIsNotUndropped)
+        {
+            ctsUdpBlastSequenceTracker tracker;
+            tracker.record(MakeHeader(1, 0, 10));
+            tracker.record(MakeHeader(1, 1, 10));
+
+            const auto result = tracker.record(MakeHeader(1, 1, 10));
+            Assert::IsTrue(result.valid);
+            Assert::IsTrue(result.late);
+            Assert::AreEqual(0LL, result.dropped_change);
+        }
+
+        TEST_METHOD(FinishCountsTheTail)
+        {
+            ctsUdpBlastSequenceTracker tracker;
+            tracker.record(MakeHeader(1, 0, 10));
+            tracker.record(MakeHeader(1, 5, 10));
+            tracker.record(MakeHeader(2, 0, 4));
+            tracker.record(MakeHeader(2, 3, 4));
+            Assert::AreEqual(static_cast<size_t>(2), tracker.stream_count());
+
+            // 4 never received from stream 1, none from stream 2
+            Assert::AreEqual(4LL, tracker.finish());
+            Assert::AreEqual(static_cast<size_t>(0), tracker.stream_count());
+        }
+
+        TEST_METHOD(TracksStreamsIndependently)
+        {
+            ctsUdpBlastSequenceTracker tracker;
+            tracker.record(MakeHeader(1, 0, 10));
+            tracker.record(MakeHeader(2, 0, 10));
+            Assert::AreEqual(0LL, tracker.record(MakeHeader(2, 1, 10)).dropped_change);
+            Assert::AreEqual(0LL, tracker.record(MakeHeader(1, 1, 10)).dropped_change);
+        }
+
+        TEST_METHOD(RejectsInvalidHeaders)
+        {
+            ctsUdpBlastSequenceTracker tracker;
+            Assert::IsFalse(tracker.record(MakeHeader(1, 0, 0)).valid);
+            Assert::IsFalse(tracker.record(MakeHeader(1, -1, 10)).valid);
+            Assert::IsFalse(tracker.record(MakeHeader(1, 10, 10)).valid);
+
+            // a stream's datagram count never changes
+            Assert::IsTrue(tracker.record(MakeHeader(1, 0, 10)).valid);
+            Assert::IsFalse(tracker.record(MakeHeader(1, 1, 11)).valid);
+        }
+    };
+}
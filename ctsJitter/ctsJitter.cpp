@@ -0,0 +1,286 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+// cpp headers
+#include <cstdio>
+#include <cwchar>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <map>
+// os headers
+#include <Windows.h>
+// wil headers
+#include <wil/resource.h>
+// ctl headers
+#include <ctString.hpp>
+// project headers
+#include "..\ctsTraffic\ctsJitterCapture.hpp"
+
+using namespace std;
+using namespace ctl;
+using namespace ctsTraffic;
+
+static const PCWSTR UsageStatement =
+    L"ctsJitter.exe usage::\n"
+    L" converts a binary jitter capture (ctsTraffic.exe -JitterFilename:<file>.bin)\n"
+    L" into the csv format written by -JitterFilename:<file>.csv, and prints jitter statistics\n"
+    L"\n"
+    L" -Input:<capture file>.bin\n"
+    L" -Output:<csv file>  [default is the capture file name with a .csv extension]\n"
+    L"\n"
+    L" a capture of a single connection produces exactly the -JitterFilename csv columns\n"
+    L" a capture of multiple connections adds a leading StreamId column\n";
+
+// the number of records read from the capture file at a time
+constexpr size_t c_ReadBlockRecords = 64 * 1024;
+
+struct StreamDetails
+{
+    bool first_frame_captured = false;
+    long long first_sender_qpc = 0;
+    long long first_sender_qpf = 0;
+    long long first_receiver_qpc = 0;
+    double previous_in_flight_ms = 0.0;
+
+    long long successful_frames = 0;
+    long long dropped_frames = 0;
+    long long jitter_samples = 0;
+    double total_in_flight_ms = 0.0;
+    double total_jitter_ms = 0.0;
+    double max_jitter_ms = 0.0;
+};
+
+// invokes the functor for every written record in the capture, in capture order
+template <typename T>
+static bool ForEachRecord(HANDLE _capture_file, T&& _functor)
+{
+    LARGE_INTEGER first_record{};
+    first_record.QuadPart = sizeof(ctsJitterCaptureHeader);
+    if (!::SetFilePointerEx(_capture_file, first_record, nullptr, FILE_BEGIN))
+    {
+        wprintf(L"SetFilePointerEx failed (%u)\n", ::GetLastError());
+        return false;
+    }
+
+    vector<ctsJitterCaptureRecord> records(c_ReadBlockRecords);
+    for (;;)
+    {
+        DWORD bytes_read{};
+        if (!::ReadFile(_capture_file, records.data(), static_cast<DWORD>(records.size() * sizeof(ctsJitterCaptureRecord)), &bytes_read, nullptr))
+        {
+            wprintf(L"ReadFile failed (%u)\n", ::GetLastError());
+            return false;
+        }
+        if (bytes_read == 0)
+        {
+            return true;
+        }
+
+        // a truncated trailing record is ignored
+        const size_t records_read = bytes_read / sizeof(ctsJitterCaptureRecord);
+        for (size_t index = 0; index < records_read; ++index)
+        {
+            // a zero stream id is a slot that was reserved but never written
+            if (records[index].stream_id != 0)
+            {
+                _functor(records[index]);
+            }
+        }
+    }
+}
+
+static void PrintStreamSummary(PCWSTR _name, const StreamDetails& _details)
+{
+    const long long total_frames = _details.successful_frames + _details.dropped_frames;
+    wprintf(
+        L"%-12ws %12lld %12lld (%6.3f%%) %16.3f %14.3f %14.3f\n",
+        _name,
+        _details.successful_frames,
+        _details.dropped_frames,
+        total_frames > 0 ? static_cast<double>(_details.dropped_frames) / total_frames * 100.0 : 0.0,
+        _details.successful_frames > 0 ? _details.total_in_flight_ms / _details.successful_frames : 0.0,
+        _details.jitter_samples > 0 ? _details.total_jitter_ms / _details.jitter_samples : 0.0,
+        _details.max_jitter_ms);
+}
+
+int __cdecl wmain(_In_ int argc, _In_reads_z_(argc) const wchar_t** argv)
+{
+    wstring inputFilename;
+    wstring outputFilename;
+
+    for (auto arg_count = 1; arg_count < argc; ++arg_count)
+    {
+        if (ctString::ctOrdinalStartsWithCaseInsensative(argv[arg_count], L"-Input:"))
+        {
+            inputFilename = argv[arg_count] + wcslen(L"-Input:");
+        }
+        else if (ctString::ctOrdinalStartsWithCaseInsensative(argv[arg_count], L"-Output:"))
+        {
+            outputFilename = argv[arg_count] + wcslen(L"-Output:");
+        }
+        else
+        {
+            wprintf(L"Incorrect option: %ws\n", argv[arg_count]);
+            wprintf(UsageStatement);
+            return 1;
+        }
+    }
+
+    if (inputFilename.empty())
+    {
+        wprintf(UsageStatement);
+        return 1;
+    }
+    if (outputFilename.empty())
+    {
+        outputFilename = inputFilename;
+        if (ctString::ctOrdinalEndsWithCaseInsensative(outputFilename, L".bin"))
+        {
+            outputFilename.erase(outputFilename.end() - 4, outputFilename.end());
+        }
+        outputFilename.append(L".csv");
+    }
+
+    const wil::unique_hfile capture_file(::CreateFileW(
+        inputFilename.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr));
+    if (!capture_file)
+    {
+        const auto gle = ::GetLastError();
+        wprintf(L"Failed to open %ws (%u)\n", inputFilename.c_str(), gle);
+        return gle;
+    }
+
+    ctsJitterCaptureHeader header{};
+    DWORD bytes_read{};
+    if (!::ReadFile(capture_file.get(), &header, static_cast<DWORD>(sizeof header), &bytes_read, nullptr) ||
+        bytes_read != sizeof header ||
+        header.magic != c_JitterCaptureMagic ||
+        header.version != c_JitterCaptureVersion ||
+        header.record_size != sizeof(ctsJitterCaptureRecord) ||
+        header.receiver_qpf == 0)
+    {
+        wprintf(L"%ws is not a ctsTraffic jitter capture file\n", inputFilename.c_str());
+        return ERROR_INVALID_DATA;
+    }
+
+    // the csv is identical to -JitterFilename output unless more than one connection was captured
+    map<unsigned long, StreamDetails> streams;
+    if (!ForEachRecord(capture_file.get(), [&](const ctsJitterCaptureRecord& _record) { streams[_record.stream_id]; }))
+    {
+        return ERROR_READ_FAULT;
+    }
+    const bool multiple_streams = streams.size() > 1;
+
+    FILE* raw_output = nullptr;
+    if (_wfopen_s(&raw_output, outputFilename.c_str(), L"w") != 0 || raw_output == nullptr)
+    {
+        wprintf(L"Failed to create %ws\n", outputFilename.c_str());
+        return ERROR_OPEN_FAILED;
+    }
+    const wil::unique_file output_file(raw_output);
+    fprintf(
+        output_file.get(),
+        "%sSequenceNumber,SenderQpc,SenderQpf,ReceiverQpc,ReceiverQpf,RelativeInFlightTimeMs,PrevToCurrentInFlightTimeJitter\n",
+        multiple_streams ? "StreamId," : "");
+
+    const auto receiver_qpf = static_cast<double>(header.receiver_qpf);
+    const bool converted = ForEachRecord(capture_file.get(), [&](const ctsJitterCaptureRecord& _record) {
+        if (multiple_streams)
+        {
+            fprintf(output_file.get(), "%lu,", _record.stream_id);
+        }
+
+        auto& details = streams[_record.stream_id];
+        // dropped frames only record the sequence number
+        if (_record.sender_qpf == 0)
+        {
+            ++details.dropped_frames;
+            fprintf(output_file.get(), "%lld,0,0,0,0,0.000,0.000\n", _record.sequence_number);
+            return;
+        }
+
+        // the same estimate ctsTraffic makes when rendering the frame:
+        // time since the first receive minus time the sender spent waiting to send this frame
+        double in_flight_ms = 0.0;
+        if (details.first_frame_captured)
+        {
+            const double ms_since_first_receive =
+                static_cast<double>(_record.receiver_qpc) * 1000.0 / receiver_qpf -
+                static_cast<double>(details.first_receiver_qpc) * 1000.0 / receiver_qpf;
+            const double ms_since_first_send =
+                static_cast<double>(_record.sender_qpc) * 1000.0 / static_cast<double>(_record.sender_qpf) -
+                static_cast<double>(details.first_sender_qpc) * 1000.0 / static_cast<double>(details.first_sender_qpf);
+            in_flight_ms = ms_since_first_receive - ms_since_first_send;
+        }
+        const double jitter_ms = fabs(details.previous_in_flight_ms - in_flight_ms);
+
+        fprintf(
+            output_file.get(),
+            "%lld,%lld,%lld,%lld,%lld,%.3f,%.3f\n",
+            _record.sequence_number, _record.sender_qpc, _record.sender_qpf, _record.receiver_qpc, header.receiver_qpf, in_flight_ms, jitter_ms);
+
+        ++details.successful_frames;
+        details.total_in_flight_ms += in_flight_ms;
+        if (details.first_frame_captured)
+        {
+            ++details.jitter_samples;
+            details.total_jitter_ms += jitter_ms;
+            details.max_jitter_ms = (std::max)(details.max_jitter_ms, jitter_ms);
+        }
+        else
+        {
+            details.first_frame_captured = true;
+            details.first_sender_qpc = _record.sender_qpc;
+            details.first_sender_qpf = _record.sender_qpf;
+            details.first_receiver_qpc = _record.receiver_qpc;
+        }
+        details.previous_in_flight_ms = in_flight_ms;
+    });
+    if (!converted)
+    {
+        return ERROR_READ_FAULT;
+    }
+
+    wprintf(
+        L"Converted %ws to %ws\n\n"
+        L"%-12ws %12ws %22ws %16ws %14ws %14ws\n",
+        inputFilename.c_str(), outputFilename.c_str(),
+        L"Stream", L"Frames", L"Dropped", L"MeanInFlightMs", L"MeanJitterMs", L"MaxJitterMs");
+
+    StreamDetails totals;
+    for (const auto& stream : streams)
+    {
+        PrintStreamSummary(ctString::ctFormatString(L"%lu", stream.first).c_str(), stream.second);
+
+        totals.successful_frames += stream.second.successful_frames;
+        totals.dropped_frames += stream.second.dropped_frames;
+        totals.jitter_samples += stream.second.jitter_samples;
+        totals.total_in_flight_ms += stream.second.total_in_flight_ms;
+        totals.total_jitter_ms += stream.second.total_jitter_ms;
+        totals.max_jitter_ms = (std::max)(totals.max_jitter_ms, stream.second.max_jitter_ms);
+    }
+    if (multiple_streams)
+    {
+        PrintStreamSummary(L"All", totals);
+    }
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// os headers
+#include <Windows.h>
+#include <Psapi.h>
+// wil headers
+#include <wil/resource.h>
+// ctl headers
+#include <ctMemoryGuard.hpp>
+
+namespace ctsTraffic
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsBufferPlacement
+    ///
+    /// Allocates IO buffers with the placement requested by -Memory
+    /// - large pages are used for allocations of at least one large page
+    ///   when -Memory:hugepages was given and SeLockMemoryPrivilege could be enabled
+    /// - buffers can be placed on a specific NUMA node:
+    ///   connections allocate on the node of the processor running their state machine,
+    ///   which with -Threading:per-core is the processor that owns the connection
+    ///
+    /// Every allocation is counted by the placement it actually received, so it can be reported
+    /// - node placement is only counted on hosts with more than one NUMA node
+    ///
+    /// Each allocation reserves at least 64KB of address space and commits whole pages:
+    /// callers use UsePlacement() to keep small per-connection buffers on the heap when placement gains nothing
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsBufferPlacement
+    {
+    public:
+        //
+        // Returns committed read/write memory, or nullptr if the allocation failed
+        // - _large_pages_used is set if the allocation is backed by large pages
+        //   (large pages are always read/write, so cannot be made read-only with VirtualProtect)
+        //
+        static wil::unique_virtualalloc_ptr<char> Allocate(
+            size_t _size,
+            bool _large_pages,
+            DWORD _preferred_node,
+            _Out_opt_ bool* _large_pages_used = nullptr) noexcept
+        {
+            if (_large_pages_used)
+            {
+                *_large_pages_used = false;
+            }
+
+            if (_large_pages)
+            {
+                auto large_page_buffer = AllocateLargePages(_size, _preferred_node);
+                if (large_page_buffer)
+                {
+                    if (_large_pages_used)
+                    {
+                        *_large_pages_used = true;
+                    }
+                    return large_page_buffer;
+                }
+            }
+
+            wil::unique_virtualalloc_ptr<char> buffer(static_cast<char*>(::VirtualAllocExNuma(
+                ::GetCurrentProcess(),
+                nullptr,
+                _size,
+                MEM_RESERVE | MEM_COMMIT,
+                PAGE_READWRITE,
+                _preferred_node)));
+            if (buffer)
+            {
+                ctl::ctMemoryGuardIncrement(&Counters().standard_page_allocations);
+                CountNode(buffer.get(), _preferred_node);
+            }
+            return buffer;
+        }
+
+        //
+        // Returns committed read/write memory backed by large pages, or nullptr without falling back to standard pages
+        // - for callers with their own fallback, so a standard-page buffer isn't committed only to be discarded
+        // - returns nullptr if _size is smaller than one large page or large pages are not supported
+        //
+        static wil::unique_virtualalloc_ptr<char> AllocateLargePages(size_t _size, DWORD _preferred_node) noexcept
+        {
+            const size_t large_page_size = ::GetLargePageMinimum();
+            if (0 == large_page_size || _size < large_page_size)
+            {
+                return nullptr;
+            }
+
+            const size_t large_page_aligned_size = (_size + large_page_size - 1) / large_page_size * large_page_size;
+            wil::unique_virtualalloc_ptr<char> large_page_buffer(static_cast<char*>(::VirtualAllocExNuma(
+                ::GetCurrentProcess(),
+                nullptr,
+                large_page_aligned_size,
+                MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                PAGE_READWRITE,
+                _preferred_node)));
+            if (large_page_buffer)
+            {
+                ctl::ctMemoryGuardIncrement(&Counters().large_page_allocations);
+                CountNode(large_page_buffer.get(), _preferred_node);
+                return large_page_buffer;
+            }
+
+            // large pages are not always available once physical memory is fragmented
+            ctl::ctMemoryGuardIncrement(&Counters().large_page_failures);
+            return nullptr;
+        }
+
+        //
+        // Whether a buffer of _size gains anything from being allocated here rather than from the heap:
+        // the host has more than one NUMA node, or the buffer can be backed by large pages
+        //
+        static bool UsePlacement(size_t _size, bool _large_pages) noexcept
+        {
+            if (MultipleNumaNodes())
+            {
+                return true;
+            }
+            const size_t large_page_size = ::GetLargePageMinimum();
+            return _large_pages && large_page_size != 0 && _size >= large_page_size;
+        }
+
+        //
+        // Whether the host has more than one NUMA node
+        //
+        static bool MultipleNumaNodes() noexcept
+        {
+            static const bool s_multiple_nodes = []() noexcept {
+                ULONG highest_node = 0;
+                return ::GetNumaHighestNodeNumber(&highest_node) && highest_node > 0;
+            }();
+            return s_multiple_nodes;
+        }
+
+        //
+        // The NUMA node of the processor running the calling thread
+        // - NUMA_NO_PREFERRED_NODE on hosts with a single node, where there is no placement to request or count
+        //
+        static DWORD CurrentNumaNode() noexcept
+        {
+            if (!MultipleNumaNodes())
+            {
+                return NUMA_NO_PREFERRED_NODE;
+            }
+
+            PROCESSOR_NUMBER processor{};
+            ::GetCurrentProcessorNumberEx(&processor);
+            USHORT node = 0;
+            if (!::GetNumaProcessorNodeEx(&processor, &node))
+            {
+                return NUMA_NO_PREFERRED_NODE;
+            }
+            return node;
+        }
+
+        struct PlacementCounters
+        {
+            long long large_page_allocations = 0LL;
+            long long large_page_failures = 0LL;
+            long long standard_page_allocations = 0LL;
+            // allocations requesting a node, by whether the first page landed on that node
+            long long local_node_allocations = 0LL;
+            long long remote_node_allocations = 0LL;
+        };
+
+        static PlacementCounters& Counters() noexcept
+        {
+            static PlacementCounters s_counters;
+            return s_counters;
+        }
+
+    private:
+        static void CountNode(_Inout_ char* _buffer, DWORD _preferred_node) noexcept
+        {
+            if (NUMA_NO_PREFERRED_NODE == _preferred_node || !MultipleNumaNodes())
+            {
+                return;
+            }
+
+            // the first page must be resident to see which node backs it
+            *static_cast<volatile char*>(_buffer) = 0;
+            PSAPI_WORKING_SET_EX_INFORMATION working_set{};
+            working_set.VirtualAddress = _buffer;
+            if (::QueryWorkingSetEx(::GetCurrentProcess(), &working_set, sizeof working_set) && working_set.VirtualAttributes.Valid)
+            {
+                if (working_set.VirtualAttributes.Node == _preferred_node)
+                {
+                    ctl::ctMemoryGuardIncrement(&Counters().local_node_allocations);
+                }
+                else
+                {
+                    ctl::ctMemoryGuardIncrement(&Counters().remote_node_allocations);
+                }
+            }
+        }
+    };
+}
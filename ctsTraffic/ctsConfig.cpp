@@ -22,6 +22,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <iphlpapi.h>
 // multimedia timer
 #include <Mmsystem.h>
+#include <Psapi.h>
 // wil headers
 #include <wil/resource.h>
 // ctl headers
@@ -35,12 +36,20 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // project headers
 #include "ctsConfig.h"
 #include "ctsLogger.hpp"
+#include "ctsJitterCapture.hpp"
+#include "ctsLocalPortAllocator.hpp"
+#include "ctsBufferPlacement.hpp"
 #include "ctsIOPattern.h"
+#include "ctsSocket.h"
+#include "ctsSocketState.h"
 #include "ctsPrintStatus.hpp"
 // project functors
 #include "ctsTCPFunctions.h"
 #include "ctsMediaStreamClient.h"
 #include "ctsMediaStreamServer.h"
+#include "ctsMediaStreamProtocol.hpp"
+#include "ctsUdpBlastReceiver.h"
+#include "ctsUdpBlastProtocol.hpp"
 
 
 using namespace std;
@@ -76,6 +85,7 @@ namespace ctsTraffic::ctsConfig
     constexpr unsigned long c_DefaultAcceptExLimit = 100;
     constexpr unsigned long c_DefaultTcpConnectionLimit = 8;
     constexpr unsigned long c_DefaultUdpConnectionLimit = 1;
+    constexpr unsigned long c_DefaultUdpBlastPrePost = 16;
     constexpr unsigned long c_DefaultConnectionThrottleLimit = 1000;
     constexpr unsigned long c_DefaultThreadpoolFactor = 2;
 
@@ -83,6 +93,22 @@ namespace ctsTraffic::ctsConfig
     static TP_CALLBACK_ENVIRON s_ThreadPoolEnvironment;
     static unsigned long s_ThreadPoolThreadCount = 0;
 
+    // -Threading:per-core : one single-threaded pool per processor, with that thread pinned to its processor
+    // - the environments are sized once and never reallocated, as callers hold pointers into the vector
+    static vector<PTP_POOL> s_PerCoreThreadPools;
+    static vector<TP_CALLBACK_ENVIRON> s_PerCoreThreadPoolEnvironments;
+    static long long s_PerCoreThreadPoolCounter = 0LL;
+
+    // -Memory:hugepages : the error enabling SeLockMemoryPrivilege, if large pages could not be used
+    static bool s_LargePagesRequested = false;
+    static DWORD s_LargePagesError = NO_ERROR;
+
+    // the process private bytes before any connection was created, and when the most connections were active
+    // - the peak is sampled with each status update
+    static SIZE_T s_BaselinePrivateBytes = 0;
+    static SIZE_T s_PeakPrivateBytes = 0;
+    static long long s_PeakConnectionCount = 0LL;
+
     static const wchar_t* s_CreateFunctionName = nullptr;
     static const wchar_t* s_ConnectFunctionName = nullptr;
     static const wchar_t* s_AcceptFunctionName = nullptr;
@@ -118,6 +144,19 @@ namespace ctsTraffic::ctsConfig
     static shared_ptr<ctsLogger> s_StatusLogger;
     static shared_ptr<ctsLogger> s_ErrorLogger;
     static shared_ptr<ctsLogger> s_JitterLogger;
+    // binary jitter capture, used instead of s_JitterLogger for a .bin -JitterFilename
+    static unique_ptr<ctsJitterCaptureFile> s_JitterCapture;
+
+    // leases ports when -LocalPort specifies a range
+    static unique_ptr<ctsLocalPortAllocator> s_LocalPortAllocator;
+    // TCP's TIME_WAIT period when not configured through TcpTimedWaitDelay
+    constexpr unsigned long c_DefaultTimeWaitSeconds = 120;
+
+    // optional binary file of per-connection time series (-TimeSeriesFilename)
+    constexpr unsigned long c_DefaultTimeSeriesInterval = 1000;
+    constexpr unsigned long c_DefaultTimeSeriesSamples = 256;
+    static wil::critical_section s_TimeSeriesLock;
+    static wil::unique_hfile s_TimeSeriesFile;
 
     static bool s_BreakOnError = false;
     static bool s_ShutdownCalled = false;
@@ -432,15 +471,21 @@ namespace ctsTraffic::ctsConfig
         }
         else
         {
-            if (Settings->IoPattern != IoPatternType::MediaStream)
+            if (IoPatternType::MediaStream == Settings->IoPattern)
             {
-                Settings->ConnectFunction = ctsConnectEx;
-                s_ConnectFunctionName = L"ConnectEx";
+                Settings->ConnectFunction = ctsMediaStreamClientConnect;
+                s_ConnectFunctionName = L"MediaStream Client Connect";
+            }
+            else if (IoPatternType::UdpBlast == Settings->IoPattern)
+            {
+                // connecting the datagram socket lets each datagram be sent with WSASend
+                Settings->ConnectFunction = ctsSimpleConnect;
+                s_ConnectFunctionName = L"connect";
             }
             else
             {
-                Settings->ConnectFunction = ctsMediaStreamClientConnect;
-                s_ConnectFunctionName = L"MediaStream Client Connect";
+                Settings->ConnectFunction = ctsConnectEx;
+                s_ConnectFunctionName = L"ConnectEx";
             }
         }
 
@@ -495,16 +540,23 @@ namespace ctsTraffic::ctsConfig
         }
         else if (!Settings->ListenAddresses.empty())
         {
-            if (IoPatternType::MediaStream != Settings->IoPattern)
+            if (IoPatternType::MediaStream == Settings->IoPattern)
             {
-                // only default an Accept function if listening
-                Settings->AcceptFunction = ctsAcceptEx;
-                s_AcceptFunctionName = L"AcceptEx";
+                Settings->AcceptFunction = ctsMediaStreamServerListener;
+                s_AcceptFunctionName = L"MediaStream Server Listener";
+            }
+            else if (IoPatternType::UdpBlast == Settings->IoPattern)
+            {
+                Settings->AcceptFunction = ctsUdpBlastReceiverBind;
+                s_AcceptFunctionName = L"UdpBlast Receiver Bind";
+                // one receiving socket is bound to each listen address at a time
+                Settings->AcceptLimit = static_cast<unsigned long>(Settings->ListenAddresses.size());
             }
             else
             {
-                Settings->AcceptFunction = ctsMediaStreamServerListener;
-                s_AcceptFunctionName = L"MediaStream Server Listener";
+                // only default an Accept function if listening
+                Settings->AcceptFunction = ctsAcceptEx;
+                s_AcceptFunctionName = L"AcceptEx";
             }
         }
     }
@@ -540,6 +592,7 @@ namespace ctsTraffic::ctsConfig
             {
                 Settings->IoFunction = ctsSendRecvIocp;
                 Settings->Options |= HANDLE_INLINE_IOCP;
+                Settings->VectoredIo = true;
                 s_IoFunctionName = L"Iocp (WSASend/WSARecv using IOCP)";
             }
             else if (ctString::ctOrdinalEqualsCaseInsensative(L"readwritefile", value))
@@ -568,8 +621,31 @@ namespace ctsTraffic::ctsConfig
                 // Default for TCP is WSASend/WSARecv using IOCP
                 Settings->IoFunction = ctsSendRecvIocp;
                 Settings->Options |= HANDLE_INLINE_IOCP;
+                Settings->VectoredIo = true;
                 s_IoFunctionName = L"Iocp (WSASend/WSARecv using IOCP)";
             }
+            else if (IoPatternType::UdpBlast == Settings->IoPattern)
+            {
+                if (IsListening())
+                {
+                    // the receiver only ever posts WSARecvFrom, and ends the stream from its pattern with an Abort
+                    constexpr int UDP_RECV_BUFF = 1048576;
+                    Settings->IoFunction = ctsMediaStreamClient;
+                    // the receiver also has a closing function to hand its address to the next receiving socket
+                    Settings->ClosingFunction = ctsUdpBlastReceiverClose;
+                    Settings->Options |= SET_RECV_BUF;
+                    Settings->RecvBufValue = UDP_RECV_BUFF;
+                    Settings->Options |= HANDLE_INLINE_IOCP;
+                    s_IoFunctionName = L"UdpBlast Receiver (WSARecvFrom using IOCP)";
+                }
+                else
+                {
+                    // not VectoredIo: the pattern builds the header and payload segments of each datagram itself
+                    Settings->IoFunction = ctsSendRecvIocp;
+                    Settings->Options |= HANDLE_INLINE_IOCP;
+                    s_IoFunctionName = L"UdpBlast Sender (WSASend using IOCP)";
+                }
+            }
             else
             {
                 if (IsListening())
@@ -702,7 +778,7 @@ namespace ctsTraffic::ctsConfig
     ///
     /// Parses for socket Options
     /// - allows for more than one option to be set
-    /// -Options:<keepalive,tcpfastpath [-Options:<...>] [-Options:<...>]
+    /// -Options:<keepalive,tcpfastpath,fastopen [-Options:<...>] [-Options:<...>]
     ///
     //////////////////////////////////////////////////////////////////////////////////////////
     static void set_options(vector<const wchar_t*>& args)
@@ -740,6 +816,17 @@ namespace ctsTraffic::ctsConfig
                         throw invalid_argument("-Options (tcpfastpath only allowed with TCP sockets)");
                     }
                 }
+                else if (ctString::ctOrdinalEqualsCaseInsensative(L"fastopen", value))
+                {
+                    if (ProtocolType::TCP == Settings->Protocol)
+                    {
+                        Settings->Options |= FAST_OPEN;
+                    }
+                    else
+                    {
+                        throw invalid_argument("-Options (fastopen only allowed with TCP sockets)");
+                    }
+                }
                 else
                 {
                     throw invalid_argument("-Options");
@@ -796,6 +883,11 @@ namespace ctsTraffic::ctsConfig
     /// -pattern:pushpull
     /// -pattern:duplex
     ///
+    /// --- these only apply to UDP
+    ///
+    /// -pattern:mediastream (*default)
+    /// -pattern:udpblast
+    ///
     //////////////////////////////////////////////////////////////////////////////////////////
     static void set_ioPattern(vector<const wchar_t*>& args)
     {
@@ -805,11 +897,7 @@ namespace ctsTraffic::ctsConfig
             });
         if (found_arg != end(args))
         {
-            if (Settings->Protocol != ProtocolType::TCP)
-            {
-                throw invalid_argument("-pattern (only applicable to TCP)");
-            }
-
+            // the protocol and pattern combination is validated once the pattern is known
             const auto* const value = ParseArgument(*found_arg, L"-pattern");
             if (ctString::ctOrdinalEqualsCaseInsensative(L"push", value))
             {
@@ -828,6 +916,14 @@ namespace ctsTraffic::ctsConfig
                 // the old name for this was 'flood'
                 Settings->IoPattern = IoPatternType::Duplex;
             }
+            else if (ctString::ctOrdinalEqualsCaseInsensative(L"mediastream", value))
+            {
+                Settings->IoPattern = IoPatternType::MediaStream;
+            }
+            else if (ctString::ctOrdinalEqualsCaseInsensative(L"udpblast", value))
+            {
+                Settings->IoPattern = IoPatternType::UdpBlast;
+            }
             else
             {
                 throw invalid_argument("-pattern");
@@ -888,6 +984,21 @@ namespace ctsTraffic::ctsConfig
             Settings->PullBytes = c_DefaultPullBytes;
         }
 
+        found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+            const auto* const value = ParseArgument(parameter, L"-PacketsPerSecond");
+            return value != nullptr;
+            });
+        if (found_arg != end(args))
+        {
+            if (Settings->IoPattern != IoPatternType::UdpBlast)
+            {
+                throw invalid_argument("-PacketsPerSecond can only be set with -Pattern:UdpBlast");
+            }
+            Settings->PacketsPerSecond = as_integral<unsigned long>(ParseArgument(*found_arg, L"-PacketsPerSecond"));
+            // always remove the arg from our vector
+            args.erase(found_arg);
+        }
+
         //
         // Options for the UDP protocol
         //
@@ -912,6 +1023,43 @@ namespace ctsTraffic::ctsConfig
             args.erase(found_arg);
         }
 
+        found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+            const auto* const value = ParseArgument(parameter, L"-FrameModel");
+            return value != nullptr;
+            });
+        if (found_arg != end(args))
+        {
+            if (Settings->Protocol != ProtocolType::UDP)
+            {
+                throw invalid_argument("-FrameModel requires -Protocol:UDP");
+            }
+            const auto* const value = ParseArgument(*found_arg, L"-FrameModel");
+            if (ctString::ctOrdinalStartsWithCaseInsensative(value, L"gop:"))
+            {
+                // gop:<I-frame bytes>,<P-frame bytes>,<GOP length>
+                const wstring gop_values(value + 4);
+                const auto first_comma = gop_values.find(L',');
+                const auto second_comma = (first_comma != wstring::npos) ? gop_values.find(L',', first_comma + 1) : wstring::npos;
+                if (second_comma == wstring::npos || gop_values.find(L',', second_comma + 1) != wstring::npos)
+                {
+                    throw invalid_argument("-FrameModel:gop:<I-frame bytes>,<P-frame bytes>,<GOP length>");
+                }
+                s_MediaStreamSettings.IFrameSizeBytes = as_integral<unsigned long>(gop_values.substr(0, first_comma));
+                s_MediaStreamSettings.PFrameSizeBytes = as_integral<unsigned long>(gop_values.substr(first_comma + 1, second_comma - first_comma - 1));
+                s_MediaStreamSettings.GopLengthFrames = as_integral<unsigned long>(gop_values.substr(second_comma + 1));
+                if (0 == s_MediaStreamSettings.GopLengthFrames)
+                {
+                    throw invalid_argument("-FrameModel:gop requires a GOP length of at least 1 frame");
+                }
+            }
+            else if (!ctString::ctOrdinalEqualsCaseInsensative(L"cbr", value))
+            {
+                throw invalid_argument("-FrameModel");
+            }
+            // always remove the arg from our vector
+            args.erase(found_arg);
+        }
+
         found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
             const auto* const value = ParseArgument(parameter, L"-FrameRate");
             return value != nullptr;
@@ -947,6 +1095,52 @@ namespace ctsTraffic::ctsConfig
             s_MediaStreamSettings.BufferDepthSeconds = 1;
         }
 
+        found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+            const auto* const value = ParseArgument(parameter, L"-Playout");
+            return value != nullptr;
+            });
+        if (found_arg != end(args))
+        {
+            if (Settings->Protocol != ProtocolType::UDP)
+            {
+                throw invalid_argument("-Playout requires -Protocol:UDP");
+            }
+            const auto* const value = ParseArgument(*found_arg, L"-Playout");
+            if (ctString::ctOrdinalEqualsCaseInsensative(L"adaptive", value))
+            {
+                s_MediaStreamSettings.AdaptivePlayout = true;
+            }
+            else if (!ctString::ctOrdinalEqualsCaseInsensative(L"fixed", value))
+            {
+                throw invalid_argument("-Playout");
+            }
+            // always remove the arg from our vector
+            args.erase(found_arg);
+        }
+
+        found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+            const auto* const value = ParseArgument(parameter, L"-Timestamps");
+            return value != nullptr;
+            });
+        if (found_arg != end(args))
+        {
+            if (Settings->Protocol != ProtocolType::UDP)
+            {
+                throw invalid_argument("-Timestamps requires -Protocol:UDP");
+            }
+            const auto* const value = ParseArgument(*found_arg, L"-Timestamps");
+            if (ctString::ctOrdinalEqualsCaseInsensative(L"kernel", value))
+            {
+                s_MediaStreamSettings.KernelTimestamps = true;
+            }
+            else if (!ctString::ctOrdinalEqualsCaseInsensative(L"user", value))
+            {
+                throw invalid_argument("-Timestamps");
+            }
+            // always remove the arg from our vector
+            args.erase(found_arg);
+        }
+
         found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
             const auto* const value = ParseArgument(parameter, L"-StreamLength");
             return value != nullptr;
@@ -962,10 +1156,74 @@ namespace ctsTraffic::ctsConfig
             args.erase(found_arg);
         }
 
+        found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+            const auto* const value = ParseArgument(parameter, L"-Recovery");
+            return value != nullptr;
+            });
+        if (found_arg != end(args))
+        {
+            if (Settings->Protocol != ProtocolType::UDP)
+            {
+                throw invalid_argument("-Recovery requires -Protocol:UDP");
+            }
+            const auto* const value = ParseArgument(*found_arg, L"-Recovery");
+            if (ctString::ctOrdinalEqualsCaseInsensative(L"nack", value))
+            {
+                s_MediaStreamSettings.NackRecovery = true;
+            }
+            else if (ctString::ctOrdinalStartsWithCaseInsensative(value, L"fec:"))
+            {
+                // fec:<data datagrams per group>,<parity datagrams per group>
+                const wstring fec_values(value + 4);
+                const auto comma = fec_values.find(L',');
+                if (comma == wstring::npos || fec_values.find(L',', comma + 1) != wstring::npos)
+                {
+                    throw invalid_argument("-Recovery:fec:<data datagrams>,<parity datagrams>");
+                }
+                s_MediaStreamSettings.FecDataDatagrams = as_integral<unsigned long>(fec_values.substr(0, comma));
+                s_MediaStreamSettings.FecParityDatagrams = as_integral<unsigned long>(fec_values.substr(comma + 1));
+                if (0 == s_MediaStreamSettings.FecParityDatagrams ||
+                    s_MediaStreamSettings.FecParityDatagrams > s_MediaStreamSettings.FecDataDatagrams ||
+                    s_MediaStreamSettings.FecDataDatagrams > UdpDatagramFecMaximumDatagrams)
+                {
+                    throw invalid_argument("-Recovery:fec requires at least 1 parity datagram, and no more parity datagrams than data datagrams");
+                }
+            }
+            else if (!ctString::ctOrdinalEqualsCaseInsensative(L"none", value))
+            {
+                throw invalid_argument("-Recovery");
+            }
+            // always remove the arg from our vector
+            args.erase(found_arg);
+        }
+
         // validate and resolve the UDP protocol options
-        if (ProtocolType::UDP == Settings->Protocol)
+        if (IoPatternType::UdpBlast == Settings->IoPattern)
+        {
+            // UdpBlast datagrams are sized by -buffer, and sent for -transfer bytes
+            if (s_MediaStreamSettings.BitsPerSecond != 0 ||
+                s_MediaStreamSettings.FramesPerSecond != 0 ||
+                s_MediaStreamSettings.StreamLengthSeconds != 0 ||
+                s_MediaStreamSettings.GopLengthFrames > 0 ||
+                s_MediaStreamSettings.AdaptivePlayout ||
+                s_MediaStreamSettings.KernelTimestamps ||
+                s_MediaStreamSettings.NackRecovery ||
+                s_MediaStreamSettings.FecDataDatagrams > 0)
+            {
+                throw invalid_argument("-BitsPerSecond, -FrameRate, -StreamLength, -FrameModel, -Playout, -Timestamps and -Recovery only apply to -Pattern:MediaStream");
+            }
+        }
+        else if (ProtocolType::UDP == Settings->Protocol)
         {
-            if (0 == s_MediaStreamSettings.BitsPerSecond)
+            if (s_MediaStreamSettings.GopLengthFrames > 0)
+            {
+                // the bit rate follows from the frame sizes
+                if (s_MediaStreamSettings.BitsPerSecond != 0)
+                {
+                    throw invalid_argument("-BitsPerSecond cannot be specified with -FrameModel:gop");
+                }
+            }
+            else if (0 == s_MediaStreamSettings.BitsPerSecond)
             {
                 throw invalid_argument("-BitsPerSecond is required");
             }
@@ -980,6 +1238,23 @@ namespace ctsTraffic::ctsConfig
 
             // finally calculate the total stream length after all settings are captured from the user
             s_TransferSizeLow = s_MediaStreamSettings.CalculateTransferSize();
+
+            // every datagram of the largest frame, and its parity, must be numbered in the protocol header's flag
+            if (s_MediaStreamSettings.FecDataDatagrams > 0)
+            {
+                const auto frame_datagrams = ctsMediaStreamSendRequests::DatagramCount(s_MediaStreamSettings.FrameSizeBytes);
+                if (frame_datagrams > UdpDatagramFecMaximumDatagrams ||
+                    ctsMediaStreamFec::ParityCount(frame_datagrams, s_MediaStreamSettings.FecDataDatagrams, s_MediaStreamSettings.FecParityDatagrams) > UdpDatagramFecMaximumDatagrams)
+                {
+                    throw invalid_argument("-Recovery:fec cannot protect frames of more than 4096 datagrams");
+                }
+            }
+
+            if (s_MediaStreamSettings.GopLengthFrames > 0)
+            {
+                // report the average bit rate across the stream
+                s_MediaStreamSettings.BitsPerSecond = static_cast<long long>(s_TransferSizeLow * 8ULL / static_cast<unsigned long>(s_MediaStreamSettings.StreamLengthSeconds));
+            }
         }
     }
 
@@ -1373,9 +1648,9 @@ namespace ctsTraffic::ctsConfig
             });
         if (found_arg != end(args))
         {
-            if (Settings->Protocol != ProtocolType::TCP)
+            if (Settings->Protocol != ProtocolType::TCP && Settings->IoPattern != IoPatternType::UdpBlast)
             {
-                throw invalid_argument("-buffer (only applicable to TCP)");
+                throw invalid_argument("-buffer (only applicable to TCP and -Pattern:UdpBlast)");
             }
 
             const auto* const value = ParseArgument(*found_arg, L"-buffer");
@@ -1392,10 +1667,21 @@ namespace ctsTraffic::ctsConfig
             {
                 throw invalid_argument("-buffer");
             }
+            if (IoPatternType::UdpBlast == Settings->IoPattern &&
+                (s_BufferSizeHigh != 0 || s_BufferSizeLow < UdpBlastHeaderLength || s_BufferSizeLow > UdpBlastMaximumDatagramSize))
+            {
+                throw invalid_argument("-buffer with -Pattern:UdpBlast must be a single datagram size from 24 to 65507 bytes");
+            }
 
             // always remove the arg from our vector
             args.erase(found_arg);
         }
+        else if (IoPatternType::UdpBlast == Settings->IoPattern)
+        {
+            // senders default to small datagrams, while receivers can take the largest datagram sent to them
+            s_BufferSizeLow = IsListening() ? UdpBlastMaximumDatagramSize : UdpBlastDefaultDatagramSize;
+            s_BufferSizeHigh = 0;
+        }
         else
         {
             s_BufferSizeLow = c_DefaultBufferSize;
@@ -1419,9 +1705,9 @@ namespace ctsTraffic::ctsConfig
             });
         if (found_arg != end(args))
         {
-            if (Settings->Protocol != ProtocolType::TCP)
+            if (Settings->Protocol != ProtocolType::TCP && Settings->IoPattern != IoPatternType::UdpBlast)
             {
-                throw invalid_argument("-transfer (only applicable to TCP)");
+                throw invalid_argument("-transfer (only applicable to TCP and -Pattern:UdpBlast)");
             }
 
             const auto* const value = ParseArgument(*found_arg, L"-transfer");
@@ -1438,6 +1724,11 @@ namespace ctsTraffic::ctsConfig
             {
                 throw invalid_argument("-transfer");
             }
+            // every UdpBlast sender must have at least one full datagram to send
+            if (IoPatternType::UdpBlast == Settings->IoPattern && s_TransferSizeLow < s_BufferSizeLow)
+            {
+                throw invalid_argument("-transfer with -Pattern:UdpBlast must be at least one datagram (-buffer)");
+            }
             // always remove the arg from our vector
             args.erase(found_arg);
         }
@@ -1595,6 +1886,38 @@ namespace ctsTraffic::ctsConfig
         }
     }
 
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Layout of the binary -TimeSeriesFilename file (all values little-endian)
+    ///
+    /// TimeSeriesFileHeader
+    /// then one block per connection, appended as each connection completes:
+    ///   TimeSeriesBlockHeader
+    ///   unsigned long interval[sample_count]          (interval index since the first IO completed)
+    ///   long long bytes[sample_count]                 (bytes sent + received within the interval)
+    ///   unsigned long rtt_microseconds[sample_count]  (0 if no RTT sample was taken)
+    ///
+    /// Values are written as columns so a post-processing tool can map each column directly
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    constexpr unsigned long c_TimeSeriesFileMagic = 0x53544343; // "CCTS"
+    constexpr unsigned long c_TimeSeriesFileVersion = 1;
+#pragma pack(push, 1)
+    struct TimeSeriesFileHeader
+    {
+        unsigned long magic;
+        unsigned long version;
+        unsigned long interval_milliseconds;
+        unsigned long max_samples_per_connection;
+    };
+    struct TimeSeriesBlockHeader
+    {
+        char connection_id[ctsStatistics::ConnectionIdLength];
+        unsigned long sample_count;
+        unsigned long long overwritten_samples;
+    };
+#pragma pack(pop)
+
     //////////////////////////////////////////////////////////////////////////////////////////
     ///
     /// Parses for the verbosity level
@@ -1684,6 +2007,50 @@ namespace ctsTraffic::ctsConfig
             args.erase(found_jitter_filename);
         }
 
+        wstring timeSeriesFilename;
+        const auto found_time_series_filename = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+            const auto* const value = ParseArgument(parameter, L"-TimeSeriesFilename");
+            return value != nullptr;
+            });
+        if (found_time_series_filename != end(args))
+        {
+            timeSeriesFilename = ParseArgument(*found_time_series_filename, L"-TimeSeriesFilename");
+            // always remove the arg from our vector
+            args.erase(found_time_series_filename);
+        }
+
+        unsigned long timeSeriesInterval = c_DefaultTimeSeriesInterval;
+        const auto found_time_series_interval = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+            const auto* const value = ParseArgument(parameter, L"-TimeSeriesInterval");
+            return value != nullptr;
+            });
+        if (found_time_series_interval != end(args))
+        {
+            timeSeriesInterval = as_integral<unsigned long>(ParseArgument(*found_time_series_interval, L"-TimeSeriesInterval"));
+            if (0 == timeSeriesInterval || timeSeriesFilename.empty())
+            {
+                throw invalid_argument("-TimeSeriesInterval");
+            }
+            // always remove the arg from our vector
+            args.erase(found_time_series_interval);
+        }
+
+        unsigned long timeSeriesSamples = c_DefaultTimeSeriesSamples;
+        const auto found_time_series_samples = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+            const auto* const value = ParseArgument(parameter, L"-TimeSeriesSamples");
+            return value != nullptr;
+            });
+        if (found_time_series_samples != end(args))
+        {
+            timeSeriesSamples = as_integral<unsigned long>(ParseArgument(*found_time_series_samples, L"-TimeSeriesSamples"));
+            if (0 == timeSeriesSamples || timeSeriesFilename.empty())
+            {
+                throw invalid_argument("-TimeSeriesSamples");
+            }
+            // always remove the arg from our vector
+            args.erase(found_time_series_samples);
+        }
+
         // since CSV files each have their own header, we cannot allow the same CSV filename to be used
         // for different loggers, as opposed to txt files, which can be shared across different loggers
 
@@ -1762,11 +2129,55 @@ namespace ctsTraffic::ctsConfig
                 }
                 s_JitterLogger = make_shared<ctsTextLogger>(jitterFilename.c_str(), StatusFormatting::Csv);
             }
+            else if (ctString::ctOrdinalEndsWithCaseInsensative(jitterFilename, L".bin"))
+            {
+                if (ctString::ctOrdinalEqualsCaseInsensative(connectionFilename, jitterFilename) ||
+                    ctString::ctOrdinalEqualsCaseInsensative(errorFilename, jitterFilename) ||
+                    ctString::ctOrdinalEqualsCaseInsensative(statusFilename, jitterFilename))
+                {
+                    throw invalid_argument("The jitter capture file is binary and cannot be shared with other loggers");
+                }
+                s_JitterCapture = make_unique<ctsJitterCaptureFile>(jitterFilename.c_str());
+            }
             else
             {
-                throw invalid_argument("Jitter can only be logged using a csv format");
+                throw invalid_argument("Jitter can only be logged using a csv or bin format");
             }
         }
+
+        if (!timeSeriesFilename.empty())
+        {
+            if (ctString::ctOrdinalEqualsCaseInsensative(connectionFilename, timeSeriesFilename) ||
+                ctString::ctOrdinalEqualsCaseInsensative(errorFilename, timeSeriesFilename) ||
+                ctString::ctOrdinalEqualsCaseInsensative(statusFilename, timeSeriesFilename) ||
+                ctString::ctOrdinalEqualsCaseInsensative(jitterFilename, timeSeriesFilename))
+            {
+                throw invalid_argument("The time series file is binary and cannot be shared with other loggers");
+            }
+
+            s_TimeSeriesFile.reset(CreateFileW(
+                timeSeriesFilename.c_str(),
+                GENERIC_WRITE,
+                FILE_SHARE_READ,
+                nullptr,
+                CREATE_ALWAYS,
+                FILE_ATTRIBUTE_NORMAL,
+                nullptr));
+            if (!s_TimeSeriesFile)
+            {
+                throw ctException(GetLastError(), L"CreateFileW", L"ctsConfig::set_logging", false);
+            }
+
+            const TimeSeriesFileHeader file_header{ c_TimeSeriesFileMagic, c_TimeSeriesFileVersion, timeSeriesInterval, timeSeriesSamples };
+            DWORD bytes_written{};
+            if (!WriteFile(s_TimeSeriesFile.get(), &file_header, static_cast<DWORD>(sizeof file_header), &bytes_written, nullptr))
+            {
+                throw ctException(GetLastError(), L"WriteFile", L"ctsConfig::set_logging", false);
+            }
+
+            Settings->TimeSeriesIntervalMilliseconds = timeSeriesInterval;
+            Settings->TimeSeriesSampleCount = timeSeriesSamples;
+        }
     }
 
     //////////////////////////////////////////////////////////////////////////////////////////
@@ -1825,6 +2236,11 @@ namespace ctsTraffic::ctsConfig
             // always remove the arg from our vector
             args.erase(found_arg);
         }
+        else if (IoPatternType::UdpBlast == Settings->IoPattern)
+        {
+            // keep enough datagrams in flight for the pattern to never wait on a single completion
+            Settings->PrePostRecvs = c_DefaultUdpBlastPrePost;
+        }
         else
         {
             Settings->PrePostRecvs = ProtocolType::TCP == Settings->Protocol ? 1 : 2;
@@ -1847,9 +2263,18 @@ namespace ctsTraffic::ctsConfig
         if (found_arg != end(args))
         {
             Settings->PrePostSends = as_integral<unsigned long>(ParseArgument(*found_arg, L"-PrePostSends"));
+            if (IoPatternType::UdpBlast == Settings->IoPattern && 0 == Settings->PrePostSends)
+            {
+                // UDP has no send backlog to follow
+                throw invalid_argument("-PrePostSends must be at least 1 with -Pattern:UdpBlast");
+            }
             // always remove the arg from our vector
             args.erase(found_arg);
         }
+        else if (IoPatternType::UdpBlast == Settings->IoPattern)
+        {
+            Settings->PrePostSends = c_DefaultUdpBlastPrePost;
+        }
         else
         {
             Settings->PrePostSends = 1;
@@ -1935,38 +2360,280 @@ namespace ctsTraffic::ctsConfig
                 "GetAdaptersAddresses could not find the interface alias '%ws'",
                 value);
 
-            s_CompartmentId = found_interface->CompartmentId;
-            // always remove the arg from our vector
-            args.erase(found_arg);
+            s_CompartmentId = found_interface->CompartmentId;
+            // always remove the arg from our vector
+            args.erase(found_arg);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Runs on the one thread of a per-core threadpool to pin it to its processor
+    ///
+    //////////////////////////////////////////////////////////////////////////////////////////
+    struct ctsPinThreadContext
+    {
+        GROUP_AFFINITY affinity{};
+        wil::unique_event pinned{ wil::EventOptions::ManualReset };
+        DWORD error = NO_ERROR;
+    };
+    static VOID NTAPI PinThreadpoolThreadCallback(PTP_CALLBACK_INSTANCE, PVOID _context) noexcept
+    {
+        auto* const pin_context = static_cast<ctsPinThreadContext*>(_context);
+        if (!SetThreadGroupAffinity(GetCurrentThread(), &pin_context->affinity, nullptr))
+        {
+            pin_context->error = GetLastError();
+        }
+        pin_context->pinned.SetEvent();
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Creates a pool with exactly one persistent thread, pinned to the specified processor
+    /// - every callback of every TP object created against this environment runs on that thread
+    ///
+    //////////////////////////////////////////////////////////////////////////////////////////
+    static void create_per_core_threadpool(WORD _group, BYTE _processor, _Out_ PTP_POOL& _pool, _Out_ TP_CALLBACK_ENVIRON& _environment)
+    {
+        _pool = CreateThreadpool(nullptr);
+        if (!_pool)
+        {
+            throw ctException(GetLastError(), L"CreateThreadPool", L"ctsConfig", false);
+        }
+        // the minimum thread is created immediately and is never retired
+        SetThreadpoolThreadMaximum(_pool, 1);
+        if (!SetThreadpoolThreadMinimum(_pool, 1))
+        {
+            throw ctException(GetLastError(), L"SetThreadpoolThreadMinimum", L"ctsConfig", false);
+        }
+
+        InitializeThreadpoolEnvironment(&_environment);
+        SetThreadpoolCallbackPool(&_environment, _pool);
+
+        ctsPinThreadContext pin_context;
+        pin_context.affinity.Group = _group;
+        pin_context.affinity.Mask = static_cast<KAFFINITY>(1) << _processor;
+        if (!TrySubmitThreadpoolCallback(PinThreadpoolThreadCallback, &pin_context, &_environment))
+        {
+            throw ctException(GetLastError(), L"TrySubmitThreadpoolCallback", L"ctsConfig", false);
+        }
+        pin_context.pinned.wait();
+        if (pin_context.error != NO_ERROR)
+        {
+            throw ctException(pin_context.error, L"SetThreadGroupAffinity", L"ctsConfig", false);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Sets a threadpool environment for TP APIs to consume
+    ///
+    /// Configuring for max threads == number of processors * 2
+    ///
+    /// -Threading:<pool,per-core>
+    /// - pool (default) : all connections share the one threadpool
+    /// - per-core : additionally creates one pinned single-threaded pool per processor
+    ///   each connection is assigned one of these pools for its lifetime
+    ///   the shared threadpool remains for objects not owned by a connection (e.g. listeners)
+    ///   a blocking call on one of these threads stalls every connection assigned to it
+    ///
+    //////////////////////////////////////////////////////////////////////////////////////////
+    static void set_threadpool(vector<const wchar_t*>& args)
+    {
+        bool per_core = false;
+        const auto found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+            const auto* const value = ParseArgument(parameter, L"-Threading");
+            return value != nullptr;
+            });
+        if (found_arg != end(args))
+        {
+            const auto* const value = ParseArgument(*found_arg, L"-Threading");
+            if (ctString::ctOrdinalEqualsCaseInsensative(L"per-core", value))
+            {
+                per_core = true;
+            }
+            else if (!ctString::ctOrdinalEqualsCaseInsensative(L"pool", value))
+            {
+                throw invalid_argument("-Threading");
+            }
+            // always remove the arg from our vector
+            args.erase(found_arg);
+        }
+
+        SYSTEM_INFO system_info;
+        GetSystemInfo(&system_info);
+        s_ThreadPoolThreadCount = system_info.dwNumberOfProcessors * c_DefaultThreadpoolFactor;
+
+        s_ThreadPool = CreateThreadpool(nullptr);
+        if (!s_ThreadPool)
+        {
+            throw ctException(GetLastError(), L"CreateThreadPool", L"ctsConfig", false);
+        }
+        SetThreadpoolThreadMaximum(s_ThreadPool, s_ThreadPoolThreadCount);
+
+        InitializeThreadpoolEnvironment(&s_ThreadPoolEnvironment);
+        SetThreadpoolCallbackPool(&s_ThreadPoolEnvironment, s_ThreadPool);
+
+        Settings->PTPEnvironment = &s_ThreadPoolEnvironment;
+
+        if (per_core)
+        {
+            // the active processors of a group are the bits set in its active mask
+            // - they are not always numbered 0 through the active processor count - 1
+            DWORD information_length = 0;
+            if (GetLogicalProcessorInformationEx(RelationGroup, nullptr, &information_length) || GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+            {
+                throw ctException(GetLastError(), L"GetLogicalProcessorInformationEx", L"ctsConfig", false);
+            }
+            vector<BYTE> information_buffer(information_length);
+            auto* const information = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(information_buffer.data());
+            if (!GetLogicalProcessorInformationEx(RelationGroup, information, &information_length))
+            {
+                throw ctException(GetLastError(), L"GetLogicalProcessorInformationEx", L"ctsConfig", false);
+            }
+
+            constexpr auto MaxGroupProcessors = static_cast<BYTE>(sizeof(KAFFINITY) * 8);
+            vector<PROCESSOR_NUMBER> processors;
+            const GROUP_RELATIONSHIP& groups = information->Group;
+            for (WORD group = 0; group < groups.ActiveGroupCount; ++group)
+            {
+                const KAFFINITY active_mask = groups.GroupInfo[group].ActiveProcessorMask;
+                for (BYTE processor = 0; processor < MaxGroupProcessors; ++processor)
+                {
+                    if (active_mask & (static_cast<KAFFINITY>(1) << processor))
+                    {
+                        PROCESSOR_NUMBER processor_number{};
+                        processor_number.Group = group;
+                        processor_number.Number = processor;
+                        processors.push_back(processor_number);
+                    }
+                }
+            }
+
+            s_PerCoreThreadPools.resize(processors.size(), nullptr);
+            s_PerCoreThreadPoolEnvironments.resize(processors.size());
+            for (size_t pool_index = 0; pool_index < processors.size(); ++pool_index)
+            {
+                create_per_core_threadpool(
+                    processors[pool_index].Group,
+                    processors[pool_index].Number,
+                    s_PerCoreThreadPools[pool_index],
+                    s_PerCoreThreadPoolEnvironments[pool_index]);
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// The committed private memory of this process, used to measure the memory of each connection
+    /// - returns 0 if it could not be queried
+    ///
+    //////////////////////////////////////////////////////////////////////////////////////////
+    static SIZE_T current_private_bytes() noexcept
+    {
+        PROCESS_MEMORY_COUNTERS_EX counters{};
+        counters.cb = sizeof counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PPROCESS_MEMORY_COUNTERS>(&counters), sizeof counters))
+        {
+            return 0;
+        }
+        return counters.PrivateUsage;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Large pages can only be allocated by a token holding SeLockMemoryPrivilege
+    /// - returns the Win32 error if the privilege could not be enabled
+    ///
+    //////////////////////////////////////////////////////////////////////////////////////////
+    static DWORD enable_lock_memory_privilege() noexcept
+    {
+        wil::unique_handle token;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, token.addressof()))
+        {
+            return GetLastError();
+        }
+
+        TOKEN_PRIVILEGES privileges{};
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        if (!LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid))
+        {
+            return GetLastError();
+        }
+
+        // succeeds with ERROR_NOT_ALL_ASSIGNED if the account was not granted the privilege
+        if (!AdjustTokenPrivileges(token.get(), FALSE, &privileges, 0, nullptr, nullptr))
+        {
+            return GetLastError();
         }
+        return GetLastError();
     }
 
     //////////////////////////////////////////////////////////////////////////////////////////
     ///
-    /// Sets a threadpool environment for TP APIs to consume
+    /// Sets how IO buffers are placed in memory
     ///
-    /// Configuring for max threads == number of processors * 2
+    /// -Memory:<default,hugepages,compact>
+    /// - default : standard pages
+    /// - hugepages : large pages for every buffer of at least one large page
+    ///   falls back to standard pages if SeLockMemoryPrivilege cannot be enabled
+    /// - compact : the smallest per-connection footprint, for very large connection counts
+    ///   state used only by some connections is allocated on demand, and no TP_WORK is kept per connection
+    ///
+    /// hugepages and compact are independent, and can be given together as a comma-separated list
+    /// - e.g. -Memory:hugepages,compact
     ///
-    /// currently not exposing this as a command-line parameter
+    /// Receive buffers for each connection are allocated on the NUMA node
+    /// of the processor initiating IO for that connection on hosts with more than one NUMA node
     ///
     //////////////////////////////////////////////////////////////////////////////////////////
-    static void set_threadpool(vector<const wchar_t*>&)
+    static void set_memory(vector<const wchar_t*>& args)
     {
-        SYSTEM_INFO system_info;
-        GetSystemInfo(&system_info);
-        s_ThreadPoolThreadCount = system_info.dwNumberOfProcessors * c_DefaultThreadpoolFactor;
-
-        s_ThreadPool = CreateThreadpool(nullptr);
-        if (!s_ThreadPool)
+        const auto found_arg = find_if(begin(args), end(args), [](const wchar_t* parameter) -> bool {
+            const auto* const value = ParseArgument(parameter, L"-Memory");
+            return value != nullptr;
+            });
+        if (found_arg != end(args))
         {
-            throw ctException(GetLastError(), L"CreateThreadPool", L"ctsConfig", false);
-        }
-        SetThreadpoolThreadMaximum(s_ThreadPool, s_ThreadPoolThreadCount);
+            const wstring values(ParseArgument(*found_arg, L"-Memory"));
+            if (!ctString::ctOrdinalEqualsCaseInsensative(L"default", values.c_str()))
+            {
+                size_t value_start = 0;
+                for (;;)
+                {
+                    const auto comma = values.find(L',', value_start);
+                    const wstring value(values.substr(value_start, (comma == wstring::npos) ? wstring::npos : comma - value_start));
+                    if (ctString::ctOrdinalEqualsCaseInsensative(L"hugepages", value.c_str()) && !s_LargePagesRequested)
+                    {
+                        s_LargePagesRequested = true;
+                    }
+                    else if (ctString::ctOrdinalEqualsCaseInsensative(L"compact", value.c_str()) && !Settings->CompactConnections)
+                    {
+                        Settings->CompactConnections = true;
+                    }
+                    else
+                    {
+                        // includes 'default' in a list, empty values, and a value given twice
+                        throw invalid_argument("-Memory");
+                    }
 
-        InitializeThreadpoolEnvironment(&s_ThreadPoolEnvironment);
-        SetThreadpoolCallbackPool(&s_ThreadPoolEnvironment, s_ThreadPool);
+                    if (comma == wstring::npos)
+                    {
+                        break;
+                    }
+                    value_start = comma + 1;
+                }
+            }
+            // always remove the arg from our vector
+            args.erase(found_arg);
+        }
 
-        Settings->PTPEnvironment = &s_ThreadPoolEnvironment;
+        if (s_LargePagesRequested)
+        {
+            s_LargePagesError = (0 == GetLargePageMinimum()) ? ERROR_NOT_SUPPORTED : enable_lock_memory_privilege();
+            Settings->LargePages = (NO_ERROR == s_LargePagesError);
+        }
     }
 
     //////////////////////////////////////////////////////////////////////////////////////////
@@ -2118,10 +2785,12 @@ namespace ctsTraffic::ctsConfig
                     L"\t-Port\n"
                     L"\t-Protocol\n"
                     L"\t-Verify\n"
-                    L"\t-Pattern (on TCP)\n"
+                    L"\t-Pattern\n"
                     L"\t-Transfer (on TCP)\n"
                     L"\t-BitsPerSecond (on UDP)\n"
+                    L"\t-FrameModel (on UDP)\n"
                     L"\t-FrameRate (on UDP)\n"
+                    L"\t-Recovery (on UDP)\n"
                     L"\t-StreamLength (on UDP)\n"
                     L"\n\n"
                     L"----------------------------------------------------------------------\n"
@@ -2232,10 +2901,38 @@ namespace ctsTraffic::ctsConfig
                     L"    similarly to audio/video streaming solutions                      \n"
                     L"  * In all cases, the client-side receives and server-side sends      \n"
                     L"    at a fixed bit-rate and frame-size                                \n"
+                    L"  * Except with -Pattern:UdpBlast, where the client-side sends        \n"
+                    L"    datagrams as fast as it can and the server-side counts them       \n"
                     L"----------------------------------------------------------------------\n"
+                    L"-Pattern:<mediastream,udpblast>\n"
+                    L"   - the protocol pattern to send & recv UDP datagrams\n"
+                    L"\t- <default> == mediastream\n"
+                    L"\t- mediastream : the server streams frames to the client, as described by the options below\n"
+                    L"\t- udpblast : the client sends fixed-size datagrams to the server with no handshake and no flow control\n"
+                    L"\t             the server counts the datagrams received, dropped and reordered from their sequence numbers\n"
+                    L"\t             the server completes each stream once no datagram has arrived for 1 second\n"
+                    L"\t  note : the stream options below (-BitsPerSecond through -Recovery) do not apply to udpblast\n"
+                    L"\t       : -Buffer is the size of every datagram (on the server, the largest datagram it can receive)\n"
+                    L"\t         <default> == 64 bytes on the client, 65507 bytes on the server\n"
+                    L"\t       : -Transfer is the total bytes each client connection sends, rounded down to whole datagrams\n"
+                    L"\t       : -PrePostSends and -PrePostRecvs set the datagrams kept in flight: <default> == 16\n"
+                    L"\t       : each connection reports the packets per second, and the summary the CPU time per datagram\n"
+                    L"-PacketsPerSecond:####\n"
+                    L"   - applied only with -Pattern:UdpBlast - the number of datagrams each client connection sends per second\n"
+                    L"\t- <default> == 0 (send as fast as the sends complete)\n"
+                    L"\t  note : the datagrams are paced with millisecond timers\n"
                     L"-BitsPerSecond:####\n"
                     L"   - the number of bits per second to stream split across '-FrameRate' # of frames\n"
-                    L"\t- <required>\n"
+                    L"\t- <required> unless -FrameModel:gop is specified\n"
+                    L"-FrameModel:<cbr,gop:<I-frame bytes>,<P-frame bytes>,<GOP length>>\n"
+                    L"   - the sizes of the frames being streamed\n"
+                    L"\t- <default> == cbr\n"
+                    L"\t- cbr : every frame is the same size, set from -BitsPerSecond and -FrameRate\n"
+                    L"\t- gop : every GOP-length # of frames starts with an I-frame followed by P-frames\n"
+                    L"\t        e.g. -FrameModel:gop:60000,4000,30 streams a 60000 byte I-frame\n"
+                    L"\t             followed by 29 4000 byte P-frames, repeating\n"
+                    L"\t  note : the bit rate is calculated from the frame sizes: -BitsPerSecond cannot also be set\n"
+                    L"\t       : the client reports dropped I-frames separately, as the loss from each I-frame burst\n"
                     L"-FrameRate:####\n"
                     L"   - the number of frames per second being streamed\n"
                     L"\t- <required>\n"
@@ -2250,6 +2947,36 @@ namespace ctsTraffic::ctsConfig
                     L"\t  note : this affects the client-side buffering of frames\n"
                     L"\t       : this also affects how far the client-side will peek at frames to resend if missing\n"
                     L"\t       : the client will look ahead at 1/2 the buffer depth to request a resend if missing\n"
+                    L"-Playout:<fixed,adaptive>\n"
+                    L"   - how the client-side sizes the buffer of frames waiting to be processed\n"
+                    L"\t- <default> == fixed\n"
+                    L"\t- fixed    : frames are processed -BufferDepth seconds after the stream starts\n"
+                    L"\t- adaptive : the buffer starts at -BufferDepth seconds, then grows or shrinks a frame at a time\n"
+                    L"\t             to hold frames 4 times the interarrival jitter (as RFC 3550 estimates it) past their arrival\n"
+                    L"\t             the buffer is never more than 2 times -BufferDepth seconds\n"
+                    L"\t  note : adaptive reports the frames arriving after they were processed (late frames),\n"
+                    L"\t       : the time frames waited in the buffer, the average buffer depth, and the jitter estimate\n"
+                    L"-Timestamps:<user,kernel>\n"
+                    L"   - when the client-side takes the receive time of each datagram for the -JitterFilename log\n"
+                    L"\t- <default> == user\n"
+                    L"\t- user   : when the completed receive is processed by ctsTraffic\n"
+                    L"\t- kernel : when the datagram was received by the network stack (SIO_TIMESTAMPING software timestamps)\n"
+                    L"\t           the jitter log adds columns splitting the time in flight into the network delay\n"
+                    L"\t           (sender to network stack) and the host processing delay (network stack to ctsTraffic)\n"
+                    L"\t  note : kernel requires a csv -JitterFilename, and Windows 10 20H1 or Windows Server 2022 or later\n"
+                    L"-Recovery:<none,nack,fec:<N>,<K>>\n"
+                    L"   - how the stream recovers frames lost in the network\n"
+                    L"\t- <default> == none\n"
+                    L"\t- none : missing frames are counted as dropped\n"
+                    L"\t- nack : the client sends NACKs for frames still missing 1/2 the buffer depth before they are processed\n"
+                    L"\t         the server retransmits them from the last -BufferDepth seconds of frames it has sent\n"
+                    L"\t- fec  : the server follows every N datagrams of a frame with K XOR parity datagrams\n"
+                    L"\t         parity datagram j of a group is the XOR of datagrams j, j+K, j+2K, ... of the group\n"
+                    L"\t         the client rebuilds one lost datagram of each of these stripes before the frame is processed\n"
+                    L"\t         e.g. -Recovery:fec:8,2 sends 2 parity datagrams for each 8 data datagrams (25% overhead)\n"
+                    L"\t  note : the client reports the raw loss, the frames recovered, and the bandwidth used by retransmits\n"
+                    L"\t       : -BufferDepth on the server must be at least as deep as on the client\n"
+                    L"\t       : with fec, each connection reports the datagrams encoded or rebuilt and the CPU time it took\n"
                     L"\n");
                 break;
 
@@ -2282,6 +3009,9 @@ namespace ctsTraffic::ctsConfig
                     L"                             - qpf is the result of QueryPerformanceFrequency\n"
                     L"                             the algorithm to apply to this data can be found on this site under 'Performance Metrics'\n"
                     L"                             http://msdn.microsoft.com/en-us/library/windows/hardware/dn247504.aspx \n"
+                    L"                             a .bin -JitterFilename writes compact binary records instead of csv text\n"
+                    L"                             - binary capture supports any number of connections (csv is limited to 1)\n"
+                    L"                             - ctsJitter.exe converts the capture to the above csv format and summarizes jitter\n"
                     L"\n"
                     L"The format in which the above data is logged is based off of the file extension of the filename specified above\n"
                     L"  - There are 2 possible file types:\n"
@@ -2319,9 +3049,23 @@ namespace ctsTraffic::ctsConfig
                     L"\t - <default> == (not written to a log file)\n"
                     L"\t   note : the same filename can be specified for the different logging options\n"
                     L"\t          in which case the same file will receive all the specified details\n"
+                    L"\t   note : a .bin filename writes a binary capture which cannot be shared with other logging options\n"
                     L"-StatusUpdate:####\n"
                     L"\t - the millisecond frequency which real-time status updates are written\n"
                     L"\t   <default> == 5000 (milliseconds)\n"
+                    L"-TimeSeriesFilename:<filename with/without path>\n"
+                    L"\t - <default> == (not written to a log file)\n"
+                    L"\t   writes a compact binary file with a time series of every connection\n"
+                    L"\t   the bytes transferred in each interval (and a TCP RTT sample per interval)\n"
+                    L"\t   are kept in memory and written once when the connection completes\n"
+                    L"\t   note : this file cannot be shared with the other logging options\n"
+                    L"-TimeSeriesInterval:####\n"
+                    L"\t - the millisecond length of each interval in the time series\n"
+                    L"\t   <default> == 1000 (milliseconds)\n"
+                    L"-TimeSeriesSamples:####\n"
+                    L"\t - the number of intervals kept per connection\n"
+                    L"\t   once exceeded the oldest intervals are overwritten\n"
+                    L"\t   <default> == 256\n"
                     L"\n");
                 break;
 
@@ -2380,11 +3124,33 @@ namespace ctsTraffic::ctsConfig
                     L"-LocalPort:####\n"
                     L"   - the local port to bind to when initiating a connection\n"
                     L"\t- <default> == 0  (an ephemeral port will be chosen when making a connection)\n"
-                    L"\t- supports range : [low,high] each new connection will sequentially choose a port within this range\n"
+                    L"\t- supports range : [low,high] each new connection will choose a free port within this range\n"
+                    L"\t                   ports are tracked separately for each bind address\n"
                     L"\t  note : You must provide a sufficiently large range to support the number of connections\n"
                     L"\t  note : Be very careful when using with TCP connections, as port values will not be immediately\n"
                     L"\t         reusable; TCP will hold an closed IP:port in a TIME_WAIT statue for a period of time\n"
-                    L"\t         only after which will it be able to be reused (default is 4 minutes)\n"
+                    L"\t         only after which will it be able to be reused (TcpTimedWaitDelay, default is 2 minutes)\n"
+                    L"\t         with a range, ports closed gracefully are not reused until their TIME_WAIT period has passed\n"
+                    L"\t         and ports which fail to bind are moved to the back of the range instead of retried\n"
+                    L"\t         -shutdown:rst avoids TIME_WAIT entirely\n"
+                    L"-Memory:<default,hugepages,compact>\n"
+                    L"   - how buffers used for IO are allocated\n"
+                    L"     hugepages and compact can be combined as a comma-separated list: e.g. -Memory:hugepages,compact\n"
+                    L"\t- <default> == default\n"
+                    L"\t- default : standard pages\n"
+                    L"\t- hugepages : large pages for every buffer at least the size of one large page\n"
+                    L"\t              (the shared send and receive buffers, and larger per-connection buffers)\n"
+                    L"\t  note : requires the 'Lock pages in memory' privilege (SeLockMemoryPrivilege)\n"
+                    L"\t         standard pages are used if the privilege is not held\n"
+                    L"\t  note : the shared send buffer is not made read-only when it is in large pages\n"
+                    L"\t- compact : the smallest memory footprint per connection, for tests with very many connections\n"
+                    L"\t            timers and other state used by only some connections are allocated when first used,\n"
+                    L"\t            and each state transition is queued as a one-time threadpool callback\n"
+                    L"\t            instead of keeping a threadpool work object for every connection\n"
+                    L"\t            combine with -verify:connection so connections share one receive buffer\n"
+                    L"\t  note : on hosts with more than one NUMA node, each connection's receive buffers are allocated\n"
+                    L"\t         on the NUMA node of the processor initiating its IO\n"
+                    L"\t         - with -Threading:per-core, the processor which owns the connection\n"
                     L"-MsgWaitAll:<on,off>\n"
                     L"   - sets the MSG_WAITALL flag when calling WSARecv for receiving data over TCP connections\n"
                     L"     this flag instructs TCP to not complete the receive request until the entire buffer is full\n"
@@ -2397,13 +3163,16 @@ namespace ctsTraffic::ctsConfig
                     L"\t- log : log error information only\n"
                     L"\t- break : break into the debugger with error information\n"
                     L"\t          useful when live-troubleshooting difficult failures\n"
-                    L"-Options:<keepalive,tcpfastpath>  [-Options:<...>] [-Options:<...>]\n"
+                    L"-Options:<keepalive,tcpfastpath,fastopen>  [-Options:<...>] [-Options:<...>]\n"
                     L"   - additional socket options and IOCTLS available to be set on connected sockets\n"
                     L"\t- <default> == None\n"
                     L"\t- keepalive : only for TCP sockets - enables default timeout Keep-Alive probes\n"
                     L"\t            : ctsTraffic servers have this enabled by default\n"
                     L"\t- tcpfastpath : a new option for Windows 8, only for TCP sockets over loopback\n"
                     L"\t              : the firewall must be disabled for the option to take effect\n"
+                    L"\t- fastopen : only for TCP sockets - enables TCP Fast Open (TCP_FASTOPEN) on clients and listeners\n"
+                    L"\t            : the client sends its connection id with the SYN instead of receiving one from the server\n"
+                    L"\t            : must be specified on both the client and the server; clients must use -conn:ConnectEx\n"
                     L"-PrePostRecvs:#####\n"
                     L"   - specifies the number of recv requests to issue concurrently within an IO Pattern\n"
                     L"   - for example, with the default -pattern:pull, the client will post recv calls \n"
@@ -2442,6 +3211,17 @@ namespace ctsTraffic::ctsConfig
                     L"\t     Note: this is only necessary to specify in carefully considered scenarios\n"
                     L"\t     the default send buffering is optimal for the majority of scenarios\n"
                     L"\t- <default> == <not set>\n"
+                    L"-Threading:<pool,per-core>\n"
+                    L"   - the threading model used to run connection state changes, IO completions and timers\n"
+                    L"\t- <default> == pool\n"
+                    L"\t- pool : all connections share one threadpool with up to 2 threads per processor\n"
+                    L"\t- per-core : one thread pinned to each processor, each with its own threadpool\n"
+                    L"\t             connections are assigned round-robin to a thread which then runs all of their work\n"
+                    L"\t             listeners and other shared objects remain on the shared threadpool\n"
+                    L"\t  note : not supported with -IO:rioiocp\n"
+                    L"\t       : a blocking call stalls every connection assigned to the same thread, e.g.\n"
+                    L"\t         -Conn:connect (a blocking connect), retrying bind after WSAEADDRINUSE without a -LocalPort range\n"
+                    L"\t         (up to 5 seconds), and closing a socket (which waits for its outstanding IO callbacks)\n"
                     L"-ThrottleConnections:####\n"
                     L"   - gates currently pended connection attempts\n"
                     L"\t- <default> == 1000  (there will be at most 1000 sockets trying to connect at any one time)\n"
@@ -2584,14 +3364,16 @@ namespace ctsTraffic::ctsConfig
 
         set_ioPattern(args);
         set_threadpool(args);
+        set_memory(args);
         // validate protocol & pattern combinations
-        if (ProtocolType::UDP == Settings->Protocol && IoPatternType::MediaStream != Settings->IoPattern)
+        const bool udp_pattern = IoPatternType::MediaStream == Settings->IoPattern || IoPatternType::UdpBlast == Settings->IoPattern;
+        if (ProtocolType::UDP == Settings->Protocol && !udp_pattern)
         {
-            throw invalid_argument("UDP only supports the MediaStream IO Pattern");
+            throw invalid_argument("UDP only supports the MediaStream and UdpBlast IO Patterns");
         }
-        if (ProtocolType::TCP == Settings->Protocol && IoPatternType::MediaStream == Settings->IoPattern)
+        if (ProtocolType::TCP == Settings->Protocol && udp_pattern)
         {
-            throw invalid_argument("TCP does not support the MediaStream IO Pattern");
+            throw invalid_argument("TCP does not support the MediaStream or UdpBlast IO Patterns");
         }
         // set appropriate defaults for # of connections for TCP vs. UDP
         if (ProtocolType::UDP == Settings->Protocol)
@@ -2640,17 +3422,28 @@ namespace ctsTraffic::ctsConfig
         //
         // verify jitter logging requirements
         //
-        if (s_JitterLogger && Settings->Protocol != ProtocolType::UDP)
+        const bool jitter_enabled = s_JitterLogger || s_JitterCapture;
+        if (jitter_enabled && Settings->Protocol != ProtocolType::UDP)
         {
             throw invalid_argument("Jitter can only be logged using UDP");
         }
-        if (s_JitterLogger && !Settings->ListenAddresses.empty())
+        if (jitter_enabled && IoPatternType::UdpBlast == Settings->IoPattern)
+        {
+            throw invalid_argument("Jitter can only be logged with -Pattern:MediaStream");
+        }
+        if (jitter_enabled && !Settings->ListenAddresses.empty())
         {
             throw invalid_argument("Jitter can only be logged on the client");
         }
+        // the csv format has no connection column - a binary capture tags each record with its stream
         if (s_JitterLogger && Settings->ConnectionLimit != 1)
         {
-            throw invalid_argument("Jitter can only be logged for a single UDP connection");
+            throw invalid_argument("Jitter can only be logged for a single UDP connection to a csv file - use a .bin file to capture multiple connections");
+        }
+        // kernel timestamps are only reported as the csv jitter columns splitting network and host delay
+        if (s_MediaStreamSettings.KernelTimestamps && !s_JitterLogger)
+        {
+            throw invalid_argument("-Timestamps:kernel requires a csv -JitterFilename");
         }
 
         if (s_MediaStreamSettings.FrameSizeBytes > 0)
@@ -2658,6 +3451,11 @@ namespace ctsTraffic::ctsConfig
             // the buffersize is now effectively the frame size
             s_BufferSizeHigh = 0;
             s_BufferSizeLow = s_MediaStreamSettings.FrameSizeBytes;
+            if (s_MediaStreamSettings.FecDataDatagrams > 0)
+            {
+                // a parity datagram carries its parity header in addition to the longest payload
+                s_BufferSizeLow += ctsMediaStreamFec::ParityHeaderLength;
+            }
             if (s_BufferSizeLow < 20)
             {
                 throw invalid_argument("The media stream frame size (buffer) must be at least 20 bytes");
@@ -2694,6 +3492,13 @@ namespace ctsTraffic::ctsConfig
                 Settings->UseSharedBuffer = false;
             }
         }
+        if (IoPatternType::UdpBlast == Settings->IoPattern)
+        {
+            // UdpBlast receivers read the header of every datagram from its own recv buffer
+            // - and only the sequence numbers are checked: the payload is not verified
+            Settings->ShouldVerifyBuffers = false;
+            Settings->UseSharedBuffer = false;
+        }
 
         //
         // finally set the functions to use once all other settings are established
@@ -2701,6 +3506,11 @@ namespace ctsTraffic::ctsConfig
         // - hence it is requirement to invoke it prior to any socket operation
         //
         set_ioFunction(args);
+        if (!s_PerCoreThreadPools.empty() && (Settings->SocketFlags & WSA_FLAG_REGISTERED_IO))
+        {
+            // RIO completions are processed on ctsRioIocp's own worker threads
+            throw invalid_argument("-Threading:per-core is not supported with -IO:rioiocp");
+        }
         set_inlineCompletions(args);
         set_msgWaitAll(args);
         set_create(args);
@@ -2712,16 +3522,59 @@ namespace ctsTraffic::ctsConfig
             Settings->CreateFunction = Settings->AcceptFunction;
             Settings->ConnectFunction = nullptr;
         }
+        else if ((Settings->Options & FAST_OPEN) && 0 != wcscmp(s_ConnectFunctionName, L"ConnectEx"))
+        {
+            // only ConnectEx can send data with the SYN
+            throw invalid_argument("-Options:FastOpen requires -conn:ConnectEx");
+        }
 
         Settings->TcpShutdown = TcpShutdownType::GracefulShutdown;
         set_shutdownOption(args);
 
+        if (Settings->ListenAddresses.empty() && Settings->LocalPortHigh != 0)
+        {
+            // the client side only enters TIME_WAIT when it initiates a graceful close
+            unsigned long time_wait_ms = c_DefaultTimeWaitSeconds * 1000UL;
+            DWORD time_wait_seconds{};
+            DWORD time_wait_seconds_size = sizeof time_wait_seconds;
+            if (ERROR_SUCCESS == RegGetValueW(
+                HKEY_LOCAL_MACHINE,
+                L"SYSTEM\\CurrentControlSet\\Services\\Tcpip\\Parameters",
+                L"TcpTimedWaitDelay",
+                RRF_RT_REG_DWORD,
+                nullptr,
+                &time_wait_seconds,
+                &time_wait_seconds_size))
+            {
+                time_wait_ms = time_wait_seconds * 1000UL;
+            }
+            const bool client_time_wait = ProtocolType::TCP == Settings->Protocol && TcpShutdownType::GracefulShutdown == Settings->TcpShutdown;
+
+            s_LocalPortAllocator = make_unique<ctsLocalPortAllocator>(
+                Settings->LocalPortLow,
+                Settings->LocalPortHigh,
+                Settings->BindAddresses.size(),
+                client_time_wait ? time_wait_ms : 0UL,
+                time_wait_ms);
+        }
+
         set_prepostrecvs(args);
         if (ProtocolType::TCP == Settings->Protocol && Settings->ShouldVerifyBuffers && Settings->PrePostRecvs > 1)
         {
             throw invalid_argument("-PrePostRecvs > 1 requires -Verify:connection when using TCP");
         }
         set_prepostsends(args);
+        // Push and Pull with one send and one recv in flight only ever have one IO pended
+        // - the Iocp and ReadWriteFile IO functions stop calling initiate_io once that IO pends,
+        //   handing the pattern to the completing thread, so the pattern can skip its lock
+        // - RIO keeps its loop running while completions are processed
+        // - rate limiting schedules IO from a timer while the completion may still be running
+        Settings->SingleOwnerIoPattern =
+            (IoPatternType::Push == Settings->IoPattern || IoPatternType::Pull == Settings->IoPattern) &&
+            !(Settings->SocketFlags & WSA_FLAG_REGISTERED_IO) &&
+            1 == Settings->PrePostRecvs &&
+            1 == Settings->PrePostSends &&
+            0LL == s_RateLimitLow;
         set_recvbufvalue(args);
         set_sendbufvalue(args);
 
@@ -2823,9 +3676,16 @@ namespace ctsTraffic::ctsConfig
 
         if (s_ConnectionLogger && s_ConnectionLogger->IsCsvFormat())
         {
-            if (ProtocolType::UDP == Settings->Protocol)
+            if (IoPatternType::UdpBlast == Settings->IoPattern)
+            {
+                s_ConnectionLogger->LogMessage(L"TimeSlice,LocalAddress,RemoteAddress,Bits/Sec,Completed,Dropped,Repeated,Errors,Result,ConnectionId,Packets/Sec\r\n");
+            }
+            else if (ProtocolType::UDP == Settings->Protocol)
             {
-                s_ConnectionLogger->LogMessage(L"TimeSlice,LocalAddress,RemoteAddress,Bits/Sec,Completed,Dropped,Repeated,Errors,Result,ConnectionId\r\n");
+                s_ConnectionLogger->LogMessage(
+                    s_MediaStreamSettings.FecDataDatagrams > 0 ?
+                    L"TimeSlice,LocalAddress,RemoteAddress,Bits/Sec,Completed,Dropped,Repeated,Errors,Result,ConnectionId,FecDatagrams,FecCpuUs\r\n" :
+                    L"TimeSlice,LocalAddress,RemoteAddress,Bits/Sec,Completed,Dropped,Repeated,Errors,Result,ConnectionId\r\n");
             }
             else
             { // TCP
@@ -2835,7 +3695,10 @@ namespace ctsTraffic::ctsConfig
 
         if (s_JitterLogger && s_JitterLogger->IsCsvFormat())
         {
-            s_JitterLogger->LogMessage(L"SequenceNumber,SenderQpc,SenderQpf,ReceiverQpc,ReceiverQpf,RelativeInFlightTimeMs,PrevToCurrentInFlightTimeJitter\r\n");
+            s_JitterLogger->LogMessage(
+                s_MediaStreamSettings.KernelTimestamps ?
+                L"SequenceNumber,SenderQpc,SenderQpf,ReceiverQpc,ReceiverQpf,RelativeInFlightTimeMs,PrevToCurrentInFlightTimeJitter,ReceiverKernelQpc,RelativeNetworkInFlightTimeMs,PrevToCurrentNetworkJitter,HostProcessingMs,PrevToCurrentHostProcessingJitter\r\n" :
+                L"SequenceNumber,SenderQpc,SenderQpf,ReceiverQpc,ReceiverQpf,RelativeInFlightTimeMs,PrevToCurrentInFlightTimeJitter\r\n");
         }
     }
 
@@ -3128,27 +3991,62 @@ namespace ctsTraffic::ctsConfig
                         // update tracking values
                         s_PreviousPrintTimeslice = l_current_timeslice;
                         ++s_PrintTimesliceCount;
+
+                        const long long active_connections = Settings->ConnectionStatusDetails.active_connection_count.get();
+                        if (active_connections > s_PeakConnectionCount)
+                        {
+                            s_PeakConnectionCount = active_connections;
+                            s_PeakPrivateBytes = current_private_bytes();
+                        }
                     }
                 }
             }
         }
     }
 
-    void PrintJitterUpdate(const JitterFrameEntry& current_frame, const JitterFrameEntry& previous_frame) noexcept
+    void PrintJitterUpdate(unsigned long stream_id, const JitterFrameEntry& current_frame, const JitterFrameEntry& previous_frame) noexcept
     {
         if (!s_ShutdownCalled)
         {
-            if (s_JitterLogger)
+            if (s_JitterCapture)
+            {
+                // the receiver qpf is fixed for the machine and is written once in the capture header
+                // - the estimated time in flight and jitter are derived offline by ctsJitter.exe
+                s_JitterCapture->write({
+                    stream_id,
+                    current_frame.bytes_received,
+                    current_frame.sequence_number,
+                    current_frame.sender_qpc,
+                    current_frame.sender_qpf,
+                    current_frame.receiver_qpc });
+            }
+            else if (s_JitterLogger)
             {
                 const auto jitter = std::abs(previous_frame.estimated_time_in_flight_ms - current_frame.estimated_time_in_flight_ms);
                 // long long ~= up to 20 characters long, 10 for each float, plus 10 for commas & CR
-                constexpr size_t formatted_text_length = 20 * 5 + 10 * 2 + 10;
+                // - with -Timestamps:kernel, another long long and 4 floats
+                constexpr size_t formatted_text_length = 20 * 6 + 10 * 6 + 20;
                 wchar_t formatted_text[formatted_text_length]{};
-                const auto converted = _snwprintf_s(
-                    formatted_text,
-                    formatted_text_length,
-                    L"%lld,%lld,%lld,%lld,%lld,%.3f,%.3f\r\n",
-                    current_frame.sequence_number, current_frame.sender_qpc, current_frame.sender_qpf, current_frame.receiver_qpc, current_frame.receiver_qpf, current_frame.estimated_time_in_flight_ms, jitter);
+                int converted;
+                if (s_MediaStreamSettings.KernelTimestamps)
+                {
+                    const auto network_jitter = std::abs(previous_frame.estimated_network_time_in_flight_ms - current_frame.estimated_network_time_in_flight_ms);
+                    const auto host_jitter = std::abs(previous_frame.host_processing_ms - current_frame.host_processing_ms);
+                    converted = _snwprintf_s(
+                        formatted_text,
+                        formatted_text_length,
+                        L"%lld,%lld,%lld,%lld,%lld,%.3f,%.3f,%lld,%.3f,%.3f,%.3f,%.3f\r\n",
+                        current_frame.sequence_number, current_frame.sender_qpc, current_frame.sender_qpf, current_frame.receiver_qpc, current_frame.receiver_qpf, current_frame.estimated_time_in_flight_ms, jitter,
+                        current_frame.receiver_kernel_qpc, current_frame.estimated_network_time_in_flight_ms, network_jitter, current_frame.host_processing_ms, host_jitter);
+                }
+                else
+                {
+                    converted = _snwprintf_s(
+                        formatted_text,
+                        formatted_text_length,
+                        L"%lld,%lld,%lld,%lld,%lld,%.3f,%.3f\r\n",
+                        current_frame.sequence_number, current_frame.sender_qpc, current_frame.sender_qpf, current_frame.receiver_qpc, current_frame.receiver_qpf, current_frame.estimated_time_in_flight_ms, jitter);
+                }
                 FAIL_FAST_IF(-1 == converted);
                 s_JitterLogger->LogMessage(formatted_text);
             }
@@ -3525,11 +4423,24 @@ namespace ctsTraffic::ctsConfig
         static PCWSTR UDPProtocolFailureResultTextFormat = L"[%.3f] UDP connection failed with the protocol error %ws : [%ws - %ws] [%hs] : BitsPerSecond [%llu]  Completed [%llu]  Dropped [%llu]  Repeated [%llu]  Errors [%llu]";
 
         // csv format : "TimeSlice,LocalAddress,RemoteAddress,Bits/Sec,Completed,Dropped,Repeated,Errors,Result,ConnectionId"
-        static PCWSTR UDPResultCsvFormat = L"%.3f,%ws,%ws,%llu,%llu,%llu,%llu,%llu,%ws,%hs\r\n";
+        // - with -Recovery:fec followed by "FecDatagrams,FecCpuUs"
+        // - with -Pattern:UdpBlast followed by "Packets/Sec"
+        static PCWSTR UDPResultCsvFormat = L"%.3f,%ws,%ws,%llu,%llu,%llu,%llu,%llu,%ws,%hs";
+        static PCWSTR UDPFecResultCsvFormat = L",%lld,%lld";
+        static PCWSTR UDPFecResultTextFormat = L"  FecDatagrams [%lld]  FecCpu [%lld us]";
+        // -Pattern:UdpBlast - followed by "Packets/Sec"
+        static PCWSTR UDPBlastResultCsvFormat = L",%lld";
+        static PCWSTR UDPBlastResultTextFormat = L"  PacketsPerSecond [%lld]";
 
         const float current_time = GetStatusTimeStamp();
         const long long elapsed_time(_stats.end_time.get() - _stats.start_time.get());
         const long long bits_per_second = elapsed_time > 0LL ? static_cast<long long>(_stats.bits_received.get() * 1000LL / elapsed_time) : 0LL;
+        // the parity datagrams the server encoded or the datagrams the client rebuilt, and the time spent doing so
+        const bool fec_enabled = s_MediaStreamSettings.FecDataDatagrams > 0;
+        const long long fec_cpu_microseconds = _stats.fec_cpu_ticks.get() * 1000000LL / ctTimer::ctSnapQpf();
+        // the datagrams sent (client) or received (server) each second
+        const bool udp_blast = IoPatternType::UdpBlast == Settings->IoPattern;
+        const long long packets_per_second = elapsed_time > 0LL ? _stats.successful_frames.get() * 1000LL / elapsed_time : 0LL;
 
         wstring csv_string;
         wstring text_string;
@@ -3567,6 +4478,15 @@ namespace ctsTraffic::ctsConfig
                 ctsIOPattern::BuildProtocolErrorString(_error) :
                 error_string.c_str(),
                 _stats.connection_identifier);
+            if (fec_enabled)
+            {
+                csv_string.append(ctString::ctFormatString(UDPFecResultCsvFormat, _stats.fec_datagrams.get(), fec_cpu_microseconds));
+            }
+            if (udp_blast)
+            {
+                csv_string.append(ctString::ctFormatString(UDPBlastResultCsvFormat, packets_per_second));
+            }
+            csv_string.append(L"\r\n");
         }
         // we'll never write csv format to the console so we'll need a text string in that case
         // - and/or in the case the s_ConnectionLogger isn't writing to csv
@@ -3603,6 +4523,14 @@ namespace ctsTraffic::ctsConfig
                     _stats.duplicate_frames.get(),
                     _stats.error_frames.get());
             }
+            if (fec_enabled)
+            {
+                text_string.append(ctString::ctFormatString(UDPFecResultTextFormat, _stats.fec_datagrams.get(), fec_cpu_microseconds));
+            }
+            if (udp_blast)
+            {
+                text_string.append(ctString::ctFormatString(UDPBlastResultTextFormat, packets_per_second));
+            }
         }
 
         if (write_to_console)
@@ -3640,6 +4568,53 @@ namespace ctsTraffic::ctsConfig
         }
     }
 
+    void PrintTimeSeries(_In_z_ const char* _connection_id, const ctsConnectionTimeSeries& _time_series) noexcept
+        try
+    {
+        ctsConfigInitOnce();
+
+        const auto sample_count = _time_series.sample_count();
+        if (0 == sample_count)
+        {
+            return;
+        }
+
+        // build the entire block before taking the lock so each connection is a single write
+        vector<char> block(
+            sizeof(TimeSeriesBlockHeader) +
+            sample_count * (sizeof(unsigned long) + sizeof(long long) + sizeof(unsigned long)));
+
+        auto* const block_header = reinterpret_cast<TimeSeriesBlockHeader*>(block.data());
+        memcpy_s(block_header->connection_id, sizeof block_header->connection_id, _connection_id, ctsStatistics::ConnectionIdLength);
+        block_header->sample_count = sample_count;
+        block_header->overwritten_samples = _time_series.overwritten_samples();
+
+        auto* interval_column = block.data() + sizeof(TimeSeriesBlockHeader);
+        auto* bytes_column = interval_column + sample_count * sizeof(unsigned long);
+        auto* rtt_column = bytes_column + sample_count * sizeof(long long);
+        _time_series.for_each_sample([&](const ctsTimeSeriesSample& _sample) noexcept {
+            memcpy(interval_column, &_sample.interval, sizeof _sample.interval);
+            interval_column += sizeof _sample.interval;
+            memcpy(bytes_column, &_sample.bytes, sizeof _sample.bytes);
+            bytes_column += sizeof _sample.bytes;
+            memcpy(rtt_column, &_sample.rtt_microseconds, sizeof _sample.rtt_microseconds);
+            rtt_column += sizeof _sample.rtt_microseconds;
+        });
+
+        const auto lock = s_TimeSeriesLock.lock();
+        if (s_TimeSeriesFile)
+        {
+            DWORD bytes_written{};
+            if (!WriteFile(s_TimeSeriesFile.get(), block.data(), static_cast<DWORD>(block.size()), &bytes_written, nullptr))
+            {
+                PrintErrorIfFailed("WriteFile (TimeSeriesFilename)", GetLastError());
+            }
+        }
+    }
+    catch (...)
+    {
+    }
+
     void __cdecl PrintSummary(_In_z_ _Printf_format_string_ PCWSTR _text, ...) noexcept
     {
         ctsConfigInitOnce();
@@ -3689,6 +4664,101 @@ namespace ctsTraffic::ctsConfig
         va_end(argptr);
     }
 
+    void PrintDroppedLogMessages() noexcept
+    {
+        ctsConfigInitOnce();
+
+        const pair<PCWSTR, const ctsLogger*> loggers[]{
+            { L"Connection", s_ConnectionLogger.get() },
+            { L"Error", s_ErrorLogger.get() },
+            { L"Status", s_StatusLogger.get() },
+            { L"Jitter", s_JitterLogger.get() } };
+        for (auto logger = begin(loggers); logger != end(loggers); ++logger)
+        {
+            // the same logger can be shared across multiple logging options
+            const bool already_printed = any_of(begin(loggers), logger, [&](const pair<PCWSTR, const ctsLogger*>& _prior) {
+                return _prior.second == logger->second;
+            });
+            if (logger->second && !already_printed && logger->second->DroppedMessageCount() > 0)
+            {
+                PrintSummary(
+                    L"  ** %ws log dropped %lld messages : the log writer fell behind **\n",
+                    logger->first,
+                    logger->second->DroppedMessageCount());
+            }
+        }
+
+        if (s_JitterCapture && s_JitterCapture->dropped_record_count() > 0)
+        {
+            PrintSummary(
+                L"  ** Jitter capture dropped %lld records : the capture file could not be extended **\n",
+                s_JitterCapture->dropped_record_count());
+        }
+    }
+
+    void PrintBufferPlacementStatistics() noexcept
+    {
+        ctsConfigInitOnce();
+
+        const auto& counters = ctsBufferPlacement::Counters();
+        if (s_LargePagesRequested)
+        {
+            PrintSummary(
+                L"  Buffers In Large Pages : %lld   Large Page Allocations Failed : %lld   Buffers In Standard Pages : %lld\n",
+                ctMemoryGuardRead(&counters.large_page_allocations),
+                ctMemoryGuardRead(&counters.large_page_failures),
+                ctMemoryGuardRead(&counters.standard_page_allocations));
+        }
+        // placement is only interesting with more than one NUMA node
+        ULONG highest_numa_node = 0;
+        if (GetNumaHighestNodeNumber(&highest_numa_node) && highest_numa_node > 0)
+        {
+            PrintSummary(
+                L"  Receive Buffers On The Local NUMA Node : %lld   On A Remote NUMA Node : %lld\n",
+                ctMemoryGuardRead(&counters.local_node_allocations),
+                ctMemoryGuardRead(&counters.remote_node_allocations));
+        }
+    }
+
+    void PrintConnectionFootprint() noexcept
+    {
+        ctsConfigInitOnce();
+
+        // the status lock guards the peak values
+        const auto lock = s_StatusUpdateLock.lock();
+        if (s_PeakConnectionCount > 0 && s_PeakPrivateBytes > s_BaselinePrivateBytes)
+        {
+            // includes buffers shared across connections, spread over the connections at that peak
+            PrintSummary(
+                L"  Peak Active Connections : %lld   Private Bytes At Peak : %Iu   Bytes Per Connection : %Iu\n",
+                s_PeakConnectionCount,
+                s_PeakPrivateBytes,
+                (s_PeakPrivateBytes - s_BaselinePrivateBytes) / static_cast<SIZE_T>(s_PeakConnectionCount));
+        }
+    }
+
+    void PrintLocalPortStatistics() noexcept
+    {
+        ctsConfigInitOnce();
+
+        if (s_LocalPortAllocator)
+        {
+            PrintSummary(
+                L"  Local Ports Leased : %lld\n"
+                L"    Bind Conflicts : %lld   Reused Before TIME_WAIT Expired : %lld   Range Exhausted : %lld\n",
+                s_LocalPortAllocator->acquired(),
+                s_LocalPortAllocator->conflicts(),
+                s_LocalPortAllocator->early_reuses(),
+                s_LocalPortAllocator->exhausted());
+            if (s_LocalPortAllocator->lost() > 0)
+            {
+                PrintSummary(
+                    L"  ** %lld local ports could not be returned to the range : out of memory **\n",
+                    s_LocalPortAllocator->lost());
+            }
+        }
+    }
+
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
@@ -3874,6 +4944,31 @@ namespace ctsTraffic::ctsConfig
             }
         }
 
+        //
+        // TCP Fast Open must be enabled before connecting and before listening
+        // - clients send their connection id with the SYN through the ConnectEx send buffer
+        //
+        if (ProtocolType::TCP == Settings->Protocol && (Settings->Options & FAST_OPEN))
+        {
+            constexpr DWORD optval = 1; // BOOL
+            constexpr auto optlen = static_cast<int>(sizeof optval);
+#ifndef TCP_FASTOPEN
+#define TCP_FASTOPEN 15
+#endif
+            const auto error = setsockopt(
+                _s,
+                IPPROTO_TCP,   // level
+                TCP_FASTOPEN, // optname
+                reinterpret_cast<const char*>(&optval),
+                optlen);
+            if (error != 0)
+            {
+                const auto gle = WSAGetLastError();
+                PrintErrorIfFailed("setsockopt(TCP_FASTOPEN)", gle);
+                return gle;
+            }
+        }
+
         if (Settings->Options & LOOPBACK_FAST_PATH)
         {
             DWORD in_value = 1;
@@ -4022,10 +5117,83 @@ namespace ctsTraffic::ctsConfig
     int SetPreConnectOptions(SOCKET _s) noexcept
     {
         ctsConfigInitOnce();
-        UNREFERENCED_PARAMETER(_s);
+
+        //
+        // -Timestamps:kernel : have the stack return a software receive timestamp with each datagram
+        // - requires Windows 10 20H1 or Windows Server 2022 or later
+        //
+        if (s_MediaStreamSettings.KernelTimestamps && ProtocolType::UDP == Settings->Protocol && !IsListening())
+        {
+            TIMESTAMPING_CONFIG timestamping_config{};
+            timestamping_config.Flags = TIMESTAMPING_FLAG_RX;
+            DWORD bytes_returned = 0;
+            if (WSAIoctl(
+                _s,
+                SIO_TIMESTAMPING,
+                &timestamping_config,
+                static_cast<DWORD>(sizeof timestamping_config),
+                nullptr,
+                0,
+                &bytes_returned,
+                nullptr,
+                nullptr) != 0)
+            {
+                const auto gle = WSAGetLastError();
+                PrintErrorIfFailed("WSAIoctl(SIO_TIMESTAMPING)", gle);
+                return gle;
+            }
+        }
+
         return 0;
     }
 
+    PTP_CALLBACK_ENVIRON NextConnectionThreadpoolEnvironment() noexcept
+    {
+        ctsConfigInitOnce();
+
+        if (s_PerCoreThreadPoolEnvironments.empty())
+        {
+            return Settings->PTPEnvironment;
+        }
+        const auto next = ctMemoryGuardIncrement(&s_PerCoreThreadPoolCounter);
+        return &s_PerCoreThreadPoolEnvironments[static_cast<size_t>(next % s_PerCoreThreadPoolEnvironments.size())];
+    }
+
+    size_t PerCoreThreadpoolEnvironments(_Outptr_result_maybenull_ PTP_CALLBACK_ENVIRON* _environments) noexcept
+    {
+        ctsConfigInitOnce();
+
+        *_environments = s_PerCoreThreadPoolEnvironments.empty() ? nullptr : s_PerCoreThreadPoolEnvironments.data();
+        return s_PerCoreThreadPoolEnvironments.size();
+    }
+
+    bool AcquireLocalPort(size_t _address_index, _Out_ LocalPortLease& _lease) noexcept
+    {
+        ctsConfigInitOnce();
+
+        _lease = LocalPortLease{};
+        if (!s_LocalPortAllocator)
+        {
+            return false;
+        }
+        if (!s_LocalPortAllocator->acquire(_address_index, _lease.port))
+        {
+            return false;
+        }
+        _lease.address_index = _address_index;
+        return true;
+    }
+
+    void ReleaseLocalPort(const LocalPortLease& _lease, bool _bind_conflict) noexcept
+    {
+        ctsConfigInitOnce();
+
+        if (s_LocalPortAllocator && _lease.port != 0)
+        {
+            s_LocalPortAllocator->release(_lease.address_index, _lease.port, _bind_conflict);
+        }
+    }
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     ///
     /// PrintSettings
@@ -4067,6 +5235,10 @@ namespace ctsTraffic::ctsConfig
             {
                 setting_string.append(L" TCPFastPath");
             }
+            if (Settings->Options & FAST_OPEN)
+            {
+                setting_string.append(L" FastOpen");
+            }
             if (Settings->KeepAliveValue > 0)
             {
                 setting_string.append(L" KeepAlive (");
@@ -4105,6 +5277,49 @@ namespace ctsTraffic::ctsConfig
         setting_string.append(L"\n");
 
         setting_string.append(ctString::ctFormatString(L"\tIO function: %ws\n", s_IoFunctionName));
+        if (s_PerCoreThreadPools.empty())
+        {
+            setting_string.append(ctString::ctFormatString(L"\tThreading: threadpool (up to %lu threads)\n", s_ThreadPoolThreadCount));
+        }
+        else
+        {
+            setting_string.append(ctString::ctFormatString(L"\tThreading: per-core (%Iu pinned threads)\n", s_PerCoreThreadPools.size()));
+        }
+
+        if (Settings->LargePages)
+        {
+            setting_string.append(ctString::ctFormatString(
+                L"\tMemory: large pages (%Iu KB) for buffers of at least one large page\n",
+                GetLargePageMinimum() / 1024));
+        }
+        else if (s_LargePagesRequested)
+        {
+            setting_string.append(ctString::ctFormatString(
+                L"\tMemory: standard pages - large pages could not be enabled (%u)\n",
+                s_LargePagesError));
+        }
+        ULONG highest_numa_node = 0;
+        if (GetNumaHighestNodeNumber(&highest_numa_node) && highest_numa_node > 0)
+        {
+            setting_string.append(ctString::ctFormatString(
+                L"\tMemory: receive buffers allocated on the NUMA node of the connection's processor (%lu NUMA nodes)\n",
+                highest_numa_node + 1));
+        }
+        if (Settings->CompactConnections)
+        {
+            setting_string.append(L"\tMemory: compact connections\n");
+        }
+        // the objects every connection allocates, plus its own receive buffers when not sharing one buffer
+        // - the measured footprint at the peak connection count is printed on exit
+        size_t connection_bytes = sizeof(ctsSocketState) + sizeof(ctsSocket) + sizeof(ctThreadIocp) + ctsIOPattern::PatternObjectSize();
+        if (!Settings->UseSharedBuffer)
+        {
+            connection_bytes += static_cast<size_t>(Settings->PrePostRecvs > 0 ? Settings->PrePostRecvs : 1) * GetMaxBufferSize();
+        }
+        setting_string.append(ctString::ctFormatString(
+            L"\tMemory: estimated %Iu bytes per connection\n",
+            connection_bytes));
+        s_BaselinePrivateBytes = current_private_bytes();
 
         setting_string.append(L"\tIoPattern: ");
         switch (Settings->IoPattern)
@@ -4126,6 +5341,17 @@ namespace ctsTraffic::ctsConfig
             case IoPatternType::MediaStream:
                 setting_string.append(L"MediaStream <UDP controlled stream from server to client>\n");
                 break;
+            case IoPatternType::UdpBlast:
+                setting_string.append(L"UdpBlast <UDP datagrams from client to server, measuring the packet rate and loss>\n");
+                if (Settings->PacketsPerSecond > 0)
+                {
+                    setting_string.append(ctString::ctFormatString(L"\t\tPacketsPerSecond: %lu\n", Settings->PacketsPerSecond));
+                }
+                else
+                {
+                    setting_string.append(L"\t\tPacketsPerSecond: as fast as the sends complete\n");
+                }
+                break;
 
             case IoPatternType::NoIOSet: // fall-through
             default:
@@ -4142,6 +5368,10 @@ namespace ctsTraffic::ctsConfig
         {
             setting_string.append(ctString::ctFormatString(L"\tPrePostSends: Following Ideal Send Backlog\n"));
         }
+        if (Settings->SingleOwnerIoPattern)
+        {
+            setting_string.append(L"\tIO pattern: single owner (no per-connection lock)\n");
+        }
 
         setting_string.append(
             ctString::ctFormatString(
@@ -4180,7 +5410,7 @@ namespace ctsTraffic::ctsConfig
                     s_TransferSizeLow, s_TransferSizeHigh));
         }
 
-        if (ProtocolType::UDP == Settings->Protocol)
+        if (IoPatternType::MediaStream == Settings->IoPattern)
         {
             setting_string.append(
                 ctString::ctFormatString(
@@ -4199,15 +5429,50 @@ namespace ctsTraffic::ctsConfig
                         static_cast<unsigned long>(s_MediaStreamSettings.BufferDepthSeconds)));
             }
 
+            if (s_MediaStreamSettings.AdaptivePlayout)
+            {
+                setting_string.append(L"\t\tUDP Stream Playout: adaptive to the observed jitter\n");
+            }
+
+            if (s_MediaStreamSettings.KernelTimestamps)
+            {
+                setting_string.append(L"\t\tUDP Stream Timestamps: kernel receive timestamps\n");
+            }
+
+            if (s_MediaStreamSettings.NackRecovery)
+            {
+                setting_string.append(L"\t\tUDP Stream Recovery: NACK retransmission\n");
+            }
+            else if (s_MediaStreamSettings.FecDataDatagrams > 0)
+            {
+                setting_string.append(
+                    ctString::ctFormatString(
+                        L"\t\tUDP Stream Recovery: FEC with %lu XOR parity datagrams per %lu data datagrams\n",
+                        static_cast<unsigned long>(s_MediaStreamSettings.FecParityDatagrams),
+                        static_cast<unsigned long>(s_MediaStreamSettings.FecDataDatagrams)));
+            }
+
             setting_string.append(
                 ctString::ctFormatString(
                     L"\t\tUDP Stream StreamLength: %lu seconds (%lu frames)\n",
                     static_cast<unsigned long>(s_MediaStreamSettings.StreamLengthSeconds),
                     static_cast<unsigned long>(s_MediaStreamSettings.StreamLengthFrames)));
-            setting_string.append(
-                ctString::ctFormatString(
-                    L"\t\tUDP Stream FrameSize: %lu bytes\n",
-                    static_cast<unsigned long>(s_MediaStreamSettings.FrameSizeBytes)));
+            if (s_MediaStreamSettings.GopLengthFrames > 0)
+            {
+                setting_string.append(
+                    ctString::ctFormatString(
+                        L"\t\tUDP Stream FrameModel: GOP of %lu frames (I-frame %lu bytes, P-frame %lu bytes)\n",
+                        static_cast<unsigned long>(s_MediaStreamSettings.GopLengthFrames),
+                        static_cast<unsigned long>(s_MediaStreamSettings.IFrameSizeBytes),
+                        static_cast<unsigned long>(s_MediaStreamSettings.PFrameSizeBytes)));
+            }
+            else
+            {
+                setting_string.append(
+                    ctString::ctFormatString(
+                        L"\t\tUDP Stream FrameSize: %lu bytes\n",
+                        static_cast<unsigned long>(s_MediaStreamSettings.FrameSizeBytes)));
+            }
         }
 
         if (ProtocolType::TCP == Settings->Protocol && s_RateLimitLow > 0)
@@ -72,7 +72,8 @@ namespace ctsTraffic
             Pull,
             PushPull,
             Duplex,
-            MediaStream
+            MediaStream,
+            UdpBlast
         };
 
         enum class StatusFormatting
@@ -97,7 +98,8 @@ namespace ctsTraffic
             SET_SEND_BUF = 0x0040,
             ENABLE_CIRCULAR_QUEUEING = 0x0080,
             MSG_WAIT_ALL = 0x0100,
-            // next enum  = 0x0200
+            FAST_OPEN = 0x0200,
+            // next enum  = 0x0400
         };
 
         ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -169,17 +171,30 @@ namespace ctsTraffic
         struct JitterFrameEntry
         {
             unsigned long bytes_received = 0UL;
+            // -Recovery:nack : bytes received from retransmitted datagrams, tracked apart from the original datagrams
+            unsigned long retransmitted_bytes = 0UL;
+            bool retransmit_requested = false;
             long long sequence_number = 0LL;
             long long sender_qpc = 0LL;
             long long sender_qpf = 0LL;
             long long receiver_qpc = 0LL;
             long long receiver_qpf = 0LL;
             double estimated_time_in_flight_ms = 0;
+            // -Timestamps:kernel : when the kernel received the frame's latest datagram, on the receiver_qpf clock
+            // - the time in flight to the kernel is the network delay, the time from the kernel to receiver_qpc is the host delay
+            long long receiver_kernel_qpc = 0LL;
+            double estimated_network_time_in_flight_ms = 0;
+            double host_processing_ms = 0;
         };
-        void PrintJitterUpdate(const JitterFrameEntry& current_frame, const JitterFrameEntry& previous_frame) noexcept;
+        // stream_id distinguishes connections when multiple connections write to a binary jitter capture
+        void PrintJitterUpdate(unsigned long stream_id, const JitterFrameEntry& current_frame, const JitterFrameEntry& previous_frame) noexcept;
 
         void PrintStatusUpdate() noexcept;
         void __cdecl PrintSummary(_In_z_ _Printf_format_string_ PCWSTR _text, ...) noexcept;
+        void PrintDroppedLogMessages() noexcept;
+        void PrintLocalPortStatistics() noexcept;
+        void PrintBufferPlacementStatistics() noexcept;
+        void PrintConnectionFootprint() noexcept;
 
         // Putting PrintDebugInfo as a macro to avoid running any code for debug printing if not necessary
 #define PrintDebugInfo(fmt, ...)                                        \
@@ -206,6 +221,7 @@ namespace ctsTraffic
         void PrintConnectionResults(const ctl::ctSockaddr& _local_addr, const ctl::ctSockaddr& _remote_addr, unsigned long _error, const ctsTcpStatistics& _stats) noexcept;
         void PrintConnectionResults(const ctl::ctSockaddr& _local_addr, const ctl::ctSockaddr& _remote_addr, unsigned long _error, const ctsUdpStatistics& _stats) noexcept;
         void PrintConnectionResults(unsigned long _error) noexcept;
+        void PrintTimeSeries(_In_z_ const char* _connection_id, const ctsConnectionTimeSeries& _time_series) noexcept;
 
         // Get* functions
         ctsSignedLongLong   GetTcpBytesPerSecond() noexcept;
@@ -218,10 +234,35 @@ namespace ctsTraffic
         int  GetListenBacklog() noexcept;
         bool IsListening() noexcept;
 
+        //
+        // Returns the threadpool environment a new connection should use for all its TP objects
+        // - with -Threading:per-core this assigns connections round-robin across the per-processor pools
+        //
+        PTP_CALLBACK_ENVIRON NextConnectionThreadpoolEnvironment() noexcept;
+        //
+        // Returns the number of per-processor pools with -Threading:per-core, and the array of their environments
+        // - returns 0 and nullptr without per-core pools
+        //
+        size_t PerCoreThreadpoolEnvironments(_Outptr_result_maybenull_ PTP_CALLBACK_ENVIRON* _environments) noexcept;
+
         // Set* functions
         int SetPreBindOptions(SOCKET _s, const ctl::ctSockaddr& _local_address) noexcept;
         int SetPreConnectOptions(SOCKET _s) noexcept;
 
+        //
+        // Local ports leased from a -LocalPort range, tracked per index into Settings->BindAddresses
+        // - AcquireLocalPort returns false if there is no -LocalPort range or every port is leased
+        // - ReleaseLocalPort must be called once the socket bound to the port is closed
+        //   or when bind failed: _bind_conflict indicates bind failed with WSAEADDRINUSE
+        //
+        struct LocalPortLease
+        {
+            size_t address_index = 0;
+            unsigned short port = 0;
+        };
+        bool AcquireLocalPort(size_t _address_index, _Out_ LocalPortLease& _lease) noexcept;
+        void ReleaseLocalPort(const LocalPortLease& _lease, bool _bind_conflict) noexcept;
+
         // for the MediaStream pattern
         struct MediaStreamSettings
         {
@@ -230,13 +271,49 @@ namespace ctsTraffic
             ctsUnsignedLong FramesPerSecond = 0;
             ctsUnsignedLong BufferDepthSeconds = 0;
             ctsUnsignedLong StreamLengthSeconds = 0;
+            // -FrameModel:gop - every GopLengthFrames frames starts with an I-frame, followed by P-frames
+            ctsUnsignedLong IFrameSizeBytes = 0;
+            ctsUnsignedLong PFrameSizeBytes = 0;
+            ctsUnsignedLong GopLengthFrames = 0;
+            // -Recovery:nack - the client requests missing frames, which the server retransmits from its recent history
+            bool NackRecovery = false;
+            // -Recovery:fec:<N>,<K> - every N data datagrams of a frame are followed by K XOR parity datagrams
+            ctsUnsignedLong FecDataDatagrams = 0;
+            ctsUnsignedLong FecParityDatagrams = 0;
+            // -Playout:adaptive - the client sizes its playout buffer from the jitter it observes,
+            // starting from -BufferDepth and limited to twice -BufferDepth
+            bool AdaptivePlayout = false;
+            // -Timestamps:kernel - the client reads the receive time of each datagram from the kernel's software timestamp,
+            // so the jitter log can split the time in flight into network delay and host processing delay
+            bool KernelTimestamps = false;
             // internally calculated
+            // - with a GOP model, FrameSizeBytes is the largest frame: the size buffers must hold
             ctsUnsignedLong FrameSizeBytes = 0;
             ctsUnsignedLong StreamLengthFrames = 0;
             ctsUnsignedLong BufferedFrames = 0;
 
+            // sequence numbers start at 1 : the first frame of every GOP is an I-frame
+            bool IsKeyFrame(long long _sequence_number) const noexcept
+            {
+                return GopLengthFrames > 0 && _sequence_number > 0 && (_sequence_number - 1) % static_cast<unsigned long>(GopLengthFrames) == 0;
+            }
+
+            unsigned long FrameSize(long long _sequence_number) const noexcept
+            {
+                if (0 == GopLengthFrames)
+                {
+                    return FrameSizeBytes;
+                }
+                return IsKeyFrame(_sequence_number) ? IFrameSizeBytes : PFrameSizeBytes;
+            }
+
             ctsUnsignedLongLong CalculateTransferSize()
             {
+                if (GopLengthFrames > 0)
+                {
+                    return CalculateGopTransferSize();
+                }
+
                 FAIL_FAST_IF_MSG(
                     0LL == BitsPerSecond,
                     "BitsPerSecond cannot be set to zero");
@@ -300,6 +377,58 @@ namespace ctsTraffic
 
                 return total_stream_length_bytes;
             }
+
+        private:
+            ctsUnsignedLongLong CalculateGopTransferSize()
+            {
+                FAIL_FAST_IF_MSG(
+                    0 == FramesPerSecond,
+                    "FramesPerSecond cannot be set to zero");
+                FAIL_FAST_IF_MSG(
+                    0 == StreamLengthSeconds,
+                    "StreamLengthSeconds cannot be set to zero");
+
+                if (!IsListening())
+                {
+                    FAIL_FAST_IF_MSG(
+                        0 == BufferDepthSeconds,
+                        "BufferDepthSeconds cannot be set to zero");
+
+                    BufferedFrames = BufferDepthSeconds * FramesPerSecond;
+                    if (BufferedFrames < BufferDepthSeconds || BufferedFrames < FramesPerSecond)
+                    {
+                        throw std::invalid_argument("The total buffered frames exceed the maximum allowed : review -BufferDepth and -FrameRate");
+                    }
+                }
+
+                if (IFrameSizeBytes < 40 || PFrameSizeBytes < 40)
+                {
+                    throw std::invalid_argument("The I-frame and P-frame sizes are too small - each must be at least 40 bytes");
+                }
+
+                const ctsUnsignedLongLong total_stream_length_frames = StreamLengthSeconds * FramesPerSecond;
+                if (total_stream_length_frames > MAXULONG32)
+                {
+                    throw std::invalid_argument("The total stream length in frame-count exceeds the maximum allowed to be streamed (2^32)");
+                }
+
+                // every full GOP is one I-frame and (GopLengthFrames - 1) P-frames
+                // - a trailing partial GOP still starts with its I-frame
+                const ctsUnsignedLongLong gop_length = static_cast<unsigned long>(GopLengthFrames);
+                const ctsUnsignedLongLong full_gops = total_stream_length_frames / gop_length;
+                const ctsUnsignedLongLong remaining_frames = total_stream_length_frames % gop_length;
+                const ctsUnsignedLongLong i_frame_bytes = static_cast<unsigned long>(IFrameSizeBytes);
+                const ctsUnsignedLongLong p_frame_bytes = static_cast<unsigned long>(PFrameSizeBytes);
+                ctsUnsignedLongLong total_stream_length_bytes = full_gops * (i_frame_bytes + (gop_length - 1ULL) * p_frame_bytes);
+                if (remaining_frames > 0ULL)
+                {
+                    total_stream_length_bytes += i_frame_bytes + (remaining_frames - 1ULL) * p_frame_bytes;
+                }
+
+                FrameSizeBytes = IFrameSizeBytes > PFrameSizeBytes ? IFrameSizeBytes : PFrameSizeBytes;
+                StreamLengthFrames = static_cast<unsigned long>(total_stream_length_frames);
+                return total_stream_length_bytes;
+            }
         };
         const MediaStreamSettings& GetMediaStream() noexcept;
 
@@ -346,10 +475,13 @@ namespace ctsTraffic
 
             // stats for status updates and summaries
             ctsConnectionStatistics ConnectionStatusDetails;
-            ctsTcpStatistics TcpStatusDetails;
-            ctsUdpStatistics UdpStatusDetails;
+            ctsGlobalTcpStatistics TcpStatusDetails;
+            ctsGlobalUdpStatistics UdpStatusDetails;
 
             unsigned long StatusUpdateFrequencyMilliseconds = 0;
+            // optional per-connection time series (0 samples == not tracked)
+            unsigned long TimeSeriesIntervalMilliseconds = 0;
+            unsigned long TimeSeriesSampleCount = 0;
 
             long long TcpBytesPerSecondPeriod = 100LL;
             long long StartTimeMilliseconds = 0;
@@ -363,6 +495,8 @@ namespace ctsTraffic
 
             unsigned long PushBytes = 0;
             unsigned long PullBytes = 0;
+            // -Pattern:UdpBlast : the datagrams each connection sends per second (0 == as fast as the sends complete)
+            unsigned long PacketsPerSecond = 0;
 
             unsigned long OutgoingIfIndex = 0;
 
@@ -371,6 +505,14 @@ namespace ctsTraffic
 
             bool UseSharedBuffer = false;
             bool ShouldVerifyBuffers = false;
+            // only one thread at a time ever calls into a connection's ctsIOPattern
+            bool SingleOwnerIoPattern = false;
+            // the IoFunction passes every ctsIOTask buffer segment in a single WSASend/WSARecv
+            bool VectoredIo = false;
+            // -Memory:hugepages was requested and SeLockMemoryPrivilege is enabled
+            bool LargePages = false;
+            // -Memory:compact : connections keep only the state they are using in line
+            bool CompactConnections = false;
         };
 
         ////////////////////////////////////////////////////////////////////////////////////////////////////
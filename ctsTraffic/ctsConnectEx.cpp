@@ -74,6 +74,12 @@ namespace ctsTraffic
 
         if (NO_ERROR == gle)
         {
+            if (ctsConfig::Settings->Options & ctsConfig::OptionType::FAST_OPEN)
+            {
+                // the connection id was sent with the SYN - ConnectEx only succeeds once the send buffer was sent
+                ctsConfig::Settings->TcpStatusDetails.bytes_sent.add(ctsStatistics::ConnectionIdLength);
+            }
+
             // store the local addr of the connection
             int local_addr_len = local_addr.length();
             if (0 == getsockname(socket, local_addr.sockaddr(), &local_addr_len))
@@ -117,7 +123,18 @@ namespace ctsTraffic
                 OVERLAPPED* pov = connect_iocp->new_request(
                     [_weak_socket, targetAddress](OVERLAPPED* _ov) noexcept { ctsConnectExIoCompletionCallback(_ov, _weak_socket, targetAddress); });
 
-                if (!ctl::ctConnectEx(socket, targetAddress.sockaddr(), targetAddress.length(), nullptr, 0, nullptr, pov))
+                // with -Options:FastOpen the connection id is carried in the SYN
+                // - the buffer is owned by the ctsSocket, so it remains valid until the connect completes
+                PVOID send_buffer = nullptr;
+                DWORD send_buffer_length = 0;
+                DWORD bytes_sent = 0;
+                if (ctsConfig::Settings->Options & ctsConfig::OptionType::FAST_OPEN)
+                {
+                    send_buffer = const_cast<char*>(shared_socket->fast_open_connection_id());
+                    send_buffer_length = ctsStatistics::ConnectionIdLength;
+                }
+
+                if (!ctl::ctConnectEx(socket, targetAddress.sockaddr(), targetAddress.length(), send_buffer, send_buffer_length, &bytes_sent, pov))
                 {
                     error = WSAGetLastError();
                     if (ERROR_IO_PENDING == error)
@@ -24,6 +24,8 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // project headers
 #include "ctsMediaStreamProtocol.hpp"
 #include "ctsIOBuffers.hpp"
+#include "ctsBufferPlacement.hpp"
+#include "ctsPatternSegments.hpp"
 
 
 namespace ctsTraffic
@@ -31,7 +33,7 @@ namespace ctsTraffic
     using namespace ctl;
     using namespace std;
 
-    constexpr unsigned long c_BufferPatternSize = 0xffff + 0x1; // fill from 0x0000 to 0xffff
+    constexpr unsigned long c_BufferPatternSize = ctsPatternSegments::BufferPatternSize;
     static unsigned char s_BufferPattern[c_BufferPatternSize * 2]; // * 2 as unsigned short values are twice as large as unsigned char
 
     /// SharedBuffer is a larger buffer with many copies of BufferPattern in it. This is what the various IO patterns
@@ -39,11 +41,20 @@ namespace ctsTraffic
     ///
     /// The buffers' sizes will be the constant "BufferPatternSize + ctsConfig::GetMaxBufferSize()", but we
     /// need to wait for input parsing before we can set that.
+    ///
+    /// When the IO function can post several WSABUFs in one call, sends which run past the end of the pattern
+    /// are split into segments which wrap back to the start of the pattern, so the protected buffer only needs
+    /// to hold one copy of BufferPattern.
+    ///
+    /// Larger buffers are mirrored: every BufferPatternSize block but the last is a view of the same single copy
+    /// of the pattern, so a 1GB buffer costs two blocks of physical memory and only two blocks to fill.
 
     static INIT_ONCE s_IoPatternInitializer = INIT_ONCE_STATIC_INIT;
     static char* s_WriteableSharedBuffer = nullptr;
     static char* s_ProtectedSharedBuffer = nullptr;
     static unsigned long s_SharedBufferSize = 0;
+    static unsigned long s_ProtectedSharedBufferSize = 0;
+    static bool s_SegmentedSends = false;
     static RIO_BUFFERID s_SharedBufferId = RIO_INVALID_BUFFERID;  // NOLINT(cppcoreguidelines-pro-type-cstyle-cast)
 
     const char* s_CompletionMessage = "DONE";
@@ -51,49 +62,158 @@ namespace ctsTraffic
     constexpr unsigned long c_FinBufferSize = 4; // just 4 bytes for the FIN
     static char s_FinBuffer[c_FinBufferSize];
 
-    BOOL CALLBACK InitOnceIoPatternCallback(PINIT_ONCE, PVOID, PVOID*) noexcept
-    {
-        // first create the buffer pattern
-        for (unsigned long fill_slot = 0; fill_slot < c_BufferPatternSize; ++fill_slot)
-        {
-            *reinterpret_cast<unsigned short*>(&s_BufferPattern[fill_slot * 2]) = static_cast<unsigned short>(fill_slot);
-        }
-
-        s_SharedBufferSize = c_BufferPatternSize + ctsConfig::GetMaxBufferSize() + c_CompletionMessageSize;
-
-        s_ProtectedSharedBuffer = static_cast<char*>(VirtualAlloc(nullptr, s_SharedBufferSize, MEM_COMMIT, PAGE_READWRITE));
-        FAIL_FAST_IF_MSG(!s_ProtectedSharedBuffer, "VirtualAlloc alloc failed: %u", GetLastError());
+    // placeholder APIs are only available starting with Windows 10 1803 - resolved at runtime
+    using VirtualAlloc2Function = PVOID(WINAPI*)(HANDLE, PVOID, SIZE_T, ULONG, ULONG, PVOID, ULONG);
+    using MapViewOfFile3Function = PVOID(WINAPI*)(HANDLE, HANDLE, PVOID, ULONG64, SIZE_T, ULONG, ULONG, PVOID, ULONG);
 
-        s_WriteableSharedBuffer = static_cast<char*>(VirtualAlloc(nullptr, s_SharedBufferSize, MEM_COMMIT, PAGE_READWRITE));
-        FAIL_FAST_IF_MSG(!s_WriteableSharedBuffer, "VirtualAlloc alloc failed: %u", GetLastError());
-
-        // fill in this allocated buffer while we can write to it
-        char* protected_destination = s_ProtectedSharedBuffer;
-        char* writeable_destination = s_WriteableSharedBuffer;
-        unsigned long write_size_remaining = s_SharedBufferSize;
+    static void FillBufferPattern(_Out_writes_bytes_(_size) char* _buffer, unsigned long _size) noexcept
+    {
+        char* destination = _buffer;
+        unsigned long write_size_remaining = _size;
         while (write_size_remaining > 0)
         {
             const unsigned long bytes_to_write = (write_size_remaining > c_BufferPatternSize) ? c_BufferPatternSize : write_size_remaining;
 
-            auto memerror = memcpy_s(protected_destination, write_size_remaining, s_BufferPattern, bytes_to_write);
+            const auto memerror = memcpy_s(destination, write_size_remaining, s_BufferPattern, bytes_to_write);
             FAIL_FAST_IF_MSG(
                 memerror != 0,
                 "memcpy_s(%p, %lu, %p, %lu) failed : %d",
-                protected_destination, write_size_remaining, s_BufferPattern, bytes_to_write, memerror);
+                destination, write_size_remaining, s_BufferPattern, bytes_to_write, memerror);
+
+            destination += bytes_to_write;
+            write_size_remaining -= bytes_to_write;
+        }
+    }
+
+    ///
+    /// Reserves _size bytes (a multiple of BufferPatternSize) as back-to-back views of one section holding the pattern
+    /// - the final BufferPatternSize block is private memory, so the completion message can be written at the end
+    /// - returns nullptr if placeholders are not supported by the OS
+    ///
+    static char* MapMirroredPatternBuffer(unsigned long _size, ULONG _view_protection) noexcept
+    {
+        const HMODULE kernelbase = GetModuleHandleW(L"kernelbase.dll");
+        if (!kernelbase)
+        {
+            return nullptr;
+        }
+        const auto virtual_alloc2 = reinterpret_cast<VirtualAlloc2Function>(GetProcAddress(kernelbase, "VirtualAlloc2"));
+        const auto map_view_of_file3 = reinterpret_cast<MapViewOfFile3Function>(GetProcAddress(kernelbase, "MapViewOfFile3"));
+        if (!virtual_alloc2 || !map_view_of_file3)
+        {
+            return nullptr;
+        }
+
+        // each buffer has its own section: data received into the writeable buffer must not show up in the protected buffer
+        // - the views hold a reference on the section, so the handle can be closed once they are mapped
+        const wil::unique_handle pattern_section(CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, c_BufferPatternSize, nullptr));
+        FAIL_FAST_IF_MSG(!pattern_section, "CreateFileMapping failed: %u", GetLastError());
+        {
+            const wil::unique_mapview_ptr<char> fill_view(static_cast<char*>(MapViewOfFile(pattern_section.get(), FILE_MAP_WRITE, 0, 0, c_BufferPatternSize)));
+            FAIL_FAST_IF_MSG(!fill_view, "MapViewOfFile failed: %u", GetLastError());
+            FillBufferPattern(fill_view.get(), c_BufferPatternSize);
+        }
+
+        const auto buffer = static_cast<char*>(virtual_alloc2(nullptr, nullptr, _size, MEM_RESERVE | MEM_RESERVE_PLACEHOLDER, PAGE_NOACCESS, nullptr, 0));
+        FAIL_FAST_IF_MSG(!buffer, "VirtualAlloc2 placeholder reservation failed: %u", GetLastError());
 
-            memerror = memcpy_s(writeable_destination, write_size_remaining, s_BufferPattern, bytes_to_write);
+        const unsigned long mirrored_size = _size - c_BufferPatternSize;
+        for (unsigned long offset = 0; offset < mirrored_size; offset += c_BufferPatternSize)
+        {
+            // split the next block off the front of the remaining placeholder and map the pattern into it
             FAIL_FAST_IF_MSG(
-                memerror != 0,
-                "memcpy_s(%p, %lu, %p, %lu) failed : %d",
-                writeable_destination, write_size_remaining, s_BufferPattern, bytes_to_write, memerror);
+                !VirtualFree(buffer + offset, c_BufferPatternSize, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER),
+                "VirtualFree splitting the placeholder failed: %u", GetLastError());
+            FAIL_FAST_IF_MSG(
+                !map_view_of_file3(pattern_section.get(), nullptr, buffer + offset, 0, c_BufferPatternSize, MEM_REPLACE_PLACEHOLDER, _view_protection, nullptr, 0),
+                "MapViewOfFile3 failed: %u", GetLastError());
+        }
 
-            protected_destination += bytes_to_write;
-            writeable_destination += bytes_to_write;
-            write_size_remaining -= bytes_to_write;
+        FAIL_FAST_IF_MSG(
+            !virtual_alloc2(nullptr, buffer + mirrored_size, c_BufferPatternSize, MEM_RESERVE | MEM_COMMIT | MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE, nullptr, 0),
+            "VirtualAlloc2 failed: %u", GetLastError());
+        FillBufferPattern(buffer + mirrored_size, c_BufferPatternSize);
+        return buffer;
+    }
+
+    ///
+    /// Returns a read/write buffer of _size bytes filled with BufferPattern
+    /// - _mirrored_size is the length of the leading mirrored views, zero if the whole buffer is private memory
+    /// - _large_pages_used is set if -Memory:hugepages backed the buffer with large pages instead of mirroring it
+    ///
+    static char* AllocatePatternBuffer(
+        unsigned long _size,
+        ULONG _view_protection,
+        bool _can_mirror,
+        _Out_ unsigned long& _mirrored_size,
+        _Out_ bool& _large_pages_used) noexcept
+    {
+        _mirrored_size = 0;
+        _large_pages_used = false;
+        if (ctsConfig::Settings->LargePages)
+        {
+            // the shared buffers are read by every connection, so are not placed on any one NUMA node
+            // - falls through to mirroring or a private buffer if large pages are not available
+            auto large_page_buffer = ctsBufferPlacement::AllocateLargePages(_size, NUMA_NO_PREFERRED_NODE);
+            if (large_page_buffer)
+            {
+                _large_pages_used = true;
+                FillBufferPattern(large_page_buffer.get(), _size);
+                return large_page_buffer.release();
+            }
+        }
+
+        if (_can_mirror && _size > 2 * c_BufferPatternSize && 0 == _size % c_BufferPatternSize)
+        {
+            const auto mirrored_buffer = MapMirroredPatternBuffer(_size, _view_protection);
+            if (mirrored_buffer)
+            {
+                _mirrored_size = _size - c_BufferPatternSize;
+                return mirrored_buffer;
+            }
+        }
+
+        const auto buffer = static_cast<char*>(VirtualAlloc(nullptr, _size, MEM_COMMIT, PAGE_READWRITE));
+        FAIL_FAST_IF_MSG(!buffer, "VirtualAlloc alloc failed: %u", GetLastError());
+        FillBufferPattern(buffer, _size);
+        return buffer;
+    }
+
+    BOOL CALLBACK InitOnceIoPatternCallback(PINIT_ONCE, PVOID, PVOID*) noexcept
+    {
+        // first create the buffer pattern
+        for (unsigned long fill_slot = 0; fill_slot < c_BufferPatternSize; ++fill_slot)
+        {
+            *reinterpret_cast<unsigned short*>(&s_BufferPattern[fill_slot * 2]) = static_cast<unsigned short>(fill_slot);
+        }
+
+        s_SharedBufferSize = c_BufferPatternSize + ctsConfig::GetMaxBufferSize() + c_CompletionMessageSize;
+        if (s_SharedBufferSize > 2 * c_BufferPatternSize)
+        {
+            // round up to whole copies of the pattern so every mirrored view is aligned to the allocation granularity
+            s_SharedBufferSize = (s_SharedBufferSize + c_BufferPatternSize - 1) / c_BufferPatternSize * c_BufferPatternSize;
         }
+        s_SegmentedSends =
+            ctsConfig::Settings->VectoredIo &&
+            ctsPatternSegments::CanSegmentSends(ctsConfig::GetMaxBufferSize());
+        s_ProtectedSharedBufferSize = s_SegmentedSends ? c_BufferPatternSize + c_CompletionMessageSize : s_SharedBufferSize;
+
+        unsigned long protected_mirrored_size;
+        bool protected_large_pages;
+        s_ProtectedSharedBuffer = AllocatePatternBuffer(s_ProtectedSharedBufferSize, PAGE_READONLY, true, protected_mirrored_size, protected_large_pages);
+        // not mirroring the buffer registered with RIO: RIORegisterBuffer locks a single private allocation
+        unsigned long writeable_mirrored_size;
+        bool writeable_large_pages;
+        s_WriteableSharedBuffer = AllocatePatternBuffer(
+            s_SharedBufferSize,
+            PAGE_READWRITE,
+            !(ctsConfig::Settings->SocketFlags & WSA_FLAG_REGISTERED_IO),
+            writeable_mirrored_size,
+            writeable_large_pages);
+
         // set the final 4 bytes to the DONE message for the send buffer
         memcpy_s(
-            s_ProtectedSharedBuffer + s_SharedBufferSize - c_CompletionMessageSize,
+            s_ProtectedSharedBuffer + s_ProtectedSharedBufferSize - c_CompletionMessageSize,
             c_CompletionMessageSize,
             s_CompletionMessage,
             c_CompletionMessageSize);
@@ -104,8 +224,15 @@ namespace ctsTraffic
             c_CompletionMessageSize);
 
         // guarantee noone will write to our s_ProtectedSharedBuffer
-        DWORD old_setting;
-        FAIL_FAST_IF_MSG(!VirtualProtect(s_ProtectedSharedBuffer, s_SharedBufferSize, PAGE_READONLY, &old_setting), "VirtualProtect failed: %u", GetLastError());
+        // - mirrored views were already mapped read-only
+        // - large pages are always read/write
+        if (!protected_large_pages)
+        {
+            DWORD old_setting;
+            FAIL_FAST_IF_MSG(
+                !VirtualProtect(s_ProtectedSharedBuffer + protected_mirrored_size, s_ProtectedSharedBufferSize - protected_mirrored_size, PAGE_READONLY, &old_setting),
+                "VirtualProtect failed: %u", GetLastError());
+        }
 
         // establish a RIO ID for the writable shared buffer if we're using RIO APIs
         if (ctsConfig::Settings->SocketFlags & WSA_FLAG_REGISTERED_IO)
@@ -148,10 +275,46 @@ namespace ctsTraffic
                     return make_shared<ctsIOPatternMediaStreamClient>();
                 }
 
+            case ctsConfig::IoPatternType::UdpBlast:
+                if (ctsConfig::IsListening())
+                {
+                    return make_shared<ctsIOPatternUdpBlastReceiver>();
+                }
+                else
+                {
+                    return make_shared<ctsIOPatternUdpBlastSender>();
+                }
+
             default:
                 FAIL_FAST_MSG("ctsIOPattern::MakeIOPattern - Unknown IoPattern specified (%d)", ctsConfig::Settings->IoPattern);
         }
     }
+    size_t ctsIOPattern::PatternObjectSize() noexcept
+    {
+        switch (ctsConfig::Settings->IoPattern)
+        {
+            case ctsConfig::IoPatternType::Pull:
+                return sizeof(ctsIOPatternPull);
+
+            case ctsConfig::IoPatternType::Push:
+                return sizeof(ctsIOPatternPush);
+
+            case ctsConfig::IoPatternType::PushPull:
+                return sizeof(ctsIOPatternPushPull);
+
+            case ctsConfig::IoPatternType::Duplex:
+                return sizeof(ctsIOPatternDuplex);
+
+            case ctsConfig::IoPatternType::MediaStream:
+                return ctsConfig::IsListening() ? sizeof(ctsIOPatternMediaStreamServer) : sizeof(ctsIOPatternMediaStreamClient);
+
+            case ctsConfig::IoPatternType::UdpBlast:
+                return ctsConfig::IsListening() ? sizeof(ctsIOPatternUdpBlastReceiver) : sizeof(ctsIOPatternUdpBlastSender);
+
+            default:
+                return 0;
+        }
+    }
     char* ctsIOPattern::AccessSharedBuffer() noexcept
     {
         // this init-once call is no-fail
@@ -160,6 +323,7 @@ namespace ctsTraffic
     }
 
     ctsIOPattern::ctsIOPattern(unsigned long recv_count) :
+        m_singleOwner(ctsConfig::Settings->SingleOwnerIoPattern),
         // (bytes/sec) * (1 sec/1000 ms) * (x ms/Quantum) == (bytes/quantum)
         m_bytesSendingPerQuantum(ctsConfig::GetTcpBytesPerSecond()* static_cast<unsigned long long>(ctsConfig::Settings->TcpBytesPerSecondPeriod) / 1000LL),
         m_quantumStartTimeMs(ctTimer::ctSnapQpcInMillis())
@@ -197,8 +361,26 @@ namespace ctsTraffic
             {
                 if (recv_count > 0)
                 {
-                    m_recvBufferContainer.resize(ctsConfig::GetMaxBufferSize() * recv_count);
-                    char* raw_recv_buffer = &m_recvBufferContainer[0];
+                    const size_t recv_buffer_size = static_cast<size_t>(ctsConfig::GetMaxBufferSize()) * recv_count;
+                    char* raw_recv_buffer = nullptr;
+                    if (ctsBufferPlacement::UsePlacement(recv_buffer_size, ctsConfig::Settings->LargePages))
+                    {
+                        // this runs on the thread initiating IO for the connection: keep its receive buffers local to it
+                        m_recvBufferPlacedContainer = ctsBufferPlacement::Allocate(
+                            recv_buffer_size,
+                            ctsConfig::Settings->LargePages,
+                            ctsBufferPlacement::CurrentNumaNode());
+                        if (!m_recvBufferPlacedContainer)
+                        {
+                            throw ctException(GetLastError(), L"VirtualAllocExNuma", L"ctsIOPattern", false);
+                        }
+                        raw_recv_buffer = m_recvBufferPlacedContainer.get();
+                    }
+                    else
+                    {
+                        m_recvBufferContainer.resize(recv_buffer_size);
+                        raw_recv_buffer = &m_recvBufferContainer[0];
+                    }
                     for (unsigned long free_list = 0; free_list < recv_count; ++free_list)
                     {
                         m_recvBufferFreeList.push_back(raw_recv_buffer + static_cast<size_t>(free_list * ctsConfig::GetMaxBufferSize()));
@@ -223,6 +405,13 @@ namespace ctsTraffic
                 }
             }
         }
+
+        if (m_timeSeriesEnabled)
+        {
+            m_timeSeries = std::make_unique<ctsConnectionTimeSeries>(
+                ctsConfig::Settings->TimeSeriesIntervalMilliseconds,
+                ctsConfig::Settings->TimeSeriesSampleCount);
+        }
     }
 
 
@@ -239,7 +428,7 @@ namespace ctsTraffic
         // make sure stats starts tracking IO at the first IO request
         this->start_stats();
 
-        const auto local_cs = m_cs.lock();
+        const auto local_cs = lock_pattern();
         ctsIOTask return_task;
         switch (m_patternState.get_next_task())
         {
@@ -271,7 +460,7 @@ namespace ctsTraffic
                 return_task.buffer = s_ProtectedSharedBuffer;
                 return_task.rio_bufferid = s_SharedBufferId;
                 return_task.buffer_length = c_CompletionMessageSize;
-                return_task.buffer_offset = s_SharedBufferSize - c_CompletionMessageSize;
+                return_task.buffer_offset = s_ProtectedSharedBufferSize - c_CompletionMessageSize;
                 return_task.track_io = false;
                 return_task.buffer_type = ctsIOTask::BufferType::Static;
                 break;
@@ -369,7 +558,7 @@ namespace ctsTraffic
     ctsIOStatus ctsIOPattern::complete_io(const ctsIOTask& original_task, unsigned long current_transfer, unsigned long status_code) noexcept
     try
     {
-        const auto lock = m_cs.lock();
+        const auto lock = lock_pattern();
 
         // Only add the recv buffer back if it was one of our listed recv buffers
         if (ctsIOTask::BufferType::Tracked == original_task.buffer_type)
@@ -522,6 +711,13 @@ namespace ctsTraffic
             {
                 ctsConfig::Settings->TcpStatusDetails.bytes_recv.add(current_transfer);
             }
+            if (m_timeSeries && current_transfer > 0)
+            {
+                if (m_timeSeries->add_bytes(ctTimer::ctSnapQpcInMillis(), current_transfer))
+                {
+                    m_timeSeriesRttNeeded = true;
+                }
+            }
             // only complete tasks that were requested
             if (task_was_more_io)
             {
@@ -544,9 +740,39 @@ namespace ctsTraffic
     }
     CATCH_FAIL_FAST()
 
+    bool ctsIOPattern::time_series_rtt_needed() const noexcept
+    {
+        // called on every IO completion: only take the lock when a time series is being kept
+        if (!m_timeSeriesEnabled)
+        {
+            return false;
+        }
+        const auto lock = lock_pattern();
+        return m_timeSeriesRttNeeded;
+    }
+
+    void ctsIOPattern::set_time_series_rtt(unsigned long rtt_microseconds) noexcept
+    {
+        const auto lock = lock_pattern();
+        if (m_timeSeries)
+        {
+            m_timeSeries->set_rtt(rtt_microseconds);
+            m_timeSeriesRttNeeded = false;
+        }
+    }
+
+    void ctsIOPattern::print_time_series() noexcept
+    {
+        const auto lock = lock_pattern();
+        if (m_timeSeries)
+        {
+            ctsConfig::PrintTimeSeries(this->connection_id(), *m_timeSeries);
+        }
+    }
+
     ctsIOTask ctsIOPattern::tracked_task(IOTaskAction _action, unsigned long max_transfer) noexcept
     {
-        const auto lock = m_cs.lock();
+        const auto lock = lock_pattern();
         ctsIOTask return_task(this->new_task(_action, max_transfer));
         return_task.track_io = true;
         return return_task;
@@ -554,7 +780,7 @@ namespace ctsTraffic
 
     ctsIOTask ctsIOPattern::untracked_task(IOTaskAction _action, unsigned long max_transfer) noexcept
     {
-        const auto lock = m_cs.lock();
+        const auto lock = lock_pattern();
         ctsIOTask return_task(this->new_task(_action, max_transfer));
         return_task.track_io = false;
         return return_task;
@@ -674,6 +900,17 @@ namespace ctsTraffic
             return_task.expected_pattern_offset = 0; // The sender shouldn't be validating this
             return_task.buffer_type = ctsIOTask::BufferType::Static;
 
+            if (s_SegmentedSends)
+            {
+                // wrap back to the start of the pattern instead of reading past the single copy of it
+                ctsPatternSegments::SegmentSend(
+                    return_task,
+                    s_ProtectedSharedBuffer,
+                    c_BufferPatternSize,
+                    static_cast<unsigned long>(m_sendPatternOffset),
+                    static_cast<unsigned long>(new_buffer_size));
+            }
+
             // now that we are indicating this buffer to send, increment the offset for the next send request
             m_sendPatternOffset += new_buffer_size;
             m_sendPatternOffset %= c_BufferPatternSize;
@@ -683,9 +920,9 @@ namespace ctsTraffic
                 "this->pattern_offset being too large (larger than BufferPatternSize %lu) means we might walk off the end of our shared buffer (dt ctsTraffic!ctsTraffic::ctsIOPattern %p)",
                 c_BufferPatternSize, this);
             FAIL_FAST_IF_MSG(
-                return_task.buffer_length + return_task.buffer_offset > s_SharedBufferSize,
+                0 == return_task.buffer_segment_count && return_task.buffer_length + return_task.buffer_offset > s_ProtectedSharedBufferSize,
                 "return_task (%p) for a Send request is specifying a buffer that is larger than the static SharedBufferSize (%lu) (dt ctsTraffic!ctsTraffic::ctsIOPattern %p)",
-                &return_task, s_SharedBufferSize, this);
+                &return_task, s_ProtectedSharedBufferSize, this);
 
         }
         else
@@ -724,16 +961,9 @@ namespace ctsTraffic
         {
             return true;
         }
-        //
-        // We're using RtlCompareMemory instead of memcmp because it returns the first offset at which the buffers differ,
-        // which is more useful than memcmp's "sign of the difference between the first two differing elements"
-        //
-        const auto pattern_buffer = s_ProtectedSharedBuffer + original_task.expected_pattern_offset;
-        const size_t length_matched = RtlCompareMemory(
-            pattern_buffer,
-            original_task.buffer + original_task.buffer_offset,
-            transferred_bytes);
-        if (length_matched != transferred_bytes)
+        // the protected buffer only holds a single copy of the pattern when sends are segmented
+        ctsPatternSegments::Mismatch mismatch;
+        if (!ctsPatternSegments::Compare(original_task, transferred_bytes, s_ProtectedSharedBuffer, c_BufferPatternSize, mismatch))
         {
             try
             {
@@ -742,18 +972,19 @@ namespace ctsTraffic
                         "ctsIOPattern found data corruption: detected an invalid byte pattern in the returned buffer (length %u): "
                         "buffer received (%p), expected buffer pattern (%p) - mismatch from expected pattern at offset (%Iu) [expected 32-bit value '0x%x' didn't match '0x%x']",
                         transferred_bytes,
-                        original_task.buffer + original_task.buffer_offset,
-                        pattern_buffer,
-                        length_matched,
-                        pattern_buffer[length_matched],
-                        *(original_task.buffer + original_task.buffer_offset + length_matched)).c_str());
+                        mismatch.received,
+                        mismatch.expected,
+                        mismatch.matched_length,
+                        mismatch.expected[mismatch.matched_length],
+                        mismatch.received[mismatch.matched_length]).c_str());
             }
             catch (...)
             {
             }
+            return false;
         }
 
-        return (length_matched == transferred_bytes);
+        return true;
     }
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1131,7 +1362,7 @@ namespace ctsTraffic
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ctsIOPatternMediaStreamServer::ctsIOPatternMediaStreamServer() :
         ctsIOPatternStatistics(1), // the pattern will use the recv writeable-buffer for sending a connection ID
-        m_frameSizeBytes(ctsConfig::GetMediaStream().FrameSizeBytes),
+        m_frameSizeBytes(ctsConfig::GetMediaStream().FrameSize(1)),
         m_currentFrameRequested(0UL),
         m_currentFrameCompleted(0UL),
         m_frameRateFps(ctsConfig::GetMediaStream().FramesPerSecond),
@@ -1189,6 +1420,8 @@ namespace ctsTraffic
             if (m_currentFrameCompleted == m_frameSizeBytes)
             {
                 ++m_currentFrame;
+                // frames can vary in size with -FrameModel:gop
+                m_frameSizeBytes = ctsConfig::GetMediaStream().FrameSize(static_cast<unsigned long>(m_currentFrame));
                 m_currentFrameRequested = 0UL;
                 m_currentFrameCompleted = 0UL;
             }
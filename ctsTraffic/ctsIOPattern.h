@@ -16,14 +16,21 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // cpp headers
 #include <memory>
 #include <algorithm>
+#include <vector>
 // os headers
 #include <windows.h>
+// wil headers
+#include <wil/resource.h>
 // project headers
 #include "ctsConfig.h"
 #include "ctsIOTask.hpp"
 #include "ctsSafeInt.hpp"
 #include "ctsIOPatternState.hpp"
+#include "ctsMediaStreamFec.hpp"
+#include "ctsMediaStreamFrameRing.hpp"
+#include "ctsMediaStreamPlayout.hpp"
 #include "ctsStatistics.hpp"
+#include "ctsUdpBlastProtocol.hpp"
 #include <mswsock.h>
 
 namespace ctsTraffic
@@ -79,6 +86,10 @@ namespace ctsTraffic
         ///
         static std::shared_ptr<ctsIOPattern> MakeIOPattern();
         ///
+        /// The size of the object MakeIOPattern builds, excluding the buffers it allocates
+        ///
+        static size_t PatternObjectSize() noexcept;
+        ///
         /// Making available the shared buffer used for sends and recvs
         ///
         static char* AccessSharedBuffer() noexcept;
@@ -92,33 +103,49 @@ namespace ctsTraffic
         ///
         virtual void print_stats(const ctl::ctSockaddr& local_addr, const ctl::ctSockaddr& remote_addr) noexcept = 0;
 
+        ///
+        /// -Recovery:fec : the media stream server encodes parity outside of the pattern,
+        /// and adds the parity datagrams sent and QPC ticks spent encoding them once the stream completes
+        ///
+        virtual void add_fec_results(long long, long long) noexcept
+        {
+        }
+
         ///
         /// Some derived IO types require callbacks to the IO functions
         /// - to request tasks from the normal initiate_io / complete_io pattern
         ///
         virtual void register_callback(std::function<void(const ctsIOTask&)> callback) noexcept
         {
-            const auto lock = m_cs.lock();
+            const auto lock = lock_pattern();
             m_callback = std::move(callback);
         }
 
         virtual unsigned long get_last_error() const noexcept
         {
-            const auto lock = m_cs.lock();
+            const auto lock = lock_pattern();
             return m_lastError;
         }
 
         ctsUnsignedLong get_ideal_send_backlog() const noexcept
         {
-            const auto lock = m_cs.lock();
+            const auto lock = lock_pattern();
             return m_patternState.get_ideal_send_backlog();
         }
         void set_ideal_send_backlog(const ctsUnsignedLong& new_isb) noexcept
         {
-            const auto lock = m_cs.lock();
+            const auto lock = lock_pattern();
             m_patternState.set_ideal_send_backlog(new_isb);
         }
 
+        ///
+        /// Optional per-connection time series (-TimeSeriesFilename)
+        /// - time_series_rtt_needed returns true once per interval, after IO opened a new interval
+        /// - IO functions with access to the socket can then provide an RTT sample for that interval
+        ///
+        bool time_series_rtt_needed() const noexcept;
+        void set_time_series_rtt(unsigned long rtt_microseconds) noexcept;
+
         ///
         /// none of these *_io functions can throw
         /// failures are critical and will RaiseException to be debugged
@@ -195,14 +222,89 @@ namespace ctsTraffic
         // - it's mutable to allow us to take the CS in const methods
         mutable wil::critical_section m_cs;
 
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Held for the duration of each call into the pattern
+        /// - holds m_cs, unless the pattern has a single owner (ctsConfig::Settings->SingleOwnerIoPattern)
+        ///   in which case debug builds instead verify no other thread is inside the pattern
+        ///
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+        class PatternLock
+        {
+        public:
+            explicit PatternLock(wil::cs_leave_scope_exit&& _cs_lock) noexcept :
+                cs_lock(std::move(_cs_lock))
+            {
+            }
+#ifdef _DEBUG
+            explicit PatternLock(long* _owner_thread_id) noexcept
+            {
+                // nested calls from the owning thread (e.g. complete_io -> update_last_error) are expected
+                const auto thread_id = static_cast<long>(::GetCurrentThreadId());
+                const auto prior_owner = ::InterlockedCompareExchange(_owner_thread_id, thread_id, 0);
+                FAIL_FAST_IF_MSG(
+                    prior_owner != 0 && prior_owner != thread_id,
+                    "ctsIOPattern: thread %ld entered a single-owner pattern while thread %ld was inside it", thread_id, prior_owner);
+                if (0 == prior_owner)
+                {
+                    owner_thread_id = _owner_thread_id;
+                }
+            }
+#else
+            PatternLock() noexcept = default;
+#endif
+            ~PatternLock() noexcept
+            {
+#ifdef _DEBUG
+                if (owner_thread_id)
+                {
+                    ::InterlockedExchange(owner_thread_id, 0);
+                }
+#endif
+            }
+
+            PatternLock(const PatternLock&) = delete;
+            PatternLock& operator=(const PatternLock&) = delete;
+            PatternLock(PatternLock&&) = delete;
+            PatternLock& operator=(PatternLock&&) = delete;
+
+        private:
+            wil::cs_leave_scope_exit cs_lock;
+#ifdef _DEBUG
+            long* owner_thread_id = nullptr;
+#endif
+        };
+
+        PatternLock lock_pattern() const noexcept
+        {
+            if (!m_singleOwner)
+            {
+                return PatternLock(m_cs.lock());
+            }
+#ifdef _DEBUG
+            return PatternLock(&m_ownerThreadId);
+#else
+            return PatternLock();
+#endif
+        }
+
+        // set at construction: see ctsConfig::Settings->SingleOwnerIoPattern
+        const bool m_singleOwner;
+#ifdef _DEBUG
+        // the thread currently inside a single-owner pattern
+        mutable long m_ownerThreadId = 0;
+#endif
+
         // recv buffers to return to the caller
         // - tracking sending buffers separate from receiving buffers
         //   since sending buffers will have a test pattern written to it (thus send buffers can be static)
         // For supporting multiple recv calls, allocating a larger buffer to contain all recv requests
         // - as well as a vector to contain the multiple ptrs to each buffer
-        // When needing to dynamically allocate, containing a vector to hold the bytes
+        // When needing to dynamically allocate, placing the bytes on the NUMA node of the connection's processor
+        // - only with more than one NUMA node or large pages: otherwise the heap allocation is smaller and cheaper
         std::vector<char*> m_recvBufferFreeList;
         std::vector<char> m_recvBufferContainer;
+        wil::unique_virtualalloc_ptr<char> m_recvBufferPlacedContainer;
         // optional callback for protocols which need to communicate OOB to the IO function
         std::function<void(const ctsIOTask&)> m_callback;
 
@@ -223,6 +325,12 @@ namespace ctsTraffic
 
         unsigned long m_lastError = ctsStatusIORunning;
 
+        // only allocated when a time series was requested
+        // - m_timeSeriesEnabled is fixed at construction, so IO completions can check it without the lock
+        const bool m_timeSeriesEnabled = ctsConfig::Settings->TimeSeriesSampleCount > 0;
+        std::unique_ptr<ctsConnectionTimeSeries> m_timeSeries;
+        bool m_timeSeriesRttNeeded = false;
+
     protected:
         ///////////////////////////////////////////////////////////////////////////////////////////////////
         ///
@@ -241,6 +349,14 @@ namespace ctsTraffic
         virtual void end_stats() noexcept = 0;
         virtual char* connection_id() noexcept = 0;
 
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+        ///
+        /// Writes the time series for this connection if one was tracked
+        /// - expected to be called once the connection has completed, when printing the results
+        ///
+        ///////////////////////////////////////////////////////////////////////////////////////////////////
+        void print_time_series() noexcept;
+
         ///////////////////////////////////////////////////////////////////////////////////////////////////
         ///
         /// tracked_task(IOTaskAction, unsigned long _max_transfer)
@@ -305,7 +421,7 @@ namespace ctsTraffic
         ///////////////////////////////////////////////////////////////////////////////////////////////////
         unsigned long update_last_error(const DWORD error) noexcept
         {
-            const auto lock = m_cs.lock();
+            const auto lock = lock_pattern();
             if (ctsStatusIORunning == m_lastError)
             {
                 const auto status_error = m_patternState.update_error(error);
@@ -420,6 +536,8 @@ namespace ctsTraffic
                 remote_addr,
                 this->get_last_error(),
                 stats);
+
+            this->print_time_series();
         }
         ///
         /// ensures that the pattern has started
@@ -607,6 +725,12 @@ namespace ctsTraffic
         ctsIOTask next_task() noexcept override;
         ctsIOPatternProtocolError completed_task(const ctsIOTask& task, unsigned long current_transfer) noexcept override;
 
+        void add_fec_results(long long parity_datagrams, long long encode_ticks) noexcept override
+        {
+            this->stats.fec_datagrams.add(parity_datagrams);
+            this->stats.fec_cpu_ticks.add(encode_ticks);
+        }
+
     private:
         ctsUnsignedLong m_frameSizeBytes;
         ctsUnsignedLong m_currentFrameRequested;
@@ -658,21 +782,47 @@ namespace ctsTraffic
         const double m_frameRateMsPerFrame = 0LL;
         const unsigned long m_frameSizeBytes = ctsConfig::GetMediaStream().FrameSizeBytes;
         const unsigned long m_finalFrame = ctsConfig::GetMediaStream().StreamLengthFrames;
+        // identifies this connection's records in a binary jitter capture
+        const unsigned long m_jitterStreamId;
 
         unsigned long m_initialBufferFrames = ctsConfig::GetMediaStream().BufferedFrames;
         unsigned long m_timerWheelOffsetFrames = 0UL;
         unsigned long m_recvNeeded = ctsConfig::Settings->PrePostRecvs;
 
+        // -Recovery:nack
+        // - frames are requested again once they are this close to being rendered
+        // - NACKs are written to a small ring of buffers, as each must stay valid until its send completes
+        const unsigned long m_nackLookaheadFrames = ctsConfig::GetMediaStream().BufferedFrames / 2;
+        std::vector<char> m_nackBuffers;
+        unsigned long m_nextNackBuffer = 0UL;
+        long long m_highestSequenceNumber = 0LL;
+
+        // -Recovery:fec
+        // - rebuilds lost datagrams as the datagrams and parity of each frame arrive
+        std::unique_ptr<ctsMediaStreamFecDecoder> m_fecDecoder;
+
+        // -Playout:adaptive
+        // - m_playout decides when each frame is rendered
+        // - m_droppedFrames is set for each slot of m_frames whose prior frame was rendered as dropped,
+        //   so datagrams arriving for that frame afterwards count it as late
+        const bool m_adaptivePlayout = ctsConfig::GetMediaStream().AdaptivePlayout;
+        ctsMediaStreamPlayout m_playout;
+        std::vector<unsigned char> m_droppedFrames;
+
+        // -Timestamps:kernel
+        // - each recv is posted with its own WSAMSG for the kernel receive timestamp to be returned in
+        // - m_freeRecvMessages are those without a recv in flight
+        const bool m_kernelTimestamps = ctsConfig::GetMediaStream().KernelTimestamps;
+        std::vector<ctsRecvMessage> m_recvMessages;
+        std::vector<ctsRecvMessage*> m_freeRecvMessages;
+
         // these must be protected by the base class cs
         // - the base lock is always taken before our virtual functions are called
         // - so this is most important to know in our timer callback
 
         // member variables that require the base lock
         _Requires_lock_held_(cs)
-            std::vector<ctsConfig::JitterFrameEntry> m_frameEntries;
-
-        _Requires_lock_held_(cs)
-            std::vector<ctsConfig::JitterFrameEntry>::iterator m_headEntry;
+            ctsMediaStreamFrameRing m_frames;
 
         // tracking for jitter information
         ctsConfig::JitterFrameEntry m_firstFrame;
@@ -682,7 +832,7 @@ namespace ctsTraffic
 
         // member functions - all require the base lock
         _Requires_lock_held_(cs)
-            std::vector<ctsConfig::JitterFrameEntry>::iterator find_sequence_number(long long seq_number) noexcept;
+            size_t find_sequence_number(long long seq_number) const noexcept;
 
         _Requires_lock_held_(cs)
             bool received_buffered_frames() noexcept;
@@ -696,6 +846,18 @@ namespace ctsTraffic
         _Requires_lock_held_(cs)
             void render_frame() noexcept;
 
+        _Requires_lock_held_(cs)
+            void request_missing_frames() noexcept;
+
+        _Requires_lock_held_(cs)
+            void render_due_frames() noexcept;
+
+        _Requires_lock_held_(cs)
+            void update_playout_delay(const ctsConfig::JitterFrameEntry& frame) noexcept;
+
+        _Requires_lock_held_(cs)
+            void track_late_frame(long long sequence_number) noexcept;
+
         /// The "Renderer" processes frames at the specified frame rate
         static
             VOID CALLBACK TimerCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID context, PTP_TIMER) noexcept;
@@ -704,4 +866,89 @@ namespace ctsTraffic
             VOID CALLBACK StartCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID context, PTP_TIMER) noexcept;
     };
 
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///  - UDP Blast sender
+    ///    -- Sends -transfer bytes as datagrams of -buffer bytes to the receiver, with no handshake
+    ///    -- Each datagram starts with its stream id, sequence number and the datagram count of the stream
+    ///    -- Keeps -PrePostSends datagrams in flight, as fast as they complete or paced at -PacketsPerSecond
+    ///    -- Completes once every datagram's send has completed
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsIOPatternUdpBlastSender final : public ctsIOPatternStatistics<ctsUdpStatistics>
+    {
+    public:
+        ctsIOPatternUdpBlastSender();
+        ~ctsIOPatternUdpBlastSender() noexcept override = default;
+
+        ctsIOPatternUdpBlastSender(const ctsIOPatternUdpBlastSender&) = delete;
+        ctsIOPatternUdpBlastSender& operator=(const ctsIOPatternUdpBlastSender&) = delete;
+        ctsIOPatternUdpBlastSender(ctsIOPatternUdpBlastSender&&) = delete;
+        ctsIOPatternUdpBlastSender& operator=(ctsIOPatternUdpBlastSender&&) = delete;
+
+        // required virtual functions
+        ctsIOTask next_task() noexcept override;
+        ctsIOPatternProtocolError completed_task(const ctsIOTask& task, unsigned long completed_bytes) noexcept override;
+
+    private:
+        const unsigned long m_datagramSize;
+        const long long m_datagramCount;
+        const unsigned long m_packetsPerSecond = ctsConfig::Settings->PacketsPerSecond;
+        unsigned long long m_streamId = 0ULL;
+        long long m_nextSequenceNumber = 0LL;
+        long long m_completedDatagrams = 0LL;
+        long long m_baseTimeMilliseconds = 0LL;
+
+        // each datagram in flight has its own header, sent ahead of the payload from the shared send buffer
+        // - m_scheduledHeader is the one datagram waiting on the pacing timer: only one is scheduled at a time
+        std::vector<char> m_headers;
+        std::vector<char*> m_freeHeaders;
+        char* m_scheduledHeader = nullptr;
+    };
+
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///  - UDP Blast receiver
+    ///    -- Keeps -PrePostRecvs datagrams posted, counting the datagrams dropped and reordered from the sequence numbers
+    ///    -- Completes once no datagram has arrived for an entire idle interval after the first one
+    ///    -- The datagrams never received at the tail of each stream are counted as dropped when completing
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsIOPatternUdpBlastReceiver final : public ctsIOPatternStatistics<ctsUdpStatistics>
+    {
+    public:
+        ctsIOPatternUdpBlastReceiver();
+        ~ctsIOPatternUdpBlastReceiver() noexcept override;
+
+        ctsIOPatternUdpBlastReceiver(const ctsIOPatternUdpBlastReceiver&) = delete;
+        ctsIOPatternUdpBlastReceiver& operator=(const ctsIOPatternUdpBlastReceiver&) = delete;
+        ctsIOPatternUdpBlastReceiver(ctsIOPatternUdpBlastReceiver&&) = delete;
+        ctsIOPatternUdpBlastReceiver& operator=(ctsIOPatternUdpBlastReceiver&&) = delete;
+
+        // required virtual functions
+        ctsIOTask next_task() noexcept override;
+        ctsIOPatternProtocolError completed_task(const ctsIOTask& task, unsigned long completed_bytes) noexcept override;
+
+    private:
+        PTP_TIMER m_idleTimer = nullptr;
+        unsigned long m_recvNeeded = ctsConfig::Settings->PrePostRecvs;
+
+        // these must be protected by the base class cs
+        // - the base lock is always taken before our virtual functions are called
+        // - so this is most important to know in our timer callback
+        _Requires_lock_held_(cs)
+            ctsUdpBlastSequenceTracker m_sequenceTracker;
+        bool m_timerStarted = false;
+        bool m_receivedAny = false;
+        bool m_receivedThisInterval = false;
+        bool m_finished = false;
+        long long m_lastDatagramMilliseconds = 0LL;
+
+        /// Completes the pattern once the datagrams stop arriving
+        static
+            VOID CALLBACK IdleTimerCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID context, PTP_TIMER) noexcept;
+    };
+
 } //namespace
@@ -13,7 +13,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 
 
 // cpp headers
-#include <vector>
+#include <array>
 // os headers
 #include <Windows.h>
 // wil headers
@@ -30,7 +30,6 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include "ctsMediaStreamProtocol.hpp"
 
 using namespace ctl;
-using std::vector;
 
 namespace ctsTraffic
 {
@@ -47,7 +46,7 @@ namespace ctsTraffic
     ///            FrameSize = 4096 byte frames
     ///            BufferDepth = 81920 bytes (2 seconds)
     ///
-    ///   -- The client must maintain a vector of up to ExtraBufferDepthFactor * the buffer depth requested
+    ///   -- The client must maintain a ring of up to ExtraBufferDepthFactor * the buffer depth requested
     ///      - after the initial BufferDepth is received, 
     ///        it will start its timer to access the next frame's data
     ///
@@ -56,9 +55,17 @@ namespace ctsTraffic
     ///
     ///////////////////////////////////////////////////////////////////////////////////////////////////
     ///////////////////////////////////////////////////////////////////////////////////////////////////
+    // jitter stream ids start at 1 so a zeroed capture record is never mistaken for a stream
+    static long s_NextJitterStreamId = 0;
+    // a NACK is sent at most once per frame rendered: a buffer is reused only after this many frames,
+    // long after the send of the prior NACK written to it completed
+    constexpr unsigned long c_NackBufferCount = 4;
+
     ctsIOPatternMediaStreamClient::ctsIOPatternMediaStreamClient() :
         ctsIOPatternStatistics(ctsConfig::Settings->PrePostRecvs),
-        m_frameRateMsPerFrame(1000.0 / static_cast<unsigned long>(ctsConfig::GetMediaStream().FramesPerSecond))
+        m_frameRateMsPerFrame(1000.0 / static_cast<unsigned long>(ctsConfig::GetMediaStream().FramesPerSecond)),
+        m_jitterStreamId(static_cast<unsigned long>(InterlockedIncrement(&s_NextJitterStreamId))),
+        m_frames(ctTimer::ctSnapQpf())
     {
         // if the entire session fits in the inital buffer, update accordingly
         if (m_finalFrame < m_initialBufferFrames)
@@ -82,15 +89,39 @@ namespace ctsTraffic
         PrintDebugInfo(L"\t\tctsIOPatternMediaStreamClient - queue size for this new connection is %d\n", static_cast<long>(queue_size));
         PrintDebugInfo(L"\t\tctsIOPatternMediaStreamClient - frame rate in milliseconds per frame : %f\n", m_frameRateMsPerFrame);
 
-        m_frameEntries.resize(queue_size);
-        m_headEntry = m_frameEntries.begin();
+        // the queue starts with the frames from sequence number 1
+        m_frames.resize(static_cast<size_t>(static_cast<long>(queue_size)), ctsConfig::GetMediaStream().NackRecovery, m_kernelTimestamps);
 
-        // pre-populate the queue of frames with the initial seq numbers
-        ctsSignedLong last_used_sequence_number = 1;
-        for (auto& entry : m_frameEntries)
+        if (m_adaptivePlayout)
+        {
+            // the buffer starts at -BufferDepth, and cannot grow past the frames the queue can track
+            m_playout.reset(m_initialBufferFrames, static_cast<unsigned long>(m_frames.size()) - 1, m_frameRateMsPerFrame);
+            m_droppedFrames.resize(m_frames.size());
+        }
+
+        if (ctsConfig::GetMediaStream().NackRecovery)
+        {
+            m_nackBuffers.resize(c_NackBufferCount * UdpDatagramNackMaximumLength);
+        }
+        if (m_kernelTimestamps)
+        {
+            // one for each recv that can be in flight: m_recvNeeded starts at PrePostRecvs
+            m_recvMessages.resize(ctsConfig::Settings->PrePostRecvs);
+            m_freeRecvMessages.reserve(m_recvMessages.size());
+            for (auto& recv_message : m_recvMessages)
+            {
+                m_freeRecvMessages.push_back(&recv_message);
+            }
+        }
+        if (ctsConfig::GetMediaStream().FecDataDatagrams > 0)
         {
-            entry.sequence_number = last_used_sequence_number;
-            ++last_used_sequence_number;
+            const unsigned long max_datagram_length = m_frameSizeBytes > UdpDatagramMaximumSizeBytes ? UdpDatagramMaximumSizeBytes : m_frameSizeBytes;
+            m_fecDecoder = std::make_unique<ctsMediaStreamFecDecoder>(
+                ctsConfig::GetMediaStream().FecDataDatagrams,
+                ctsConfig::GetMediaStream().FecParityDatagrams,
+                ctsMediaStreamSendRequests::DatagramCount(m_frameSizeBytes),
+                max_datagram_length - UdpDatagramDataHeaderLength,
+                UdpDatagramDataHeaderLength);
         }
 
         // after creating, refer to the timers under the lock
@@ -151,10 +182,20 @@ namespace ctsTraffic
             {
                 max_size_buffer = m_frameSizeBytes;
             }
+            // parity datagrams carry their own header after the datagram header
+            if (m_fecDecoder)
+            {
+                max_size_buffer += ctsMediaStreamFec::ParityHeaderLength;
+            }
 
             return_task = this->untracked_task(IOTaskAction::Recv, max_size_buffer);
             // always write in a zero for the seq number to initialize the buffer
             *reinterpret_cast<long long*>(return_task.buffer) = 0LL;
+            if (!m_freeRecvMessages.empty())
+            {
+                return_task.recv_message = m_freeRecvMessages.back();
+                m_freeRecvMessages.pop_back();
+            }
             --m_recvNeeded;
         }
         return return_task;
@@ -176,6 +217,19 @@ namespace ctsTraffic
 
         if (task.ioAction == IOTaskAction::Recv)
         {
+            // -Timestamps:kernel : when the network stack received the datagram
+            // - the time this completion is processed if the stack did not return a timestamp
+            long long kernel_qpc = qpc.QuadPart;
+            if (task.recv_message)
+            {
+                UINT64 receive_timestamp = 0;
+                if (task.recv_message->receive_timestamp(receive_timestamp))
+                {
+                    kernel_qpc = static_cast<long long>(receive_timestamp);
+                }
+                m_freeRecvMessages.push_back(task.recv_message);
+            }
+
             if (0 == bytes_received)
             {
                 if (m_finishedStream)
@@ -206,24 +260,49 @@ namespace ctsTraffic
                 return ctsIOPatternProtocolError::NoError;
             }
 
+            const unsigned short protocol_flag = ctsMediaStreamMessage::GetProtocolHeaderFromTask(task);
+            const bool fec_parity = (protocol_flag & UdpDatagramProtocolHeaderFlagFecTypeMask) == UdpDatagramProtocolHeaderFlagFecParity;
+
             // validate the buffer contents
-            ctsIOTask validation_task(task);
-            validation_task.buffer_offset = UdpDatagramDataHeaderLength; // skip the UdpDatagramDataHeaderLength since we use them for our own stuff
-            validation_task.buffer_length -= UdpDatagramDataHeaderLength;
-            if (!VerifyBuffer(validation_task, bytes_received - UdpDatagramDataHeaderLength))
+            // - parity is the XOR of the frame's payloads, so has no pattern of its own to verify
+            if (!fec_parity)
             {
-                // exit early if the buffers don't match
-                return ctsIOPatternProtocolError::CorruptedBytes;
+                ctsIOTask validation_task(task);
+                validation_task.buffer_offset = UdpDatagramDataHeaderLength; // skip the UdpDatagramDataHeaderLength since we use them for our own stuff
+                validation_task.buffer_length -= UdpDatagramDataHeaderLength;
+                if (!VerifyBuffer(validation_task, bytes_received - UdpDatagramDataHeaderLength))
+                {
+                    // exit early if the buffers don't match
+                    return ctsIOPatternProtocolError::CorruptedBytes;
+                }
             }
 
+            const long long received_seq_number = ctsMediaStreamMessage::GetSequenceNumberFromTask(task);
+            const bool unknown_seq_number = received_seq_number > m_finalFrame;
+            const bool retransmitted = protocol_flag == UdpDatagramProtocolHeaderFlagRetransmit;
+
             // track the # of *bits* received
-            ctsConfig::Settings->UdpStatusDetails.bits_received.add(bytes_received * 8);
+            // - with the error for an unknown seq. number as a single update to the global stats
+            {
+                const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+                ctsConfig::Settings->UdpStatusDetails.bits_received.add(bytes_received * 8);
+                if (retransmitted)
+                {
+                    ctsConfig::Settings->UdpStatusDetails.retransmitted_bits.add(bytes_received * 8);
+                }
+                if (fec_parity)
+                {
+                    ctsConfig::Settings->UdpStatusDetails.fec_parity_bits.add(bytes_received * 8);
+                }
+                if (unknown_seq_number)
+                {
+                    ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+                }
+            }
             this->stats.bits_received.add(bytes_received * 8);
 
-            const long long received_seq_number = ctsMediaStreamMessage::GetSequenceNumberFromTask(task);
-            if (received_seq_number > m_finalFrame)
+            if (unknown_seq_number)
             {
-                ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
                 this->stats.error_frames.increment();
 
                 PrintDebugInfo(
@@ -238,23 +317,56 @@ namespace ctsTraffic
                 // for the seq number we just received, and if found, tag as received
                 //
                 const auto found_slot = this->find_sequence_number(received_seq_number);
-                if (found_slot != m_frameEntries.end())
+                if (found_slot != ctsMediaStreamFrameRing::NotFound)
                 {
                     const long long buffered_qpc = *reinterpret_cast<long long*>(task.buffer + 8);
                     const long long buffered_qpf = *reinterpret_cast<long long*>(task.buffer + 16);
 
+                    // a retransmit resends the entire frame: the ring counts it apart so a frame partially received
+                    // the first time is complete when either copy is, rather than appearing duplicated
+                    unsigned long frame_bytes = 0;
+                    if (retransmitted || (!m_fecDecoder && !fec_parity))
+                    {
+                        frame_bytes = bytes_received;
+                    }
+                    else if (m_fecDecoder)
+                    {
+                        // the decoder counts only the frame's datagrams: those received and those rebuilt from parity
+                        const long long recovered_before = m_fecDecoder->recovered_datagrams();
+                        LARGE_INTEGER decode_start;
+                        QueryPerformanceCounter(&decode_start);
+
+                        const unsigned long fec_index = protocol_flag & UdpDatagramProtocolHeaderFlagFecIndexMask;
+                        const char* const payload = task.buffer + task.buffer_offset + UdpDatagramDataHeaderLength;
+                        const unsigned long payload_length = bytes_received - UdpDatagramDataHeaderLength;
+                        frame_bytes = fec_parity ?
+                            m_fecDecoder->parity_received(received_seq_number, fec_index, payload, payload_length) :
+                            m_fecDecoder->data_received(received_seq_number, fec_index, payload, payload_length);
+
+                        LARGE_INTEGER decode_end;
+                        QueryPerformanceCounter(&decode_end);
+                        const long long recovered = m_fecDecoder->recovered_datagrams() - recovered_before;
+                        this->stats.fec_datagrams.add(recovered);
+                        this->stats.fec_cpu_ticks.add(decode_end.QuadPart - decode_start.QuadPart);
+                        {
+                            const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+                            ctsConfig::Settings->UdpStatusDetails.fec_recovered_datagrams.add(recovered);
+                            ctsConfig::Settings->UdpStatusDetails.fec_cpu_ticks.add(decode_end.QuadPart - decode_start.QuadPart);
+                        }
+                    }
                     // always overwrite qpc & qpf values with the latest datagram details
-                    found_slot->sender_qpc = buffered_qpc;
-                    found_slot->sender_qpf = buffered_qpf;
-                    found_slot->receiver_qpc = qpc.QuadPart;
-                    found_slot->receiver_qpf = ctTimer::ctSnapQpf();
-                    found_slot->bytes_received += bytes_received;
+                    m_frames.record_datagram(found_slot, frame_bytes, retransmitted, buffered_qpc, buffered_qpf, qpc.QuadPart);
+                    m_frames.record_kernel_timestamp(found_slot, kernel_qpc);
+                    if (received_seq_number > m_highestSequenceNumber)
+                    {
+                        m_highestSequenceNumber = received_seq_number;
+                    }
 
                     PrintDebugInfo(
                         L"\t\tctsIOPatternMediaStreamClient received seq number %lld (%lu received-bytes, %lu frame-bytes)\n",
-                        found_slot->sequence_number,
+                        received_seq_number,
                         bytes_received,
-                        found_slot->bytes_received
+                        m_frames.bytes_received(found_slot)
                     );
 
                     // stop the timer once we receive the last frame
@@ -269,23 +381,30 @@ namespace ctsTraffic
                 else
                 {
                     // didn't find a slot for the received seq. number
-                    ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+                    {
+                        const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+                        ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+                    }
                     this->stats.error_frames.increment();
 
-                    if (received_seq_number < m_headEntry->sequence_number)
+                    if (received_seq_number < m_frames.head_sequence_number())
                     {
+                        if (m_adaptivePlayout)
+                        {
+                            this->track_late_frame(received_seq_number);
+                        }
                         PrintDebugInfo(
                             L"\t\tctsIOPatternMediaStreamClient received **a stale** seq number (%lld) - current seq number (%lld)\n",
                             received_seq_number,
-                            static_cast<long long>(m_headEntry->sequence_number));
+                            m_frames.head_sequence_number());
                     }
                     else
                     {
                         PrintDebugInfo(
                             L"\t\tctsIOPatternMediaStreamClient recevieved **a future** seq number (%lld) - head of queue (%lld) tail of queue (%lld)\n",
                             received_seq_number,
-                            static_cast<long long>(m_headEntry->sequence_number),
-                            static_cast<long long>(m_headEntry->sequence_number + m_frameEntries.size() - 1));
+                            m_frames.head_sequence_number(),
+                            m_frames.head_sequence_number() + static_cast<long long>(m_frames.size()) - 1);
                     }
                 }
             }
@@ -299,57 +418,25 @@ namespace ctsTraffic
     }
 
     ///
-    /// Returns an iterator within frame_entries pointing to the FrameEntry
-    ///   matching the specified sequence number.
-    /// If the sequence number was not found, will return end(frame_entries)
+    /// Returns the slot within m_frames of the frame matching the specified sequence number.
+    /// If the sequence number is not in the queue, will return ctsMediaStreamFrameRing::NotFound
     ///
     _Requires_lock_held_(cs)
-        vector<ctsConfig::JitterFrameEntry>::iterator ctsIOPatternMediaStreamClient::find_sequence_number(long long seq_number) noexcept
+        size_t ctsIOPatternMediaStreamClient::find_sequence_number(long long seq_number) const noexcept
     {
-        const ctsSignedLongLong head_sequence_number = m_headEntry->sequence_number;
-        const ctsSignedLongLong tail_sequence_number = head_sequence_number + m_frameEntries.size() - 1;
-        const ctsSignedLongLong vector_end_sequence_number = m_frameEntries.rbegin()->sequence_number;
-
-        if (seq_number > tail_sequence_number || seq_number < head_sequence_number)
-        {
-            // sequence number was out of range of our circular queue
-            // - return end(frame_entries) to indicate it could not be found
-            return end(m_frameEntries);
-        }
-
-        if (seq_number <= vector_end_sequence_number)
-        {
-            // offset just from the head since it hasn't wrapped around the end
-            const auto offset = static_cast<size_t>(seq_number - head_sequence_number);
-            return m_headEntry + offset;
-        }
-        // offset from the beginning since it wrapped around from the end
-        const auto offset = static_cast<size_t>(seq_number - vector_end_sequence_number - 1LL);
-        return m_frameEntries.begin() + offset;
+        // the frame's slot is its offset from the head: no frames are searched
+        return m_frames.find(seq_number);
     }
 
     _Requires_lock_held_(cs)
         bool ctsIOPatternMediaStreamClient::received_buffered_frames() noexcept
     {
-        if (m_frameEntries[0].sequence_number > 1)
+        if (m_frames.head_sequence_number() > 1)
         {
-            // we've already received enough datagrams to fill one buffer
+            // we've already moved the head after processing a frame
             return true;
         }
-        if (m_headEntry != m_frameEntries.begin())
-        {
-            // we've already moved the head entry after processing a frame
-            return true;
-        }
-
-        for (const auto& udp_frame : m_frameEntries)
-        {
-            if (udp_frame.bytes_received > 0UL)
-            {
-                return true;
-            }
-        }
-        return false;
+        return m_frames.received_any();
     }
 
     _Requires_lock_held_(cs)
@@ -400,74 +487,261 @@ namespace ctsTraffic
     _Requires_lock_held_(cs)
         void ctsIOPatternMediaStreamClient::render_frame() noexcept
     {
+        // the frame queue keeps only what is needed to find and count frames:
+        // the full record for jitter is only built for the frame being rendered
+        const size_t head_slot = m_frames.head();
+        ctsConfig::JitterFrameEntry head_frame;
+        head_frame.sequence_number = m_frames.head_sequence_number();
+        head_frame.bytes_received = m_frames.bytes_received(head_slot);
+        head_frame.retransmitted_bytes = m_frames.retransmitted_bytes(head_slot);
+        if (m_frames.arrived(head_slot))
+        {
+            head_frame.sender_qpc = m_frames.sender_qpc(head_slot);
+            head_frame.sender_qpf = m_frames.sender_qpf();
+            head_frame.receiver_qpc = m_frames.receiver_qpc(head_slot);
+            head_frame.receiver_qpf = m_frames.receiver_qpf();
+            if (m_kernelTimestamps)
+            {
+                head_frame.receiver_kernel_qpc = m_frames.receiver_kernel_qpc(head_slot);
+                head_frame.host_processing_ms =
+                    static_cast<double>(head_frame.receiver_qpc - head_frame.receiver_kernel_qpc) * 1000.0 / static_cast<double>(head_frame.receiver_qpf);
+            }
+        }
+
         // estimating time in flight for this frame by determining how much time since the first send was just 'waiting' to send this frame
         // and subtracing that from how much time since the first receive - since time between receives should at least be time between sends
-        if (m_headEntry->receiver_qpf != 0 && m_firstFrame.receiver_qpf != 0)
+        if (head_frame.receiver_qpf != 0 && m_firstFrame.receiver_qpf != 0)
         {
             const double ms_since_first_receive =
-                (static_cast<double>(m_headEntry->receiver_qpc) * 1000.0f / static_cast<double>(m_headEntry->receiver_qpf)) -
+                (static_cast<double>(head_frame.receiver_qpc) * 1000.0f / static_cast<double>(head_frame.receiver_qpf)) -
                 (static_cast<double>(m_firstFrame.receiver_qpc) * 1000.0f / static_cast<double>(m_firstFrame.receiver_qpf));
             const double ms_since_first_send =
-                (static_cast<double>(m_headEntry->sender_qpc) * 1000.0f / static_cast<double>(m_headEntry->sender_qpf)) -
+                (static_cast<double>(head_frame.sender_qpc) * 1000.0f / static_cast<double>(head_frame.sender_qpf)) -
                 (static_cast<double>(m_firstFrame.sender_qpc) * 1000.0f / static_cast<double>(m_firstFrame.sender_qpf));
-            m_headEntry->estimated_time_in_flight_ms = ms_since_first_receive - ms_since_first_send;
+            head_frame.estimated_time_in_flight_ms = ms_since_first_receive - ms_since_first_send;
+
+            // -Timestamps:kernel : the same estimate up to when the network stack received the frame
+            // - excludes the time the datagram waited to be completed and processed on this host
+            if (m_kernelTimestamps)
+            {
+                const double ms_since_first_kernel_receive =
+                    static_cast<double>(head_frame.receiver_kernel_qpc - m_firstFrame.receiver_kernel_qpc) * 1000.0 / static_cast<double>(head_frame.receiver_qpf);
+                head_frame.estimated_network_time_in_flight_ms = ms_since_first_kernel_receive - ms_since_first_send;
+            }
         }
 
-        if (m_headEntry->bytes_received == m_frameSizeBytes)
+        // with -FrameModel:gop each frame is expected to be the size of its place in the GOP
+        const auto& media_stream = ctsConfig::GetMediaStream();
+        const unsigned long expected_frame_bytes = media_stream.FrameSize(head_frame.sequence_number);
+        const bool key_frame = media_stream.IsKeyFrame(head_frame.sequence_number);
+
+        // with -Recovery:nack, a frame missing datagrams the first time is recovered if its retransmit arrived complete
+        const bool recovered_frame =
+            head_frame.bytes_received < expected_frame_bytes &&
+            head_frame.retransmitted_bytes >= expected_frame_bytes;
+        const bool successful_frame = head_frame.bytes_received == expected_frame_bytes || recovered_frame;
+        const bool dropped_frame = !successful_frame && head_frame.bytes_received < expected_frame_bytes;
+
+        // the frame's counters are a single update to the global stats
+        {
+            const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+            if (key_frame)
+            {
+                ctsConfig::Settings->UdpStatusDetails.key_frames.increment();
+            }
+            if (recovered_frame)
+            {
+                ctsConfig::Settings->UdpStatusDetails.recovered_frames.increment();
+            }
+            if (successful_frame)
+            {
+                ctsConfig::Settings->UdpStatusDetails.successful_frames.increment();
+            }
+            else if (dropped_frame)
+            {
+                ctsConfig::Settings->UdpStatusDetails.dropped_frames.increment();
+                if (key_frame)
+                {
+                    // tracked separately: I-frames are the bursts most likely to overrun switch buffers
+                    ctsConfig::Settings->UdpStatusDetails.dropped_key_frames.increment();
+                }
+            }
+            else
+            {
+                ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
+            }
+        }
+
+        if (successful_frame)
         {
-            ctsConfig::Settings->UdpStatusDetails.successful_frames.increment();
             this->stats.successful_frames.increment();
 
             PrintDebugInfo(
                 L"\t\tctsIOPatternMediaStreamClient rendered frame %lld\n",
-                static_cast<long long>(m_headEntry->sequence_number));
+                head_frame.sequence_number);
 
             // Directly write this status update if jitter is enabled
-            PrintJitterUpdate(*m_headEntry, m_previousFrame);
+            PrintJitterUpdate(m_jitterStreamId, head_frame, m_previousFrame);
+
+            if (m_adaptivePlayout)
+            {
+                this->update_playout_delay(head_frame);
+            }
 
             // if this is the first frame, capture it
             if (m_firstFrame.receiver_qpc == 0)
             {
-                m_firstFrame = *m_headEntry;
+                m_firstFrame = head_frame;
             }
             // always keep the most recently received frame for jitter
-            m_previousFrame = *m_headEntry;
+            m_previousFrame = head_frame;
 
         }
-        else if (m_headEntry->bytes_received < m_frameSizeBytes)
+        else if (dropped_frame)
         {
-            ctsConfig::Settings->UdpStatusDetails.dropped_frames.increment();
             this->stats.dropped_frames.increment();
 
             PrintDebugInfo(
                 L"\t\tctsIOPatternMediaStreamClient **dropped** frame for seq number (%lld)\n",
-                m_headEntry->sequence_number);
+                head_frame.sequence_number);
 
             // track the dropped frame
             // indicate zero's for the other values so we won't calculate jitter for a dropped datagram
             ctsConfig::JitterFrameEntry droppedFrame;
-            droppedFrame.sequence_number = m_headEntry->sequence_number;
-            PrintJitterUpdate(droppedFrame, ctsConfig::JitterFrameEntry());
+            droppedFrame.sequence_number = head_frame.sequence_number;
+            PrintJitterUpdate(m_jitterStreamId, droppedFrame, ctsConfig::JitterFrameEntry());
         }
-        else // m_headEntry->bytes_received > m_frameSizeBytes
+        else // head_frame.bytes_received > expected_frame_bytes
         {
-            ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
             this->stats.duplicate_frames.increment();
 
             PrintDebugInfo(
                 L"\t\tctsIOPatternMediaStreamClient **a duplicate** frame for seq number (%lld)\n",
-                m_headEntry->sequence_number);
+                head_frame.sequence_number);
+        }
+
+        if (m_adaptivePlayout)
+        {
+            // the slot now tracks whether the frame it held was dropped, until its next frame is rendered
+            m_droppedFrames[head_slot] = dropped_frame ? 1 : 0;
+        }
+
+        // move the head to the next sequence number
+        // - the slot is cleared to hold the new "end" sequence number of the queue (the new max value)
+        m_frames.advance_head();
+    }
+
+    // -Playout:adaptive
+    // - render every frame the playout delay has made due
+    _Requires_lock_held_(cs)
+        void ctsIOPatternMediaStreamClient::render_due_frames() noexcept
+    {
+        while (m_frames.head_sequence_number() <= m_finalFrame &&
+            m_playout.frame_due(m_frames.head_sequence_number(), m_timerWheelOffsetFrames))
+        {
+            this->render_frame();
+        }
+    }
+
+    // -Playout:adaptive
+    // - measures the transit and wait of the frame just rendered, from which m_playout adjusts the delay
+    _Requires_lock_held_(cs)
+        void ctsIOPatternMediaStreamClient::update_playout_delay(const ctsConfig::JitterFrameEntry& frame) noexcept
+    {
+        LARGE_INTEGER render_qpc;
+        QueryPerformanceCounter(&render_qpc);
+
+        const double receiver_ms = static_cast<double>(frame.receiver_qpc) * 1000.0 / static_cast<double>(frame.receiver_qpf);
+        const double sender_ms = static_cast<double>(frame.sender_qpc) * 1000.0 / static_cast<double>(frame.sender_qpf);
+        const double wait_ms = static_cast<double>(render_qpc.QuadPart - frame.receiver_qpc) * 1000.0 / static_cast<double>(frame.receiver_qpf);
+        m_playout.frame_rendered(receiver_ms - sender_ms, wait_ms);
+
+        const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+        ctsConfig::Settings->UdpStatusDetails.playout_frames.increment();
+        ctsConfig::Settings->UdpStatusDetails.playout_wait_us.add(static_cast<long long>(wait_ms * 1000.0));
+        ctsConfig::Settings->UdpStatusDetails.playout_depth_frames.add(m_playout.delay_frames());
+        ctsConfig::Settings->UdpStatusDetails.playout_jitter_us.add(static_cast<long long>(m_playout.jitter_ms() * 1000.0));
+    }
+
+    // -Playout:adaptive
+    // - a frame rendered as dropped whose datagrams then arrive was late rather than lost: the buffer grows by a frame
+    _Requires_lock_held_(cs)
+        void ctsIOPatternMediaStreamClient::track_late_frame(long long sequence_number) noexcept
+    {
+        // a rendered frame's slot now holds the frame m_frames.size() after it
+        const size_t slot = m_frames.find(sequence_number + static_cast<long long>(m_frames.size()));
+        if (ctsMediaStreamFrameRing::NotFound == slot || 0 == m_droppedFrames[slot])
+        {
+            return;
+        }
+        // only the first datagram to arrive late counts the frame
+        m_droppedFrames[slot] = 0;
+        {
+            const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+            ctsConfig::Settings->UdpStatusDetails.late_frames.increment();
         }
+        m_playout.frame_late();
+    }
 
-        // update the current sequence number so it's now the "end" sequence number of the queue (the new max value)
-        m_headEntry->sequence_number = m_headEntry->sequence_number + m_frameEntries.size();
-        m_headEntry->bytes_received = 0;
+    // -Recovery:nack
+    // - request every frame within the lookahead still missing datagrams, once per frame
+    // - only frames before the newest frame received are requested: later frames may not have been sent yet
+    // - consecutive frames are requested as one range
+    _Requires_lock_held_(cs)
+        void ctsIOPatternMediaStreamClient::request_missing_frames() noexcept
+    {
+        const auto& media_stream = ctsConfig::GetMediaStream();
+        std::array<ctsMediaStreamNackRange, UdpDatagramNackMaximumRanges> ranges{};
+        unsigned long range_count = 0;
 
-        // move the head entry to the next sequence number
-        ++m_headEntry;
-        if (m_headEntry == m_frameEntries.end())
+        size_t slot = m_frames.head();
+        for (unsigned long offset = 0; offset < m_nackLookaheadFrames; ++offset)
         {
-            m_headEntry = m_frameEntries.begin();
+            const long long sequence_number = m_frames.head_sequence_number() + offset;
+            if (sequence_number >= m_highestSequenceNumber || sequence_number > m_finalFrame)
+            {
+                break;
+            }
+
+            if (!m_frames.retransmit_requested(slot) &&
+                m_frames.bytes_received(slot) < media_stream.FrameSize(sequence_number))
+            {
+                if (range_count > 0 &&
+                    ranges[range_count - 1].first_sequence_number + ranges[range_count - 1].frame_count == sequence_number)
+                {
+                    ++ranges[range_count - 1].frame_count;
+                }
+                else if (range_count < UdpDatagramNackMaximumRanges)
+                {
+                    ranges[range_count].first_sequence_number = sequence_number;
+                    ranges[range_count].frame_count = 1;
+                    ++range_count;
+                }
+                else
+                {
+                    // the NACK is full: this frame is requested with the next frame rendered
+                    break;
+                }
+                m_frames.set_retransmit_requested(slot);
+                {
+                    const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+                    ctsConfig::Settings->UdpStatusDetails.requested_frames.increment();
+                }
+            }
+
+            slot = m_frames.next(slot);
+        }
+
+        if (range_count > 0)
+        {
+            char* const nack_buffer = m_nackBuffers.data() + (m_nextNackBuffer % c_NackBufferCount) * UdpDatagramNackMaximumLength;
+            ++m_nextNackBuffer;
+
+            PrintDebugInfo(
+                L"\t\tctsIOPatternMediaStreamClient sending a NACK for %lu ranges starting at seq number %lld\n",
+                range_count,
+                ranges[0].first_sequence_number);
+            this->send_callback(ctsMediaStreamMessage::MakeNackTask(nack_buffer, ranges.data(), range_count));
         }
     }
 
@@ -523,7 +797,7 @@ namespace ctsTraffic
 
             bool fatal_aborted = false;
             if (this_ptr->m_timerWheelOffsetFrames >= this_ptr->m_initialBufferFrames &&
-                this_ptr->m_headEntry->sequence_number <= this_ptr->m_finalFrame)
+                this_ptr->m_frames.head_sequence_number() <= this_ptr->m_finalFrame)
             {
                 // if we haven't yet received *anything* from the server, abort this connection
                 if (!this_ptr->received_buffered_frames())
@@ -531,8 +805,18 @@ namespace ctsTraffic
                     ctsConfig::PrintErrorInfo("ctsIOPatternMediaStreamClient - issuing a FATALABORT to close the connection - have received nothing from the server");
 
                     // indicate all frames were dropped
-                    ctsConfig::Settings->UdpStatusDetails.dropped_frames.add(this_ptr->m_finalFrame);
                     this_ptr->stats.dropped_frames.add(this_ptr->m_finalFrame);
+                    {
+                        const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+                        ctsConfig::Settings->UdpStatusDetails.dropped_frames.add(this_ptr->m_finalFrame);
+                        const unsigned long gop_length = ctsConfig::GetMediaStream().GopLengthFrames;
+                        if (gop_length > 0)
+                        {
+                            const auto final_key_frames = (this_ptr->m_finalFrame + gop_length - 1) / gop_length;
+                            ctsConfig::Settings->UdpStatusDetails.key_frames.add(final_key_frames);
+                            ctsConfig::Settings->UdpStatusDetails.dropped_key_frames.add(final_key_frames);
+                        }
+                    }
 
                     this_ptr->m_finishedStream = true;
                     ctsIOTask abort_task;
@@ -544,14 +828,25 @@ namespace ctsTraffic
                 else
                 {
                     // if the initial buffer has already been filled, "render" the frame
-                    this_ptr->render_frame();
+                    if (this_ptr->m_adaptivePlayout)
+                    {
+                        this_ptr->render_due_frames();
+                    }
+                    else
+                    {
+                        this_ptr->render_frame();
+                    }
+                    if (!this_ptr->m_nackBuffers.empty())
+                    {
+                        this_ptr->request_missing_frames();
+                    }
                 }
             }
 
             if (!fatal_aborted)
             {
                 // wait for the precise number of milliseconds for the next frame
-                if (this_ptr->m_headEntry->sequence_number <= this_ptr->m_finalFrame)
+                if (this_ptr->m_frames.head_sequence_number() <= this_ptr->m_finalFrame)
                 {
                     timer_scheduled = this_ptr->set_next_timer(false);
 
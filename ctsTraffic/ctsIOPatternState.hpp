@@ -54,6 +54,7 @@ namespace ctsTraffic
             MoreIo,
             ServerSendConnectionId,
             ClientRecvConnectionId,
+            ServerRecvConnectionId, // -Options:FastOpen : the client sent its connection id with the SYN
             ServerSendCompletion,
             ClientRecvCompletion,
             GracefulShutdown,  // TCP: instruct the function to call shutdown(SD_SEND) on the socket
@@ -104,6 +105,11 @@ namespace ctsTraffic
         {
             internal_state = InternalPatternState::MoreIo;
         }
+        else if ((ctsConfig::Settings->Options & ctsConfig::OptionType::FAST_OPEN) && !ctsConfig::IsListening())
+        {
+            // the client already sent its connection id with ConnectEx
+            internal_state = InternalPatternState::MoreIo;
+        }
     }
 
     inline ctsUnsignedLongLong ctsIOPatternState::get_remaining_transfer() const noexcept
@@ -167,7 +173,14 @@ namespace ctsTraffic
         switch (this->internal_state)
         {
             case InternalPatternState::Initialized:
-                if (ctsConfig::IsListening())
+                if (ctsConfig::IsListening() && (ctsConfig::Settings->Options & ctsConfig::OptionType::FAST_OPEN))
+                {
+                    PrintDebugInfo(L"\t\tctsIOPatternState::get_next_task : ServerRecvConnectionId\n");
+                    this->pended_state = true;
+                    this->internal_state = InternalPatternState::ServerRecvConnectionId;
+                    return ctsIOPatternProtocolTask::RecvConnectionId;
+                }
+                else if (ctsConfig::IsListening())
                 {
                     PrintDebugInfo(L"\t\tctsIOPatternState::get_next_task : ServerSendConnectionId\n");
                     this->pended_state = true;
@@ -184,6 +197,7 @@ namespace ctsTraffic
 
             case InternalPatternState::ServerSendConnectionId: // both client and server start IO after the connection ID is shared
             case InternalPatternState::ClientRecvConnectionId:
+            case InternalPatternState::ServerRecvConnectionId:
                 PrintDebugInfo(L"\t\tctsIOPatternState::get_next_task : MoreIo\n");
                 this->internal_state = InternalPatternState::MoreIo;
                 return ctsIOPatternProtocolTask::MoreIo;
@@ -293,7 +307,9 @@ namespace ctsTraffic
         // if completed our connection id request, immediately return
         // (not validating IO below)
         //
-        if (InternalPatternState::ServerSendConnectionId == this->internal_state || InternalPatternState::ClientRecvConnectionId == this->internal_state)
+        if (InternalPatternState::ServerSendConnectionId == this->internal_state ||
+            InternalPatternState::ClientRecvConnectionId == this->internal_state ||
+            InternalPatternState::ServerRecvConnectionId == this->internal_state)
         {
             // must have received the full id
             if (_completed_transfer_bytes != ctsStatistics::ConnectionIdLength)
@@ -0,0 +1,337 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+// cpp headers
+#include <cstring>
+#include <exception>
+// os headers
+#include <Windows.h>
+#include <rpc.h>
+// wil headers
+#include <wil/resource.h>
+// ctl headers
+#include <ctException.hpp>
+#include <ctTimer.hpp>
+// project headers
+#include "ctsIOPattern.h"
+#include "ctsStatistics.hpp"
+#include "ctsConfig.h"
+#include "ctsIOTask.hpp"
+#include "ctsUdpBlastProtocol.hpp"
+
+using namespace ctl;
+
+namespace ctsTraffic
+{
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    ///     - ctsIOPatternUdpBlast Patterns
+    ///    -- UDP-only
+    ///    -- The sender sends fixed-size datagrams with no handshake and no flow control
+    ///    -- The receiver counts what arrives: the point is the packet rate and the loss at that rate,
+    ///       not the bytes moved
+    ///
+    ///   -- Windows has no sendmmsg/recvmmsg to batch datagrams into a single call:
+    ///      instead each side keeps many overlapped datagrams outstanding (-PrePostSends / -PrePostRecvs)
+    ///
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // the receiver completes once no datagram has arrived for a full interval
+    constexpr unsigned long c_UdpBlastIdleIntervalMilliseconds = 1000UL;
+
+    ctsIOPatternUdpBlastSender::ctsIOPatternUdpBlastSender() :
+        ctsIOPatternStatistics(0),
+        m_datagramSize(ctsConfig::GetMaxBufferSize()),
+        m_datagramCount(static_cast<long long>(ctsConfig::GetTransferSize() / ctsConfig::GetMaxBufferSize()))
+    {
+        // only send whole datagrams
+        this->set_total_transfer(static_cast<unsigned long long>(m_datagramCount) * m_datagramSize);
+
+        // there is no handshake with the receiver: the sender identifies its own connection and stream
+        ctsStatistics::GenerateConnectionId(this->stats);
+        UUID stream_uuid;
+        const RPC_STATUS status = UuidCreate(&stream_uuid);
+        if (status != RPC_S_OK)
+        {
+            throw ctException(status, L"UuidCreate", L"ctsIOPatternUdpBlastSender", false);
+        }
+        memcpy(&m_streamId, &stream_uuid, sizeof m_streamId);
+
+        const unsigned long header_count = ctsConfig::Settings->PrePostSends;
+        m_headers.resize(static_cast<size_t>(header_count) * UdpBlastHeaderLength);
+        m_freeHeaders.reserve(header_count);
+        for (unsigned long header = 0; header < header_count; ++header)
+        {
+            m_freeHeaders.push_back(m_headers.data() + static_cast<size_t>(header) * UdpBlastHeaderLength);
+        }
+
+        PrintDebugInfo(
+            L"\t\tctsIOPatternUdpBlastSender - sending %lld datagrams of %lu bytes\n",
+            m_datagramCount,
+            m_datagramSize);
+    }
+
+    ctsIOTask ctsIOPatternUdpBlastSender::next_task() noexcept
+    {
+        // defaulting to an empty task (do nothing)
+        ctsIOTask return_task;
+        if (m_nextSequenceNumber >= m_datagramCount || m_freeHeaders.empty())
+        {
+            return return_task;
+        }
+
+        long long time_offset_milliseconds = 0LL;
+        if (m_packetsPerSecond > 0)
+        {
+            const long long current_time_ms = ctTimer::ctSnapQpcInMillis();
+            if (0 == m_baseTimeMilliseconds)
+            {
+                m_baseTimeMilliseconds = current_time_ms;
+            }
+            // only one datagram waits on the timer at a time: the ones after it are due later still
+            time_offset_milliseconds = m_baseTimeMilliseconds + m_nextSequenceNumber * 1000LL / m_packetsPerSecond - current_time_ms;
+            if (time_offset_milliseconds > 0 && m_scheduledHeader != nullptr)
+            {
+                return return_task;
+            }
+        }
+
+        // untracked: the base class would complete the pattern as soon as the last datagram was posted,
+        // closing the socket under the sends still in flight - completed_task decides when the sender is done
+        return_task = this->untracked_task(IOTaskAction::Send, m_datagramSize);
+
+        char* header_buffer = m_freeHeaders.back();
+        m_freeHeaders.pop_back();
+        ctsUdpBlastHeader header;
+        header.stream_id = m_streamId;
+        header.sequence_number = m_nextSequenceNumber;
+        header.datagram_count = m_datagramCount;
+        header.write(header_buffer);
+        ++m_nextSequenceNumber;
+
+        // the header replaces the start of the payload taken from the shared buffer
+        return_task.buffer_segments[0].buf = header_buffer;
+        return_task.buffer_segments[0].len = UdpBlastHeaderLength;
+        return_task.buffer_segments[1].buf = return_task.buffer + return_task.buffer_offset;
+        return_task.buffer_segments[1].len = return_task.buffer_length - UdpBlastHeaderLength;
+        return_task.buffer_segment_count = 2;
+
+        if (time_offset_milliseconds > 0)
+        {
+            return_task.time_offset_milliseconds = time_offset_milliseconds;
+            m_scheduledHeader = header_buffer;
+        }
+        return return_task;
+    }
+
+    ctsIOPatternProtocolError ctsIOPatternUdpBlastSender::completed_task(const ctsIOTask& task, unsigned long completed_bytes) noexcept
+    {
+        if (task.ioAction != IOTaskAction::Send)
+        {
+            return ctsIOPatternProtocolError::NoError;
+        }
+
+        char* header_buffer = task.buffer_segments[0].buf;
+        if (header_buffer == m_scheduledHeader)
+        {
+            m_scheduledHeader = nullptr;
+        }
+        // never fails: the vector was reserved for every header
+        m_freeHeaders.push_back(header_buffer);
+
+        ++m_completedDatagrams;
+        const long long completed_bits = completed_bytes * 8LL;
+
+        {
+            const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+            ctsConfig::Settings->UdpStatusDetails.bits_received.add(completed_bits);
+            ctsConfig::Settings->UdpStatusDetails.successful_frames.increment();
+        }
+        this->stats.bits_received.add(completed_bits);
+        this->stats.successful_frames.increment();
+
+        // done only once the send of every datagram has completed
+        if (m_completedDatagrams == m_datagramCount)
+        {
+            return ctsIOPatternProtocolError::SuccessfullyCompleted;
+        }
+        return ctsIOPatternProtocolError::NoError;
+    }
+
+
+    ctsIOPatternUdpBlastReceiver::ctsIOPatternUdpBlastReceiver() :
+        ctsIOPatternStatistics(ctsConfig::Settings->PrePostRecvs)
+    {
+        // after creating, refer to the timer under the lock
+        m_idleTimer = CreateThreadpoolTimer(IdleTimerCallback, this, nullptr);
+        THROW_LAST_ERROR_IF(!m_idleTimer);
+    }
+
+    ctsIOPatternUdpBlastReceiver::~ctsIOPatternUdpBlastReceiver() noexcept
+    {
+        PTP_TIMER original_timer = nullptr;
+        auto lock = this->base_lock();
+        // ReSharper disable once CppLocalVariableMayBeConst
+        original_timer = m_idleTimer;
+        m_idleTimer = nullptr;
+        lock.reset();
+
+        SetThreadpoolTimer(original_timer, nullptr, 0, 0);
+        WaitForThreadpoolTimerCallbacks(original_timer, FALSE);
+        CloseThreadpoolTimer(original_timer);
+    }
+
+    ctsIOTask ctsIOPatternUdpBlastReceiver::next_task() noexcept
+    {
+        if (!m_timerStarted)
+        {
+            // check for idle intervals from the first time the object is used
+            m_timerStarted = true;
+            FILETIME file_time(ctTimer::ctConvertMillisToRelativeFiletime(c_UdpBlastIdleIntervalMilliseconds));
+            SetThreadpoolTimer(m_idleTimer, &file_time, c_UdpBlastIdleIntervalMilliseconds, 0);
+        }
+
+        // defaulting to an empty task (do nothing)
+        ctsIOTask return_task;
+        if (m_recvNeeded > 0 && !m_finished)
+        {
+            return_task = this->untracked_task(IOTaskAction::Recv);
+            --m_recvNeeded;
+        }
+        return return_task;
+    }
+
+    ctsIOPatternProtocolError ctsIOPatternUdpBlastReceiver::completed_task(const ctsIOTask& task, unsigned long completed_bytes) noexcept
+    {
+        if (task.ioAction == IOTaskAction::Abort)
+        {
+            // the streams should now be done
+            FAIL_FAST_IF_MSG(
+                !m_finished,
+                "ctsIOPatternUdpBlastReceiver (dt %p ctsTraffic!ctsTraffic::ctsIOPatternUdpBlastReceiver) processed an Abort before the streams were finished", this);
+            return ctsIOPatternProtocolError::SuccessfullyCompleted;
+        }
+
+        if (task.ioAction != IOTaskAction::Recv)
+        {
+            return ctsIOPatternProtocolError::NoError;
+        }
+
+        if (m_finished)
+        {
+            // recvs completing while the socket is closed once the streams finished are not counted
+            return ctsIOPatternProtocolError::NoError;
+        }
+        // since a recv completed, will need to request another
+        ++m_recvNeeded;
+
+        const long long current_time_ms = ctTimer::ctSnapQpcInMillis();
+        ctsUdpBlastSequenceTracker::Result result;
+        if (completed_bytes >= UdpBlastHeaderLength)
+        {
+            try
+            {
+                result = m_sequenceTracker.record(ctsUdpBlastHeader::Read(task.buffer + task.buffer_offset));
+            }
+            catch (const std::exception& e)
+            {
+                ctsConfig::PrintException(e);
+            }
+        }
+
+        if (!result.valid)
+        {
+            {
+                const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+                ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+            }
+            this->stats.error_frames.increment();
+
+            PrintDebugInfo(L"\t\tctsIOPatternUdpBlastReceiver received a datagram (%lu bytes) without a valid UdpBlast header\n", completed_bytes);
+            return ctsIOPatternProtocolError::NoError;
+        }
+
+        if (!m_receivedAny)
+        {
+            // the rate is measured from the first datagram received, not from when the receiver started waiting
+            m_receivedAny = true;
+            this->stats.start_time.set(current_time_ms);
+        }
+        m_receivedThisInterval = true;
+        m_lastDatagramMilliseconds = current_time_ms;
+
+        const long long received_bits = static_cast<long long>(completed_bytes) * 8LL;
+        {
+            const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+            ctsConfig::Settings->UdpStatusDetails.bits_received.add(received_bits);
+            ctsConfig::Settings->UdpStatusDetails.successful_frames.increment();
+            ctsConfig::Settings->UdpStatusDetails.dropped_frames.add(result.dropped_change);
+            if (result.late)
+            {
+                ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
+            }
+        }
+        this->stats.bits_received.add(received_bits);
+        this->stats.successful_frames.increment();
+        this->stats.dropped_frames.add(result.dropped_change);
+        if (result.late)
+        {
+            this->stats.duplicate_frames.increment();
+        }
+
+        return ctsIOPatternProtocolError::NoError;
+    }
+
+    VOID CALLBACK ctsIOPatternUdpBlastReceiver::IdleTimerCallback(PTP_CALLBACK_INSTANCE, _In_ PVOID context, PTP_TIMER) noexcept
+    {
+        auto* this_ptr = static_cast<ctsIOPatternUdpBlastReceiver*>(context);
+        // take the base lock before touching any internal members
+        const auto lock = this_ptr->base_lock();
+
+        if (nullptr == this_ptr->m_idleTimer || this_ptr->m_finished)
+        {
+            return;
+        }
+
+        if (!this_ptr->m_receivedAny || this_ptr->m_receivedThisInterval)
+        {
+            // still waiting for the first datagram, or the datagrams are still arriving
+            this_ptr->m_receivedThisInterval = false;
+            return;
+        }
+
+        this_ptr->m_finished = true;
+        SetThreadpoolTimer(this_ptr->m_idleTimer, nullptr, 0, 0);
+
+        // every datagram never received at the tail of a stream is now known to be dropped
+        const long long tail_dropped = this_ptr->m_sequenceTracker.finish();
+        {
+            const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+            ctsConfig::Settings->UdpStatusDetails.dropped_frames.add(tail_dropped);
+        }
+        this_ptr->stats.dropped_frames.add(tail_dropped);
+        // the idle interval is not part of the rate
+        this_ptr->stats.end_time.set_conditionally(this_ptr->m_lastDatagramMilliseconds, 0LL);
+
+        PrintDebugInfo(
+            L"\t\tctsIOPatternUdpBlastReceiver - no datagrams received for %lu ms: completing (%lld datagrams never received at the tail)\n",
+            c_UdpBlastIdleIntervalMilliseconds,
+            tail_dropped);
+
+        ctsIOTask abort_task;
+        abort_task.ioAction = IOTaskAction::Abort;
+        this_ptr->send_callback(abort_task);
+    }
+} //namespace
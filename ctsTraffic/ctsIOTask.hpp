@@ -17,6 +17,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // ReSharper disable once CppUnusedIncludeDirective
 #include <WinSock2.h>
 #include <MSWSock.h>
+#include <mstcpip.h>
 
 // ** NOTE ** should not include any local project cts headers - to avoid circular references
 
@@ -35,6 +36,44 @@ namespace ctsTraffic
         FatalAbort
     };
 
+    // (optional) WSARecvMsg storage for a recv that also returns the datagram's control data
+    // - owned by the IO pattern: it must stay valid until the recv completes
+    // - the control buffer holds the SO_TIMESTAMP message of SIO_TIMESTAMPING receive timestamps
+    struct ctsRecvMessage
+    {
+        WSAMSG message{};
+        WSABUF buffer{};
+        alignas(WSACMSGHDR) char control[WSA_CMSG_SPACE(sizeof(UINT64))]{};
+
+        // describes the single buffer the datagram is received into
+        WSAMSG* prepare(const WSABUF& _buffer) noexcept
+        {
+            buffer = _buffer;
+            message = {};
+            message.lpBuffers = &buffer;
+            message.dwBufferCount = 1;
+            message.Control.buf = control;
+            message.Control.len = static_cast<ULONG>(sizeof control);
+            return &message;
+        }
+
+        // the receive timestamp of the completed recv, if the stack returned one
+        // - software timestamps are QueryPerformanceCounter values
+        bool receive_timestamp(_Out_ UINT64& _timestamp) noexcept
+        {
+            _timestamp = 0;
+            for (auto* cmsg = WSA_CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = WSA_CMSG_NXTHDR(&message, cmsg))
+            {
+                if (SOL_SOCKET == cmsg->cmsg_level && SO_TIMESTAMP == cmsg->cmsg_type)
+                {
+                    memcpy_s(&_timestamp, sizeof _timestamp, WSA_CMSG_DATA(cmsg), sizeof _timestamp);
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
     struct ctsIOTask
     {
         long long time_offset_milliseconds = 0LL;
@@ -46,6 +85,17 @@ namespace ctsTraffic
         unsigned long expected_pattern_offset = 0UL;
         IOTaskAction ioAction = IOTaskAction::None;
 
+        // (optional) scatter/gather list for a single send or recv
+        // - when buffer_segment_count is zero, the IO is the one buffer at buffer + buffer_offset
+        // - otherwise the IO is buffer_segments[0 .. buffer_segment_count), in order,
+        //   and buffer_length is the total length of all segments
+        static constexpr unsigned long MaxBufferSegments = 4;
+        WSABUF buffer_segments[MaxBufferSegments]{};
+        unsigned long buffer_segment_count = 0UL;
+
+        // (optional) a recv is issued with WSARecvMsg into recv_message when set
+        ctsRecvMessage* recv_message = nullptr;
+
         // (internal) flag identifying the type of buffer
         enum class BufferType
         {
@@ -58,6 +108,24 @@ namespace ctsTraffic
         // (internal) flag if this IO request is tracked and verified
         bool track_io = false;
 
+        // fills in the WSABUF array describing this IO
+        // - returns the number of WSABUFs to pass to WSASend/WSARecv
+        unsigned long fill_wsabufs(_Out_writes_to_(MaxBufferSegments, return) WSABUF* _wsabufs) const noexcept
+        {
+            if (0 == buffer_segment_count)
+            {
+                _wsabufs[0].buf = buffer + buffer_offset;
+                _wsabufs[0].len = buffer_length;
+                return 1;
+            }
+
+            for (unsigned long segment = 0; segment < buffer_segment_count; ++segment)
+            {
+                _wsabufs[segment] = buffer_segments[segment];
+            }
+            return buffer_segment_count;
+        }
+
         static PCWSTR PrintIOAction(const IOTaskAction& _action) noexcept
         {
             switch (_action)
@@ -0,0 +1,206 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <vector>
+// os headers
+#include <Windows.h>
+// wil headers
+#include <wil/resource.h>
+
+namespace ctsTraffic
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Binary jitter capture format (-JitterFilename:<name>.bin)
+    ///
+    /// The file is an array of fixed-size 40-byte slots:
+    /// - slot 0 is the ctsJitterCaptureHeader
+    /// - every following slot is one ctsJitterCaptureRecord, in the order frames were rendered
+    ///
+    /// Records from different connections are interleaved; stream_id identifies the connection
+    /// - stream_id values start at 1: a zeroed slot was reserved but never written
+    /// - dropped frames are recorded with only the stream_id and sequence_number set
+    ///
+    /// ctsJitter.exe converts a capture back into the -JitterFilename csv format
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    constexpr unsigned long c_JitterCaptureMagic = 0x4a535443; // "CTSJ"
+    constexpr unsigned long c_JitterCaptureVersion = 1;
+
+#pragma pack(push, 1)
+    struct ctsJitterCaptureHeader
+    {
+        unsigned long magic;
+        unsigned long version;
+        unsigned long record_size;
+        unsigned long reserved;
+        long long receiver_qpf;
+        long long reserved_for_future[2];
+    };
+
+    struct ctsJitterCaptureRecord
+    {
+        unsigned long stream_id;
+        unsigned long bytes_received;
+        long long sequence_number;
+        long long sender_qpc;
+        long long sender_qpf;
+        long long receiver_qpc;
+    };
+#pragma pack(pop)
+    static_assert(sizeof(ctsJitterCaptureHeader) == sizeof(ctsJitterCaptureRecord), "the capture header must occupy exactly one record slot");
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsJitterCaptureFile
+    ///
+    /// Append-only writer for the binary jitter capture
+    /// - writers reserve a slot with an interlocked increment and copy the record straight into a mapped view
+    /// - the file is mapped in fixed-size chunks which stay mapped until the capture is closed
+    /// - the shared lock protects only the chunk list; it is taken exclusive only to map a new chunk
+    /// - the destructor unmaps every chunk and truncates the file to the slots actually reserved
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsJitterCaptureFile
+    {
+    public:
+        // a multiple of both the allocation granularity (64KB) and the record size (40 bytes)
+        static constexpr unsigned long ChunkSizeBytes = 5UL * 65536UL * 16UL;
+        static constexpr long long RecordsPerChunk = ChunkSizeBytes / sizeof(ctsJitterCaptureRecord);
+
+        explicit ctsJitterCaptureFile(_In_ PCWSTR _file_name)
+        {
+            file.reset(::CreateFileW(
+                _file_name,
+                GENERIC_READ | GENERIC_WRITE,
+                FILE_SHARE_READ,
+                nullptr,
+                CREATE_ALWAYS,
+                FILE_ATTRIBUTE_NORMAL,
+                nullptr));
+            THROW_LAST_ERROR_IF(!file);
+
+            LARGE_INTEGER qpf{};
+            ::QueryPerformanceFrequency(&qpf);
+
+            // slot 0 holds the header, so the first chunk must be mapped up-front
+            const auto lock = chunk_lock.lock_exclusive();
+            THROW_LAST_ERROR_IF(!map_next_chunk());
+            auto* const header = reinterpret_cast<ctsJitterCaptureHeader*>(chunks[0].get());
+            header->magic = c_JitterCaptureMagic;
+            header->version = c_JitterCaptureVersion;
+            header->record_size = static_cast<unsigned long>(sizeof(ctsJitterCaptureRecord));
+            header->receiver_qpf = qpf.QuadPart;
+        }
+
+        ~ctsJitterCaptureFile() noexcept
+        {
+            const auto lock = chunk_lock.lock_exclusive();
+            const auto mapped_slots = static_cast<long long>(chunks.size()) * RecordsPerChunk;
+            const auto reserved_slots = next_slot < mapped_slots ? next_slot : mapped_slots;
+            chunks.clear();
+
+            LARGE_INTEGER end_of_file{};
+            end_of_file.QuadPart = reserved_slots * static_cast<long long>(sizeof(ctsJitterCaptureRecord));
+            LOG_IF_WIN32_BOOL_FALSE(::SetFilePointerEx(file.get(), end_of_file, nullptr, FILE_BEGIN));
+            LOG_IF_WIN32_BOOL_FALSE(::SetEndOfFile(file.get()));
+        }
+
+        void write(const ctsJitterCaptureRecord& _record) noexcept
+        {
+            const long long slot = ::InterlockedIncrement64(&next_slot) - 1;
+            const auto chunk = static_cast<size_t>(slot / RecordsPerChunk);
+            const auto offset = static_cast<size_t>(slot % RecordsPerChunk);
+            {
+                const auto lock = chunk_lock.lock_shared();
+                if (chunk < chunks.size())
+                {
+                    chunks[chunk].get()[offset] = _record;
+                    return;
+                }
+            }
+
+            const auto lock = chunk_lock.lock_exclusive();
+            while (!failed && chunk >= chunks.size())
+            {
+                failed = !map_next_chunk();
+            }
+            if (failed)
+            {
+                ::InterlockedIncrement64(&dropped_records);
+                return;
+            }
+            chunks[chunk].get()[offset] = _record;
+        }
+
+        [[nodiscard]] long long dropped_record_count() const noexcept
+        {
+            return ::InterlockedCompareExchange64(const_cast<long long*>(&dropped_records), 0LL, 0LL);
+        }
+
+        ctsJitterCaptureFile(const ctsJitterCaptureFile&) = delete;
+        ctsJitterCaptureFile& operator=(const ctsJitterCaptureFile&) = delete;
+        ctsJitterCaptureFile(ctsJitterCaptureFile&&) = delete;
+        ctsJitterCaptureFile& operator=(ctsJitterCaptureFile&&) = delete;
+
+    private:
+        wil::unique_hfile file;
+        wil::srwlock chunk_lock;
+        _Guarded_by_(chunk_lock) std::vector<wil::unique_mapview_ptr<ctsJitterCaptureRecord>> chunks;
+        _Guarded_by_(chunk_lock) bool failed = false;
+        // slot 0 is the header
+        long long next_slot = 1;
+        long long dropped_records = 0;
+
+        // extending the mapping grows the file to the end of the new chunk
+        _Requires_exclusive_lock_held_(chunk_lock)
+        bool map_next_chunk() noexcept
+        try
+        {
+            const auto chunk_offset = static_cast<unsigned long long>(chunks.size()) * ChunkSizeBytes;
+            const auto mapping_size = chunk_offset + ChunkSizeBytes;
+            const wil::unique_handle mapping(::CreateFileMappingW(
+                file.get(),
+                nullptr,
+                PAGE_READWRITE,
+                static_cast<DWORD>(mapping_size >> 32),
+                static_cast<DWORD>(mapping_size),
+                nullptr));
+            if (!mapping)
+            {
+                return false;
+            }
+
+            // the view keeps its own reference on the mapping object
+            wil::unique_mapview_ptr<ctsJitterCaptureRecord> view(static_cast<ctsJitterCaptureRecord*>(::MapViewOfFile(
+                mapping.get(),
+                FILE_MAP_WRITE,
+                static_cast<DWORD>(chunk_offset >> 32),
+                static_cast<DWORD>(chunk_offset),
+                ChunkSizeBytes)));
+            if (!view)
+            {
+                return false;
+            }
+            chunks.emplace_back(std::move(view));
+            return true;
+        }
+        catch (...)
+        {
+            return false;
+        }
+    };
+}
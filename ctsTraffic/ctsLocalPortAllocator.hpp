@@ -0,0 +1,208 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <deque>
+#include <memory>
+// os headers
+#include <Windows.h>
+// wil headers
+#include <wil/resource.h>
+// ctl headers
+#include <ctTimer.hpp>
+#include <ctMemoryGuard.hpp>
+// project headers
+#include "ctsStatistics.hpp"
+
+namespace ctsTraffic
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsLocalPortAllocator
+    ///
+    /// Hands out local ports from the -LocalPort range, separately for each bind address
+    /// - every port of the range is either leased to exactly one socket or queued as free
+    /// - free ports are kept in per-processor shards so concurrent sockets rarely share a lock
+    ///   an empty shard takes a port from the other shards of the same bind address
+    ///
+    /// Ports are returned when their socket is closed, and are not handed out again until
+    /// - _reuse_delay_ms has passed : the time the closed connection is expected to be held in TIME_WAIT
+    /// - _conflict_delay_ms has passed if bind failed with WSAEADDRINUSE
+    /// Each shard keeps two FIFO queues, one for each delay, so the port at the front of each queue is the next to be ready
+    /// - a port waiting out a bind conflict never hides ports behind it which are already done waiting
+    /// - if every free port is still waiting, the port which will be ready soonest is handed out rather than failing
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsLocalPortAllocator
+    {
+    public:
+        // must be a power of 2 - matching ctStatsShardedTracking
+        static constexpr unsigned long MaxShardCount = 64;
+
+        ctsLocalPortAllocator(
+            unsigned short _low_port,
+            unsigned short _high_port,
+            size_t _address_count,
+            unsigned long _reuse_delay_ms,
+            unsigned long _conflict_delay_ms) :
+            address_count(_address_count),
+            reuse_delay_ms(_reuse_delay_ms),
+            conflict_delay_ms(_conflict_delay_ms)
+        {
+            const unsigned long port_count = static_cast<unsigned long>(_high_port) - _low_port + 1UL;
+            const unsigned long processor_count = ::GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+            while (shard_count * 2 <= MaxShardCount && shard_count * 2 <= processor_count && shard_count * 2 <= port_count)
+            {
+                shard_count *= 2;
+            }
+
+            shards = std::make_unique<Shard[]>(address_count * shard_count);
+            for (size_t address_index = 0; address_index < address_count; ++address_index)
+            {
+                for (unsigned long port = _low_port; port <= _high_port; ++port)
+                {
+                    shards[address_index * shard_count + (port & (shard_count - 1))].free_ports.push_back({ 0LL, static_cast<unsigned short>(port) });
+                }
+            }
+        }
+
+        //
+        // Returns false only if every port for the address is currently leased
+        //
+        bool acquire(size_t _address_index, _Out_ unsigned short& _port) noexcept
+        {
+            _port = 0;
+            const auto now = ctl::ctTimer::ctSnapQpcInMillis();
+            const auto home_shard = ctsStatistics::CurrentProcessorIndex();
+            Shard* const address_shards = &shards[_address_index * shard_count];
+
+            // the first pass only takes ports which are done waiting: the second takes any free port
+            for (auto pass = 0; pass < 2; ++pass)
+            {
+                for (unsigned long offset = 0; offset < shard_count; ++offset)
+                {
+                    Shard& shard = address_shards[(home_shard + offset) & (shard_count - 1)];
+                    const auto lock = shard.lock.lock_exclusive();
+                    std::deque<FreePort>* const ports = shard.next_ports();
+                    if (ports != nullptr && (pass > 0 || ports->front().available_after_ms <= now))
+                    {
+                        _port = ports->front().port;
+                        ports->pop_front();
+                        if (pass > 0)
+                        {
+                            ctl::ctMemoryGuardIncrement(&early_reuse_count);
+                        }
+                        ctl::ctMemoryGuardIncrement(&acquired_count);
+                        return true;
+                    }
+                }
+            }
+
+            ctl::ctMemoryGuardIncrement(&exhausted_count);
+            return false;
+        }
+
+        //
+        // _bind_conflict indicates bind failed with WSAEADDRINUSE on this port
+        //
+        void release(size_t _address_index, unsigned short _port, bool _bind_conflict) noexcept
+        try
+        {
+            if (_bind_conflict)
+            {
+                ctl::ctMemoryGuardIncrement(&conflict_count);
+            }
+            const auto available_after_ms = ctl::ctTimer::ctSnapQpcInMillis() + (_bind_conflict ? conflict_delay_ms : reuse_delay_ms);
+
+            Shard& shard = shards[_address_index * shard_count + (ctsStatistics::CurrentProcessorIndex() & (shard_count - 1))];
+            const auto lock = shard.lock.lock_exclusive();
+            (_bind_conflict ? shard.conflict_ports : shard.free_ports).push_back({ available_after_ms, _port });
+        }
+        catch (...)
+        {
+            // failing to allocate the deque block only removes this port from the range
+            ctl::ctMemoryGuardIncrement(&lost_count);
+        }
+
+        [[nodiscard]] long long acquired() const noexcept
+        {
+            return ctl::ctMemoryGuardRead(&acquired_count);
+        }
+        [[nodiscard]] long long conflicts() const noexcept
+        {
+            return ctl::ctMemoryGuardRead(&conflict_count);
+        }
+        [[nodiscard]] long long early_reuses() const noexcept
+        {
+            return ctl::ctMemoryGuardRead(&early_reuse_count);
+        }
+        [[nodiscard]] long long exhausted() const noexcept
+        {
+            return ctl::ctMemoryGuardRead(&exhausted_count);
+        }
+        [[nodiscard]] long long lost() const noexcept
+        {
+            return ctl::ctMemoryGuardRead(&lost_count);
+        }
+
+        ctsLocalPortAllocator(const ctsLocalPortAllocator&) = delete;
+        ctsLocalPortAllocator& operator=(const ctsLocalPortAllocator&) = delete;
+        ctsLocalPortAllocator(ctsLocalPortAllocator&&) = delete;
+        ctsLocalPortAllocator& operator=(ctsLocalPortAllocator&&) = delete;
+
+    private:
+        struct FreePort
+        {
+            long long available_after_ms;
+            unsigned short port;
+        };
+        struct alignas(SYSTEM_CACHE_ALIGNMENT_SIZE) Shard
+        {
+            wil::srwlock lock;
+            // ports released after their socket closed, waiting reuse_delay_ms
+            _Guarded_by_(lock) std::deque<FreePort> free_ports;
+            // ports which failed to bind, waiting conflict_delay_ms
+            _Guarded_by_(lock) std::deque<FreePort> conflict_ports;
+
+            // the queue whose front port is ready soonest, or nullptr if both are empty
+            _Requires_exclusive_lock_held_(lock)
+            std::deque<FreePort>* next_ports() noexcept
+            {
+                if (conflict_ports.empty())
+                {
+                    return free_ports.empty() ? nullptr : &free_ports;
+                }
+                if (free_ports.empty())
+                {
+                    return &conflict_ports;
+                }
+                return conflict_ports.front().available_after_ms < free_ports.front().available_after_ms ? &conflict_ports : &free_ports;
+            }
+        };
+
+        const size_t address_count;
+        const unsigned long reuse_delay_ms;
+        const unsigned long conflict_delay_ms;
+        unsigned long shard_count = 1;
+        // address_count * shard_count shards: the shards for each address are contiguous
+        std::unique_ptr<Shard[]> shards;
+
+        long long acquired_count = 0LL;
+        long long conflict_count = 0LL;
+        long long early_reuse_count = 0LL;
+        long long exhausted_count = 0LL;
+        long long lost_count = 0LL;
+    };
+}
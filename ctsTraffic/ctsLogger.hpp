@@ -14,10 +14,16 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #pragma once
 
 // cpp headers
+#include <algorithm>
+#include <memory>
+#include <vector>
 // os headers
 #include <windows.h>
 // wil headers
 #include <wil/resource.h>
+// ctl headers
+#include <ctMemoryGuard.hpp>
+#include <ctString.hpp>
 // project headers
 #include "ctsConfig.h"
 #include "ctsPrintStatus.hpp"
@@ -89,6 +95,12 @@ namespace ctsTraffic
             return ctsConfig::StatusFormatting::Csv == m_format;
         }
 
+        // the # of messages which could not be logged because the logger fell behind
+        [[nodiscard]] virtual long long DroppedMessageCount() const noexcept
+        {
+            return 0LL;
+        }
+
         // not copyable
         ctsLogger(const ctsLogger&) = delete;
         ctsLogger& operator=(const ctsLogger&) = delete;
@@ -103,11 +115,28 @@ namespace ctsTraffic
         virtual void log_error_impl(_In_ PCWSTR _message) noexcept = 0;
     };
 
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsTextLogger
+    ///
+    /// Writes UTF-16 text to a file without blocking the caller on disk IO
+    /// - each calling thread appends its preformatted message into its own single-producer ring
+    ///   (no locks are taken once a thread has registered its ring with this logger)
+    /// - a dedicated writer thread drains all rings into one large buffer and writes it sequentially
+    /// - if a thread's ring is full the message is dropped and counted rather than blocking IO threads;
+    ///   text files get an inline note of the dropped messages, the total is available from DroppedMessageCount
+    /// - messages from one thread remain in order, messages across threads are ordered by when they were drained
+    /// - a thread's ring is freed once the thread has exited and the writer has drained it,
+    ///   so memory follows the threads currently logging rather than every thread which ever logged
+    /// - the d'tor drains all remaining messages before closing the file
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
     class ctsTextLogger : public ctsLogger
     {
     public:
         ctsTextLogger(_In_ PCWSTR _file_name, ctsConfig::StatusFormatting _format) :
-            ctsLogger(_format)
+            ctsLogger(_format),
+            logger_id(ctl::ctMemoryGuardIncrement(&s_next_logger_id))
         {
             file_handle.reset(CreateFileW(
                 _file_name,
@@ -128,8 +157,26 @@ namespace ctsTraffic
                 static_cast<DWORD>(sizeof WCHAR),
                 &bytesWritten,
                 nullptr));
+
+            write_buffer.resize(c_WriteBufferBytes);
+            wake_event.create(wil::EventOptions::None);
+            shutdown_event.create(wil::EventOptions::ManualReset);
+            writer_thread.reset(CreateThread(nullptr, 0, WriterThreadProc, this, 0, nullptr));
+            THROW_LAST_ERROR_IF_NULL(writer_thread.get());
+        }
+        ~ctsTextLogger() noexcept override
+        {
+            // the writer thread drains every ring before it exits
+            shutdown_event.SetEvent();
+            WaitForSingleObject(writer_thread.get(), INFINITE);
+
+            // threads still caching these rings evict them the next time they look for a ring
+            const auto lock = rings_cs.lock();
+            for (const auto& ring : rings)
+            {
+                ctl::ctMemoryGuardWrite(&ring->logger_closed, 1LL);
+            }
         }
-        ~ctsTextLogger() noexcept = default;
 
         void log_message_impl(_In_ PCWSTR _message) noexcept override
         {
@@ -141,25 +188,287 @@ namespace ctsTraffic
             write_impl(_message);
         }
 
+        [[nodiscard]] long long DroppedMessageCount() const noexcept override
+        {
+            return ctl::ctMemoryGuardRead(&dropped_messages);
+        }
+
         ctsTextLogger(const ctsTextLogger&) = delete;
         ctsTextLogger& operator=(const ctsTextLogger&) = delete;
         ctsTextLogger(ctsTextLogger&&) = delete;
         ctsTextLogger& operator=(ctsTextLogger&&) = delete;
 
     private:
-        wil::critical_section file_cs;
+        static constexpr long long c_RingBytes = 0x40000; // 256KB per thread
+        static constexpr size_t c_WriteBufferBytes = 0x100000; // 1MB per WriteFile
+        static constexpr DWORD c_WriterIntervalMilliseconds = 100;
+        static constexpr unsigned long c_MaxCachedLoggers = 8;
+
+        // single-producer (the owning thread), single-consumer (the writer thread) ring of records
+        // - each record is an unsigned long byte count followed by that many bytes of UTF-16 text
+        // - offsets only ever increase; the position in the buffer is the offset modulo c_RingBytes
+        // - shared by the logger and the owning thread's cache, so either can go away first
+        struct RecordRing
+        {
+            std::vector<char> buffer = std::vector<char>(c_RingBytes);
+            alignas(SYSTEM_CACHE_ALIGNMENT_SIZE) long long write_offset = 0LL;
+            alignas(SYSTEM_CACHE_ALIGNMENT_SIZE) long long read_offset = 0LL;
+            // set by the owning thread as it exits, after its last write
+            long long owner_exited = 0LL;
+            // set by the logger's d'tor, after which the owning thread no longer uses the ring
+            long long logger_closed = 0LL;
+        };
+
+        // each thread caches the ring it registered with each logger, to find it without a lock
+        // - the d'tor runs as the thread exits, releasing its rings to be freed once drained
+        struct ThreadRingCache
+        {
+            struct Entry
+            {
+                long long logger_id = 0LL;
+                std::shared_ptr<RecordRing> ring;
+            };
+            Entry entries[c_MaxCachedLoggers]{};
+
+            ThreadRingCache() noexcept = default;
+            ~ThreadRingCache() noexcept
+            {
+                for (const auto& entry : entries)
+                {
+                    if (entry.ring)
+                    {
+                        ctl::ctMemoryGuardWrite(&entry.ring->owner_exited, 1LL);
+                    }
+                }
+            }
+            ThreadRingCache(const ThreadRingCache&) = delete;
+            ThreadRingCache& operator=(const ThreadRingCache&) = delete;
+            ThreadRingCache(ThreadRingCache&&) = delete;
+            ThreadRingCache& operator=(ThreadRingCache&&) = delete;
+        };
+        static inline thread_local ThreadRingCache t_ring_cache;
+        static inline long long s_next_logger_id = 0LL;
+
+        const long long logger_id;
         wil::unique_hfile file_handle;
+        wil::unique_event wake_event;
+        wil::unique_event shutdown_event;
+        wil::unique_handle writer_thread;
+
+        // guards the list of rings - not taken when logging
+        // - the writer thread only holds it to copy and to prune the list, never while writing to the file
+        wil::critical_section rings_cs;
+        std::vector<std::shared_ptr<RecordRing>> rings;
+
+        long long dropped_messages = 0LL;
+        // only accessed by the writer thread
+        long long reported_dropped_messages = 0LL;
+        std::vector<char> write_buffer;
+        size_t write_buffer_used = 0;
+        std::vector<std::shared_ptr<RecordRing>> draining_rings;
+
+        RecordRing* thread_ring() noexcept
+        {
+            for (const auto& cache_entry : t_ring_cache.entries)
+            {
+                if (cache_entry.logger_id == logger_id)
+                {
+                    return cache_entry.ring.get();
+                }
+            }
+
+            // first message from this thread: register a new ring
+            try
+            {
+                // first evict the rings of loggers which have since been destroyed
+                for (auto& cache_entry : t_ring_cache.entries)
+                {
+                    if (cache_entry.ring && ctl::ctMemoryGuardRead(&cache_entry.ring->logger_closed))
+                    {
+                        cache_entry.logger_id = 0LL;
+                        cache_entry.ring.reset();
+                    }
+                }
+
+                for (auto& cache_entry : t_ring_cache.entries)
+                {
+                    if (0LL == cache_entry.logger_id)
+                    {
+                        auto new_ring = std::make_shared<RecordRing>();
+                        const auto lock = rings_cs.lock();
+                        rings.push_back(new_ring);
+                        cache_entry.logger_id = logger_id;
+                        cache_entry.ring = std::move(new_ring);
+                        return cache_entry.ring.get();
+                    }
+                }
+            }
+            catch (...)
+            {
+            }
+            return nullptr;
+        }
+
+        static void copy_into_ring(RecordRing& _ring, long long _offset, _In_reads_bytes_(_length) const void* _source, size_t _length) noexcept
+        {
+            const auto position = static_cast<size_t>(_offset % c_RingBytes);
+            const auto first_length = (position + _length <= c_RingBytes) ? _length : c_RingBytes - position;
+            memcpy(_ring.buffer.data() + position, _source, first_length);
+            memcpy(_ring.buffer.data(), static_cast<const char*>(_source) + first_length, _length - first_length);
+        }
+
+        static void copy_from_ring(const RecordRing& _ring, long long _offset, _Out_writes_bytes_(_length) void* _destination, size_t _length) noexcept
+        {
+            const auto position = static_cast<size_t>(_offset % c_RingBytes);
+            const auto first_length = (position + _length <= c_RingBytes) ? _length : c_RingBytes - position;
+            memcpy(_destination, _ring.buffer.data() + position, first_length);
+            memcpy(static_cast<char*>(_destination) + first_length, _ring.buffer.data(), _length - first_length);
+        }
 
         void write_impl(_In_ PCWSTR _message) noexcept
         {
-            const auto lock = file_cs.lock();
-            DWORD bytesWritten{};
-            THROW_LAST_ERROR_IF(!WriteFile(
-                file_handle.get(),
-                _message,
-                static_cast<DWORD>(wcslen(_message) * sizeof(WCHAR)),
-                &bytesWritten,
-                nullptr));
+            const auto message_bytes = static_cast<unsigned long>(wcslen(_message) * sizeof(WCHAR));
+            const long long record_bytes = sizeof(unsigned long) + message_bytes;
+
+            RecordRing* const ring = thread_ring();
+            if (!ring || record_bytes > c_RingBytes)
+            {
+                ctl::ctMemoryGuardIncrement(&dropped_messages);
+                return;
+            }
+
+            // only this thread writes write_offset
+            const long long write_offset = ring->write_offset;
+            const long long used_bytes = write_offset - ctl::ctMemoryGuardRead(&ring->read_offset);
+            if (used_bytes + record_bytes > c_RingBytes)
+            {
+                ctl::ctMemoryGuardIncrement(&dropped_messages);
+                wake_event.SetEvent();
+                return;
+            }
+
+            copy_into_ring(*ring, write_offset, &message_bytes, sizeof message_bytes);
+            copy_into_ring(*ring, write_offset + sizeof message_bytes, _message, message_bytes);
+            // publish the record to the writer thread
+            ctl::ctMemoryGuardWrite(&ring->write_offset, write_offset + record_bytes);
+
+            // wake the writer early if this ring is filling up
+            if (used_bytes < c_RingBytes / 2 && used_bytes + record_bytes >= c_RingBytes / 2)
+            {
+                wake_event.SetEvent();
+            }
+        }
+
+        void append_to_write_buffer(_In_reads_bytes_(_length) const void* _source, size_t _length) noexcept
+        {
+            if (write_buffer_used + _length > write_buffer.size())
+            {
+                flush_write_buffer();
+            }
+            memcpy(write_buffer.data() + write_buffer_used, _source, _length);
+            write_buffer_used += _length;
+        }
+
+        void flush_write_buffer() noexcept
+        {
+            if (write_buffer_used > 0)
+            {
+                DWORD bytes_written{};
+                // logging failures are not fatal - the text is lost as it would have been on a failed synchronous write
+                LOG_IF_WIN32_BOOL_FALSE(WriteFile(
+                    file_handle.get(),
+                    write_buffer.data(),
+                    static_cast<DWORD>(write_buffer_used),
+                    &bytes_written,
+                    nullptr));
+                write_buffer_used = 0;
+            }
+        }
+
+        void drain_rings() noexcept
+        {
+            // drain a copy of the list, so threads registering a ring don't wait on the file
+            {
+                const auto lock = rings_cs.lock();
+                try
+                {
+                    draining_rings = rings;
+                }
+                catch (...)
+                {
+                    // try again on the next interval
+                    draining_rings.clear();
+                }
+            }
+
+            for (const auto& ring : draining_rings)
+            {
+                // only this thread writes read_offset
+                long long read_offset = ring->read_offset;
+                const long long write_offset = ctl::ctMemoryGuardRead(&ring->write_offset);
+                while (read_offset < write_offset)
+                {
+                    unsigned long message_bytes{};
+                    copy_from_ring(*ring, read_offset, &message_bytes, sizeof message_bytes);
+                    read_offset += sizeof message_bytes;
+
+                    if (write_buffer_used + message_bytes > write_buffer.size())
+                    {
+                        flush_write_buffer();
+                    }
+                    copy_from_ring(*ring, read_offset, write_buffer.data() + write_buffer_used, message_bytes);
+                    write_buffer_used += message_bytes;
+                    read_offset += message_bytes;
+                }
+                // release the space back to the producing thread
+                ctl::ctMemoryGuardWrite(&ring->read_offset, read_offset);
+            }
+            draining_rings.clear();
+
+            // free the rings of exited threads once everything they wrote has been drained
+            // - owner_exited is set after the thread's last write, so the write_offset read after it is final
+            {
+                const auto lock = rings_cs.lock();
+                rings.erase(
+                    std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<RecordRing>& _ring) noexcept {
+                        return ctl::ctMemoryGuardRead(&_ring->owner_exited) &&
+                            ctl::ctMemoryGuardRead(&_ring->write_offset) == _ring->read_offset;
+                    }),
+                    rings.end());
+            }
+
+            const auto dropped = ctl::ctMemoryGuardRead(&dropped_messages);
+            if (dropped != reported_dropped_messages && !IsCsvFormat())
+            {
+                try
+                {
+                    const auto note = ctl::ctString::ctFormatString(
+                        L"** %lld log messages were dropped : the log writer fell behind **\r\n",
+                        dropped - reported_dropped_messages);
+                    append_to_write_buffer(note.c_str(), note.size() * sizeof(WCHAR));
+                }
+                catch (...)
+                {
+                }
+            }
+            reported_dropped_messages = dropped;
+
+            flush_write_buffer();
+        }
+
+        static DWORD WINAPI WriterThreadProc(LPVOID _context) noexcept
+        {
+            auto* const this_ptr = static_cast<ctsTextLogger*>(_context);
+            for (;;)
+            {
+                HANDLE wait_handles[]{ this_ptr->shutdown_event.get(), this_ptr->wake_event.get() };
+                const auto wait = WaitForMultipleObjects(2, wait_handles, FALSE, c_WriterIntervalMilliseconds);
+                this_ptr->drain_rings();
+                if (WAIT_OBJECT_0 == wait)
+                {
+                    return 0;
+                }
+            }
         }
     };
 
@@ -72,8 +72,8 @@ namespace ctsTraffic
         {
             return;
         }
-        // hold a reference on the iopattern
-        auto shared_pattern(shared_socket->io_pattern());
+        // the iopattern lives as long as the ctsSocket
+        const auto& shared_pattern(shared_socket->io_pattern());
 
         // always register our ctsIOPattern callback since it's necessary for this IO Pattern
         // this callback can be invoked out-of-band directly from the IO Pattern class
@@ -264,8 +264,8 @@ namespace ctsTraffic
                     // - or the IO failed
                     if (result.error_code != 0) PrintDebugInfo(L"\t\tIO Failed: %hs (%d) [ctsMediaStreamClient]\n", function_name, result.error_code);
 
-                    // hold a reference on the iopattern
-                    auto shared_pattern(_shared_socket->io_pattern());
+                    // the iopattern lives as long as the ctsSocket
+                    const auto& shared_pattern(_shared_socket->io_pattern());
                     const auto protocol_status = shared_pattern->complete_io(
                         _next_io,
                         result.bytes_transferred,
@@ -322,7 +322,7 @@ namespace ctsTraffic
             case IOTaskAction::Abort:
             {
                 // the protocol signaled to immediately stop the stream
-                auto shared_pattern(_shared_socket->io_pattern());
+                const auto& shared_pattern(_shared_socket->io_pattern());
                 shared_pattern->complete_io(_next_io, 0, 0);
                 _shared_socket->close_socket();
 
@@ -334,7 +334,7 @@ namespace ctsTraffic
             case IOTaskAction::FatalAbort:
             {
                 // the protocol indicated to rudely abort the connection
-                auto shared_pattern(_shared_socket->io_pattern());
+                const auto& shared_pattern(_shared_socket->io_pattern());
                 shared_pattern->complete_io(_next_io, 0, 0);
                 _shared_socket->close_socket();
 
@@ -391,8 +391,8 @@ namespace ctsTraffic
             }
         }
 
-        // hold a reference on the iopattern
-        auto shared_pattern(shared_socket->io_pattern());
+        // the iopattern lives as long as the ctsSocket
+        const auto& shared_pattern(shared_socket->io_pattern());
         // see if complete_io requests more IO
         const ctsIOStatus protocol_status = shared_pattern->complete_io(_io_task, transferred, gle);
         switch (protocol_status)
@@ -0,0 +1,367 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <algorithm>
+#include <array>
+#include <vector>
+// os headers
+#include <Windows.h>
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#endif
+
+namespace ctsTraffic
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsMediaStreamFec
+    ///
+    /// The XOR parity layout for -Recovery:fec:<N>,<K>
+    /// - the data datagrams of a frame are split into groups of N (the last group can be smaller)
+    /// - each group is followed by K parity datagrams (or one per datagram if the group is smaller than K)
+    /// - parity datagram j of a group is the XOR of the group's datagrams j, j + K, j + 2K, ...
+    ///   so each parity datagram can rebuild any one datagram of its stripe,
+    ///   and a burst of up to K consecutive lost datagrams in a group can be rebuilt
+    ///
+    /// Each parity datagram's payload starts with ParityHeaderLength bytes:
+    /// - the number of data datagrams in its stripe (16 bits)
+    /// - the XOR of their payload lengths (16 bits), giving the length of the datagram rebuilt
+    /// followed by the XOR of the stripe's payloads, each zero-padded to the longest
+    ///
+    /// Parity indexes are numbered across the frame: group * K + stripe
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsMediaStreamFec
+    {
+    public:
+        static constexpr unsigned long ParityHeaderLength = 4;
+        static constexpr unsigned long ParityMemberCountOffset = 0;
+        static constexpr unsigned long ParityLengthXorOffset = 2;
+
+        //
+        // XORs _length bytes of _source into _target
+        // - uses SSE2 on x86 and x64, which every processor running Windows on those architectures supports
+        //
+        static void XorInto(
+            _Inout_updates_bytes_(_length) char* _target,
+            _In_reads_bytes_(_length) const char* _source,
+            size_t _length) noexcept
+        {
+            size_t offset = 0;
+#if defined(_M_X64) || defined(_M_IX86)
+            for (; offset + 4 * sizeof(__m128i) <= _length; offset += 4 * sizeof(__m128i))
+            {
+                auto* const target = reinterpret_cast<__m128i*>(_target + offset);
+                const auto* const source = reinterpret_cast<const __m128i*>(_source + offset);
+                const __m128i xor0 = _mm_xor_si128(_mm_loadu_si128(target), _mm_loadu_si128(source));
+                const __m128i xor1 = _mm_xor_si128(_mm_loadu_si128(target + 1), _mm_loadu_si128(source + 1));
+                const __m128i xor2 = _mm_xor_si128(_mm_loadu_si128(target + 2), _mm_loadu_si128(source + 2));
+                const __m128i xor3 = _mm_xor_si128(_mm_loadu_si128(target + 3), _mm_loadu_si128(source + 3));
+                _mm_storeu_si128(target, xor0);
+                _mm_storeu_si128(target + 1, xor1);
+                _mm_storeu_si128(target + 2, xor2);
+                _mm_storeu_si128(target + 3, xor3);
+            }
+            for (; offset + sizeof(__m128i) <= _length; offset += sizeof(__m128i))
+            {
+                auto* const target = reinterpret_cast<__m128i*>(_target + offset);
+                _mm_storeu_si128(target, _mm_xor_si128(_mm_loadu_si128(target), _mm_loadu_si128(reinterpret_cast<const __m128i*>(_source + offset))));
+            }
+#else
+            for (; offset + sizeof(unsigned long long) <= _length; offset += sizeof(unsigned long long))
+            {
+                unsigned long long target;
+                unsigned long long source;
+                ::memcpy(&target, _target + offset, sizeof target);
+                ::memcpy(&source, _source + offset, sizeof source);
+                target ^= source;
+                ::memcpy(_target + offset, &target, sizeof target);
+            }
+#endif
+            for (; offset < _length; ++offset)
+            {
+                _target[offset] ^= _source[offset];
+            }
+        }
+
+        //
+        // The number of parity datagrams sent for a frame of _datagram_count data datagrams
+        //
+        static unsigned long ParityCount(unsigned long _datagram_count, unsigned long _data_per_group, unsigned long _parity_per_group) noexcept
+        {
+            const unsigned long last_group_size = _datagram_count % _data_per_group;
+            return _datagram_count / _data_per_group * _parity_per_group +
+                (last_group_size < _parity_per_group ? last_group_size : _parity_per_group);
+        }
+
+        //
+        // The parity datagram protecting the data datagram at _datagram_index
+        //
+        static unsigned long ParityIndex(unsigned long _datagram_index, unsigned long _data_per_group, unsigned long _parity_per_group) noexcept
+        {
+            return _datagram_index / _data_per_group * _parity_per_group + _datagram_index % _data_per_group % _parity_per_group;
+        }
+
+        //
+        // The data datagrams protected by a parity datagram are
+        // FirstMember, FirstMember + _parity_per_group, ... for MemberCount datagrams
+        //
+        static unsigned long FirstMember(unsigned long _parity_index, unsigned long _data_per_group, unsigned long _parity_per_group) noexcept
+        {
+            return _parity_index / _parity_per_group * _data_per_group + _parity_index % _parity_per_group;
+        }
+
+        static unsigned long MemberCount(unsigned long _parity_index, unsigned long _datagram_count, unsigned long _data_per_group, unsigned long _parity_per_group) noexcept
+        {
+            const unsigned long first_member = FirstMember(_parity_index, _data_per_group, _parity_per_group);
+            unsigned long group_end = (_parity_index / _parity_per_group + 1) * _data_per_group;
+            if (group_end > _datagram_count)
+            {
+                group_end = _datagram_count;
+            }
+            return first_member < group_end ? (group_end - first_member + _parity_per_group - 1) / _parity_per_group : 0;
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsMediaStreamFecDecoder
+    ///
+    /// Rebuilds data datagrams lost from a frame from the parity datagrams sent with -Recovery:fec
+    /// - every datagram received is XORed into the running parity of its stripe as it arrives,
+    ///   so once a stripe's parity and all but one of its datagrams have arrived,
+    ///   the running parity is the missing datagram's payload
+    /// - the frames being decoded are kept in FrameSlots slots by sequence number:
+    ///   datagrams for a frame older than its slot are no longer decoded
+    ///
+    /// Both calls return the bytes to count toward the frame:
+    /// - the datagram itself (a parity datagram is never counted toward the frame)
+    /// - plus a datagram rebuilt from it, counted with its header
+    /// - a datagram arriving after it was rebuilt is not counted again
+    ///
+    /// Not thread-safe: the caller serializes access
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsMediaStreamFecDecoder
+    {
+    public:
+        // datagrams of consecutive frames are sent one frame after the other:
+        // only a frame still completing while the next begins needs its own slot
+        static constexpr unsigned long FrameSlots = 2;
+
+        ctsMediaStreamFecDecoder(
+            unsigned long _data_per_group,
+            unsigned long _parity_per_group,
+            unsigned long _max_datagrams,
+            unsigned long _max_payload_length,
+            unsigned long _header_length) :
+            data_per_group(_data_per_group),
+            parity_per_group(_parity_per_group),
+            max_datagrams(_max_datagrams),
+            max_parity(ctsMediaStreamFec::ParityCount(_max_datagrams, _data_per_group, _parity_per_group)),
+            max_payload_length(_max_payload_length),
+            header_length(_header_length)
+        {
+            for (auto& frame : frames)
+            {
+                frame.datagram_state.resize(max_datagrams);
+                frame.stripes.resize(max_parity);
+                frame.accumulators.resize(static_cast<size_t>(max_parity) * max_payload_length);
+            }
+        }
+        ~ctsMediaStreamFecDecoder() = default;
+
+        ctsMediaStreamFecDecoder(const ctsMediaStreamFecDecoder&) = delete;
+        ctsMediaStreamFecDecoder& operator=(const ctsMediaStreamFecDecoder&) = delete;
+        ctsMediaStreamFecDecoder(ctsMediaStreamFecDecoder&&) = delete;
+        ctsMediaStreamFecDecoder& operator=(ctsMediaStreamFecDecoder&&) = delete;
+
+        unsigned long data_received(
+            long long _sequence_number,
+            unsigned long _datagram_index,
+            _In_reads_bytes_(_payload_length) const char* _payload,
+            unsigned long _payload_length) noexcept
+        {
+            const unsigned long datagram_bytes = _payload_length + header_length;
+            Frame* const frame = frame_for(_sequence_number);
+            if (!frame || _datagram_index >= max_datagrams || _payload_length > max_payload_length)
+            {
+                return datagram_bytes;
+            }
+
+            auto& datagram_state = frame->datagram_state[_datagram_index];
+            if (DatagramState::Recovered == datagram_state)
+            {
+                return 0;
+            }
+            if (DatagramState::Received == datagram_state)
+            {
+                // a duplicate is still counted, so the frame is seen as duplicated
+                return datagram_bytes;
+            }
+            datagram_state = DatagramState::Received;
+
+            const unsigned long parity_index = ctsMediaStreamFec::ParityIndex(_datagram_index, data_per_group, parity_per_group);
+            if (parity_index >= max_parity)
+            {
+                return datagram_bytes;
+            }
+            auto& stripe = frame->stripes[parity_index];
+            ++stripe.received_members;
+            stripe.length_xor ^= static_cast<unsigned short>(_payload_length);
+            accumulate(*frame, parity_index, _payload, _payload_length);
+            return datagram_bytes + try_recover(*frame, parity_index);
+        }
+
+        unsigned long parity_received(
+            long long _sequence_number,
+            unsigned long _parity_index,
+            _In_reads_bytes_(_parity_length) const char* _parity,
+            unsigned long _parity_length) noexcept
+        {
+            Frame* const frame = frame_for(_sequence_number);
+            if (!frame ||
+                _parity_index >= max_parity ||
+                _parity_length < ctsMediaStreamFec::ParityHeaderLength ||
+                _parity_length - ctsMediaStreamFec::ParityHeaderLength > max_payload_length)
+            {
+                return 0;
+            }
+
+            auto& stripe = frame->stripes[_parity_index];
+            if (stripe.parity_received)
+            {
+                return 0;
+            }
+            unsigned short member_count;
+            unsigned short length_xor;
+            ::memcpy(&member_count, _parity + ctsMediaStreamFec::ParityMemberCountOffset, sizeof member_count);
+            ::memcpy(&length_xor, _parity + ctsMediaStreamFec::ParityLengthXorOffset, sizeof length_xor);
+            if (0 == member_count || member_count > data_per_group)
+            {
+                return 0;
+            }
+
+            stripe.parity_received = true;
+            stripe.member_count = member_count;
+            stripe.length_xor ^= length_xor;
+            accumulate(*frame, _parity_index, _parity + ctsMediaStreamFec::ParityHeaderLength, _parity_length - ctsMediaStreamFec::ParityHeaderLength);
+            return try_recover(*frame, _parity_index);
+        }
+
+        [[nodiscard]] long long recovered_datagrams() const noexcept
+        {
+            return recovered_count;
+        }
+
+    private:
+        enum class DatagramState : unsigned char
+        {
+            Missing,
+            Received,
+            Recovered
+        };
+        struct Stripe
+        {
+            unsigned long accumulated_length = 0;
+            unsigned short member_count = 0;
+            unsigned short received_members = 0;
+            unsigned short length_xor = 0;
+            bool parity_received = false;
+            bool recovered = false;
+        };
+        struct Frame
+        {
+            long long sequence_number = 0LL;
+            std::vector<DatagramState> datagram_state;
+            std::vector<Stripe> stripes;
+            // max_payload_length bytes for each stripe: the XOR of everything received for it
+            std::vector<char> accumulators;
+        };
+
+        const unsigned long data_per_group;
+        const unsigned long parity_per_group;
+        const unsigned long max_datagrams;
+        const unsigned long max_parity;
+        const unsigned long max_payload_length;
+        const unsigned long header_length;
+        std::array<Frame, FrameSlots> frames;
+        long long recovered_count = 0LL;
+
+        // returns nullptr for a frame older than the one now decoded in its slot
+        Frame* frame_for(long long _sequence_number) noexcept
+        {
+            auto& frame = frames[static_cast<size_t>(_sequence_number) % FrameSlots];
+            if (frame.sequence_number == _sequence_number)
+            {
+                return &frame;
+            }
+            if (_sequence_number < frame.sequence_number)
+            {
+                return nullptr;
+            }
+
+            frame.sequence_number = _sequence_number;
+            std::fill(frame.datagram_state.begin(), frame.datagram_state.end(), DatagramState::Missing);
+            std::fill(frame.stripes.begin(), frame.stripes.end(), Stripe());
+            return &frame;
+        }
+
+        void accumulate(Frame& _frame, unsigned long _parity_index, _In_reads_bytes_(_length) const char* _payload, unsigned long _length) noexcept
+        {
+            auto& stripe = _frame.stripes[_parity_index];
+            char* const accumulator = _frame.accumulators.data() + static_cast<size_t>(_parity_index) * max_payload_length;
+            // shorter payloads are zero-padded: only zero what this stripe has not yet used
+            if (_length > stripe.accumulated_length)
+            {
+                ::memset(accumulator + stripe.accumulated_length, 0, _length - stripe.accumulated_length);
+                stripe.accumulated_length = _length;
+            }
+            ctsMediaStreamFec::XorInto(accumulator, _payload, _length);
+        }
+
+        // returns the bytes of the datagram rebuilt, or zero if the stripe cannot rebuild one
+        unsigned long try_recover(Frame& _frame, unsigned long _parity_index) noexcept
+        {
+            auto& stripe = _frame.stripes[_parity_index];
+            if (!stripe.parity_received || stripe.recovered || stripe.received_members + 1 != stripe.member_count)
+            {
+                return 0;
+            }
+
+            // the payload of the missing datagram is now the first length_xor bytes of the accumulator
+            const unsigned long recovered_length = stripe.length_xor;
+            if (0 == recovered_length || recovered_length > stripe.accumulated_length)
+            {
+                return 0;
+            }
+
+            const unsigned long first_member = ctsMediaStreamFec::FirstMember(_parity_index, data_per_group, parity_per_group);
+            for (unsigned long member = 0; member < stripe.member_count; ++member)
+            {
+                const unsigned long datagram_index = first_member + member * parity_per_group;
+                if (datagram_index < max_datagrams && DatagramState::Missing == _frame.datagram_state[datagram_index])
+                {
+                    _frame.datagram_state[datagram_index] = DatagramState::Recovered;
+                    stripe.recovered = true;
+                    ++recovered_count;
+                    return recovered_length + header_length;
+                }
+            }
+            return 0;
+        }
+    };
+}
@@ -0,0 +1,292 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <vector>
+// os headers
+#include <Windows.h>
+
+namespace ctsTraffic
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsMediaStreamFrameRing
+    ///
+    /// The frames a media stream client is buffering, from the next frame to render (the head)
+    /// through the following size() - 1 frames
+    /// - sequence numbers start at 1, and the frame with sequence number N is always in slot (N - 1) % size():
+    ///   finding a frame's slot is an offset from the head, with no sequence number stored per frame
+    /// - each field is its own array, so walking the frames touches only the fields being read
+    ///
+    /// The timestamps of each frame's latest datagram are kept as the low 32 bits of the microseconds
+    /// since the first datagram of the stream, one clock for the sender and one for the receiver
+    /// - the QPF of each clock is kept once for the stream, rather than with every frame
+    /// - a timestamp is restored against the most recent datagram's: frames in the ring are within seconds of it,
+    ///   far less than the 35 minutes a 32-bit count of microseconds can be apart either way
+    ///
+    /// With -Timestamps:kernel the kernel receive timestamp of the latest datagram is kept on the receiver clock as well
+    ///
+    /// A frame costs 12 bytes, plus 5 when retransmits are tracked for -Recovery:nack,
+    /// plus 4 when kernel receive timestamps are tracked for -Timestamps:kernel
+    ///
+    /// Not thread-safe: the caller serializes access
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsMediaStreamFrameRing
+    {
+    public:
+        static constexpr size_t NotFound = static_cast<size_t>(-1);
+
+        explicit ctsMediaStreamFrameRing(long long _receiver_qpf) noexcept :
+            receiver_frequency(_receiver_qpf)
+        {
+        }
+        ~ctsMediaStreamFrameRing() = default;
+
+        ctsMediaStreamFrameRing(const ctsMediaStreamFrameRing&) = delete;
+        ctsMediaStreamFrameRing& operator=(const ctsMediaStreamFrameRing&) = delete;
+        ctsMediaStreamFrameRing(ctsMediaStreamFrameRing&&) = delete;
+        ctsMediaStreamFrameRing& operator=(ctsMediaStreamFrameRing&&) = delete;
+
+        //
+        // Sizes the ring before any frame is recorded
+        // - can throw std::bad_alloc
+        //
+        void resize(size_t _frame_count, bool _track_retransmits, bool _track_kernel_timestamps = false)
+        {
+            bytes.resize(_frame_count);
+            sender_microseconds.resize(_frame_count);
+            receiver_microseconds.resize(_frame_count);
+            if (_track_retransmits)
+            {
+                retransmit_bytes.resize(_frame_count);
+                retransmit_requests.resize(_frame_count);
+            }
+            if (_track_kernel_timestamps)
+            {
+                receiver_kernel_microseconds.resize(_frame_count);
+            }
+        }
+
+        [[nodiscard]] size_t size() const noexcept
+        {
+            return bytes.size();
+        }
+
+        [[nodiscard]] size_t head() const noexcept
+        {
+            return head_slot;
+        }
+
+        [[nodiscard]] long long head_sequence_number() const noexcept
+        {
+            return head_sequence;
+        }
+
+        [[nodiscard]] size_t next(size_t _slot) const noexcept
+        {
+            return _slot + 1 == bytes.size() ? 0 : _slot + 1;
+        }
+
+        //
+        // Returns NotFound if the sequence number is not between the head and the last frame in the ring
+        //
+        [[nodiscard]] size_t find(long long _sequence_number) const noexcept
+        {
+            if (_sequence_number < head_sequence || _sequence_number - head_sequence >= static_cast<long long>(bytes.size()))
+            {
+                return NotFound;
+            }
+            const size_t slot = head_slot + static_cast<size_t>(_sequence_number - head_sequence);
+            return slot < bytes.size() ? slot : slot - bytes.size();
+        }
+
+        //
+        // Counts a datagram toward the frame in the slot
+        // - the frame's timestamps are always those of its latest datagram
+        //
+        void record_datagram(
+            size_t _slot,
+            unsigned long _frame_bytes,
+            bool _retransmitted,
+            long long _sender_qpc,
+            long long _sender_qpf,
+            long long _receiver_qpc) noexcept
+        {
+            if (!any_received)
+            {
+                any_received = true;
+                sender_base_qpc = _sender_qpc;
+                receiver_base_qpc = _receiver_qpc;
+            }
+            sender_frequency = _sender_qpf;
+
+            if (_retransmitted && !retransmit_bytes.empty())
+            {
+                retransmit_bytes[_slot] += _frame_bytes;
+            }
+            else
+            {
+                bytes[_slot] += _frame_bytes;
+            }
+
+            latest_sender_microseconds = ToMicroseconds(_sender_qpc - sender_base_qpc, sender_frequency);
+            latest_receiver_microseconds = ToMicroseconds(_receiver_qpc - receiver_base_qpc, receiver_frequency);
+            sender_microseconds[_slot] = static_cast<unsigned long>(latest_sender_microseconds);
+            receiver_microseconds[_slot] = static_cast<unsigned long>(latest_receiver_microseconds);
+        }
+
+        //
+        // -Timestamps:kernel : when the kernel received the datagram just recorded for the slot
+        // - on the receiver clock, so it is kept relative to the first datagram's user-mode receive time:
+        //   it is earlier than the datagram's receive time, by no more than the host delay
+        //
+        void record_kernel_timestamp(size_t _slot, long long _receiver_kernel_qpc) noexcept
+        {
+            if (!receiver_kernel_microseconds.empty())
+            {
+                receiver_kernel_microseconds[_slot] = static_cast<unsigned long>(ToMicroseconds(_receiver_kernel_qpc - receiver_base_qpc, receiver_frequency));
+            }
+        }
+
+        [[nodiscard]] unsigned long bytes_received(size_t _slot) const noexcept
+        {
+            return bytes[_slot];
+        }
+
+        // -Recovery:nack : bytes received from retransmitted datagrams, tracked apart from the original datagrams
+        [[nodiscard]] unsigned long retransmitted_bytes(size_t _slot) const noexcept
+        {
+            return retransmit_bytes.empty() ? 0UL : retransmit_bytes[_slot];
+        }
+
+        [[nodiscard]] bool retransmit_requested(size_t _slot) const noexcept
+        {
+            return !retransmit_requests.empty() && retransmit_requests[_slot] != 0;
+        }
+
+        void set_retransmit_requested(size_t _slot) noexcept
+        {
+            if (!retransmit_requests.empty())
+            {
+                retransmit_requests[_slot] = 1;
+            }
+        }
+
+        // whether any datagram has counted toward the frame
+        [[nodiscard]] bool arrived(size_t _slot) const noexcept
+        {
+            return bytes[_slot] > 0 || retransmitted_bytes(_slot) > 0;
+        }
+
+        // whether any datagram has been recorded since the stream started
+        [[nodiscard]] bool received_any() const noexcept
+        {
+            return any_received;
+        }
+
+        //
+        // The timestamps of the frame's latest datagram, as QPC values
+        // - only meaningful once arrived() is true for the slot
+        //
+        [[nodiscard]] long long sender_qpc(size_t _slot) const noexcept
+        {
+            return sender_base_qpc + ToTicks(Restore(sender_microseconds[_slot], latest_sender_microseconds), sender_frequency);
+        }
+
+        [[nodiscard]] long long sender_qpf() const noexcept
+        {
+            return sender_frequency;
+        }
+
+        [[nodiscard]] long long receiver_qpc(size_t _slot) const noexcept
+        {
+            return receiver_base_qpc + ToTicks(Restore(receiver_microseconds[_slot], latest_receiver_microseconds), receiver_frequency);
+        }
+
+        [[nodiscard]] long long receiver_qpf() const noexcept
+        {
+            return receiver_frequency;
+        }
+
+        // the receiver_qpc of the frame when kernel receive timestamps are not tracked
+        [[nodiscard]] long long receiver_kernel_qpc(size_t _slot) const noexcept
+        {
+            if (receiver_kernel_microseconds.empty())
+            {
+                return receiver_qpc(_slot);
+            }
+            return receiver_base_qpc + ToTicks(Restore(receiver_kernel_microseconds[_slot], latest_receiver_microseconds), receiver_frequency);
+        }
+
+        //
+        // Moves the head past the frame just rendered
+        // - its slot is cleared to hold the frame size() after it
+        //
+        void advance_head() noexcept
+        {
+            bytes[head_slot] = 0;
+            if (!retransmit_bytes.empty())
+            {
+                retransmit_bytes[head_slot] = 0;
+                retransmit_requests[head_slot] = 0;
+            }
+            head_slot = next(head_slot);
+            ++head_sequence;
+        }
+
+    private:
+        std::vector<unsigned long> bytes;
+        std::vector<unsigned long> sender_microseconds;
+        std::vector<unsigned long> receiver_microseconds;
+        // empty unless -Recovery:nack
+        std::vector<unsigned long> retransmit_bytes;
+        std::vector<unsigned char> retransmit_requests;
+        // empty unless -Timestamps:kernel
+        std::vector<unsigned long> receiver_kernel_microseconds;
+
+        size_t head_slot = 0;
+        long long head_sequence = 1LL;
+
+        bool any_received = false;
+        long long sender_base_qpc = 0LL;
+        long long sender_frequency = 0LL;
+        long long latest_sender_microseconds = 0LL;
+        long long receiver_base_qpc = 0LL;
+        const long long receiver_frequency;
+        long long latest_receiver_microseconds = 0LL;
+
+        // split to not overflow the multiply for streams running many days
+        static long long ToMicroseconds(long long _ticks, long long _frequency) noexcept
+        {
+            if (0 == _frequency)
+            {
+                return 0LL;
+            }
+            return _ticks / _frequency * 1000000LL + _ticks % _frequency * 1000000LL / _frequency;
+        }
+
+        static long long ToTicks(long long _microseconds, long long _frequency) noexcept
+        {
+            return _microseconds / 1000000LL * _frequency + _microseconds % 1000000LL * _frequency / 1000000LL;
+        }
+
+        // the 64-bit value whose low 32 bits are _stored, nearest to _latest
+        static long long Restore(unsigned long _stored, long long _latest) noexcept
+        {
+            return _latest + static_cast<long>(_stored - static_cast<unsigned long>(_latest));
+        }
+    };
+}
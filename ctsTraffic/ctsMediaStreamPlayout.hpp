@@ -0,0 +1,141 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <cmath>
+
+namespace ctsTraffic
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsMediaStreamPlayout
+    ///
+    /// The playout delay of a media stream client with -Playout:adaptive
+    /// - a frame is rendered once the timer wheel is delay_frames() past it
+    /// - the delay moves a frame at a time to keep frames waiting 4 times the interarrival jitter after they arrive
+    ///
+    /// The interarrival jitter is estimated as in RFC 3550 (6.4.1) from the transit time of each frame's last datagram:
+    /// the sender and receiver clocks are not synchronized, but only the change in transit time between frames is used
+    /// - a frame's wait is the time between its last datagram arriving and the frame being rendered
+    /// - the delay shrinks only once frames would still wait the jitter margin with one frame less of buffering,
+    ///   and the average wait is moved with the delay so the next frames are not measured against the prior depth
+    /// - a frame rendered as dropped whose datagrams then arrive was late rather than lost: the delay grows by a frame
+    ///
+    /// Not thread-safe: the caller serializes access
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsMediaStreamPlayout
+    {
+    public:
+        ctsMediaStreamPlayout() noexcept = default;
+        ~ctsMediaStreamPlayout() = default;
+
+        ctsMediaStreamPlayout(const ctsMediaStreamPlayout&) = delete;
+        ctsMediaStreamPlayout& operator=(const ctsMediaStreamPlayout&) = delete;
+        ctsMediaStreamPlayout(ctsMediaStreamPlayout&&) = delete;
+        ctsMediaStreamPlayout& operator=(ctsMediaStreamPlayout&&) = delete;
+
+        //
+        // Sets the delay before any frame is rendered
+        // - the delay starts at -BufferDepth, and cannot grow past the frames the client can track
+        //
+        void reset(unsigned long _initial_delay_frames, unsigned long _max_delay_frames, double _ms_per_frame) noexcept
+        {
+            delay = _initial_delay_frames;
+            max_delay = _max_delay_frames;
+            frame_ms = _ms_per_frame;
+            transit_measured = false;
+            previous_transit_ms = 0.0;
+            jitter = 0.0;
+            average_wait = 0.0;
+        }
+
+        //
+        // Whether the frame is rendered once the timer wheel has reached _timer_wheel_frames
+        // - no frame is due for the tick after the delay grows, and two frames are due for the tick after it shrinks
+        //
+        bool frame_due(long long _sequence_number, unsigned long _timer_wheel_frames) const noexcept
+        {
+            return _sequence_number + delay <= _timer_wheel_frames;
+        }
+
+        //
+        // Updates the jitter estimate and the delay after a received frame is rendered
+        // - _transit_ms is the receiver's timestamp of the frame's last datagram less the sender's, each in milliseconds
+        // - _wait_ms is the time from that datagram arriving until the frame was rendered
+        //
+        void frame_rendered(double _transit_ms, double _wait_ms) noexcept
+        {
+            if (transit_measured)
+            {
+                jitter += (std::fabs(_transit_ms - previous_transit_ms) - jitter) / 16.0;
+            }
+            previous_transit_ms = _transit_ms;
+
+            average_wait = transit_measured ? average_wait + (_wait_ms - average_wait) / 16.0 : _wait_ms;
+            transit_measured = true;
+
+            const double jitter_margin_ms = 4.0 * jitter;
+            if (average_wait - frame_ms > jitter_margin_ms && delay > 1)
+            {
+                --delay;
+                average_wait -= frame_ms;
+            }
+            else if (average_wait < jitter_margin_ms && delay < max_delay)
+            {
+                ++delay;
+                average_wait += frame_ms;
+            }
+        }
+
+        //
+        // Grows the delay after datagrams arrive for a frame already rendered as dropped
+        //
+        void frame_late() noexcept
+        {
+            if (delay < max_delay)
+            {
+                ++delay;
+                average_wait += frame_ms;
+            }
+        }
+
+        unsigned long delay_frames() const noexcept
+        {
+            return delay;
+        }
+        unsigned long max_delay_frames() const noexcept
+        {
+            return max_delay;
+        }
+        double jitter_ms() const noexcept
+        {
+            return jitter;
+        }
+        double average_wait_ms() const noexcept
+        {
+            return average_wait;
+        }
+
+    private:
+        unsigned long delay = 0UL;
+        unsigned long max_delay = 0UL;
+        double frame_ms = 0.0;
+        bool transit_measured = false;
+        double previous_transit_ms = 0.0;
+        double jitter = 0.0;
+        double average_wait = 0.0;
+    };
+}
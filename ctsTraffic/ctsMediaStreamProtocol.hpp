@@ -16,6 +16,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // cpp headers
 #include <array>
 #include <string>
+#include <vector>
 // os headers
 #include <windows.h>
 #include <WinSock2.h>
@@ -25,6 +26,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // local headers
 #include "ctsConfig.h"
 #include "ctsIOTask.hpp"
+#include "ctsMediaStreamFec.hpp"
 #include "ctsSafeInt.hpp"
 #include "ctsStatistics.hpp"
 
@@ -37,9 +39,19 @@ namespace ctsTraffic
     //
     //   REQUEST_ID
     //   START
+    //   NACK <first sequence number, frame count> ...
     //
     constexpr unsigned short UdpDatagramProtocolHeaderFlagData = 0x0000;
+    // a data datagram sent again in response to a NACK
+    constexpr unsigned short UdpDatagramProtocolHeaderFlagRetransmit = 0x0001;
     constexpr unsigned short UdpDatagramProtocolHeaderFlagId = 0x1000;
+    // -Recovery:fec : the low 12 bits of these flags are the datagram's index within its frame
+    // - data datagrams are numbered from 0, as are the parity datagrams following them (see ctsMediaStreamFec)
+    constexpr unsigned short UdpDatagramProtocolHeaderFlagFecData = 0x2000;
+    constexpr unsigned short UdpDatagramProtocolHeaderFlagFecParity = 0x3000;
+    constexpr unsigned short UdpDatagramProtocolHeaderFlagFecTypeMask = 0xf000;
+    constexpr unsigned short UdpDatagramProtocolHeaderFlagFecIndexMask = 0x0fff;
+    constexpr unsigned long UdpDatagramFecMaximumDatagrams = UdpDatagramProtocolHeaderFlagFecIndexMask + 1UL;
 
     constexpr unsigned long UdpDatagramProtocolHeaderFlagLength = 2;
     constexpr unsigned long UdpDatagramConnectionIdHeaderLength = UdpDatagramProtocolHeaderFlagLength + ctsStatistics::ConnectionIdLength;
@@ -54,219 +66,275 @@ namespace ctsTraffic
     static const char* UdpDatagramStartString = "START";
     constexpr unsigned long UdpDatagramStartStringLength = 5;
 
+    // a NACK is the string "NACK" followed by up to UdpDatagramNackMaximumRanges ranges of missing frames
+    // - each range is the 64-bit first sequence number followed by the 32-bit count of frames
+    static const char* UdpDatagramNackString = "NACK";
+    constexpr unsigned long UdpDatagramNackStringLength = 4;
+    constexpr unsigned long UdpDatagramNackRangeLength = 12;
+    constexpr unsigned long UdpDatagramNackMaximumRanges = 32;
+    constexpr unsigned long UdpDatagramNackMaximumLength = UdpDatagramNackStringLength + UdpDatagramNackMaximumRanges * UdpDatagramNackRangeLength;
+
+    struct ctsMediaStreamNackRange
+    {
+        long long first_sequence_number = 0LL;
+        unsigned long frame_count = 0UL;
+    };
+
     enum class MediaStreamAction : char
     {
-        START
+        START,
+        NACK
     };
 
+    ////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsMediaStreamSendRequests
+    ///
+    /// Splits one frame into the datagrams to send, each described by 2 WSABUFs:
+    /// - [0] : the datagram header : flag, sequence number, QPC, QPF
+    ///         (the flag is UdpDatagramProtocolHeaderFlagRetransmit when the frame is being sent again)
+    /// - [1] : the payload from the frame's send buffer
+    ///
+    /// With -Recovery:fec, add_parity() follows the data datagrams with their parity datagrams
+    /// - the parity payloads are written into a second block, also kept across frames
+    ///
+    /// The headers for every datagram of the frame are written contiguously into one block,
+    /// which is kept across frames so a reused object stops allocating once it has seen its largest frame
+    /// - stamp_send_time() writes the QPC into every header with a single QueryPerformanceCounter call
+    ///   and should be called immediately before the datagrams are sent
+    ///
+    /// Iterating yields a std::array<WSABUF, 2> per datagram; the arrays are contiguous
+    /// so they can be handed to APIs which send a batch of datagrams
+    ///
+    ////////////////////////////////////////////////////////////////////////////////
     class ctsMediaStreamSendRequests
     {
     public:
+        static constexpr unsigned long BufferArraySize = 2;
+        typedef std::array<WSABUF, BufferArraySize> DatagramBuffers;
+        typedef std::vector<DatagramBuffers>::iterator iterator;
+
+        // offsets of each field within a datagram header
+        static constexpr unsigned long HeaderSequenceNumberOffset = UdpDatagramProtocolHeaderFlagLength;
+        static constexpr unsigned long HeaderQPCOffset = HeaderSequenceNumberOffset + UdpDatagramSequenceNumberLength;
+        static constexpr unsigned long HeaderQPFOffset = HeaderQPCOffset + UdpDatagramQPCLength;
+
+        ctsMediaStreamSendRequests() noexcept = default;
         ~ctsMediaStreamSendRequests() = default;
-        ctsMediaStreamSendRequests() = delete;
         ctsMediaStreamSendRequests(const ctsMediaStreamSendRequests&) = delete;
         ctsMediaStreamSendRequests& operator=(const ctsMediaStreamSendRequests&) = delete;
         ctsMediaStreamSendRequests(ctsMediaStreamSendRequests&&) = delete;
         ctsMediaStreamSendRequests& operator=(ctsMediaStreamSendRequests&&) = delete;
 
+        ///
+        /// Constructor of the ctsMediaStreamSendRequests captures the properties of the next Send() request
+        /// - the total # of bytes to send (across X number of send requests)
+        /// - the sequence number to tag in every send request
+        ///
+        ctsMediaStreamSendRequests(long long _bytes_to_send, long long _sequence_number, const char* _send_buffer)
+        {
+            this->encode(_bytes_to_send, _sequence_number, _send_buffer);
+            this->stamp_send_time();
+        }
 
-        static constexpr unsigned long BufferArraySize = 5;
         ///
-        /// compose iteration across buffers to be sent per instantiated request
+        /// Replaces the datagrams with those for the next frame
+        /// - can throw std::bad_alloc only when this frame needs more datagrams than any before it
         ///
-        class iterator
+        void encode(
+            long long _bytes_to_send,
+            long long _sequence_number,
+            const char* _send_buffer,
+            unsigned short _protocol_flag = UdpDatagramProtocolHeaderFlagData)
         {
-        public:
-            ////////////////////////////////////////////////////////////////////////////////
-            ///
-            /// iterator_traits
-            /// - allows <algorithm> functions to be used
-            ///
-            ////////////////////////////////////////////////////////////////////////////////
-            typedef std::forward_iterator_tag iterator_category;
-            typedef std::array<WSABUF, BufferArraySize> value_type;
-            typedef size_t difference_type;
-            typedef std::array<WSABUF, BufferArraySize>* pointer;
-            typedef std::array<WSABUF, BufferArraySize>& reference;
-
-            ~iterator() = default;
-            iterator(const iterator&) = default;
-            iterator& operator=(const iterator&) = default;
-            iterator(iterator&&) = default;
-            iterator& operator=(iterator&&) = default;
-
-            ///
-            /// Dereferencing operators
-            /// - returning non-const array references as Winsock APIs don't take const WSABUF*
-            ///
-            std::array<WSABUF, BufferArraySize>* operator->() noexcept
-            {
-                FAIL_FAST_IF_MSG(
-                    nullptr == this->qpc_address,
-                    "Invalid ctsMediaStreamSendRequests::iterator being dereferenced (%p)", this);
-
-                // refresh the QPC value at the last possible moment before returning the array to the user
-                _Analysis_assume_(this->qpc_address != nullptr);
-                QueryPerformanceCounter(this->qpc_address);
-                return &this->wsa_buf_array;
-            }
+            FAIL_FAST_IF_MSG(
+                _bytes_to_send <= UdpDatagramDataHeaderLength,
+                "ctsMediaStreamSendRequests requires a buffer size to send larger than the ctsTraffic UDP header");
 
-            std::array<WSABUF, BufferArraySize>& operator*() noexcept
+            // the headers must all be written before taking addresses into the header block
+            // - as growing the block can move it
+            size_t datagram_count = 0;
+            for (auto bytes_remaining = _bytes_to_send; bytes_remaining > 0; bytes_remaining -= NextDatagramLength(bytes_remaining))
             {
-                FAIL_FAST_IF_MSG(
-                    nullptr == this->qpc_address,
-                    "Invalid ctsMediaStreamSendRequests::iterator being dereferenced (%p)", this);
-
-                // refresh the QPC value at the last possible moment before returning the array to the user
-                _Analysis_assume_(this->qpc_address != nullptr);
-                QueryPerformanceCounter(this->qpc_address);
-                return this->wsa_buf_array;
+                ++datagram_count;
             }
+            this->headers.resize(datagram_count * UdpDatagramDataHeaderLength); // can throw
+            this->datagrams.resize(datagram_count); // can throw
+            this->data_datagram_count = datagram_count;
 
-            ///
-            /// Equality operators
-            ///
-            bool operator ==(const iterator& _comparand) const noexcept
+            const long long qpf = ctl::ctTimer::ctSnapQpf();
+            auto bytes_remaining = _bytes_to_send;
+            for (size_t datagram = 0; datagram < datagram_count; ++datagram)
             {
-                return this->qpc_address == _comparand.qpc_address &&
-                    this->bytes_to_send == _comparand.bytes_to_send;
+                char* const header = this->headers.data() + datagram * UdpDatagramDataHeaderLength;
+                ::memcpy(header, &_protocol_flag, UdpDatagramProtocolHeaderFlagLength);
+                ::memcpy(header + HeaderSequenceNumberOffset, &_sequence_number, UdpDatagramSequenceNumberLength);
+                ::memset(header + HeaderQPCOffset, 0, UdpDatagramQPCLength);
+                ::memcpy(header + HeaderQPFOffset, &qpf, UdpDatagramQPFLength);
+
+                const auto datagram_length = NextDatagramLength(bytes_remaining);
+                auto& buffers = this->datagrams[datagram];
+                buffers[0].buf = header;
+                buffers[0].len = UdpDatagramDataHeaderLength;
+                // every datagram carries the payload from the start of the send buffer
+                buffers[1].buf = const_cast<char*>(_send_buffer);
+                buffers[1].len = datagram_length - UdpDatagramDataHeaderLength;
+
+                bytes_remaining -= datagram_length;
             }
-            bool operator !=(const iterator& _comparand) const noexcept
+        }
+
+        ///
+        /// Follows the data datagrams of the frame just encoded with their parity datagrams for -Recovery:fec,
+        /// and tags every datagram's flag with its index in the frame
+        /// - can throw std::bad_alloc only when this frame needs more parity than any before it
+        ///
+        void add_parity(unsigned long _data_per_group, unsigned long _parity_per_group)
+        {
+            const auto data_count = static_cast<unsigned long>(this->data_datagram_count);
+            const unsigned long parity_count = ctsMediaStreamFec::ParityCount(data_count, _data_per_group, _parity_per_group);
+            FAIL_FAST_IF_MSG(
+                data_count > UdpDatagramFecMaximumDatagrams || parity_count > UdpDatagramFecMaximumDatagrams,
+                "ctsMediaStreamSendRequests::add_parity : the frame's datagrams (%u) or parity datagrams (%u) exceed UdpDatagramFecMaximumDatagrams (%u)",
+                data_count, parity_count, UdpDatagramFecMaximumDatagrams);
+
+            // payloads never grow along a frame: no parity payload is longer than the first datagram's
+            const unsigned long parity_stride = ctsMediaStreamFec::ParityHeaderLength + this->datagrams[0][1].len;
+            this->parity.resize(static_cast<size_t>(parity_count) * parity_stride); // can throw
+            this->headers.resize(static_cast<size_t>(data_count + parity_count) * UdpDatagramDataHeaderLength); // can throw
+            this->datagrams.resize(static_cast<size_t>(data_count) + parity_count); // can throw
+
+            // growing the header block can have moved it
+            for (unsigned long datagram = 0; datagram < data_count; ++datagram)
             {
-                return !(*this == _comparand);
+                char* const header = this->headers.data() + static_cast<size_t>(datagram) * UdpDatagramDataHeaderLength;
+                const auto protocol_flag = static_cast<unsigned short>(UdpDatagramProtocolHeaderFlagFecData | datagram);
+                ::memcpy(header, &protocol_flag, UdpDatagramProtocolHeaderFlagLength);
+                this->datagrams[datagram][0].buf = header;
             }
 
-            /// preincrement
-            iterator& operator++() noexcept
+            for (unsigned long parity_index = 0; parity_index < parity_count; ++parity_index)
             {
-                FAIL_FAST_IF_MSG(
-                    nullptr == this->qpc_address,
-                    "Invalid ctsMediaStreamSendRequests::iterator being dereferenced (%p)", this);
-
-                // if bytes is zero, then increment to the end() iterator
-                if (0 == this->bytes_to_send)
+                // the sequence number and QPF are those of the data datagrams
+                char* const header = this->headers.data() + static_cast<size_t>(data_count + parity_index) * UdpDatagramDataHeaderLength;
+                ::memcpy(header, this->headers.data(), UdpDatagramDataHeaderLength);
+                const auto protocol_flag = static_cast<unsigned short>(UdpDatagramProtocolHeaderFlagFecParity | parity_index);
+                ::memcpy(header, &protocol_flag, UdpDatagramProtocolHeaderFlagLength);
+
+                const unsigned long first_member = ctsMediaStreamFec::FirstMember(parity_index, _data_per_group, _parity_per_group);
+                const unsigned long member_count = ctsMediaStreamFec::MemberCount(parity_index, data_count, _data_per_group, _parity_per_group);
+                const unsigned long parity_length = this->datagrams[first_member][1].len;
+
+                char* const parity_datagram = this->parity.data() + static_cast<size_t>(parity_index) * parity_stride;
+                char* const parity_payload = parity_datagram + ctsMediaStreamFec::ParityHeaderLength;
+                ::memset(parity_payload, 0, parity_length);
+                unsigned short length_xor = 0;
+                for (unsigned long member = 0; member < member_count; ++member)
                 {
-                    this->qpc_address = nullptr;
+                    const auto& payload = this->datagrams[first_member + member * _parity_per_group][1];
+                    ctsMediaStreamFec::XorInto(parity_payload, payload.buf, payload.len);
+                    length_xor ^= static_cast<unsigned short>(payload.len);
                 }
-                else
-                {
-                    this->bytes_to_send -= this->update_buffer_length();
-                }
-
-                return *this;
-            }
-            // postincrement
-            iterator operator++(int) noexcept
-            {
-                iterator temp(*this);
-                ++* this;
-                return temp;
+                const auto stripe_members = static_cast<unsigned short>(member_count);
+                ::memcpy(parity_datagram + ctsMediaStreamFec::ParityMemberCountOffset, &stripe_members, sizeof stripe_members);
+                ::memcpy(parity_datagram + ctsMediaStreamFec::ParityLengthXorOffset, &length_xor, sizeof length_xor);
+
+                auto& buffers = this->datagrams[static_cast<size_t>(data_count) + parity_index];
+                buffers[0].buf = header;
+                buffers[0].len = UdpDatagramDataHeaderLength;
+                buffers[1].buf = parity_datagram;
+                buffers[1].len = ctsMediaStreamFec::ParityHeaderLength + parity_length;
             }
+        }
 
-        private:
-            // c'tor is only available to the begin() and end() methods of ctsMediaStreamSendRequests
-            friend class ctsMediaStreamSendRequests;
-            iterator(_In_opt_ LARGE_INTEGER* _qpc_address, long long _bytes_to_send, const std::array<WSABUF, BufferArraySize>& _wsa_buf_array) noexcept :
-                qpc_address(_qpc_address),
-                bytes_to_send(_bytes_to_send),
-                wsa_buf_array(_wsa_buf_array)
+        ///
+        /// Writes the current QPC into the header of every datagram of the frame
+        ///
+        void stamp_send_time() noexcept
+        {
+            LARGE_INTEGER qpc;
+            QueryPerformanceCounter(&qpc);
+            for (size_t offset = HeaderQPCOffset; offset < this->headers.size(); offset += UdpDatagramDataHeaderLength)
             {
-                // set the buffer length for the first iterator
-                this->bytes_to_send -= this->update_buffer_length();
+                ::memcpy(this->headers.data() + offset, &qpc.QuadPart, UdpDatagramQPCLength);
             }
+        }
 
-            unsigned long update_buffer_length() noexcept
-            {
-                // only update when not the end() iterator
-                if (this->qpc_address)
-                {
-                    if (this->bytes_to_send > UdpDatagramMaximumSizeBytes)
-                    {
-                        this->wsa_buf_array[4].len = UdpDatagramMaximumSizeBytes - UdpDatagramDataHeaderLength;
-                    }
-                    else
-                    {
-                        this->wsa_buf_array[4].len = static_cast<unsigned long>(this->bytes_to_send - UdpDatagramDataHeaderLength);
-                    }
-
-                    ctsUnsignedLong total_bytes_to_send =
-                        this->wsa_buf_array[0].len + this->wsa_buf_array[1].len + this->wsa_buf_array[2].len + this->wsa_buf_array[3].len + this->wsa_buf_array[4].len;
-
-                    // must guarantee that after we send this datagram we have enough bytes for the next send if there are bytes left over
-                    const ctsSignedLongLong bytes_remaining = this->bytes_to_send - static_cast<long long>(total_bytes_to_send);
-
-                    if (bytes_remaining > 0 && bytes_remaining <= UdpDatagramDataHeaderLength)
-                    {
-                        // subtract out enough bytes so the next datagram will be large enough for the header and at least one byte of data
-                        ctsUnsignedLong new_length = this->wsa_buf_array[4].len;
-                        const ctsUnsignedLong delta_to_remove = UdpDatagramDataHeaderLength + 1 - static_cast<unsigned long>(bytes_remaining);
-                        new_length -= delta_to_remove;
-
-                        this->wsa_buf_array[4].len = new_length;
-                        total_bytes_to_send -= delta_to_remove;
-                    }
+        [[nodiscard]] size_t size() const noexcept
+        {
+            return this->datagrams.size();
+        }
 
-                    return total_bytes_to_send;
-                }
+        // the datagrams carrying the frame: any datagrams after these are parity
+        [[nodiscard]] size_t data_size() const noexcept
+        {
+            return this->data_datagram_count;
+        }
 
-                return 0UL;
+        [[nodiscard]] unsigned long parity_bytes() const noexcept
+        {
+            unsigned long bytes = 0;
+            for (size_t datagram = this->data_datagram_count; datagram < this->datagrams.size(); ++datagram)
+            {
+                bytes += this->datagrams[datagram][0].len + this->datagrams[datagram][1].len;
             }
-
-            LARGE_INTEGER* qpc_address;
-            ctsSignedLongLong bytes_to_send;
-            std::array<WSABUF, BufferArraySize> wsa_buf_array;
-        };
-
+            return bytes;
+        }
 
         ///
-        /// Constructor of the ctsMediaStreamSendRequests captures the properties of the next Send() request
-        /// - the total # of bytes to send (across X number of send requests)
-        /// - the sequence number to tag in every send request
+        /// The number of datagrams a frame of _bytes_to_send is split into
         ///
-        ctsMediaStreamSendRequests(long long _bytes_to_send, long long _sequence_number, const char* _send_buffer) noexcept :
-            qpf(ctl::ctTimer::ctSnapQpf()),
-            bytes_to_send(_bytes_to_send),
-            sequence_number(_sequence_number)
+        static unsigned long DatagramCount(long long _bytes_to_send) noexcept
         {
-            FAIL_FAST_IF_MSG(
-                _bytes_to_send <= UdpDatagramDataHeaderLength,
-                "ctsMediaStreamSendRequests requires a buffer size to send larger than the ctsTraffic UDP header");
-
-            // buffer layout: header#, seq. number, qpc, qpf, then the buffered data
-            this->wsabuf[0].buf = reinterpret_cast<char*>(const_cast<unsigned short*>(&UdpDatagramProtocolHeaderFlagData));
-            this->wsabuf[0].len = UdpDatagramProtocolHeaderFlagLength;
-
-            this->wsabuf[1].buf = reinterpret_cast<char*>(&this->sequence_number);
-            this->wsabuf[1].len = UdpDatagramSequenceNumberLength;
-
-            this->wsabuf[2].buf = reinterpret_cast<char*>(&this->qpc_value.QuadPart);
-            this->wsabuf[2].len = UdpDatagramQPCLength;
-
-            this->wsabuf[3].buf = reinterpret_cast<char*>(&this->qpf);
-            this->wsabuf[3].len = UdpDatagramQPFLength;
+            unsigned long datagram_count = 0;
+            for (auto bytes_remaining = _bytes_to_send; bytes_remaining > 0; bytes_remaining -= NextDatagramLength(bytes_remaining))
+            {
+                ++datagram_count;
+            }
+            return datagram_count;
+        }
 
-            this->wsabuf[4].buf = const_cast<char*>(_send_buffer);
-            // the this->wsabuf[4].len field is dependent on bytes_to_send and can change by iterator()
+        [[nodiscard]] DatagramBuffers* data() noexcept
+        {
+            return this->datagrams.data();
         }
 
         [[nodiscard]] iterator begin() noexcept
         {
-            return { &this->qpc_value, this->bytes_to_send, this->wsabuf };
+            return this->datagrams.begin();
         }
 
-        [[nodiscard]] iterator end() const noexcept
+        [[nodiscard]] iterator end() noexcept
         {
-            // end == null qpc + 0 byte length
-            return { nullptr, 0, this->wsabuf };
+            return this->datagrams.end();
         }
 
-
     private:
-        std::array<WSABUF, BufferArraySize> wsabuf{};
-        LARGE_INTEGER qpc_value{};
-        long long qpf{};
-        long long bytes_to_send{};
-        long long sequence_number{};
+        ///
+        /// The length (header + payload) of the next datagram to send with _bytes_remaining left in the frame
+        /// - must guarantee that after this datagram there are enough bytes for the next datagram if there are bytes left over
+        ///
+        static unsigned long NextDatagramLength(long long _bytes_remaining) noexcept
+        {
+            unsigned long datagram_length = _bytes_remaining > UdpDatagramMaximumSizeBytes ?
+                UdpDatagramMaximumSizeBytes :
+                static_cast<unsigned long>(_bytes_remaining);
+
+            const long long bytes_left_over = _bytes_remaining - datagram_length;
+            if (bytes_left_over > 0 && bytes_left_over <= UdpDatagramDataHeaderLength)
+            {
+                // subtract out enough bytes so the next datagram will be large enough for the header and at least one byte of data
+                datagram_length -= UdpDatagramDataHeaderLength + 1 - static_cast<unsigned long>(bytes_left_over);
+            }
+            return datagram_length;
+        }
+
+        // UdpDatagramDataHeaderLength bytes for each datagram, in the order of datagrams
+        std::vector<char> headers;
+        std::vector<DatagramBuffers> datagrams;
+        size_t data_datagram_count = 0;
+        // -Recovery:fec : the parity header and payload of each parity datagram
+        std::vector<char> parity;
     };
 
 
@@ -274,6 +342,9 @@ namespace ctsTraffic
     {
         long long sequence_number = 0ll;
         MediaStreamAction action{};
+        // only set for a NACK
+        unsigned long nack_range_count = 0UL;
+        std::array<ctsMediaStreamNackRange, UdpDatagramNackMaximumRanges> nack_ranges{};
 
         explicit ctsMediaStreamMessage(MediaStreamAction _action) noexcept : action(_action)
         {
@@ -296,9 +367,28 @@ namespace ctsTraffic
                 return false;
             }
 
+            const unsigned short fec_type = GetProtocolHeaderFromTask(_task) & UdpDatagramProtocolHeaderFlagFecTypeMask;
+            if (UdpDatagramProtocolHeaderFlagFecData == fec_type || UdpDatagramProtocolHeaderFlagFecParity == fec_type)
+            {
+                const unsigned long minimum_length = UdpDatagramProtocolHeaderFlagFecParity == fec_type ?
+                    UdpDatagramDataHeaderLength + ctsMediaStreamFec::ParityHeaderLength :
+                    UdpDatagramDataHeaderLength;
+                if (_completed_bytes < minimum_length)
+                {
+                    ctsConfig::PrintErrorInfo(
+                        ctl::ctString::ctFormatString("ValidateBufferLengthFromTask rejecting the FEC datagram type (%u): the datagram size (%u) is less than its header length (%u)",
+                            fec_type,
+                            _completed_bytes,
+                            minimum_length).c_str());
+                    return false;
+                }
+                return true;
+            }
+
             switch (GetProtocolHeaderFromTask(_task))
             {
                 case UdpDatagramProtocolHeaderFlagData:
+                case UdpDatagramProtocolHeaderFlagRetransmit:
                     if (_completed_bytes < UdpDatagramDataHeaderLength)
                     {
                         ctsConfig::PrintErrorInfo(
@@ -322,9 +412,10 @@ namespace ctsTraffic
 
                 default:
                     ctsConfig::PrintErrorInfo(
-                        ctl::ctString::ctFormatString("ValidateBufferLengthFromTask rejecting the datagram of unknown frame type (%u) - expecting UdpDatagramProtocolHeaderFlagData (%u) or UdpDatagramProtocolHeaderFlagId (%u)",
+                        ctl::ctString::ctFormatString("ValidateBufferLengthFromTask rejecting the datagram of unknown frame type (%u) - expecting UdpDatagramProtocolHeaderFlagData (%u), UdpDatagramProtocolHeaderFlagRetransmit (%u) or UdpDatagramProtocolHeaderFlagId (%u)",
                             GetProtocolHeaderFromTask(_task),
                             UdpDatagramProtocolHeaderFlagData,
+                            UdpDatagramProtocolHeaderFlagRetransmit,
                             UdpDatagramProtocolHeaderFlagId).c_str());
                     return false;
             }
@@ -433,6 +524,39 @@ namespace ctsTraffic
             return return_task;
         }
 
+        ///
+        /// Writes a NACK for the ranges into _nack_buffer, returning the task to send it
+        /// - _nack_buffer must remain valid until the send completes
+        ///
+        static ctsIOTask MakeNackTask(
+            _Out_writes_bytes_(UdpDatagramNackMaximumLength) char* _nack_buffer,
+            _In_reads_(_range_count) const ctsMediaStreamNackRange* _ranges,
+            unsigned long _range_count) noexcept
+        {
+            FAIL_FAST_IF_MSG(
+                0 == _range_count || _range_count > UdpDatagramNackMaximumRanges,
+                "ctsMediaStreamMessage::MakeNackTask : the range count (%u) must be between 1 and UdpDatagramNackMaximumRanges (%u)",
+                _range_count, UdpDatagramNackMaximumRanges);
+
+            ::memcpy(_nack_buffer, UdpDatagramNackString, UdpDatagramNackStringLength);
+            char* next_range = _nack_buffer + UdpDatagramNackStringLength;
+            for (unsigned long range = 0; range < _range_count; ++range)
+            {
+                ::memcpy(next_range, &_ranges[range].first_sequence_number, UdpDatagramSequenceNumberLength);
+                ::memcpy(next_range + UdpDatagramSequenceNumberLength, &_ranges[range].frame_count, sizeof(unsigned long));
+                next_range += UdpDatagramNackRangeLength;
+            }
+
+            ctsIOTask return_task;
+            return_task.ioAction = IOTaskAction::Send;
+            return_task.buffer_type = ctsIOTask::BufferType::Static;
+            return_task.track_io = false;
+            return_task.buffer = _nack_buffer;
+            return_task.buffer_offset = 0;
+            return_task.buffer_length = UdpDatagramNackStringLength + _range_count * UdpDatagramNackRangeLength;
+            return return_task;
+        }
+
         static ctsMediaStreamMessage Extract(_In_reads_bytes_(inputLength) const char* inputBuffer, unsigned inputLength)
         {
             if (inputLength == UdpDatagramStartStringLength)
@@ -443,6 +567,25 @@ namespace ctsTraffic
                 }
             }
 
+            if (inputLength > UdpDatagramNackStringLength &&
+                inputLength <= UdpDatagramNackMaximumLength &&
+                (inputLength - UdpDatagramNackStringLength) % UdpDatagramNackRangeLength == 0)
+            {
+                if (0 == memcmp(inputBuffer, UdpDatagramNackString, UdpDatagramNackStringLength))
+                {
+                    ctsMediaStreamMessage nack_message(MediaStreamAction::NACK);
+                    nack_message.nack_range_count = (inputLength - UdpDatagramNackStringLength) / UdpDatagramNackRangeLength;
+                    const char* next_range = inputBuffer + UdpDatagramNackStringLength;
+                    for (unsigned long range = 0; range < nack_message.nack_range_count; ++range)
+                    {
+                        ::memcpy(&nack_message.nack_ranges[range].first_sequence_number, next_range, UdpDatagramSequenceNumberLength);
+                        ::memcpy(&nack_message.nack_ranges[range].frame_count, next_range + UdpDatagramSequenceNumberLength, sizeof(unsigned long));
+                        next_range += UdpDatagramNackRangeLength;
+                    }
+                    return nack_message;
+                }
+            }
+
             THROW_HR_MSG(HRESULT_FROM_WIN32(ERROR_INVALID_DATA),
                 "Invalid MediaStream message: %hs",
                 std::string(inputBuffer, inputLength).c_str());
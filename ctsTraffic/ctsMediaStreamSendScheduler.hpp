@@ -0,0 +1,297 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <map>
+#include <memory>
+#include <vector>
+// os headers
+#include <Windows.h>
+// wil headers
+#include <wil/resource.h>
+// ctl headers
+#include <ctTimer.hpp>
+#include <ctMemoryGuard.hpp>
+
+namespace ctsTraffic
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsMediaStreamSendScheduler
+    ///
+    /// Schedules the next frame of every media stream the server is sending
+    /// - streams are spread round-robin across one worker per processor
+    ///   with -Threading:per-core, each worker's timer runs on one of the per-processor pools
+    /// - each worker keeps its streams ordered by when their next frame is due,
+    ///   and owns a single threadpool timer armed for the earliest of them
+    /// - when that timer fires, the worker sends every frame due within this tick across all of its streams,
+    ///   then re-arms for the next due stream
+    ///
+    /// This replaces a threadpool timer per stream with one timer per worker,
+    /// so the number of timer expirations per tick does not grow with the number of streams
+    ///
+    /// A Stream is owned by the caller and must be canceled before it is destroyed:
+    /// cancel() waits for a send already running for that stream to return,
+    /// and a canceled stream is never scheduled again - including by that running send
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsMediaStreamSendScheduler
+    {
+    public:
+        // frames due within this many milliseconds of the timer firing are sent in the same tick
+        static constexpr long long TickToleranceMilliseconds = 1LL;
+        static constexpr unsigned long MaxWorkerCount = 64;
+
+        typedef void (*StreamCallback)(_In_ PVOID _context) noexcept;
+
+        class Worker;
+        class Stream
+        {
+        public:
+            Stream(StreamCallback _callback, _In_ PVOID _context) noexcept :
+                callback(_callback),
+                context(_context)
+            {
+            }
+            ~Stream() = default;
+
+            Stream(const Stream&) = delete;
+            Stream& operator=(const Stream&) = delete;
+            Stream(Stream&&) = delete;
+            Stream& operator=(Stream&&) = delete;
+
+        private:
+            friend class Worker;
+            friend class ctsMediaStreamSendScheduler;
+
+            const StreamCallback callback;
+            PVOID const context;
+            // assigned on the first call to schedule()
+            Worker* worker = nullptr;
+            // the remaining members are guarded by the worker's lock
+            std::multimap<long long, Stream*>::iterator position{};
+            bool scheduled = false;
+            bool running = false;
+            bool canceled = false;
+        };
+
+        //
+        // The scheduler for the process
+        // - the threadpool environments are only used by the first call, which creates the workers
+        // - with per-core environments, a worker is created for each (up to MaxWorkerCount) in its environment:
+        //   otherwise a worker is created for each processor in _environment
+        // - never freed: streams can still be canceling as the process shuts down
+        //
+        static ctsMediaStreamSendScheduler& Instance(
+            PTP_CALLBACK_ENVIRON _environment,
+            _In_reads_opt_(_per_core_count) PTP_CALLBACK_ENVIRON _per_core_environments = nullptr,
+            size_t _per_core_count = 0)
+        {
+            static ctsMediaStreamSendScheduler* s_scheduler = new ctsMediaStreamSendScheduler(_environment, _per_core_environments, _per_core_count);
+            return *s_scheduler;
+        }
+
+        //
+        // Queues the stream's callback to be run once _due_milliseconds (in ctTimer::ctSnapQpcInMillis) has been reached
+        // - a stream has at most one scheduled callback: scheduling again replaces the due time
+        // - does nothing once the stream has been canceled
+        //
+        void schedule(Stream& _stream, long long _due_milliseconds)
+        {
+            if (!_stream.worker)
+            {
+                const auto next_worker = ctl::ctMemoryGuardIncrement(&worker_counter);
+                _stream.worker = workers[static_cast<size_t>(next_worker) % workers.size()].get();
+            }
+            _stream.worker->schedule(_stream, _due_milliseconds);
+        }
+
+        //
+        // Removes the stream from its worker, waiting for a callback which is already running
+        // - must not be called from within the stream's own callback
+        //
+        static void cancel(Stream& _stream) noexcept
+        {
+            if (_stream.worker)
+            {
+                _stream.worker->cancel(_stream);
+            }
+        }
+
+        ctsMediaStreamSendScheduler(const ctsMediaStreamSendScheduler&) = delete;
+        ctsMediaStreamSendScheduler& operator=(const ctsMediaStreamSendScheduler&) = delete;
+        ctsMediaStreamSendScheduler(ctsMediaStreamSendScheduler&&) = delete;
+        ctsMediaStreamSendScheduler& operator=(ctsMediaStreamSendScheduler&&) = delete;
+
+        class Worker
+        {
+        public:
+            explicit Worker(PTP_CALLBACK_ENVIRON _environment)
+            {
+                timer.reset(::CreateThreadpoolTimer(TimerCallback, this, _environment));
+                THROW_LAST_ERROR_IF(!timer);
+            }
+            ~Worker() = default;
+
+            void schedule(Stream& _stream, long long _due_milliseconds)
+            {
+                const auto lock = guard.lock_exclusive();
+                if (_stream.canceled)
+                {
+                    // the stream's running callback scheduled its next frame while cancel() waited for it
+                    return;
+                }
+                if (_stream.scheduled)
+                {
+                    due_streams.erase(_stream.position);
+                    _stream.scheduled = false;
+                }
+                _stream.position = due_streams.emplace(_due_milliseconds, &_stream); // can throw
+                _stream.scheduled = true;
+
+                // a running tick re-arms the timer once it has sent its frames
+                if (!in_tick && (0LL == armed_due_milliseconds || _due_milliseconds < armed_due_milliseconds))
+                {
+                    arm_timer(_due_milliseconds);
+                }
+            }
+
+            void cancel(Stream& _stream) noexcept
+            {
+                auto lock = guard.lock_exclusive();
+                _stream.canceled = true;
+                if (_stream.scheduled)
+                {
+                    due_streams.erase(_stream.position);
+                    _stream.scheduled = false;
+                }
+                while (_stream.running)
+                {
+                    stream_completed.wait(lock);
+                }
+            }
+
+            Worker(const Worker&) = delete;
+            Worker& operator=(const Worker&) = delete;
+            Worker(Worker&&) = delete;
+            Worker& operator=(Worker&&) = delete;
+
+        private:
+            wil::srwlock guard;
+            wil::condition_variable stream_completed;
+            _Guarded_by_(guard) std::multimap<long long, Stream*> due_streams;
+            // the streams being sent in the current tick: kept to avoid allocating every tick
+            _Guarded_by_(guard) std::vector<Stream*> tick_streams;
+            _Guarded_by_(guard) long long armed_due_milliseconds = 0LL;
+            _Guarded_by_(guard) bool in_tick = false;
+            // destroyed first, waiting for the TimerCallback before the members it uses are released
+            wil::unique_threadpool_timer timer;
+
+            _Requires_exclusive_lock_held_(guard)
+            void arm_timer(long long _due_milliseconds) noexcept
+            {
+                const auto now = ctl::ctTimer::ctSnapQpcInMillis();
+                FILETIME relative_due_time(ctl::ctTimer::ctConvertMillisToRelativeFiletime(_due_milliseconds > now ? _due_milliseconds - now : 0LL));
+                ::SetThreadpoolTimer(timer.get(), &relative_due_time, 0, 0);
+                armed_due_milliseconds = _due_milliseconds;
+            }
+
+            static VOID CALLBACK TimerCallback(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_TIMER) noexcept
+            {
+                auto* const this_ptr = static_cast<Worker*>(_context);
+
+                {
+                    const auto lock = this_ptr->guard.lock_exclusive();
+                    if (this_ptr->in_tick)
+                    {
+                        // the timer was re-armed and expired again before the running tick took the lock:
+                        // the running tick sends what is due and re-arms once it completes
+                        return;
+                    }
+                    this_ptr->in_tick = true;
+                    this_ptr->armed_due_milliseconds = 0LL;
+
+                    const auto tick_end = ctl::ctTimer::ctSnapQpcInMillis() + TickToleranceMilliseconds;
+                    auto due_stream = this_ptr->due_streams.begin();
+                    while (due_stream != this_ptr->due_streams.end() && due_stream->first <= tick_end)
+                    {
+                        due_stream->second->scheduled = false;
+                        due_stream->second->running = true;
+                        // tick_streams only grows to the largest number of frames sent in one tick
+                        this_ptr->tick_streams.push_back(due_stream->second);
+                        due_stream = this_ptr->due_streams.erase(due_stream);
+                    }
+                }
+
+                // streams are called without the lock held, as each schedules its own next frame
+                // - tick_streams is only modified by the callback which set in_tick, so is not guarded while it runs
+                for (auto* const stream : this_ptr->tick_streams)
+                {
+                    stream->callback(stream->context);
+                }
+
+                {
+                    const auto lock = this_ptr->guard.lock_exclusive();
+                    for (auto* const stream : this_ptr->tick_streams)
+                    {
+                        stream->running = false;
+                    }
+                    this_ptr->tick_streams.clear();
+                    this_ptr->in_tick = false;
+                    if (!this_ptr->due_streams.empty())
+                    {
+                        this_ptr->arm_timer(this_ptr->due_streams.begin()->first);
+                    }
+                }
+                this_ptr->stream_completed.notify_all();
+            }
+        };
+
+    private:
+        ctsMediaStreamSendScheduler(
+            PTP_CALLBACK_ENVIRON _environment,
+            _In_reads_opt_(_per_core_count) PTP_CALLBACK_ENVIRON _per_core_environments,
+            size_t _per_core_count)
+        {
+            if (!_per_core_environments)
+            {
+                _per_core_count = 0;
+            }
+
+            size_t worker_count = (_per_core_count > 0) ? _per_core_count : ::GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+            if (worker_count > MaxWorkerCount)
+            {
+                worker_count = MaxWorkerCount;
+            }
+            if (0 == worker_count)
+            {
+                worker_count = 1;
+            }
+            workers.reserve(worker_count);
+            for (size_t worker = 0; worker < worker_count; ++worker)
+            {
+                // with more per-core pools than workers, the workers are spread evenly across the pools
+                PTP_CALLBACK_ENVIRON worker_environment = (_per_core_count > 0) ?
+                    &_per_core_environments[worker * _per_core_count / worker_count] :
+                    _environment;
+                workers.emplace_back(std::make_unique<Worker>(worker_environment));
+            }
+        }
+        ~ctsMediaStreamSendScheduler() = default;
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        long long worker_counter = 0LL;
+    };
+}
@@ -33,6 +33,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include "ctsMediaStreamServerConnectedSocket.h"
 #include "ctsMediaStreamServerListeningSocket.h"
 #include "ctsMediaStreamProtocol.hpp"
+#include "ctsSockaddrMap.hpp"
 
 
 namespace ctsTraffic
@@ -69,8 +70,8 @@ namespace ctsTraffic
             const auto shared_socket(_weak_socket.lock());
             if (shared_socket)
             {
-                // hold a reference on the iopattern
-                auto shared_pattern(shared_socket->io_pattern());
+                // the iopattern lives as long as the ctsSocket
+                const auto& shared_pattern(shared_socket->io_pattern());
                 do
                 {
                     next_task = shared_pattern->initiate_io();
@@ -90,8 +91,8 @@ namespace ctsTraffic
                 auto exception_shared_socket(_weak_socket.lock());
                 if (exception_shared_socket)
                 {
-                    // hold a reference on the iopattern
-                    auto exception_shared_pattern(exception_shared_socket->io_pattern());
+                    // the iopattern lives as long as the ctsSocket
+                    const auto& exception_shared_pattern(exception_shared_socket->io_pattern());
                     // must complete any IO that was requested but not scheduled
                     exception_shared_pattern->complete_io(next_task, 0, WSAENOBUFS);
                     if (0 == exception_shared_socket->pended_io())
@@ -126,9 +127,26 @@ namespace ctsTraffic
 
         // function for doing the actual IO for a UDP media stream datagram connection
         wsIOResult ConnectedSocketIo(_In_ ctsMediaStreamServerConnectedSocket* connected_socket) noexcept;
+        // function for sending a frame again in response to a NACK
+        wsIOResult RetransmitFrame(_In_ ctsMediaStreamServerConnectedSocket* connected_socket, const ctsMediaStreamSentFrame& sent_frame) noexcept;
+
+        // -Recovery:nack : each stream keeps -BufferDepth seconds of frames to retransmit
+        static unsigned long RetransmitHistoryFrames() noexcept
+        {
+            const auto& media_stream = ctsConfig::GetMediaStream();
+            if (!media_stream.NackRecovery)
+            {
+                return 0UL;
+            }
+            return static_cast<unsigned long>(media_stream.BufferDepthSeconds) * static_cast<unsigned long>(media_stream.FramesPerSecond);
+        }
+
+        // connected sockets keyed by their remote address
+        // - found for every frame sent, so the map guards itself by shard rather than taking socket_vector_guard
+        // - entries are only added under socket_vector_guard, so an address can only be checked then added once
+        ctsSockaddrMap<ctsMediaStreamServerConnectedSocket> connected_sockets;
 
         wil::critical_section socket_vector_guard;
-        _Guarded_by_(socket_vector_guard) std::vector<std::shared_ptr<ctsMediaStreamServerConnectedSocket>> connected_sockets;
         // weak_ptr<> to ctsSocket objects ready to accept a connection
         _Guarded_by_(socket_vector_guard) std::vector<std::weak_ptr<ctsSocket>> accepting_sockets;
         // endpoints that have been received from clients not yet matched to ctsSockets
@@ -205,33 +223,18 @@ namespace ctsTraffic
                 throw ctl::ctException(WSAECONNABORTED, L"ctsSocket already freed", L"ctsMediaStreamServer", false);
             }
 
-            std::shared_ptr<ctsMediaStreamServerConnectedSocket> shared_connected_socket;
+            // find the matching connected_socket
+            const auto shared_connected_socket = connected_sockets.find(shared_socket->target_address());
+            if (!shared_connected_socket)
             {
-                // must guard connected_sockets since we need to add it
-                const auto lock_connected_object = socket_vector_guard.lock();
-
-                // find the matching connected_socket
-                const auto found_socket = std::find_if(
-                    std::begin(connected_sockets),
-                    std::end(connected_sockets),
-                    [&shared_socket](const std::shared_ptr<ctsMediaStreamServerConnectedSocket>& _connected_socket) noexcept {
-                        return (shared_socket->target_address() == _connected_socket->get_remote_address());
-                    }
-                );
-
-                if (found_socket == std::end(connected_sockets))
-                {
-                    ctsConfig::PrintErrorInfo(
-                        ctl::ctString::ctFormatString("ctsMediaStreamServer - failed to find the socket with remote address %ws in our connected socket list to continue sending datagrams",
-                            shared_socket->target_address().WriteCompleteAddress().c_str()).c_str());
-                    throw ctl::ctException(ERROR_INVALID_DATA, L"ctsSocket was not found in the connected sockets to continue sending datagrams", L"ctsMediaStreamServer", false);
-                }
-
-                shared_connected_socket = *found_socket;
+                ctsConfig::PrintErrorInfo(
+                    ctl::ctString::ctFormatString("ctsMediaStreamServer - failed to find the socket with remote address %ws in our connected socket list to continue sending datagrams",
+                        shared_socket->target_address().WriteCompleteAddress().c_str()).c_str());
+                throw ctl::ctException(ERROR_INVALID_DATA, L"ctsSocket was not found in the connected sockets to continue sending datagrams", L"ctsMediaStreamServer", false);
             }
-            // must call into connected socket without holding a lock
-            // and without maintaining an iterator into the list
-            // since the call to schedule_io could end up asking to remove this object from the list
+
+            // the map lock is not held when calling into the connected socket
+            // since the call to schedule_io could end up asking to remove this object from the map
             shared_connected_socket->schedule_task(_task);
         }
 
@@ -254,16 +257,12 @@ namespace ctsTraffic
                 {
                     auto waiting_endpoint = awaiting_endpoints.rbegin();
 
-                    const auto existing_socket = std::find_if(
-                        std::begin(connected_sockets),
-                        std::end(connected_sockets),
-                        [&](const std::shared_ptr<ctsMediaStreamServerConnectedSocket>& _connected_socket) noexcept {
-                            return waiting_endpoint->second == _connected_socket->get_remote_address();
-                        });
-
-                    if (existing_socket != std::end(connected_sockets))
+                    if (connected_sockets.find(waiting_endpoint->second))
                     {
-                        ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
+                        {
+                            const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+                            ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
+                        }
                         PrintDebugInfo(L"ctsMediaStreamServer::accept_socket - socket with remote address %ws asked to be Started but was already established",
                             waiting_endpoint->second.WriteCompleteAddress().c_str());
                         // return early if this was a duplicate request: this can happen if there is latency or drops
@@ -271,12 +270,15 @@ namespace ctsTraffic
                         return;
                     }
 
-                    connected_sockets.emplace_back(
+                    connected_sockets.insert(
+                        waiting_endpoint->second,
                         std::make_shared<ctsMediaStreamServerConnectedSocket>(
                             _weak_socket,
                             waiting_endpoint->first,
                             waiting_endpoint->second,
-                            ConnectedSocketIo));
+                            ConnectedSocketIo,
+                            RetransmitHistoryFrames(),
+                            RetransmitFrame));
 
                     PrintDebugInfo(L"ctsMediaStreamServer::accept_socket - socket with remote address %ws added to connected_sockets",
                         waiting_endpoint->second.WriteCompleteAddress().c_str());
@@ -308,19 +310,8 @@ namespace ctsTraffic
         // - remove_socket takes the remote address to find the socket
         void remove_socket(const ctl::ctSockaddr& _target_addr)
         {
-            const auto lock_connected_object = socket_vector_guard.lock();
-
-            const auto found_socket = std::find_if(
-                std::begin(connected_sockets),
-                std::end(connected_sockets),
-                [&_target_addr](const std::shared_ptr<ctsMediaStreamServerConnectedSocket>& _connected_socket) noexcept {
-                    return _target_addr == _connected_socket->get_remote_address();
-                });
-
-            if (found_socket != std::end(connected_sockets))
-            {
-                connected_sockets.erase(found_socket);
-            }
+            // the removed socket is released once the map lock is no longer held
+            connected_sockets.remove(_target_addr);
         }
 
         // Processes the incoming START request from the client
@@ -330,15 +321,12 @@ namespace ctsTraffic
         {
             const auto lock_awaiting_object = socket_vector_guard.lock();
 
-            const auto existing_socket = std::find_if(
-                std::begin(connected_sockets),
-                std::end(connected_sockets),
-                [&_target_addr](const std::shared_ptr<ctsMediaStreamServerConnectedSocket>& _connected_socket) noexcept {
-                    return _target_addr == _connected_socket->get_remote_address();
-                });
-            if (existing_socket != std::end(connected_sockets))
+            if (connected_sockets.find(_target_addr))
             {
-                ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
+                {
+                    const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+                    ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
+                }
                 PrintDebugInfo(L"ctsMediaStreamServer::start - socket with remote address %ws asked to be Started but was already in connected_sockets",
                     _target_addr.WriteCompleteAddress().c_str());
                 // return early if this was a duplicate request: this can happen if there is latency or drops
@@ -353,7 +341,10 @@ namespace ctsTraffic
                 });
             if (awaiting_endpoint != std::end(awaiting_endpoints))
             {
-                ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
+                {
+                    const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+                    ctsConfig::Settings->UdpStatusDetails.duplicate_frames.increment();
+                }
                 PrintDebugInfo(L"ctsMediaStreamServer::start - socket with remote address %ws asked to be Started but was already in awaiting endpoints",
                     _target_addr.WriteCompleteAddress().c_str());
                 // return early if this was a duplicate request: this can happen if there is latency or drops
@@ -370,8 +361,9 @@ namespace ctsTraffic
                 if (shared_instance)
                 {
                     // 'move' the accepting socket to connected
-                    connected_sockets.emplace_back(
-                        std::make_shared<ctsMediaStreamServerConnectedSocket>(weak_instance, _socket, _target_addr, ConnectedSocketIo));
+                    connected_sockets.insert(
+                        _target_addr,
+                        std::make_shared<ctsMediaStreamServerConnectedSocket>(weak_instance, _socket, _target_addr, ConnectedSocketIo, RetransmitHistoryFrames(), RetransmitFrame));
 
                     PrintDebugInfo(L"ctsMediaStreamServer::start - socket with remote address %ws added to connected_sockets",
                         _target_addr.WriteCompleteAddress().c_str());
@@ -401,6 +393,123 @@ namespace ctsTraffic
             }
         }
 
+        // Processes an incoming NACK from the client
+        // - queues the requested frames still in the stream's history to be retransmitted
+        //   off the listening socket's receive path, so one stream's NACK doesn't delay other streams' requests
+        void Retransmit(const ctl::ctSockaddr& _target_addr, const ctsMediaStreamMessage& _nack) noexcept
+        {
+            const auto shared_connected_socket = connected_sockets.find(_target_addr);
+            if (!shared_connected_socket)
+            {
+                // the stream already completed
+                return;
+            }
+
+            shared_connected_socket->queue_retransmit(_nack);
+        }
+
+        // Sends every datagram of the encoded frame
+        // - only the bytes of the frame's data datagrams are returned: parity is not part of the frame
+        static wsIOResult SendFrameDatagrams(
+            SOCKET socket,
+            const ctl::ctSockaddr& remote_addr,
+            long long seq_number,
+            ctsMediaStreamSendRequests& sending_requests) noexcept
+        {
+            wsIOResult return_results;
+            // every datagram of the frame is stamped with the same send time
+            sending_requests.stamp_send_time();
+            size_t datagram = 0;
+            for (auto& send_request : sending_requests)
+            {
+                // making a synchronous call
+                DWORD bytes_sent{};
+                const auto send_result = WSASendTo(
+                    socket,
+                    send_request.data(),
+                    static_cast<DWORD>(send_request.size()),
+                    &bytes_sent,
+                    0,
+                    remote_addr.sockaddr(),
+                    remote_addr.length(),
+                    nullptr,
+                    nullptr);
+                if (SOCKET_ERROR == send_result)
+                {
+                    const auto error = WSAGetLastError();
+                    try
+                    {
+                        if (WSAEMSGSIZE == error)
+                        {
+                            unsigned long bytes_requested = 0;
+                            // iterate across each WSABUF* in the array
+                            for (auto& wasbuf : send_request)
+                            {
+                                bytes_requested += wasbuf.len;
+                            }
+                            ctsConfig::PrintErrorInfo(
+                                ctl::ctString::ctFormatString("WSASendTo(%Iu, seq %lld, %ws) failed with WSAEMSGSIZE : attempted to send datagram of size %u bytes",
+                                    socket,
+                                    seq_number,
+                                    remote_addr.WriteCompleteAddress().c_str(),
+                                    bytes_requested).c_str());
+                        }
+                        else
+                        {
+                            ctsConfig::PrintErrorInfo(
+                                ctl::ctString::ctFormatString("WSASendTo(%Iu, seq %lld, %ws) failed [%d]",
+                                    socket,
+                                    seq_number,
+                                    remote_addr.WriteCompleteAddress().c_str(),
+                                    error).c_str());
+                        }
+                    }
+                    catch (...)
+                    {
+                        // best effort
+                    }
+                    return wsIOResult(error);
+                }
+
+                // successfully completed synchronously
+                if (datagram < sending_requests.data_size())
+                {
+                    return_results.bytes_transferred += bytes_sent;
+                }
+                ++datagram;
+            }
+            return return_results;
+        }
+
+        wsIOResult RetransmitFrame(_In_ ctsMediaStreamServerConnectedSocket* connected_socket, const ctsMediaStreamSentFrame& sent_frame) noexcept
+        {
+            const SOCKET socket = connected_socket->get_sending_socket();
+            if (INVALID_SOCKET == socket)
+            {
+                return wsIOResult(WSA_OPERATION_ABORTED);
+            }
+
+            PrintDebugInfo(
+                L"\t\tctsMediaStreamServer retransmitting seq number %lld (%lu bytes)\n",
+                sent_frame.sequence_number,
+                sent_frame.buffer_length);
+
+            auto& retransmit_requests = connected_socket->get_retransmit_requests();
+            try
+            {
+                retransmit_requests.encode(
+                    sent_frame.buffer_length,
+                    sent_frame.sequence_number,
+                    sent_frame.buffer,
+                    UdpDatagramProtocolHeaderFlagRetransmit);
+            }
+            catch (...)
+            {
+                return wsIOResult(WSAENOBUFS);
+            }
+            return SendFrameDatagrams(socket, connected_socket->get_remote_address(), sent_frame.sequence_number, retransmit_requests);
+        }
+
         wsIOResult ConnectedSocketIo(_In_ ctsMediaStreamServerConnectedSocket* connected_socket) noexcept
         {
             const SOCKET socket = connected_socket->get_sending_socket();
@@ -457,63 +566,39 @@ namespace ctsTraffic
                     seq_number,
                     next_task.buffer_length);
 
-                ctsMediaStreamSendRequests sending_requests(
-                    next_task.buffer_length, // total bytes to send
-                    seq_number,
-                    next_task.buffer);
-                for (auto& send_request : sending_requests)
+                // the connected socket's send requests are reused frame to frame to keep their header block
+                auto& sending_requests = connected_socket->get_send_requests();
+                try
                 {
-                    // making a synchronous call
-                    DWORD bytes_sent{};
-                    const auto send_result = WSASendTo(
-                        socket,
-                        send_request.data(),
-                        static_cast<DWORD>(send_request.size()),
-                        &bytes_sent,
-                        0,
-                        remote_addr.sockaddr(),
-                        remote_addr.length(),
-                        nullptr,
-                        nullptr);
-                    if (SOCKET_ERROR == send_result)
+                    sending_requests.encode(
+                        next_task.buffer_length, // total bytes to send
+                        seq_number,
+                        next_task.buffer);
+
+                    const auto& media_stream = ctsConfig::GetMediaStream();
+                    if (media_stream.FecDataDatagrams > 0)
                     {
-                        const auto error = WSAGetLastError();
-                        try
-                        {
-                            if (WSAEMSGSIZE == error)
-                            {
-                                unsigned long bytes_requested = 0;
-                                // iterate across each WSABUF* in the array
-                                for (auto& wasbuf : send_request)
-                                {
-                                    bytes_requested += wasbuf.len;
-                                }
-                                ctsConfig::PrintErrorInfo(
-                                    ctl::ctString::ctFormatString("WSASendTo(%Iu, seq %lld, %ws) failed with WSAEMSGSIZE : attempted to send datagram of size %u bytes",
-                                        socket,
-                                        seq_number,
-                                        remote_addr.WriteCompleteAddress().c_str(),
-                                        bytes_requested).c_str());
-                            }
-                            else
-                            {
-                                ctsConfig::PrintErrorInfo(
-                                    ctl::ctString::ctFormatString("WSASendTo(%Iu, seq %lld, %ws) failed [%d]",
-                                        socket,
-                                        seq_number,
-                                        remote_addr.WriteCompleteAddress().c_str(),
-                                        error).c_str());
-                            }
-                        }
-                        catch (...)
-                        {
-                            // best effort
-                        }
-                        return wsIOResult(error);
+                        LARGE_INTEGER encode_start;
+                        QueryPerformanceCounter(&encode_start);
+                        sending_requests.add_parity(media_stream.FecDataDatagrams, media_stream.FecParityDatagrams);
+                        LARGE_INTEGER encode_end;
+                        QueryPerformanceCounter(&encode_end);
+
+                        const auto parity_datagrams = static_cast<long long>(sending_requests.size() - sending_requests.data_size());
+                        connected_socket->record_fec_encode(parity_datagrams, encode_end.QuadPart - encode_start.QuadPart);
+                        const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+                        ctsConfig::Settings->UdpStatusDetails.fec_parity_bits.add(static_cast<long long>(sending_requests.parity_bytes()) * 8);
+                        ctsConfig::Settings->UdpStatusDetails.fec_cpu_ticks.add(encode_end.QuadPart - encode_start.QuadPart);
                     }
-
-                    // successfully completed synchronously
-                    return_results.bytes_transferred += bytes_sent;
+                }
+                catch (...)
+                {
+                    return wsIOResult(WSAENOBUFS);
+                }
+                return_results = SendFrameDatagrams(socket, remote_addr, seq_number, sending_requests);
+                if (NO_ERROR == return_results.error_code)
+                {
+                    connected_socket->record_sent_frame(seq_number, next_task);
                 }
             }
 
@@ -20,6 +20,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // project headers
 #include "ctsSocket.h"
 #include "ctsIOTask.hpp"
+#include "ctsMediaStreamProtocol.hpp"
 
 // We register both of these functions with ctsConfig:
 // - ctsMediaStreamServerListener is the "Accepting" function
@@ -55,6 +56,10 @@ namespace ctsTraffic
         // - if we have a waiting ctsSocket to accept it, will add it to connected_sockets
         // - else we'll queue it to awaiting_endpoints
         void Start(SOCKET _socket, const ctl::ctSockaddr& _local_addr, const ctl::ctSockaddr& _target_addr);
+
+        // Processes an incoming NACK from the client
+        // - retransmits the requested frames still in the stream's history
+        void Retransmit(const ctl::ctSockaddr& _target_addr, const ctsMediaStreamMessage& _nack) noexcept;
     }
 
     // Called to 'accept' incoming connections
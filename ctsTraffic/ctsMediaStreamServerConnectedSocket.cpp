@@ -17,6 +17,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <memory>
 #include <functional>
 #include <utility>
+#include <vector>
 // os headers
 #include <Windows.h>
 #include <WinSock2.h>
@@ -32,25 +33,43 @@ using namespace ctl;
 
 namespace ctsTraffic
 {
+    // with -Threading:per-core, the scheduler's workers run on the per-processor pools
+    static ctsMediaStreamSendScheduler& SendScheduler()
+    {
+        PTP_CALLBACK_ENVIRON per_core_environments = nullptr;
+        const auto per_core_count = ctsConfig::PerCoreThreadpoolEnvironments(&per_core_environments);
+        return ctsMediaStreamSendScheduler::Instance(ctsConfig::Settings->PTPEnvironment, per_core_environments, per_core_count);
+    }
+
     ctsMediaStreamServerConnectedSocket::ctsMediaStreamServerConnectedSocket(
         std::weak_ptr<ctsSocket> _weak_socket,
         SOCKET _sending_socket,
         ctSockaddr _remote_addr,
-        ctsMediaStreamConnectedSocketIoFunctor _io_functor) :
+        ctsMediaStreamConnectedSocketIoFunctor _io_functor,
+        unsigned long _retransmit_history_frames,
+        ctsMediaStreamRetransmitFunction _retransmit_function) :
+        sent_frames(_retransmit_history_frames),
+        retransmit_function(_retransmit_function),
+        scheduler(SendScheduler()),
+        scheduled_stream(ctsMediaStreamSendCallback, this),
         weak_socket(std::move(_weak_socket)),
         io_functor(std::move(_io_functor)),
         sending_socket(_sending_socket),
         remote_addr(std::move(_remote_addr)),
         connect_time(ctTimer::ctSnapQpcInMillis())
     {
-        task_timer.reset(CreateThreadpoolTimer(ctsMediaStreamTimerCallback, this, ctsConfig::Settings->PTPEnvironment));
-        THROW_LAST_ERROR_IF(!task_timer);
+        if (!sent_frames.empty() && retransmit_function)
+        {
+            retransmit_work.reset(CreateThreadpoolWork(RetransmitWorker, this, ctsConfig::Settings->PTPEnvironment));
+            THROW_LAST_ERROR_IF_NULL(retransmit_work.get());
+        }
     }
 
     ctsMediaStreamServerConnectedSocket::~ctsMediaStreamServerConnectedSocket() noexcept
     {
-        // stop the TP before letting the d'tor delete any member objects
-        task_timer.reset();
+        // stop scheduled sends and retransmits before letting the d'tor delete any member objects
+        ctsMediaStreamSendScheduler::cancel(scheduled_stream);
+        retransmit_work.reset();
     }
 
     void ctsMediaStreamServerConnectedSocket::schedule_task(const ctsIOTask& _task) noexcept
@@ -64,20 +83,117 @@ namespace ctsTraffic
             {
                 // in this case, immediately schedule the WSASendTo
                 next_task = _task;
-                ctsMediaStreamTimerCallback(nullptr, this, nullptr);
+                ctsMediaStreamSendCallback(this);
 
             }
             else
             {
-                FILETIME ftDueTime(ctTimer::ctConvertMillisToRelativeFiletime(_task.time_offset_milliseconds));
-                // assign the next task *and* schedule the timer while in *this object lock
+                // assign the next task *and* schedule the send while in *this object lock
                 next_task = _task;
-                SetThreadpoolTimer(task_timer.get(), &ftDueTime, 0, 0);
+                scheduler.schedule(scheduled_stream, ctTimer::ctSnapQpcInMillis() + _task.time_offset_milliseconds);
             }
             _Analysis_assume_lock_released_(object_guard);
         }
     }
 
+    void ctsMediaStreamServerConnectedSocket::queue_retransmit(const ctsMediaStreamMessage& _nack) noexcept
+    {
+        if (!retransmit_work)
+        {
+            return;
+        }
+
+        bool submit_work = false;
+        {
+            const auto lock = nack_guard.lock();
+            if (pending_nacks.size() < MaxPendingNacks)
+            {
+                try
+                {
+                    pending_nacks.push_back(_nack);
+                    // one callback retransmits every NACK queued until it runs
+                    submit_work = (1 == pending_nacks.size());
+                }
+                catch (...)
+                {
+                    // dropped like a NACK arriving with MaxPendingNacks queued
+                }
+            }
+        }
+        if (submit_work)
+        {
+            SubmitThreadpoolWork(retransmit_work.get());
+        }
+    }
+
+    VOID NTAPI ctsMediaStreamServerConnectedSocket::RetransmitWorker(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WORK) noexcept
+    {
+        auto* this_ptr = static_cast<ctsMediaStreamServerConnectedSocket*>(_context);
+
+        std::vector<ctsMediaStreamMessage> nacks;
+        {
+            const auto lock = this_ptr->nack_guard.lock();
+            nacks.swap(this_ptr->pending_nacks);
+        }
+
+        for (const auto& nack : nacks)
+        {
+            const auto frames_sent = this_ptr->retransmit(nack);
+            PrintDebugInfo(
+                L"\t\tctsMediaStreamServer retransmitted %lu frames for a NACK of %lu ranges\n",
+                frames_sent,
+                nack.nack_range_count);
+        }
+    }
+
+    unsigned long ctsMediaStreamServerConnectedSocket::retransmit(const ctsMediaStreamMessage& _nack) noexcept
+    {
+        // the sent frames reference the pattern's send buffers: hold the ctsSocket while sending from them
+        const auto shared_socket(weak_socket.lock());
+        if (!shared_socket)
+        {
+            return 0;
+        }
+
+        const auto lock = object_guard.lock();
+        if (sent_frames.empty())
+        {
+            return 0;
+        }
+
+        unsigned long frames_sent = 0;
+        unsigned long datagrams_sent = 0;
+        for (unsigned long range = 0; range < _nack.nack_range_count && datagrams_sent < MaxRetransmitDatagramsPerNack; ++range)
+        {
+            const auto& nack_range = _nack.nack_ranges[range];
+            // frames older than the history have been overwritten: only look at as many as the history holds
+            const auto frame_count = nack_range.frame_count < sent_frames.size() ? nack_range.frame_count : static_cast<unsigned long>(sent_frames.size());
+            for (unsigned long frame = 0; frame < frame_count && datagrams_sent < MaxRetransmitDatagramsPerNack; ++frame)
+            {
+                const long long requested_sequence_number = nack_range.first_sequence_number + frame;
+                if (requested_sequence_number <= 0)
+                {
+                    continue;
+                }
+                const auto& sent_frame = sent_frames[static_cast<size_t>(requested_sequence_number) % sent_frames.size()];
+                if (sent_frame.sequence_number != requested_sequence_number)
+                {
+                    continue;
+                }
+
+                const auto send_results = retransmit_function(this, sent_frame);
+                if (send_results.error_code != NO_ERROR)
+                {
+                    // the next frame sent from the stream will see the same failure
+                    return frames_sent;
+                }
+                ++frames_sent;
+                datagrams_sent += static_cast<unsigned long>(retransmit_requests.size());
+            }
+        }
+        return frames_sent;
+    }
+
     void ctsMediaStreamServerConnectedSocket::complete_state(unsigned long _error_code) const noexcept
     {
         std::shared_ptr<ctsSocket> shared_socket(weak_socket);
@@ -87,7 +203,7 @@ namespace ctsTraffic
         }
     }
 
-    VOID CALLBACK ctsMediaStreamServerConnectedSocket::ctsMediaStreamTimerCallback(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_TIMER) noexcept
+    void ctsMediaStreamServerConnectedSocket::ctsMediaStreamSendCallback(_In_ PVOID _context) noexcept
     {
         auto* this_ptr = static_cast<ctsMediaStreamServerConnectedSocket*>(_context);
 
@@ -98,8 +214,8 @@ namespace ctsTraffic
             return;
         }
 
-        // hold a reference on the iopattern
-        auto shared_pattern = shared_socket->io_pattern();
+        // the iopattern lives as long as the ctsSocket
+        const auto& shared_pattern = shared_socket->io_pattern();
 
         const auto lock = this_ptr->object_guard.lock();
         _Analysis_assume_lock_acquired_(this_ptr->object_guard);
@@ -148,6 +264,12 @@ namespace ctsTraffic
             }
         }
 
+        if (ctsIOStatus::ContinueIo != status)
+        {
+            // the pattern prints its results as the state completes
+            shared_pattern->add_fec_results(this_ptr->fec_parity_datagrams, this_ptr->fec_encode_ticks);
+        }
+
         if (ctsIOStatus::FailedIo == status)
         {
             // if IO has failed, we won't have anymore scheduled in the future
@@ -15,6 +15,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 
 // cpp headers
 #include <memory>
+#include <vector>
 // os headers
 #include <Windows.h>
 #include <WinSock2.h>
@@ -24,6 +25,8 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <ctSockaddr.hpp>
 // project headers
 #include "ctsIOTask.hpp"
+#include "ctsMediaStreamProtocol.hpp"
+#include "ctsMediaStreamSendScheduler.hpp"
 #include "ctsSocket.h"
 #include "ctsWinsockLayer.h"
 
@@ -32,14 +35,41 @@ namespace ctsTraffic
     class ctsMediaStreamServerConnectedSocket;
     typedef std::function<wsIOResult(ctsMediaStreamServerConnectedSocket*)> ctsMediaStreamConnectedSocketIoFunctor;
 
+    // a frame recently sent, kept to be retransmitted with -Recovery:nack
+    // - the buffer is the pattern's send buffer, which lives as long as the ctsSocket
+    struct ctsMediaStreamSentFrame
+    {
+        long long sequence_number = 0LL;
+        const char* buffer = nullptr;
+        unsigned long buffer_length = 0UL;
+    };
+    typedef wsIOResult (*ctsMediaStreamRetransmitFunction)(_In_ ctsMediaStreamServerConnectedSocket*, const ctsMediaStreamSentFrame&);
+
     class ctsMediaStreamServerConnectedSocket
     {
     private:
         // the CS is mutable so we can take a lock / release a lock in const methods
         mutable wil::critical_section object_guard;
         _Guarded_by_(object_guard) ctsIOTask next_task;
-
-        wil::unique_threadpool_timer task_timer;
+        // reused for each frame sent, keeping the block of datagram headers
+        _Guarded_by_(object_guard) ctsMediaStreamSendRequests send_requests;
+        // the last frames sent, indexed by sequence number modulo the size - empty unless -Recovery:nack
+        _Guarded_by_(object_guard) std::vector<ctsMediaStreamSentFrame> sent_frames;
+        _Guarded_by_(object_guard) ctsMediaStreamSendRequests retransmit_requests;
+        // NACKs are queued by the listening socket and retransmitted from retransmit_work
+        // - so the listening socket's receive path never waits on object_guard or sends a NACK's frames itself
+        // - NACKs arriving while MaxPendingNacks are queued are dropped: the client requests them again
+        wil::critical_section nack_guard;
+        _Guarded_by_(nack_guard) std::vector<ctsMediaStreamMessage> pending_nacks;
+        wil::unique_threadpool_work retransmit_work;
+        const ctsMediaStreamRetransmitFunction retransmit_function = nullptr;
+        // -Recovery:fec : given to the pattern once the stream completes, so its results include them
+        _Guarded_by_(object_guard) long long fec_parity_datagrams = 0LL;
+        _Guarded_by_(object_guard) long long fec_encode_ticks = 0LL;
+
+        // frames due in the future are sent by the server-wide scheduler, which sends across streams each tick
+        ctsMediaStreamSendScheduler& scheduler;
+        ctsMediaStreamSendScheduler::Stream scheduled_stream;
 
         // this weak_socket is the weak reference to the ctsSocket tracked by ctsSocketState & ctsSocketBroker
         // used to complete the state when finished and take a shared_ptr when needing to take a reference
@@ -62,7 +92,9 @@ namespace ctsTraffic
             std::weak_ptr<ctsSocket> _weak_socket,
             SOCKET _sending_socket,
             ctl::ctSockaddr _remote_addr,
-            ctsMediaStreamConnectedSocketIoFunctor _io_functor);
+            ctsMediaStreamConnectedSocketIoFunctor _io_functor,
+            unsigned long _retransmit_history_frames = 0UL,
+            ctsMediaStreamRetransmitFunction _retransmit_function = nullptr);
 
         ~ctsMediaStreamServerConnectedSocket() noexcept;
 
@@ -86,11 +118,52 @@ namespace ctsTraffic
             return next_task;
         }
 
+        // must be called while sending - which holds the object lock
+        ctsMediaStreamSendRequests& get_send_requests() noexcept
+        {
+            return send_requests;
+        }
+
+        // must be called while sending - which holds the object lock
+        ctsMediaStreamSendRequests& get_retransmit_requests() noexcept
+        {
+            return retransmit_requests;
+        }
+
         long long increment_sequence() noexcept
         {
             return InterlockedIncrement64(&sequence_number);
         }
 
+        // must be called while sending - which holds the object lock
+        void record_sent_frame(long long _sequence_number, const ctsIOTask& _task) noexcept
+        {
+            if (!sent_frames.empty())
+            {
+                auto& sent_frame = sent_frames[static_cast<size_t>(_sequence_number) % sent_frames.size()];
+                sent_frame.sequence_number = _sequence_number;
+                sent_frame.buffer = _task.buffer;
+                sent_frame.buffer_length = _task.buffer_length;
+            }
+        }
+
+        // must be called while sending - which holds the object lock
+        void record_fec_encode(long long _parity_datagrams, long long _encode_ticks) noexcept
+        {
+            fec_parity_datagrams += _parity_datagrams;
+            fec_encode_ticks += _encode_ticks;
+        }
+
+        // the most datagrams one NACK can have retransmitted
+        // - a frame reaching the limit is still sent whole, so the limit can be exceeded by the datagrams of one frame
+        static constexpr unsigned long MaxRetransmitDatagramsPerNack = 256;
+        // the most NACKs waiting to be retransmitted
+        static constexpr size_t MaxPendingNacks = 4;
+
+        // queues the NACK to be retransmitted from a threadpool callback
+        // - does nothing unless the stream keeps a history of sent frames
+        void queue_retransmit(const ctsMediaStreamMessage& _nack) noexcept;
+
         void schedule_task(const ctsIOTask& _task) noexcept;
 
         void complete_state(unsigned long _error_code) const noexcept;
@@ -102,6 +175,11 @@ namespace ctsTraffic
         ctsMediaStreamServerConnectedSocket& operator=(ctsMediaStreamServerConnectedSocket&&) = delete;
 
     private:
-        static VOID CALLBACK ctsMediaStreamTimerCallback(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_TIMER) noexcept;
+        static void ctsMediaStreamSendCallback(_In_ PVOID _context) noexcept;
+        static VOID NTAPI RetransmitWorker(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WORK) noexcept;
+
+        // sends each frame requested in the NACK which is still in the history, up to MaxRetransmitDatagramsPerNack
+        // - returns the number of frames retransmitted
+        unsigned long retransmit(const ctsMediaStreamMessage& _nack) noexcept;
     };
 }
\ No newline at end of file
@@ -141,7 +141,10 @@ namespace ctsTraffic
 
             if (error != NO_ERROR && error != WSAECONNRESET)
             {
-                ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+                {
+                    const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+                    ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+                }
                 ++failure_counter;
 
                 try
@@ -199,7 +202,10 @@ namespace ctsTraffic
                         }
                         else
                         {
-                            ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+                            {
+                                const auto stats_update = ctsConfig::Settings->UdpStatusDetails.snapshot_guard.begin_update();
+                                ctsConfig::Settings->UdpStatusDetails.error_frames.increment();
+                            }
                             priorFailureWasConectionReset = false;
                             ctsConfig::PrintErrorInfo(
                                 ctl::ctString::ctFormatString("ctsMediaStreamServer - WSARecvFrom failed [%d]", WSAGetLastError()).c_str());
@@ -230,6 +236,16 @@ namespace ctsTraffic
 #endif
                             break;
 
+                        case MediaStreamAction::NACK:
+                            PrintDebugInfo(
+                                L"\t\tctsMediaStreamServer - processing NACK from %ws\n",
+                                remoteAddr.WriteCompleteAddress().c_str());
+                            // Cannot be holding the object_guard when calling into any pimpl-> methods
+                            pimpl_operation = [this, message]() {
+                                ctsMediaStreamServerImpl::Retransmit(remoteAddr, message);
+                            };
+                            break;
+
                         default:
                             FAIL_FAST_MSG("ctsMediaStreamServer - received an unexpected Action: %d (%p)\n", message.action, recv_buffer.data());
                     }
@@ -0,0 +1,137 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// os headers
+#include <WinSock2.h>
+#include <Windows.h>
+// project headers
+#include "ctsIOTask.hpp"
+
+namespace ctsTraffic
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsPatternSegments
+    ///
+    /// Sends read from, and verified recvs are compared against, a buffer holding the byte pattern
+    /// - when the IO function can post several WSABUFs in one call, a send running past the end of the pattern
+    ///   is split into segments which wrap back to its start, so the buffer only needs one copy of the pattern
+    /// - received bytes are compared with the same wrapping, however they were sent
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    namespace ctsPatternSegments
+    {
+        constexpr unsigned long BufferPatternSize = 0xffff + 0x1; // fill from 0x0000 to 0xffff
+
+        //
+        // A send starts before the end of the pattern, so it spans at most MaxBufferSegments copies of the pattern
+        // only if it is no longer than MaxBufferSegments - 1 copies
+        //
+        constexpr bool CanSegmentSends(unsigned long _max_buffer_size, unsigned long _pattern_size = BufferPatternSize) noexcept
+        {
+            return _max_buffer_size <= (ctsIOTask::MaxBufferSegments - 1) * _pattern_size;
+        }
+
+        //
+        // Sets the task's segments to send _length bytes of the pattern starting at _pattern_offset
+        // - a send which ends within the pattern is left as the single buffer at buffer + buffer_offset
+        // - the caller guarantees CanSegmentSends(_length, _pattern_size)
+        //
+        inline void SegmentSend(
+            ctsIOTask& _task,
+            _In_reads_bytes_(_pattern_size) char* _pattern,
+            unsigned long _pattern_size,
+            unsigned long _pattern_offset,
+            unsigned long _length) noexcept
+        {
+            _task.buffer_segment_count = 0;
+            if (_pattern_offset + _length <= _pattern_size)
+            {
+                return;
+            }
+
+            unsigned long segment_offset = _pattern_offset;
+            unsigned long bytes_remaining = _length;
+            while (bytes_remaining > 0)
+            {
+                WSABUF& segment = _task.buffer_segments[_task.buffer_segment_count];
+                ++_task.buffer_segment_count;
+
+                segment.buf = _pattern + segment_offset;
+                segment.len = (bytes_remaining > _pattern_size - segment_offset) ? _pattern_size - segment_offset : bytes_remaining;
+                bytes_remaining -= segment.len;
+                segment_offset = 0;
+            }
+        }
+
+        // where Compare found the received bytes differ from the pattern
+        struct Mismatch
+        {
+            // the start of the block of received bytes which differed, and the pattern it was compared against
+            const char* received = nullptr;
+            const char* expected = nullptr;
+            // the bytes of that block which matched before the first difference
+            size_t matched_length = 0;
+        };
+
+        //
+        // Compares the first _transferred_bytes of the task's buffers against the pattern,
+        // starting at the task's expected_pattern_offset and wrapping at the end of the pattern
+        //
+        // We're using RtlCompareMemory instead of memcmp because it returns the first offset at which the buffers differ,
+        // which is more useful than memcmp's "sign of the difference between the first two differing elements"
+        //
+        inline bool Compare(
+            const ctsIOTask& _task,
+            unsigned long _transferred_bytes,
+            _In_reads_bytes_(_pattern_size) const char* _pattern,
+            unsigned long _pattern_size,
+            _Out_ Mismatch& _mismatch) noexcept
+        {
+            _mismatch = Mismatch();
+
+            WSABUF received_segments[ctsIOTask::MaxBufferSegments];
+            const auto segment_count = _task.fill_wsabufs(received_segments);
+
+            unsigned long pattern_offset = _task.expected_pattern_offset % _pattern_size;
+            unsigned long bytes_remaining = _transferred_bytes;
+            for (unsigned long segment = 0; segment < segment_count && bytes_remaining > 0; ++segment)
+            {
+                const char* received_buffer = received_segments[segment].buf;
+                unsigned long segment_remaining = (received_segments[segment].len < bytes_remaining) ? received_segments[segment].len : bytes_remaining;
+                while (segment_remaining > 0)
+                {
+                    const char* const pattern_buffer = _pattern + pattern_offset;
+                    const unsigned long compare_length = (segment_remaining < _pattern_size - pattern_offset) ? segment_remaining : _pattern_size - pattern_offset;
+                    const size_t length_matched = RtlCompareMemory(pattern_buffer, received_buffer, compare_length);
+                    if (length_matched != compare_length)
+                    {
+                        _mismatch.received = received_buffer;
+                        _mismatch.expected = pattern_buffer;
+                        _mismatch.matched_length = length_matched;
+                        return false;
+                    }
+
+                    received_buffer += compare_length;
+                    segment_remaining -= compare_length;
+                    bytes_remaining -= compare_length;
+                    pattern_offset = (pattern_offset + compare_length) % _pattern_size;
+                }
+            }
+
+            return true;
+        }
+    }
+}
@@ -27,26 +27,23 @@ See the Apache Version 2.0 License for specific language governing permissions a
 namespace ctsTraffic
 {
     void ctsReadWriteIocp(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
+    static void ctsReadWriteIocpImpl(ctsSocket& _socket) noexcept;
 
     // IO Threadpool completion callback 
+    // - the ctsSocket is given without a reference: ctsSocket::shutdown waits for these callbacks before it can be destroyed
     static void ctsReadWriteIocpIoCompletionCallback(
         _In_ OVERLAPPED* _overlapped,
-        const std::weak_ptr<ctsSocket>& _weak_socket,
+        _In_ ctsSocket* _socket,
         const ctsIOTask& _io_task) noexcept
     {
-        auto shared_socket(_weak_socket.lock());
-        if (!shared_socket)
-        {
-            return;
-        }
-        // hold a reference on the iopattern
-        auto shared_pattern(shared_socket->io_pattern());
+        // the iopattern lives as long as the ctsSocket
+        const auto& shared_pattern(_socket->io_pattern());
 
         int gle = NO_ERROR;
         DWORD transferred = 0;
-        // lock the socket just long enough to read the result
+        // pin the socket just long enough to read the result
         {
-            const auto socket_ref(shared_socket->socket_reference());
+            const auto socket_ref(_socket->socket_reference());
             const SOCKET socket = socket_ref.socket();
             if (INVALID_SOCKET == socket)
             {
@@ -72,7 +69,7 @@ namespace ctsTraffic
             case ctsIOStatus::ContinueIo:
                 // more IO is requested from the protocol
                 // - invoke the new IO call while holding a refcount to the prior IO
-                ctsReadWriteIocp(_weak_socket);
+                ctsReadWriteIocpImpl(*_socket);
                 break;
 
             case ctsIOStatus::CompletedIo:
@@ -92,32 +89,39 @@ namespace ctsTraffic
         }
 
         // always decrement *after* attempting new IO - the prior IO is now formally "done"
-        if (shared_socket->decrement_io() == 0)
+        if (_socket->decrement_io() == 0)
         {
             // if we have no more IO pended, complete the state
-            shared_socket->complete_state(readwrite_status);
+            _socket->complete_state(readwrite_status);
         }
     }
 
     // The registered function with ctsConfig
     void ctsReadWriteIocp(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
     {
-        // must get a reference to the socket and the IO pattern
-        auto shared_socket(_weak_socket.lock());
+        // must get a reference to the socket
+        const auto shared_socket(_weak_socket.lock());
         if (!shared_socket)
         {
             return;
         }
-        // hold a reference on the iopattern
-        auto shared_pattern(shared_socket->io_pattern());
+        ctsReadWriteIocpImpl(*shared_socket);
+    }
+
+    // Requests IO from the pattern until it has none to offer
+    // - callers must guarantee the ctsSocket stays alive: IO completions rely on ctsSocket::shutdown waiting for them
+    static void ctsReadWriteIocpImpl(ctsSocket& _socket) noexcept
+    {
+        // the iopattern lives as long as the ctsSocket
+        const auto& shared_pattern(_socket.io_pattern());
 
         // can't initialize to zero - zero indicates to complete_state()
         long io_count = -1;
         bool io_done = false;
         int io_error = NO_ERROR;
 
-        // lock the socket while doing IO
-        const auto socket_ref(shared_socket->socket_reference());
+        // pin the socket while doing IO
+        const auto socket_ref(_socket.socket_reference());
         SOCKET socket = socket_ref.socket();
         if (socket != INVALID_SOCKET)
         {
@@ -146,7 +150,7 @@ namespace ctsTraffic
                 if (IOTaskAction::HardShutdown == next_io.ioAction)
                 {
                     // pass through -1 to force an RST with the closesocket
-                    io_error = shared_socket->close_socket(-1);
+                    io_error = _socket.close_socket(-1);
                     socket = INVALID_SOCKET;
 
                     io_done = shared_pattern->complete_io(next_io, 0, io_error) != ctsIOStatus::ContinueIo;
@@ -155,16 +159,16 @@ namespace ctsTraffic
 
                 // else we need to initiate another IO
                 // add-ref the IO about to start
-                io_count = shared_socket->increment_io();
+                io_count = _socket.increment_io();
 
                 std::shared_ptr<ctl::ctThreadIocp> io_thread_pool;
                 OVERLAPPED* pov = nullptr;
                 try
                 {
                     // these are the only calls which can throw in this function
-                    io_thread_pool = shared_socket->thread_pool();
+                    io_thread_pool = _socket.thread_pool();
                     pov = io_thread_pool->new_request(
-                        [_weak_socket, next_io](OVERLAPPED* _ov) noexcept { ctsReadWriteIocpIoCompletionCallback(_ov, _weak_socket, next_io); });
+                        [socket_object = &_socket, next_io](OVERLAPPED* _ov) noexcept { ctsReadWriteIocpIoCompletionCallback(_ov, socket_object, next_io); });
                 }
                 catch (const std::exception& e)
                 {
@@ -175,7 +179,7 @@ namespace ctsTraffic
                 // if an exception prevented this IO from initiating,
                 if (io_error != NO_ERROR)
                 {
-                    io_count = shared_socket->decrement_io();
+                    io_count = _socket.decrement_io();
                     io_done = shared_pattern->complete_io(next_io, 0, io_error) != ctsIOStatus::ContinueIo;
                     continue;
                 }
@@ -208,7 +212,7 @@ namespace ctsTraffic
                     // must cancel the IOCP TP if the IO call fails
                     io_thread_pool->cancel_request(pov);
                     // decrement the IO count since it was not pended
-                    io_count = shared_socket->decrement_io();
+                    io_count = _socket.decrement_io();
 
                     const char* function_name = IOTaskAction::Send == next_io.ioAction ? "WriteFile" : "ReadFile";
                     PrintDebugInfo(L"\t\tIO Failed: %hs (%d) [ctsReadWriteIocp]\n", function_name, io_error);
@@ -241,6 +245,11 @@ namespace ctsTraffic
                             FAIL_FAST_MSG("ctsReadWriteIocp: unknown ctsSocket::IOStatus - %u\n", static_cast<unsigned>(protocol_status));
                     }
                 }
+                else if (ctsConfig::Settings->SingleOwnerIoPattern)
+                {
+                    // the completion of this IO now owns the pattern and will request the next IO
+                    io_done = true;
+                }
             }
         }
         else
@@ -251,7 +260,7 @@ namespace ctsTraffic
         if (0 == io_count)
         {
             // complete the ctsSocket if we have no IO pended
-            shared_socket->complete_state(io_error);
+            _socket.complete_state(io_error);
         }
     }
 } // namespace
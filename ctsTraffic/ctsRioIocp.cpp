@@ -534,13 +534,15 @@ namespace ctsTraffic
                 return 0;
             }
             //
-            // hold a reference on the iopattern
+            // the iopattern lives as long as the ctsSocket
             //
-            auto shared_pattern(shared_socket->io_pattern());
+            const auto& shared_pattern(shared_socket->io_pattern());
             //
             // Must lock the socket before doing anything on it
+            // - the RQ is not safe to use concurrently: the IO lock serializes it with execute_io
             //
-            auto socket_ref(shared_socket->socket_reference());
+            const auto rq_lock(shared_socket->io_lock());
+            const auto socket_ref(shared_socket->socket_reference());
             //
             // decrement the counter in our RQ for the completed IO
             //
@@ -632,10 +634,11 @@ namespace ctsTraffic
             FAIL_FAST_IF_MSG(
                 !shared_socket,
                 "RioSocketContext::execute_io (this == %p): the ctsSocket should always be valid - it's now nullshared_socket, get() should always return a valid ptr", this);
-            // hold a reference on the iopattern
-            auto shared_pattern(shared_socket->io_pattern());
+            // the iopattern lives as long as the ctsSocket
+            const auto& shared_pattern(shared_socket->io_pattern());
 
             // hold onto the RIO socket lock while posting IO on it
+            const auto rq_lock(shared_socket->io_lock());
             const auto socket_ref(shared_socket->socket_reference());
             SOCKET rio_socket = socket_ref.socket();
             if (INVALID_SOCKET == rio_socket)
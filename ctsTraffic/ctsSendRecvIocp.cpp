@@ -16,6 +16,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // os headers
 #include <Windows.h>
 #include <winsock2.h>
+#include <mstcpip.h>
 // ctl headers
 #include <ctThreadIocp.hpp>
 #include <ctSockaddr.hpp>
@@ -29,6 +30,7 @@ namespace ctsTraffic
 
     /// forward delcaration
     void ctsSendRecvIocp(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
+    static void ctsSendRecvIocpImpl(ctsSocket& _socket) noexcept;
 
     struct ctsSendRecvStatus
     {
@@ -43,20 +45,17 @@ namespace ctsTraffic
     ///
     /// IO Threadpool completion callback 
     ///
+    /// The ctsSocket is given without a reference: it outlives every IO callback on its threadpool
+    /// - ctsSocket::shutdown closes the socket and waits for these callbacks before it can be destroyed
+    ///
     static void ctsIoCompletionCallback(
         _In_ OVERLAPPED* _overlapped,
-        const std::weak_ptr<ctsSocket>& _weak_socket,
+        _In_ ctsSocket* _socket,
         const ctsIOTask& _io_task) noexcept
     {
-        auto shared_socket(_weak_socket.lock());
-        if (!shared_socket)
-        {
-            return;
-        }
-
         int gle = NO_ERROR;
-        // hold a reference on the iopattern
-        auto shared_pattern = shared_socket->io_pattern();
+        // the iopattern lives as long as the ctsSocket
+        const auto& shared_pattern = _socket->io_pattern();
         if (!shared_pattern)
         {
             gle = WSAECONNABORTED;
@@ -65,8 +64,8 @@ namespace ctsTraffic
         DWORD transferred = 0;
         if (NO_ERROR == gle)
         {
-            // try to get the success/error code and bytes transferred (under the socket lock)
-            const auto socket_ref(shared_socket->socket_reference());
+            // try to get the success/error code and bytes transferred (while the socket is pinned)
+            const auto socket_ref(_socket->socket_reference());
             const SOCKET socket = socket_ref.socket();
             // if we no longer have a valid socket or the pattern was destroyed, return early
             if (INVALID_SOCKET == socket)
@@ -80,6 +79,23 @@ namespace ctsTraffic
                 {
                     gle = WSAGetLastError();
                 }
+                else if (shared_pattern->time_series_rtt_needed())
+                {
+                    // sample the RTT once per time-series interval while still holding the socket reference
+                    // - record zero if the query fails so we don't retry it on every completion
+                    DWORD tcp_info_version = 0;
+                    TCP_INFO_v0 tcp_info{};
+                    DWORD bytes_returned{};
+                    const auto ioctl_error = WSAIoctl(
+                        socket,
+                        SIO_TCP_INFO,
+                        &tcp_info_version, static_cast<DWORD>(sizeof tcp_info_version),
+                        &tcp_info, static_cast<DWORD>(sizeof tcp_info),
+                        &bytes_returned,
+                        nullptr,
+                        nullptr);
+                    shared_pattern->set_time_series_rtt(0 == ioctl_error ? tcp_info.RttUs : 0UL);
+                }
             }
         }
 
@@ -95,7 +111,7 @@ namespace ctsTraffic
             {
                 case ctsIOStatus::ContinueIo:
                     // more IO is requested from the protocol : invoke the new IO call while holding a refcount to the prior IO
-                    ctsSendRecvIocp(_weak_socket);
+                    ctsSendRecvIocpImpl(*_socket);
                     break;
 
                 case ctsIOStatus::CompletedIo:
@@ -116,10 +132,10 @@ namespace ctsTraffic
         }
 
         // always decrement *after* attempting new IO : the prior IO is now formally "done"
-        if (shared_socket->decrement_io() == 0)
+        if (_socket->decrement_io() == 0)
         {
             // if we have no more IO pended, complete the state
-            shared_socket->complete_state(gle);
+            _socket->complete_state(gle);
         }
     }
 
@@ -130,7 +146,7 @@ namespace ctsTraffic
     /// ** ctsSocket::increment_io must have been called before this function was invoked
     ///
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    static ctsSendRecvStatus ctsProcessIOTask(SOCKET _socket, const std::shared_ptr<ctsSocket>& _shared_socket, const std::shared_ptr<ctsIOPattern>& _shared_pattern, const ctsIOTask& next_io) noexcept
+    static ctsSendRecvStatus ctsProcessIOTask(SOCKET _socket, ctsSocket& _cts_socket, const std::shared_ptr<ctsIOPattern>& _shared_pattern, const ctsIOTask& next_io) noexcept
     {
         ctsSendRecvStatus return_status;
 
@@ -158,7 +174,7 @@ namespace ctsTraffic
         else if (IOTaskAction::HardShutdown == next_io.ioAction)
         {
             // pass through -1 to force an RST with the closesocket
-            return_status.ioErrorcode = _shared_socket->close_socket(-1);
+            return_status.ioErrorcode = _cts_socket.close_socket(-1);
             return_status.ioDone = _shared_pattern->complete_io(next_io, 0, return_status.ioErrorcode) != ctsIOStatus::ContinueIo;
             return_status.ioStarted = false;
 
@@ -168,22 +184,21 @@ namespace ctsTraffic
             try
             {
                 // attempt to allocate an IO thread-pool object
-                const std::shared_ptr<ctl::ctThreadIocp>& io_thread_pool(_shared_socket->thread_pool());
+                const std::shared_ptr<ctl::ctThreadIocp>& io_thread_pool(_cts_socket.thread_pool());
                 OVERLAPPED* pov = io_thread_pool->new_request(
-                    [weak_reference = std::weak_ptr<ctsSocket>(_shared_socket), next_io](OVERLAPPED* _ov) noexcept
+                    [socket_object = &_cts_socket, next_io](OVERLAPPED* _ov) noexcept
                 {
-                    ctsIoCompletionCallback(_ov, weak_reference, next_io);
+                    ctsIoCompletionCallback(_ov, socket_object, next_io);
                 });
 
-                WSABUF wsabuf;
-                wsabuf.buf = next_io.buffer + next_io.buffer_offset;
-                wsabuf.len = next_io.buffer_length;
+                WSABUF wsabufs[ctsIOTask::MaxBufferSegments];
+                const auto wsabuf_count = next_io.fill_wsabufs(wsabufs);
 
                 PCSTR function_name{};
                 if (IOTaskAction::Send == next_io.ioAction)
                 {
                     function_name = "WSASend";
-                    if (WSASend(_socket, &wsabuf, 1, nullptr, 0, pov, nullptr) != 0)
+                    if (WSASend(_socket, wsabufs, wsabuf_count, nullptr, 0, pov, nullptr) != 0)
                     {
                         return_status.ioErrorcode = WSAGetLastError();
                     }
@@ -192,7 +207,7 @@ namespace ctsTraffic
                 {
                     function_name = "WSARecv";
                     DWORD flags = ctsConfig::Settings->Options & ctsConfig::OptionType::MSG_WAIT_ALL ? MSG_WAITALL : 0;
-                    if (WSARecv(_socket, &wsabuf, 1, nullptr, &flags, pov, nullptr) != 0)
+                    if (WSARecv(_socket, wsabufs, wsabuf_count, nullptr, &flags, pov, nullptr) != 0)
                     {
                         return_status.ioErrorcode = WSAGetLastError();
                     }
@@ -283,13 +298,13 @@ namespace ctsTraffic
         {
             return;
         }
-        // take a lock on the socket before working with it
+        // pin the socket before working with it
         const auto socket_ref(shared_socket->socket_reference());
         // increment IO for this IO request
         shared_socket->increment_io();
 
         // run the ctsIOTask (next_io) that was scheduled through the TP timer
-        const ctsSendRecvStatus status = ctsProcessIOTask(socket_ref.socket(), shared_socket, shared_socket->io_pattern(), next_io);
+        const ctsSendRecvStatus status = ctsProcessIOTask(socket_ref.socket(), *shared_socket, shared_socket->io_pattern(), next_io);
         // if no IO was started, decrement the IO counter
         if (!status.ioStarted)
         {
@@ -303,7 +318,7 @@ namespace ctsTraffic
         // continue requesting IO if this connection still isn't done with all IO after scheduling the prior IO
         if (!status.ioDone)
         {
-            ctsSendRecvIocp(_weak_socket);
+            ctsSendRecvIocpImpl(*shared_socket);
         }
         // finally decrement the IO that was counted for this IO that was completed async
         if (shared_socket->decrement_io() == 0)
@@ -317,15 +332,22 @@ namespace ctsTraffic
     void ctsSendRecvIocp(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
     {
         // attempt to get a reference to the socket
-        auto shared_socket(_weak_socket.lock());
+        const auto shared_socket(_weak_socket.lock());
         if (!shared_socket)
         {
             return;
         }
-        // take a lock on the socket before working with it
-        const auto socket_ref(shared_socket->socket_reference());
-        // hold a reference on the iopattern
-        auto shared_pattern(shared_socket->io_pattern());
+        ctsSendRecvIocpImpl(*shared_socket);
+    }
+
+    // Requests IO from the pattern until it has none to offer
+    // - callers must guarantee the ctsSocket stays alive: IO completions rely on ctsSocket::shutdown waiting for them
+    static void ctsSendRecvIocpImpl(ctsSocket& _socket) noexcept
+    {
+        // pin the socket before working with it
+        const auto socket_ref(_socket.socket_reference());
+        // the iopattern lives as long as the ctsSocket
+        const auto& shared_pattern(_socket.io_pattern());
         //
         // loop until failure or initiate_io returns None
         //
@@ -335,7 +357,7 @@ namespace ctsTraffic
         // The IO refcount must be incremented here to hold an IO count on the socket
         // - so that we won't inadvertently call complete_state() while IO is still being scheduled
         //
-        shared_socket->increment_io();
+        _socket.increment_io();
 
         ctsSendRecvStatus status;
         while (!status.ioDone)
@@ -348,14 +370,14 @@ namespace ctsTraffic
             }
 
             // increment IO for each individual request
-            shared_socket->increment_io();
+            _socket.increment_io();
 
             if (next_io.time_offset_milliseconds > 0)
             {
                 // set_timer can throw
                 try
                 {
-                    shared_socket->set_timer(next_io, ctsProcessIOTaskCallback);
+                    _socket.set_timer(next_io, ctsProcessIOTaskCallback);
                     status.ioStarted = true; // IO started in the context of keeping the count incremented
                     status.ioDone = true;
                 }
@@ -369,25 +391,30 @@ namespace ctsTraffic
             }
             else
             {
-                status = ctsProcessIOTask(socket_ref.socket(), shared_socket, shared_pattern, next_io);
+                status = ctsProcessIOTask(socket_ref.socket(), _socket, shared_pattern, next_io);
             }
 
             // if no IO was started, decrement the IO counter
             if (!status.ioStarted)
             {
                 // since IO is not pended, remove the refcount
-                if (0 == shared_socket->decrement_io())
+                if (0 == _socket.decrement_io())
                 {
                     // this should never be zero as we are holding a reference outside the loop
                     FAIL_FAST_MSG(
-                        "The ctsSocket (%p) refcount fell to zero while this function was holding a reference", shared_socket.get());
+                        "The ctsSocket (%p) refcount fell to zero while this function was holding a reference", &_socket);
                 }
             }
+            else if (ctsConfig::Settings->SingleOwnerIoPattern)
+            {
+                // the completion of this IO now owns the pattern and will request the next IO
+                break;
+            }
         }
         // decrement IO at the end to release the refcount held before the loop
-        if (0 == shared_socket->decrement_io())
+        if (0 == _socket.decrement_io())
         {
-            shared_socket->complete_state(status.ioErrorcode);
+            _socket.complete_state(status.ioErrorcode);
         }
     }
 
@@ -0,0 +1,134 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <memory>
+#include <unordered_map>
+// os headers
+#include <Windows.h>
+// wil headers
+#include <wil/resource.h>
+// ctl headers
+#include <ctSockaddr.hpp>
+
+namespace ctsTraffic
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsSockaddrMap
+    ///
+    /// Maps a remote address to the object tracking that remote endpoint
+    /// - the map is split into shards by the hash of the address, each with its own lock
+    /// - lookups take only a shared lock on one shard, so concurrent lookups never wait on each other
+    ///   and only wait behind an insert or remove which lands in the same shard
+    ///
+    /// Objects are held by shared_ptr: remove() returns the removed object so the caller
+    /// can release it after the shard lock is no longer held
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    template <typename T>
+    class ctsSockaddrMap
+    {
+    public:
+        // must be a power of 2
+        static constexpr size_t ShardCount = 64;
+
+        //
+        // Returns nullptr if the address is not in the map
+        //
+        std::shared_ptr<T> find(const ctl::ctSockaddr& _address) const noexcept
+        {
+            const Shard& shard = shard_for(_address);
+            const auto lock = shard.lock.lock_shared();
+            const auto found = shard.entries.find(_address);
+            return found != shard.entries.end() ? found->second : nullptr;
+        }
+
+        //
+        // Returns false if the address was already in the map
+        //
+        bool insert(const ctl::ctSockaddr& _address, std::shared_ptr<T> _value)
+        {
+            Shard& shard = shard_for(_address);
+            const auto lock = shard.lock.lock_exclusive();
+            return shard.entries.emplace(_address, std::move(_value)).second; // can throw
+        }
+
+        //
+        // Returns the object removed from the map, or nullptr if the address was not in the map
+        //
+        std::shared_ptr<T> remove(const ctl::ctSockaddr& _address) noexcept
+        {
+            Shard& shard = shard_for(_address);
+            const auto lock = shard.lock.lock_exclusive();
+            const auto found = shard.entries.find(_address);
+            if (found == shard.entries.end())
+            {
+                return nullptr;
+            }
+            auto removed = std::move(found->second);
+            shard.entries.erase(found);
+            return removed;
+        }
+
+        ctsSockaddrMap() = default;
+        ~ctsSockaddrMap() = default;
+        ctsSockaddrMap(const ctsSockaddrMap&) = delete;
+        ctsSockaddrMap& operator=(const ctsSockaddrMap&) = delete;
+        ctsSockaddrMap(ctsSockaddrMap&&) = delete;
+        ctsSockaddrMap& operator=(ctsSockaddrMap&&) = delete;
+
+    private:
+        //
+        // FNV-1a across every byte ctSockaddr::operator== compares
+        //
+        static unsigned long long hash_of(const ctl::ctSockaddr& _address) noexcept
+        {
+            const auto* const bytes = reinterpret_cast<const unsigned char*>(_address.sockaddr_inet());
+            unsigned long long hash = 14695981039346656037ULL;
+            for (size_t offset = 0; offset < sizeof(SOCKADDR_INET); ++offset)
+            {
+                hash ^= bytes[offset];
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+        struct SockaddrHash
+        {
+            size_t operator()(const ctl::ctSockaddr& _address) const noexcept
+            {
+                return static_cast<size_t>(hash_of(_address));
+            }
+        };
+
+        struct alignas(SYSTEM_CACHE_ALIGNMENT_SIZE) Shard
+        {
+            mutable wil::srwlock lock;
+            _Guarded_by_(lock) std::unordered_map<ctl::ctSockaddr, std::shared_ptr<T>, SockaddrHash> entries;
+        };
+
+        Shard& shard_for(const ctl::ctSockaddr& _address) noexcept
+        {
+            // the low bits select the bucket within the shard's unordered_map: use the high bits for the shard
+            return shards[(hash_of(_address) >> 32) & (ShardCount - 1)];
+        }
+        const Shard& shard_for(const ctl::ctSockaddr& _address) const noexcept
+        {
+            return shards[(hash_of(_address) >> 32) & (ShardCount - 1)];
+        }
+
+        Shard shards[ShardCount];
+    };
+}
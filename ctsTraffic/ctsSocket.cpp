@@ -33,6 +33,15 @@ namespace ctsTraffic
     // default values are assigned in the class declaration
     ctsSocket::ctsSocket(weak_ptr<ctsSocketState> _parent) noexcept : parent(move(_parent))
     {
+        const auto ref_parent(parent.lock());
+        if (ref_parent)
+        {
+            tp_environment = ref_parent->thread_pool_environment();
+        }
+        if (!tp_environment)
+        {
+            tp_environment = ctsConfig::Settings->PTPEnvironment;
+        }
     }
 
     _No_competing_thread_ ctsSocket::~ctsSocket() noexcept
@@ -53,11 +62,16 @@ namespace ctsTraffic
         const auto lock = socket_cs.lock();
 
         FAIL_FAST_IF_MSG(
-            !!socket,
+            read_socket_handle() != INVALID_SOCKET,
             "ctsSocket::set_socket trying to set a SOCKET (%Iu) when it has already been set in this object (%Iu)",
-            _socket, socket.get());
+            _socket, read_socket_handle());
 
-        socket.reset(_socket);
+        ::InterlockedExchangePointer(reinterpret_cast<PVOID volatile*>(&socket_handle), reinterpret_cast<PVOID>(_socket));
+        if (ctMemoryGuardRead(&socket_references) & SocketClosingFlag)
+        {
+            // close_socket was already called: no reference can be taken on this SOCKET
+            close_socket_handle();
+        }
     }
 
     int ctsSocket::close_socket(int _error_code) noexcept
@@ -65,16 +79,27 @@ namespace ctsTraffic
         const auto lock = socket_cs.lock();
 
         int error = 0;
-        if (socket)
+        const auto socket_value = read_socket_handle();
+        if (socket_value != INVALID_SOCKET && !(ctMemoryGuardRead(&socket_references) & SocketClosingFlag))
         {
             if (_error_code != 0)
             {
                 // always try to RST if we are closing due to an error
                 // to best-effort notify the opposite endpoint
-                const wsIOResult result = ctsSetLingertoRSTSocket(socket.get());
+                const wsIOResult result = ctsSetLingertoRSTSocket(socket_value);
                 error = result.error_code;
             }
-            socket.reset();
+        }
+        // new references will now see INVALID_SOCKET
+        // - if references are still in scope, the last one released will close the SOCKET
+        if (0 == ::InterlockedOr(&socket_references, SocketClosingFlag))
+        {
+            close_socket_handle();
+        }
+        if (local_port_lease.port != 0)
+        {
+            ctsConfig::ReleaseLocalPort(local_port_lease, false);
+            local_port_lease = ctsConfig::LocalPortLease{};
         }
         return error;
     }
@@ -84,9 +109,10 @@ namespace ctsTraffic
         // use the SOCKET cs to also guard creation of this TP object
         const auto lock = socket_cs.lock();
         // must verify a valid socket first to avoid racing destrying the iocp shared_ptr as we try to create it here
-        if (socket && !tp_iocp)
+        const auto socket_ref(socket_reference());
+        if (socket_ref.socket() != INVALID_SOCKET && !tp_iocp)
         {
-            tp_iocp = make_shared<ctThreadIocp>(socket.get(), ctsConfig::Settings->PTPEnvironment); // can throw
+            tp_iocp = make_shared<ctThreadIocp>(socket_ref.socket(), tp_environment); // can throw
         }
         return tp_iocp;
     }
@@ -140,6 +166,12 @@ namespace ctsTraffic
         local_sockaddr = _local;
     }
 
+    void ctsSocket::set_local_port_lease(const ctsConfig::LocalPortLease& _lease) noexcept
+    {
+        const auto lock = socket_cs.lock();
+        local_port_lease = _lease;
+    }
+
     const ctSockaddr& ctsSocket::target_address() const noexcept
     {
         return target_sockaddr;
@@ -150,7 +182,7 @@ namespace ctsTraffic
         target_sockaddr = _target;
     }
 
-    shared_ptr<ctsIOPattern> ctsSocket::io_pattern() const noexcept
+    const shared_ptr<ctsIOPattern>& ctsSocket::io_pattern() const noexcept
     {
         return pattern;
     }
@@ -158,6 +190,14 @@ namespace ctsTraffic
     void ctsSocket::set_io_pattern(const std::shared_ptr<ctsIOPattern>& _pattern) noexcept
     {
         pattern = _pattern;
+        if (fast_open_id)
+        {
+            // the server already received this connection id with the SYN
+            const auto copy_error = ::memcpy_s(pattern->connection_id(), ctsStatistics::ConnectionIdLength, fast_open_id.get(), ctsStatistics::ConnectionIdLength);
+            FAIL_FAST_IF_MSG(
+                copy_error != 0,
+                "memcpy_s failed trying to copy the FastOpen connection id (%d)", copy_error);
+        }
         if (ctsConfig::Settings->PrePostSends == 0)
         {
             // user didn't specify a specific # of sends to pend
@@ -166,6 +206,17 @@ namespace ctsTraffic
         }
     }
 
+    const char* ctsSocket::fast_open_connection_id()
+    {
+        if (!fast_open_id)
+        {
+            auto connection_id = make_unique<char[]>(ctsStatistics::ConnectionIdLength); // can throw
+            ctsStatistics::GenerateConnectionId(connection_id.get());
+            fast_open_id = move(connection_id);
+        }
+        return fast_open_id.get();
+    }
+
     void ctsSocket::process_isb_notification() noexcept
     {
         // lock the socket
@@ -289,6 +340,12 @@ namespace ctsTraffic
     {
         // close the socket to trigger IO to complete/shutdown
         close_socket();
+        // threads still holding a SocketReference can be initiating IO through the threadpool objects
+        // - the SOCKET is closed once they release it
+        while (ctMemoryGuardRead(&socket_references) != SocketClosingFlag)
+        {
+            ::SwitchToThread();
+        }
         // Must destroy these threadpool objects outside the CS to prevent a deadlock
         // - from when worker threads attempt to callback this ctsSocket object when IO completes
         // Must wait for the threadpool from this method when ctsSocketState calls ctsSocket::shutdown
@@ -296,7 +353,10 @@ namespace ctsTraffic
         //   to this ctsSocket might be from a TP thread - in which case this d'tor will deadlock
         //   (it will wait for all TP threads to exit, but it is using/blocking on of those TP threads)
         tp_iocp.reset();
-        tp_timer.reset();
+        if (timer_state)
+        {
+            timer_state->tp_timer.reset();
+        }
     }
 
     ///
@@ -307,17 +367,18 @@ namespace ctsTraffic
     void ctsSocket::set_timer(const ctsIOTask& task, function<void(weak_ptr<ctsSocket>, const ctsIOTask&)>&& func)
     {
         const auto lock = socket_cs.lock();
-        timer_task = task;
-        timer_callback = std::move(func);
-
-        if (!tp_timer)
+        if (!timer_state)
         {
-            tp_timer.reset(CreateThreadpoolTimer(ThreadPoolTimerCallback, this, ctsConfig::Settings->PTPEnvironment));
-            THROW_LAST_ERROR_IF(!tp_timer);
+            auto new_timer_state = make_unique<TimerState>();
+            new_timer_state->tp_timer.reset(CreateThreadpoolTimer(ThreadPoolTimerCallback, this, tp_environment));
+            THROW_LAST_ERROR_IF(!new_timer_state->tp_timer);
+            timer_state = move(new_timer_state);
         }
+        timer_state->timer_task = task;
+        timer_state->timer_callback = std::move(func);
 
         FILETIME relativeTimeout = wil::filetime::from_int64(-1 * wil::filetime_duration::one_millisecond * task.time_offset_milliseconds);
-        SetThreadpoolTimer(tp_timer.get(), &relativeTimeout, 0, 0);
+        SetThreadpoolTimer(timer_state->tp_timer.get(), &relativeTimeout, 0, 0);
     }
 
     void NTAPI ctsSocket::ThreadPoolTimerCallback(PTP_CALLBACK_INSTANCE, PVOID pContext, PTP_TIMER)
@@ -328,8 +389,8 @@ namespace ctsTraffic
         function<void(weak_ptr<ctsSocket>, const ctsIOTask&)> callback;
         {
             const auto lock = pThis->socket_cs.lock();
-            task = pThis->timer_task;
-            callback = std::move(pThis->timer_callback);
+            task = pThis->timer_state->timer_task;
+            callback = std::move(pThis->timer_state->timer_callback);
         }
 
         // invoke the callback outside the lock
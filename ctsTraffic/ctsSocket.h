@@ -17,6 +17,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <memory>
 #include <functional>
 #include <type_traits>
+#include <utility>
 // os headers
 #include <windows.h>
 #include <Winsock2.h>
@@ -39,19 +40,34 @@ namespace ctsTraffic
 
     //
     // A safe socket container
-    // - ensures has a lock on the socket while in scope
+    // - ensures the socket is not closed while a SocketReference is in scope
     //
     class ctsSocket : public std::enable_shared_from_this<ctsSocket>
     {
     public:
+        //
+        // Pins the SOCKET value without taking a lock
+        // - close_socket defers closesocket until every SocketReference is released
+        // - once close_socket was called, new references return INVALID_SOCKET
+        //
         class SocketReference
         {
         public:
-            SocketReference(SocketReference&&) = default;
+            SocketReference(SocketReference&& _other) noexcept :
+                m_owner(std::exchange(_other.m_owner, nullptr)),
+                m_socket(std::exchange(_other.m_socket, INVALID_SOCKET))
+            {
+            }
             SocketReference& operator=(SocketReference&&) = delete;
             SocketReference(const SocketReference&) = delete;
             SocketReference& operator=(const SocketReference&) = delete;
-            ~SocketReference() = default;
+            ~SocketReference() noexcept
+            {
+                if (m_owner)
+                {
+                    m_owner->release_socket_reference();
+                }
+            }
 
             [[nodiscard]] SOCKET socket() const noexcept
             {
@@ -60,20 +76,32 @@ namespace ctsTraffic
 
         private:
             friend class ctsSocket;
-            SocketReference(wil::cs_leave_scope_exit&& socket_lock, SOCKET socket) noexcept :
-                m_csExit(std::move(socket_lock)), m_socket(socket)
+            SocketReference(const ctsSocket* _owner, SOCKET _socket) noexcept :
+                m_owner(_owner), m_socket(_socket)
             {
             }
 
-            const wil::cs_leave_scope_exit m_csExit;
-            const SOCKET m_socket = INVALID_SOCKET;
+            const ctsSocket* m_owner = nullptr;
+            SOCKET m_socket = INVALID_SOCKET;
         };
 
         [[nodiscard]] SocketReference socket_reference() const noexcept
         {
-            auto lock = socket_cs.lock();
-            const SOCKET locked_socket_value = socket.get();
-            return SocketReference(std::move(lock), locked_socket_value);
+            if (::InterlockedIncrement(&socket_references) & SocketClosingFlag)
+            {
+                release_socket_reference();
+                return SocketReference(nullptr, INVALID_SOCKET);
+            }
+            return SocketReference(this, read_socket_handle());
+        }
+
+        //
+        // Serializes IO calls which are not safe to make concurrently on the same SOCKET (e.g. RIO request queues)
+        // - SocketReference no longer serializes callers
+        //
+        [[nodiscard]] wil::cs_leave_scope_exit io_lock() const noexcept
+        {
+            return socket_cs.lock();
         }
 
         //
@@ -128,6 +156,12 @@ namespace ctsTraffic
         const ctl::ctSockaddr& local_address() const noexcept;
         void set_local_address(const ctl::ctSockaddr& _local) noexcept;
 
+        //
+        // Takes ownership of a port leased from the -LocalPort range
+        // - the port is returned to the range when the SOCKET is closed
+        //
+        void set_local_port_lease(const ctsConfig::LocalPortLease& _lease) noexcept;
+
         //
         // Gets/Sets the target address of the SOCKET, if there is one
         //
@@ -136,10 +170,22 @@ namespace ctsTraffic
 
         //
         // Get/Set the ctsIOPattern
+        // - the pattern is set once before IO starts and lives as long as the ctsSocket
+        //   so callers holding a ctsSocket reference can use it without copying the shared_ptr
         //
-        std::shared_ptr<ctsIOPattern> io_pattern() const noexcept;
+        const std::shared_ptr<ctsIOPattern>& io_pattern() const noexcept;
         void set_io_pattern(const std::shared_ptr<ctsIOPattern>& _pattern) noexcept;
 
+        //
+        // The connection id a client sends with its SYN under -Options:FastOpen
+        // - generated on first access, then adopted by the ctsIOPattern in set_io_pattern
+        // - the buffer stays valid for the lifetime of the socket, as required for the ConnectEx send buffer
+        //
+        // This can fail under low-resource conditions
+        // - can throw ctl::ctException
+        //
+        const char* fast_open_connection_id();
+
         //
         // methods for functors to use for refcounting the # of IO they have issued on this socket
         //
@@ -181,8 +227,39 @@ namespace ctsTraffic
         // private members for this socket instance
         // mutable is requred to EnterCS/LeaveCS in const methods
 
+        // the last SocketReference released after close_socket closes the SOCKET
+        static constexpr long SocketClosingFlag = 0x40000000L;
+        void release_socket_reference() const noexcept
+        {
+            if (SocketClosingFlag == ::InterlockedDecrement(&socket_references))
+            {
+                close_socket_handle();
+            }
+        }
+        SOCKET read_socket_handle() const noexcept
+        {
+            return reinterpret_cast<SOCKET>(::InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile*>(&socket_handle), nullptr, nullptr));
+        }
+        void close_socket_handle() const noexcept
+        {
+            // only one caller can exchange out a valid SOCKET
+            const auto closing_socket = reinterpret_cast<SOCKET>(
+                ::InterlockedExchangePointer(reinterpret_cast<PVOID volatile*>(&socket_handle), reinterpret_cast<PVOID>(INVALID_SOCKET)));
+            if (closing_socket != INVALID_SOCKET)
+            {
+                ::closesocket(closing_socket);
+            }
+        }
+
+        // guards creating the threadpool objects, the port lease, and closing the socket
         mutable wil::critical_section socket_cs;
-        _Guarded_by_(socket_cs) wil::unique_socket socket;
+        // the count of SocketReference objects in scope, or'd with SocketClosingFlag once close_socket was called
+        // - only accessed with interlocked operations
+        mutable long socket_references = 0L;
+        // only accessed with interlocked operations
+        // - mutable since the final SocketReference closes it from a const method
+        mutable SOCKET socket_handle = INVALID_SOCKET;
+        _Guarded_by_(socket_cs) ctsConfig::LocalPortLease local_port_lease;
         _Interlocked_ long io_count = 0L;
 
         // maintain a weak-reference to the parent and child
@@ -192,13 +269,25 @@ namespace ctsTraffic
 
         /// only guarded when returning to the caller
         std::shared_ptr<ctl::ctThreadIocp> tp_iocp;
-        wil::unique_threadpool_timer tp_timer;
-        ctsIOTask timer_task{};
-        std::function<void(std::weak_ptr<ctsSocket>, const ctsIOTask&)> timer_callback;
+        // the parent's threadpool environment, used for every TP object of this socket
+        PTP_CALLBACK_ENVIRON tp_environment = nullptr;
+
+        // only rate-limited connections schedule IO from a timer
+        // - kept out of line so every other connection doesn't carry the timer, task, and callback
+        struct TimerState
+        {
+            wil::unique_threadpool_timer tp_timer;
+            ctsIOTask timer_task{};
+            std::function<void(std::weak_ptr<ctsSocket>, const ctsIOTask&)> timer_callback;
+        };
+        std::unique_ptr<TimerState> timer_state;
 
         ctl::ctSockaddr local_sockaddr;
         ctl::ctSockaddr target_sockaddr;
 
+        // only allocated with -Options:FastOpen
+        std::unique_ptr<char[]> fast_open_id;
+
         static void NTAPI ThreadPoolTimerCallback(PTP_CALLBACK_INSTANCE, PVOID pContext, PTP_TIMER);
     };
 } // namespace
@@ -20,6 +20,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <Windows.h>
 // ctl headers
 #include <ctException.hpp>
+#include <ctMemoryGuard.hpp>
 // project headers
 #include "ctsSocket.h"
 #include "ctsSocketBroker.h"
@@ -33,10 +34,21 @@ namespace ctsTraffic
     using namespace ctl;
     using namespace std;
 
-    ctsSocketState::ctsSocketState(std::weak_ptr<ctsSocketBroker> _broker) : broker(move(_broker))
+    // the state machine instance whose threadpool callback is running on this thread
+    static thread_local const ctsSocketState* t_RunningStateMachine = nullptr;
+    // bounds how many states one threadpool callback runs back-to-back before yielding to the pool
+    constexpr unsigned long c_MaxInlineTransitions = 8;
+
+    ctsSocketState::ctsSocketState(std::weak_ptr<ctsSocketBroker> _broker) :
+        tp_environment(ctsConfig::NextConnectionThreadpoolEnvironment()),
+        broker(move(_broker))
     {
-        thread_pool_worker.reset(CreateThreadpoolWork(ThreadPoolWorker, this, ctsConfig::Settings->PTPEnvironment));
-        THROW_LAST_ERROR_IF_NULL(thread_pool_worker.get());
+        // -Memory:compact submits a one-time callback for each state instead of keeping a TP_WORK per connection
+        if (!ctsConfig::Settings->CompactConnections)
+        {
+            thread_pool_worker.reset(CreateThreadpoolWork(ThreadPoolWorker, this, tp_environment));
+            THROW_LAST_ERROR_IF_NULL(thread_pool_worker.get());
+        }
     }
 
     ctsSocketState::~ctsSocketState() noexcept
@@ -54,6 +66,13 @@ namespace ctsTraffic
             this->socket->shutdown();
         }
         thread_pool_worker.reset();
+
+        // -Memory:compact callbacks can't be canceled, so wait for them to return
+        // - they run the remaining states against the closed socket until reaching Closed
+        while (ctMemoryGuardRead(&this->pending_callbacks) > 0)
+        {
+            SwitchToThread();
+        }
     }
 
     void ctsSocketState::start() noexcept
@@ -61,7 +80,7 @@ namespace ctsTraffic
         FAIL_FAST_IF_MSG(
             state != InternalState::Creating,
             "ctsSocketState::start must only be called once at the initial state of the object (this == %p)", this);
-        SubmitThreadpoolWork(this->thread_pool_worker.get());
+        this->submit_work();
     }
 
     void ctsSocketState::complete_state(DWORD _error) noexcept
@@ -135,9 +154,19 @@ namespace ctsTraffic
             this->state = InternalState::Closing;
         }
         //
-        // schedule the next functor to run when not closing down the socket
+        // schedule the next functor to run
+        // - if the functor completed inline from our own threadpool callback, that callback runs the next state
+        //   once the functor returns: no locks from the functor are still held and the stack does not grow
+        // - completions from any other thread (e.g. an IOCP thread) always defer to the threadpool
         //
-        SubmitThreadpoolWork(this->thread_pool_worker.get());
+        if (t_RunningStateMachine == this)
+        {
+            this->inline_transition_pending = true;
+        }
+        else
+        {
+            this->submit_work();
+        }
     }
 
     ctsSocketState::InternalState ctsSocketState::current_state() const noexcept
@@ -146,7 +175,66 @@ namespace ctsTraffic
         return this->state;
     }
 
+    void ctsSocketState::submit_work() noexcept
+    {
+        if (this->thread_pool_worker)
+        {
+            SubmitThreadpoolWork(this->thread_pool_worker.get());
+            return;
+        }
+
+        // without a TP_WORK to wait on, the d'tor waits for pending_callbacks to drain
+        // - the callback must not hold a reference: the final release would then run the d'tor on the callback's thread,
+        //   which with -Threading:per-core is the only thread to run this connection's IO callbacks the d'tor waits on
+        ctMemoryGuardIncrement(&this->pending_callbacks);
+        FAIL_FAST_IF_MSG(
+            !TrySubmitThreadpoolCallback(ThreadPoolCallback, this, this->tp_environment),
+            "TrySubmitThreadpoolCallback failed (%u) (this == %p)", GetLastError(), this);
+    }
+
+    VOID NTAPI ctsSocketState::ThreadPoolCallback(PTP_CALLBACK_INSTANCE, PVOID _context) noexcept
+    {
+        auto* const this_ptr = static_cast<ctsSocketState*>(_context);
+        RunStateMachine(this_ptr);
+        // the d'tor can run as soon as this is decremented: must be the last access to this object
+        ctMemoryGuardDecrement(&this_ptr->pending_callbacks);
+    }
+
     VOID NTAPI ctsSocketState::ThreadPoolWorker(PTP_CALLBACK_INSTANCE, PVOID _context, PTP_WORK) noexcept
+    {
+        RunStateMachine(static_cast<ctsSocketState*>(_context));
+    }
+
+    void ctsSocketState::RunStateMachine(_In_ ctsSocketState* this_ptr) noexcept
+    {
+        t_RunningStateMachine = this_ptr;
+
+        for (unsigned long transitions = 1; ; ++transitions)
+        {
+            if (!this_ptr->run_current_state())
+            {
+                break;
+            }
+
+            auto lock = this_ptr->state_guard.lock();
+            if (!this_ptr->inline_transition_pending)
+            {
+                // the functor will complete asynchronously
+                break;
+            }
+            this_ptr->inline_transition_pending = false;
+
+            if (transitions >= c_MaxInlineTransitions)
+            {
+                this_ptr->submit_work();
+                break;
+            }
+        }
+
+        t_RunningStateMachine = nullptr;
+    }
+
+    bool ctsSocketState::run_current_state() noexcept
     {
         //
         // invoke the corresponding function object
@@ -156,27 +244,26 @@ namespace ctsTraffic
         // - since this could complete inline if it fails, and complete_state
         //   needs to know that we already tried to run the functor for this state
         //
-        auto this_ptr = static_cast<ctsSocketState*>(_context);
-        switch (this_ptr->state)
+        switch (this->state)
         {
             case InternalState::Creating:
             {
                 unsigned long error = 0;
-                try { this_ptr->socket = make_shared<ctsSocket>(this_ptr->shared_from_this()); }
+                try { this->socket = make_shared<ctsSocket>(this->shared_from_this()); }
                 catch (const exception& e) { error = ctErrorCode(e); }
 
                 if (error != 0)
                 {
-                    this_ptr->complete_state(error);
+                    this->complete_state(error);
 
                 }
                 else
                 {
-                    auto lock = this_ptr->state_guard.lock();
-                    this_ptr->state = InternalState::Created;
+                    auto lock = this->state_guard.lock();
+                    this->state = InternalState::Created;
                     lock.reset();
 
-                    ctsConfig::Settings->CreateFunction(this_ptr->socket);
+                    ctsConfig::Settings->CreateFunction(this->socket);
                     PrintDebugInfo(L"\t\tctsSocketState Created\n");
                 }
                 break;
@@ -184,11 +271,11 @@ namespace ctsTraffic
 
             case InternalState::Connecting:
             {
-                auto lock = this_ptr->state_guard.lock();
-                this_ptr->state = InternalState::Connected;
+                auto lock = this->state_guard.lock();
+                this->state = InternalState::Connected;
                 lock.reset();
 
-                ctsConfig::Settings->ConnectFunction(this_ptr->socket);
+                ctsConfig::Settings->ConnectFunction(this->socket);
                 PrintDebugInfo(L"\t\tctsSocketState Connected\n");
                 break;
             }
@@ -196,28 +283,28 @@ namespace ctsTraffic
             case InternalState::InitiatingIO:
             {
                 // notify the broker when initiating IO
-                auto parent = this_ptr->broker.lock();
+                auto parent = this->broker.lock();
                 if (parent)
                 {
                     parent->initiating_io();
                 }
 
                 unsigned long error = 0;
-                try { this_ptr->socket->set_io_pattern(ctsIOPattern::MakeIOPattern()); }
+                try { this->socket->set_io_pattern(ctsIOPattern::MakeIOPattern()); }
                 catch (const exception& e) { error = ctErrorCode(e); }
 
                 if (error != 0)
                 {
-                    this_ptr->complete_state(error);
+                    this->complete_state(error);
 
                 }
                 else
                 {
-                    auto lock = this_ptr->state_guard.lock();
-                    this_ptr->state = InternalState::InitiatedIO;
+                    auto lock = this->state_guard.lock();
+                    this->state = InternalState::InitiatedIO;
                     lock.reset();
 
-                    ctsConfig::Settings->IoFunction(this_ptr->socket);
+                    ctsConfig::Settings->IoFunction(this->socket);
                     PrintDebugInfo(L"\t\tctsSocketState InitiatedIO\n");
                 }
                 break;
@@ -227,20 +314,25 @@ namespace ctsTraffic
             // - this guarantees no other locks are taken
             // - this guarantess ctsSocket won't hold the final reference to the ctsSocketState
             //   on a threadpool thread - in which case it would deadlock on itself
+            // - the threadpool callback never holds a reference either (with or without -Memory:compact),
+            //   so the final reference is always released by the broker once it sees Closed
             case InternalState::Closing:
             {
-                if (this_ptr->initiated_io)
+                if (this->initiated_io)
                 {
+                    // Moving the connection from active to completed is a single update for status snapshots
+                    const auto stats_update = ctsConfig::Settings->ConnectionStatusDetails.snapshot_guard.begin_update();
+
                     // Update the status counter if we previously tracked this connection as active
                     ctsConfig::Settings->ConnectionStatusDetails.active_connection_count.decrement();
 
                     // Update the historic stats for this connection
-                    if (0 == this_ptr->last_error)
+                    if (0 == this->last_error)
                     {
                         ctsConfig::Settings->ConnectionStatusDetails.successful_completion_count.increment();
 
                     }
-                    else if (ctsIOPattern::IsProtocolError(this_ptr->last_error))
+                    else if (ctsIOPattern::IsProtocolError(this->last_error))
                     {
                         ctsConfig::Settings->ConnectionStatusDetails.protocol_error_count.increment();
 
@@ -257,28 +349,28 @@ namespace ctsTraffic
                     ctsConfig::Settings->ConnectionStatusDetails.connection_error_count.increment();
                 }
 
-                this_ptr->socket->close_socket(this_ptr->last_error);
-                this_ptr->socket->print_pattern_results(this_ptr->last_error);
+                this->socket->close_socket(this->last_error);
+                this->socket->print_pattern_results(this->last_error);
 
                 if (ctsConfig::Settings->ClosingFunction)
                 {
-                    ctsConfig::Settings->ClosingFunction(this_ptr->socket);
+                    ctsConfig::Settings->ClosingFunction(this->socket);
                 }
 
                 // update the state last, since ctsBroker looks for this state value
                 // - to know when to delete the ctsSocketState instance
-                auto lock = this_ptr->state_guard.lock();
-                this_ptr->state = InternalState::Closed;
+                auto lock = this->state_guard.lock();
+                this->state = InternalState::Closed;
                 lock.reset();
 
-                auto parent = this_ptr->broker.lock();
+                auto parent = this->broker.lock();
                 if (parent)
                 {
-                    parent->closing(this_ptr->initiated_io);
+                    parent->closing(this->initiated_io);
                 }
 
                 PrintDebugInfo(L"\t\tctsSocketState Closed\n");
-                break;
+                return false;
             }
 
             default:
@@ -286,9 +378,10 @@ namespace ctsTraffic
                 // the callback should never see any other states
                 FAIL_FAST_MSG(
                     "ctsSocketState::ThreadPoolWorker - invalid socket state [%d]",
-                    this_ptr->state);
+                    this->state);
             }
         }
+        return true;
     }
 
 } // namespace
@@ -79,6 +79,15 @@ namespace ctsTraffic
         //
         InternalState current_state() const noexcept;
 
+        //
+        // The threadpool environment this connection was assigned
+        // - all TP objects for this connection are created against it
+        //
+        PTP_CALLBACK_ENVIRON thread_pool_environment() const noexcept
+        {
+            return tp_environment;
+        }
+
         //
         // copy c'tor and assignment
         //
@@ -92,6 +101,7 @@ namespace ctsTraffic
         // private members of ctsSocketState
         // - CS's are mutable to allow taking a CS in a const function
         //
+        PTP_CALLBACK_ENVIRON tp_environment = nullptr;
         wil::unique_threadpool_work thread_pool_worker;
         mutable wil::critical_section state_guard{};
         std::weak_ptr<ctsSocketBroker> broker{};
@@ -99,11 +109,31 @@ namespace ctsTraffic
         InternalState state = InternalState::Creating;
         int last_error = 0UL;
         bool initiated_io = false;
+        // set when complete_state is called from within this object's own threadpool callback
+        // - the callback then runs the next state itself instead of submitting new threadpool work
+        bool inline_transition_pending = false;
+        // -Memory:compact: callbacks submitted with TrySubmitThreadpoolCallback which have not yet returned
+        // - there is no TP_WORK to wait on, so the d'tor waits for this to drain instead
+        long pending_callbacks = 0;
 
         //
-        // static threadpool callback function
+        // static threadpool callback functions
+        // - ThreadPoolCallback is used under -Memory:compact, where thread_pool_worker is not created
         //
         static VOID NTAPI ThreadPoolWorker(PTP_CALLBACK_INSTANCE /*_instance*/, PVOID _context, PTP_WORK /*_work*/) noexcept;
+        static VOID NTAPI ThreadPoolCallback(PTP_CALLBACK_INSTANCE /*_instance*/, PVOID _context) noexcept;
+        static void RunStateMachine(_In_ ctsSocketState* this_ptr) noexcept;
+
+        //
+        // queues the state machine to run the current state on the threadpool
+        //
+        void submit_work() noexcept;
+
+        //
+        // runs the functor for the current state
+        // - returns false once the state machine has closed, after which the object must not be touched
+        //
+        bool run_current_state() noexcept;
     };
 
 } // namespace
@@ -14,6 +14,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #pragma once
 // cpp headers
 #include <cstring>
+#include <vector>
 // os headers
 #include <Windows.h>
 #include <rpc.h>
@@ -29,8 +30,7 @@ namespace ctsTraffic
     {
         constexpr unsigned long ConnectionIdLength = 36 + 1; // UUID strings are 36 chars
 
-        template <typename T>
-        void GenerateConnectionId(_In_ T& _statistics_object)
+        inline void GenerateConnectionId(_Out_writes_z_(ConnectionIdLength) char* _connection_identifier)
         {
             UUID connection_id;
             RPC_STATUS status = UuidCreate(&connection_id);
@@ -50,13 +50,19 @@ namespace ctsTraffic
                 "UuidToString returned a string not 36 characters long (%Iu)",
                 strlen(reinterpret_cast<LPSTR>(connection_id_string)));
 
-            const auto copy_error = ::memcpy_s(_statistics_object.connection_identifier, ConnectionIdLength, connection_id_string, ConnectionIdLength);
+            const auto copy_error = ::memcpy_s(_connection_identifier, ConnectionIdLength, connection_id_string, ConnectionIdLength);
             FAIL_FAST_IF_MSG(
                 copy_error != 0,
                 "memcpy_s failed trying to copy a UUID string (%d)", copy_error);
 
             RpcStringFreeA(&connection_id_string);
-            _statistics_object.connection_identifier[ConnectionIdLength - 1] = '\0';
+            _connection_identifier[ConnectionIdLength - 1] = '\0';
+        }
+
+        template <typename T>
+        void GenerateConnectionId(_In_ T& _statistics_object)
+        {
+            GenerateConnectionId(_statistics_object.connection_identifier);
         }
 
         template <typename T>
@@ -76,6 +82,49 @@ namespace ctsTraffic
         {
             _statistics_object.end_time.set_conditionally(ctl::ctTimer::ctSnapQpcInMillis(), 0LL);
         }
+
+        namespace details
+        {
+            //
+            // The index of the first processor of each processor group, counting the active processors of the groups before it
+            // - groups and their active processors are fixed for the lifetime of the process
+            //
+            struct ProcessorGroupBases
+            {
+                static constexpr WORD MaxGroups = 32;
+                unsigned long base[MaxGroups]{};
+
+                ProcessorGroupBases() noexcept
+                {
+                    const WORD group_count = GetActiveProcessorGroupCount();
+                    unsigned long next_base = 0;
+                    for (WORD group = 0; group < group_count && group < MaxGroups; ++group)
+                    {
+                        base[group] = next_base;
+                        next_base += GetActiveProcessorCount(group);
+                    }
+                }
+            };
+        }
+
+        //
+        // Returns an index for the current processor to select a per-processor shard
+        // - processors are numbered across all groups, so processor N of each group gets a different index:
+        //   with smaller groups (e.g. 2 groups of 36), every shard is used before any is shared
+        // - callers mask the returned value with their (power of 2) shard count
+        //
+        inline unsigned long CurrentProcessorIndex() noexcept
+        {
+            static const details::ProcessorGroupBases s_group_bases;
+
+            PROCESSOR_NUMBER processor_number{};
+            GetCurrentProcessorNumberEx(&processor_number);
+            if (processor_number.Group < details::ProcessorGroupBases::MaxGroups)
+            {
+                return s_group_bases.base[processor_number.Group] + processor_number.Number;
+            }
+            return processor_number.Group * 64UL + processor_number.Number;
+        }
     }
 
     struct ctStatsTracking
@@ -183,6 +232,216 @@ namespace ctsTraffic
         }
     };
 
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctStatsShardedTracking
+    ///
+    /// Counter for the process-wide status details which are updated on every IO completion
+    /// - the value is split across cache-line-aligned shards, one per processor
+    ///   so concurrent completions on different processors never contend on the same cache line
+    /// - writers still use Interlocked operations (threads can migrate between processors)
+    ///   but the target cache line is almost always already owned by the current processor
+    /// - readers sum all shards; the 'previous' value is only touched by the single status-printing thread
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctStatsShardedTracking
+    {
+    public:
+        // must be a power of 2 - one shard per logical processor in a processor group
+        static constexpr unsigned long ShardCount = 64;
+
+    private:
+        struct alignas(SYSTEM_CACHE_ALIGNMENT_SIZE) Shard
+        {
+            long long value = 0ll;
+        };
+        Shard shards[ShardCount]{};
+        long long previous_value = 0ll;
+
+        Shard& current_shard() noexcept
+        {
+            return shards[ctsStatistics::CurrentProcessorIndex() & (ShardCount - 1)];
+        }
+
+    public:
+        ctStatsShardedTracking() noexcept = default;
+        ~ctStatsShardedTracking() noexcept = default;
+        ctStatsShardedTracking(const ctStatsShardedTracking&) = delete;
+        ctStatsShardedTracking& operator=(const ctStatsShardedTracking&) = delete;
+        ctStatsShardedTracking(ctStatsShardedTracking&&) = delete;
+        ctStatsShardedTracking& operator=(ctStatsShardedTracking&&) = delete;
+
+        //
+        // Sums all shards - the value is not an atomic snapshot across shards
+        // - any update missed by this read is reflected in the next read
+        //
+        [[nodiscard]] long long get() const noexcept
+        {
+            long long total = 0ll;
+            for (const auto& shard : shards)
+            {
+                total += ctl::ctMemoryGuardRead(&shard.value);
+            }
+            return total;
+        }
+        //
+        // Adds the [in] value to the shard of the current processor
+        // - unlike ctStatsTracking, does not return a value as the global value is not known
+        //
+        void add(long long _value) noexcept
+        {
+            ctl::ctMemoryGuardAdd(&current_shard().value, _value);
+        }
+        void increment() noexcept
+        {
+            ctl::ctMemoryGuardIncrement(&current_shard().value);
+        }
+        //
+        // Get / Sets a new value to the 'previous' value, returning the prior 'previous' value
+        //
+        long long get_prior_value() noexcept
+        {
+            return ctl::ctMemoryGuardRead(&previous_value);
+        }
+        long long set_prior_value(long long _new_value) noexcept
+        {
+            return ctl::ctMemoryGuardWrite(&previous_value, _new_value);
+        }
+        //
+        // Updates the previous value with the current sum
+        // - returning the difference (current_value - previous_value)
+        //
+        long long snap_value_difference() noexcept
+        {
+            const long long capture_current_value = get();
+            const long long capture_prior_value = ctl::ctMemoryGuardWrite(&previous_value, capture_current_value);
+            return capture_current_value - capture_prior_value;
+        }
+        //
+        // Returns the difference (current_value - previous_value)
+        // - without modifying either value
+        //
+        [[nodiscard]] long long read_value_difference() const noexcept
+        {
+            const long long capture_current_value = get();
+            const long long capture_prior_value = ctl::ctMemoryGuardRead(&previous_value);
+            return capture_current_value - capture_prior_value;
+        }
+    };
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctStatsSnapshotGuard
+    ///
+    /// Seqlock-style guard allowing a reader to take an internally consistent cut across multiple counters
+    /// - writers never wait: an update increments an in-flight count before touching the counters,
+    ///   then bumps a generation and decrements the in-flight count when done
+    /// - the reader retries until no writer was in flight and no generation changed while it read
+    /// - ShardCount > 1 spreads the writer bookkeeping across per-processor cache lines
+    ///   (the update remembers its shard, so it is safe for a thread to migrate mid-update)
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    template <unsigned long ShardCount>
+    class ctStatsSnapshotGuard
+    {
+        static_assert(ShardCount > 0 && (ShardCount & (ShardCount - 1)) == 0, "ctStatsSnapshotGuard requires a power of 2 shard count");
+
+        struct alignas(SYSTEM_CACHE_ALIGNMENT_SIZE) Shard
+        {
+            long long writers_in_flight = 0ll;
+            long long generation = 0ll;
+        };
+        Shard shards[ShardCount]{};
+
+        // bounds the time the status thread can spin against a continuous stream of writers
+        static constexpr unsigned long MaxReadAttempts = 1024;
+
+        [[nodiscard]] long long sum_writers_in_flight() const noexcept
+        {
+            long long total = 0ll;
+            for (const auto& shard : shards)
+            {
+                total += ctl::ctMemoryGuardRead(&shard.writers_in_flight);
+            }
+            return total;
+        }
+        [[nodiscard]] long long sum_generation() const noexcept
+        {
+            long long total = 0ll;
+            for (const auto& shard : shards)
+            {
+                total += ctl::ctMemoryGuardRead(&shard.generation);
+            }
+            return total;
+        }
+
+    public:
+        //
+        // RAII object returned from begin_update() - the update is published when it goes out of scope
+        //
+        class Update
+        {
+            Shard* shard;
+
+        public:
+            explicit Update(Shard* _shard) noexcept : shard(_shard)
+            {
+                ctl::ctMemoryGuardIncrement(&shard->writers_in_flight);
+            }
+            ~Update() noexcept
+            {
+                ctl::ctMemoryGuardIncrement(&shard->generation);
+                ctl::ctMemoryGuardDecrement(&shard->writers_in_flight);
+            }
+            Update(const Update&) = delete;
+            Update& operator=(const Update&) = delete;
+            Update(Update&&) = delete;
+            Update& operator=(Update&&) = delete;
+        };
+
+        ctStatsSnapshotGuard() noexcept = default;
+        ~ctStatsSnapshotGuard() noexcept = default;
+        // copies of the statistics objects are values, not live counters - they start with a fresh guard
+        ctStatsSnapshotGuard(const ctStatsSnapshotGuard&) noexcept
+        {
+        }
+        ctStatsSnapshotGuard(ctStatsSnapshotGuard&&) noexcept
+        {
+        }
+        ctStatsSnapshotGuard& operator=(const ctStatsSnapshotGuard&) = delete;
+        ctStatsSnapshotGuard& operator=(ctStatsSnapshotGuard&&) = delete;
+
+        [[nodiscard]] Update begin_update() noexcept
+        {
+            return Update(&shards[ctsStatistics::CurrentProcessorIndex() & (ShardCount - 1)]);
+        }
+
+        //
+        // Invokes the functor to read the guarded counters until the reads form a consistent cut
+        // - returns false if the attempts were exhausted: the functor's last reads are then best-effort
+        //
+        template <typename T>
+        bool read_consistent(T&& _reader) const noexcept
+        {
+            for (unsigned long attempt = 0; attempt < MaxReadAttempts; ++attempt)
+            {
+                const long long starting_generation = sum_generation();
+                if (0 == sum_writers_in_flight())
+                {
+                    _reader();
+                    if (0 == sum_writers_in_flight() && sum_generation() == starting_generation)
+                    {
+                        return true;
+                    }
+                }
+                YieldProcessor();
+            }
+
+            _reader();
+            return false;
+        }
+    };
 
     struct ctsConnectionStatistics
     {
@@ -192,6 +451,8 @@ namespace ctsTraffic
         ctStatsTracking successful_completion_count;
         ctStatsTracking connection_error_count;
         ctStatsTracking protocol_error_count;
+        // writers updating more than one counter for a single event take an update from this guard
+        ctStatsSnapshotGuard<1> snapshot_guard;
 
         explicit ctsConnectionStatistics(long long _start_time = 0LL) noexcept :
             start_time(_start_time)
@@ -222,10 +483,12 @@ namespace ctsTraffic
             ctsConnectionStatistics return_stats(prior_time_read);
             return_stats.end_time.set(current_time);
 
-            return_stats.active_connection_count.set(this->active_connection_count.get());
-            return_stats.successful_completion_count.set(this->successful_completion_count.get());
-            return_stats.connection_error_count.set(this->connection_error_count.get());
-            return_stats.protocol_error_count.set(this->protocol_error_count.get());
+            snapshot_guard.read_consistent([&]() noexcept {
+                return_stats.active_connection_count.set(this->active_connection_count.get());
+                return_stats.successful_completion_count.set(this->successful_completion_count.get());
+                return_stats.connection_error_count.set(this->connection_error_count.get());
+                return_stats.protocol_error_count.set(this->protocol_error_count.get());
+            });
 
             return return_stats;
         }
@@ -240,6 +503,10 @@ namespace ctsTraffic
         ctStatsTracking dropped_frames;
         ctStatsTracking duplicate_frames;
         ctStatsTracking error_frames;
+        // -Recovery:fec - the parity datagrams sent (server) or the datagrams rebuilt (client),
+        // and the QPC ticks spent encoding or decoding them - only reported in the connection results
+        ctStatsTracking fec_datagrams;
+        ctStatsTracking fec_cpu_ticks;
         // unique connection identifier
         char connection_identifier[ctsStatistics::ConnectionIdLength]{};
 
@@ -358,4 +625,242 @@ namespace ctsTraffic
             return return_stats;
         }
     };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsConnectionTimeSeries
+    ///
+    /// Optional per-connection ring of per-interval samples (-TimeSeriesFilename)
+    /// - each sample holds the bytes transferred within one interval and an RTT sample taken in that interval
+    /// - only intervals in which IO completed are stored, so stalls show as gaps in the interval index
+    /// - once the ring is full the oldest samples are overwritten (the count is tracked in overwritten_samples)
+    /// - not thread safe: the owning ctsIOPattern updates it under its own lock
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct ctsTimeSeriesSample
+    {
+        unsigned long interval = 0UL;
+        // zero if no RTT sample was taken in this interval
+        unsigned long rtt_microseconds = 0UL;
+        long long bytes = 0LL;
+    };
+
+    class ctsConnectionTimeSeries
+    {
+    private:
+        std::vector<ctsTimeSeriesSample> samples;
+        // the total # of intervals ever opened - the newest sample is at (total_samples - 1) % capacity
+        unsigned long long total_samples = 0ULL;
+        long long start_time_ms = 0LL;
+        const unsigned long interval_ms;
+
+    public:
+        ctsConnectionTimeSeries(unsigned long _interval_ms, unsigned long _capacity) :
+            samples(_capacity),
+            interval_ms(_interval_ms)
+        {
+            FAIL_FAST_IF_MSG(0 == _interval_ms || 0 == _capacity, "ctsConnectionTimeSeries requires a non-zero interval and capacity");
+        }
+        ~ctsConnectionTimeSeries() noexcept = default;
+        ctsConnectionTimeSeries(const ctsConnectionTimeSeries&) = delete;
+        ctsConnectionTimeSeries& operator=(const ctsConnectionTimeSeries&) = delete;
+        ctsConnectionTimeSeries(ctsConnectionTimeSeries&&) = delete;
+        ctsConnectionTimeSeries& operator=(ctsConnectionTimeSeries&&) = delete;
+
+        //
+        // Adds bytes to the interval containing _current_time_ms
+        // - the first call starts the clock for this connection
+        // - returns true if this call opened a new interval (the caller can then take an RTT sample)
+        //
+        bool add_bytes(long long _current_time_ms, long long _bytes) noexcept
+        {
+            if (0LL == start_time_ms)
+            {
+                start_time_ms = _current_time_ms;
+            }
+            const auto interval = static_cast<unsigned long>((_current_time_ms - start_time_ms) / interval_ms);
+
+            bool opened_interval = false;
+            if (0ULL == total_samples || newest().interval != interval)
+            {
+                ++total_samples;
+                newest() = ctsTimeSeriesSample{ interval, 0UL, 0LL };
+                opened_interval = true;
+            }
+            newest().bytes += _bytes;
+            return opened_interval;
+        }
+        //
+        // Records an RTT sample in the newest interval
+        //
+        void set_rtt(unsigned long _rtt_microseconds) noexcept
+        {
+            if (total_samples > 0ULL)
+            {
+                newest().rtt_microseconds = _rtt_microseconds;
+            }
+        }
+
+        [[nodiscard]] unsigned long interval_milliseconds() const noexcept
+        {
+            return interval_ms;
+        }
+        [[nodiscard]] unsigned long sample_count() const noexcept
+        {
+            return static_cast<unsigned long>(total_samples < samples.size() ? total_samples : samples.size());
+        }
+        [[nodiscard]] unsigned long long overwritten_samples() const noexcept
+        {
+            return total_samples - sample_count();
+        }
+        //
+        // Invokes the functor with each stored sample, oldest to newest
+        //
+        template <typename T>
+        void for_each_sample(T&& _functor) const noexcept
+        {
+            const auto count = sample_count();
+            const auto capacity = samples.size();
+            const auto oldest = static_cast<size_t>((total_samples - count) % capacity);
+            for (unsigned long sample = 0; sample < count; ++sample)
+            {
+                _functor(samples[(oldest + sample) % capacity]);
+            }
+        }
+
+    private:
+        ctsTimeSeriesSample& newest() noexcept
+        {
+            return samples[static_cast<size_t>((total_samples - 1) % samples.size())];
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// Process-wide TCP and UDP status details
+    /// - the data-path counters are sharded per-processor
+    /// - snap_view() sums the shards and returns the same statistics objects as tracked per-connection
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct ctsGlobalTcpStatistics
+    {
+        ctStatsTracking start_time;
+        ctStatsShardedTracking bytes_sent;
+        ctStatsShardedTracking bytes_recv;
+
+        ctsGlobalTcpStatistics() noexcept = default;
+        ~ctsGlobalTcpStatistics() noexcept = default;
+        ctsGlobalTcpStatistics(const ctsGlobalTcpStatistics&) = delete;
+        ctsGlobalTcpStatistics& operator=(const ctsGlobalTcpStatistics&) = delete;
+        ctsGlobalTcpStatistics(ctsGlobalTcpStatistics&&) = delete;
+        ctsGlobalTcpStatistics& operator=(ctsGlobalTcpStatistics&&) = delete;
+
+        ctsTcpStatistics snap_view(bool _clear_settings) noexcept
+        {
+            const long long current_time = ctl::ctTimer::ctSnapQpcInMillis();
+            const long long prior_time_read = (_clear_settings) ?
+                this->start_time.set_prior_value(current_time) :
+                this->start_time.get_prior_value();
+
+            ctsTcpStatistics return_stats(prior_time_read);
+            return_stats.end_time.set(current_time);
+
+            if (_clear_settings)
+            {
+                return_stats.bytes_sent.set(this->bytes_sent.snap_value_difference());
+                return_stats.bytes_recv.set(this->bytes_recv.snap_value_difference());
+            }
+            else
+            {
+                return_stats.bytes_sent.set(this->bytes_sent.read_value_difference());
+                return_stats.bytes_recv.set(this->bytes_recv.read_value_difference());
+            }
+
+            return return_stats;
+        }
+    };
+
+    struct ctsGlobalUdpStatistics
+    {
+        ctStatsTracking start_time;
+        ctStatsShardedTracking bits_received;
+        ctStatsShardedTracking successful_frames;
+        ctStatsShardedTracking dropped_frames;
+        ctStatsShardedTracking duplicate_frames;
+        ctStatsShardedTracking error_frames;
+        // I-frames rendered and dropped with -FrameModel:gop - only reported in the final summary
+        ctStatsShardedTracking key_frames;
+        ctStatsShardedTracking dropped_key_frames;
+        // -Recovery:nack - frames requested again, frames which were only completed by a retransmit,
+        // and the retransmitted bits received (also counted in bits_received) - only reported in the final summary
+        ctStatsShardedTracking requested_frames;
+        ctStatsShardedTracking recovered_frames;
+        ctStatsShardedTracking retransmitted_bits;
+        // -Recovery:fec - the parity bits sent (server) or received (client, also counted in bits_received),
+        // the datagrams rebuilt from parity, and the QPC ticks spent encoding or decoding - only reported in the final summary
+        ctStatsShardedTracking fec_parity_bits;
+        ctStatsShardedTracking fec_recovered_datagrams;
+        ctStatsShardedTracking fec_cpu_ticks;
+        // -Playout:adaptive - frames whose datagrams arrived after they were rendered as dropped (also counted in dropped_frames),
+        // and for every frame rendered complete: the microseconds it waited after arriving, the buffer depth in frames,
+        // and the interarrival jitter estimate in microseconds - only reported in the final summary
+        ctStatsShardedTracking late_frames;
+        ctStatsShardedTracking playout_frames;
+        ctStatsShardedTracking playout_wait_us;
+        ctStatsShardedTracking playout_depth_frames;
+        ctStatsShardedTracking playout_jitter_us;
+        // every update of the frame counters, and every update of more than one counter, is taken under this guard
+        // so each status interval is a consistent cut - e.g. a rendered frame's key_frames, dropped_frames and
+        // dropped_key_frames are seen together or not at all
+        ctStatsSnapshotGuard<ctStatsShardedTracking::ShardCount> snapshot_guard;
+
+        ctsGlobalUdpStatistics() noexcept = default;
+        ~ctsGlobalUdpStatistics() noexcept = default;
+        ctsGlobalUdpStatistics(const ctsGlobalUdpStatistics&) = delete;
+        ctsGlobalUdpStatistics& operator=(const ctsGlobalUdpStatistics&) = delete;
+        ctsGlobalUdpStatistics(ctsGlobalUdpStatistics&&) = delete;
+        ctsGlobalUdpStatistics& operator=(ctsGlobalUdpStatistics&&) = delete;
+
+        ctsUdpStatistics snap_view(bool _clear_settings) noexcept
+        {
+            const long long current_time = ctl::ctTimer::ctSnapQpcInMillis();
+            const long long prior_time_read = (_clear_settings) ?
+                this->start_time.set_prior_value(current_time) :
+                this->start_time.get_prior_value();
+
+            ctsUdpStatistics return_stats(prior_time_read);
+            return_stats.end_time.set(current_time);
+
+            long long bits_received_value = 0ll;
+            long long successful_frames_value = 0ll;
+            long long dropped_frames_value = 0ll;
+            long long duplicate_frames_value = 0ll;
+            long long error_frames_value = 0ll;
+            snapshot_guard.read_consistent([&]() noexcept {
+                bits_received_value = this->bits_received.get();
+                successful_frames_value = this->successful_frames.get();
+                dropped_frames_value = this->dropped_frames.get();
+                duplicate_frames_value = this->duplicate_frames.get();
+                error_frames_value = this->error_frames.get();
+            });
+
+            // only the status thread reads and writes the prior values
+            // - update them from the same consistent cut so no interval double-counts or loses an update
+            return_stats.bits_received.set(bits_received_value - this->bits_received.get_prior_value());
+            return_stats.successful_frames.set(successful_frames_value - this->successful_frames.get_prior_value());
+            return_stats.dropped_frames.set(dropped_frames_value - this->dropped_frames.get_prior_value());
+            return_stats.duplicate_frames.set(duplicate_frames_value - this->duplicate_frames.get_prior_value());
+            return_stats.error_frames.set(error_frames_value - this->error_frames.get_prior_value());
+            if (_clear_settings)
+            {
+                this->bits_received.set_prior_value(bits_received_value);
+                this->successful_frames.set_prior_value(successful_frames_value);
+                this->dropped_frames.set_prior_value(dropped_frames_value);
+                this->duplicate_frames.set_prior_value(duplicate_frames_value);
+                this->error_frames.set_prior_value(error_frames_value);
+            }
+
+            return return_stats;
+        }
+    };
 }
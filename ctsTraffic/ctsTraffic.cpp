@@ -23,6 +23,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 #include <ctString.hpp>
 #include <ctException.hpp>
 #include <ctThreadPoolTimer.hpp>
+#include <ctTimer.hpp>
 // local headers
 #include "ctsConfig.h"
 #include "ctsSocketBroker.h"
@@ -168,9 +169,60 @@ int _cdecl wmain(int argc, _In_reads_z_(argc) const wchar_t** argv)
             ctsConfig::Settings->TcpStatusDetails.bytes_recv.get(),
             ctsConfig::Settings->TcpStatusDetails.bytes_sent.get());
     }
+    else if (ctsConfig::Settings->IoPattern == ctsConfig::IoPatternType::UdpBlast)
+    {
+        // the sender counts the datagrams it sent, the receiver the datagrams it received
+        const auto datagrams = ctsConfig::Settings->UdpStatusDetails.successful_frames.get();
+        ctsConfig::PrintSummary(
+            L"\n"
+            L"  Total Datagrams %ws : %lld\n"
+            L"  Total Bytes %ws : %lld\n"
+            L"  Average Packets Per Second : %lld\n",
+            ctsConfig::IsListening() ? L"Recv" : L"Sent",
+            datagrams,
+            ctsConfig::IsListening() ? L"Recv" : L"Sent",
+            ctsConfig::Settings->UdpStatusDetails.bits_received.get() / 8LL,
+            total_time_run > 0 ? static_cast<long long>(datagrams * 1000LL / total_time_run) : 0LL);
+
+        if (ctsConfig::IsListening())
+        {
+            // every datagram the senders sent was either received or dropped
+            const auto droppedDatagrams = ctsConfig::Settings->UdpStatusDetails.dropped_frames.get();
+            const auto sentDatagrams = datagrams + droppedDatagrams;
+            ctsConfig::PrintSummary(
+                L"  Total Dropped Datagrams : %lld (%f)\n"
+                L"  Total Reordered Datagrams : %lld (late or duplicate)\n"
+                L"  Total Error Datagrams : %lld\n",
+                droppedDatagrams,
+                sentDatagrams > 0 ? static_cast<double>(droppedDatagrams) / sentDatagrams * 100.0 : 0.0,
+                ctsConfig::Settings->UdpStatusDetails.duplicate_frames.get(),
+                ctsConfig::Settings->UdpStatusDetails.error_frames.get());
+        }
+
+        // the CPU cost of each datagram across the whole process, in kernel and user mode
+        FILETIME creation_time{};
+        FILETIME exit_time{};
+        FILETIME kernel_time{};
+        FILETIME user_time{};
+        if (datagrams > 0 && GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+        {
+            ULARGE_INTEGER kernel_ticks;
+            kernel_ticks.LowPart = kernel_time.dwLowDateTime;
+            kernel_ticks.HighPart = kernel_time.dwHighDateTime;
+            ULARGE_INTEGER user_ticks;
+            user_ticks.LowPart = user_time.dwLowDateTime;
+            user_ticks.HighPart = user_time.dwHighDateTime;
+            // FILETIME is in 100ns units
+            ctsConfig::PrintSummary(
+                L"  CPU Time Per Datagram : %f us. (kernel %f us., user %f us.)\n",
+                static_cast<double>(kernel_ticks.QuadPart + user_ticks.QuadPart) / 10.0 / datagrams,
+                static_cast<double>(kernel_ticks.QuadPart) / 10.0 / datagrams,
+                static_cast<double>(user_ticks.QuadPart) / 10.0 / datagrams);
+        }
+    }
     else
     {
-        // currently don't track UDP server stats
+        // the UDP server only tracks the parity it sends with -Recovery:fec
         if (!ctsConfig::IsListening())
         {
             const auto successfulFrames = ctsConfig::Settings->UdpStatusDetails.successful_frames.get();
@@ -199,11 +251,101 @@ int _cdecl wmain(int argc, _In_reads_z_(argc) const wchar_t** argv)
                 totalFrames > 0 ? static_cast<double>(duplicateFrames) / totalFrames * 100.0 : 0.0,
                 errorFrames,
                 totalFrames > 0 ? static_cast<double>(errorFrames) / totalFrames * 100.0 : 0.0);
+
+            // loss from the I-frame bursts of a GOP, separate from the loss across all frames
+            if (ctsConfig::GetMediaStream().GopLengthFrames > 0)
+            {
+                const auto keyFrames = ctsConfig::Settings->UdpStatusDetails.key_frames.get();
+                const auto droppedKeyFrames = ctsConfig::Settings->UdpStatusDetails.dropped_key_frames.get();
+                const auto droppedOtherFrames = droppedFrames - droppedKeyFrames;
+                // error frames were never matched to a frame in the stream
+                const auto otherFrames = successfulFrames + droppedFrames + duplicateFrames - keyFrames;
+                ctsConfig::PrintSummary(
+                    L"  Total Dropped I-Frames : %lld of %lld (%f)\n"
+                    L"  Total Dropped P-Frames : %lld of %lld (%f)\n",
+                    droppedKeyFrames,
+                    keyFrames,
+                    keyFrames > 0 ? static_cast<double>(droppedKeyFrames) / keyFrames * 100.0 : 0.0,
+                    droppedOtherFrames,
+                    otherFrames,
+                    otherFrames > 0 ? static_cast<double>(droppedOtherFrames) / otherFrames * 100.0 : 0.0);
+            }
+
+            // the loss before recovery is every frame dropped plus every frame only completed by a retransmit
+            if (ctsConfig::GetMediaStream().NackRecovery)
+            {
+                const auto requestedFrames = ctsConfig::Settings->UdpStatusDetails.requested_frames.get();
+                const auto recoveredFrames = ctsConfig::Settings->UdpStatusDetails.recovered_frames.get();
+                const auto rawLostFrames = droppedFrames + recoveredFrames;
+                const auto bitsReceived = ctsConfig::Settings->UdpStatusDetails.bits_received.get();
+                const auto retransmittedBits = ctsConfig::Settings->UdpStatusDetails.retransmitted_bits.get();
+                ctsConfig::PrintSummary(
+                    L"  Total Raw Lost Frames : %lld (%f)\n"
+                    L"  Total Frames Requested Again : %lld\n"
+                    L"  Total Recovered Frames : %lld (%f of raw lost frames)\n"
+                    L"  Total Retransmitted Bytes Recv : %lld (%f overhead)\n",
+                    rawLostFrames,
+                    totalFrames > 0 ? static_cast<double>(rawLostFrames) / totalFrames * 100.0 : 0.0,
+                    requestedFrames,
+                    recoveredFrames,
+                    rawLostFrames > 0 ? static_cast<double>(recoveredFrames) / rawLostFrames * 100.0 : 0.0,
+                    retransmittedBits / 8LL,
+                    bitsReceived > retransmittedBits ? static_cast<double>(retransmittedBits) / (bitsReceived - retransmittedBits) * 100.0 : 0.0);
+            }
+
+            // late frames are also counted as dropped: they arrived, but after they were rendered
+            if (ctsConfig::GetMediaStream().AdaptivePlayout)
+            {
+                const auto lateFrames = ctsConfig::Settings->UdpStatusDetails.late_frames.get();
+                const auto playoutFrames = ctsConfig::Settings->UdpStatusDetails.playout_frames.get();
+                const double averageDepthFrames = playoutFrames > 0 ?
+                    static_cast<double>(ctsConfig::Settings->UdpStatusDetails.playout_depth_frames.get()) / playoutFrames :
+                    0.0;
+                ctsConfig::PrintSummary(
+                    L"  Total Late Frames : %lld (%f)\n"
+                    L"  Average Playout Buffer Wait : %f ms.\n"
+                    L"  Average Playout Buffer Depth : %f frames (%f ms.)\n"
+                    L"  Average Interarrival Jitter : %f ms.\n",
+                    lateFrames,
+                    totalFrames > 0 ? static_cast<double>(lateFrames) / totalFrames * 100.0 : 0.0,
+                    playoutFrames > 0 ? static_cast<double>(ctsConfig::Settings->UdpStatusDetails.playout_wait_us.get()) / playoutFrames / 1000.0 : 0.0,
+                    averageDepthFrames,
+                    averageDepthFrames * 1000.0 / static_cast<unsigned long>(ctsConfig::GetMediaStream().FramesPerSecond),
+                    playoutFrames > 0 ? static_cast<double>(ctsConfig::Settings->UdpStatusDetails.playout_jitter_us.get()) / playoutFrames / 1000.0 : 0.0);
+            }
+
+            // the parity overhead is against the bytes of the frames themselves
+            if (ctsConfig::GetMediaStream().FecDataDatagrams > 0)
+            {
+                const auto bitsReceived = ctsConfig::Settings->UdpStatusDetails.bits_received.get();
+                const auto parityBits = ctsConfig::Settings->UdpStatusDetails.fec_parity_bits.get();
+                ctsConfig::PrintSummary(
+                    L"  Total FEC Recovered Datagrams : %lld\n"
+                    L"  Total FEC Parity Bytes Recv : %lld (%f overhead)\n"
+                    L"  Total FEC Decode Time : %lld us.\n",
+                    ctsConfig::Settings->UdpStatusDetails.fec_recovered_datagrams.get(),
+                    parityBits / 8LL,
+                    bitsReceived > parityBits ? static_cast<double>(parityBits) / (bitsReceived - parityBits) * 100.0 : 0.0,
+                    ctsConfig::Settings->UdpStatusDetails.fec_cpu_ticks.get() * 1000000LL / ctl::ctTimer::ctSnapQpf());
+            }
+        }
+        else if (ctsConfig::GetMediaStream().FecDataDatagrams > 0)
+        {
+            ctsConfig::PrintSummary(
+                L"\n"
+                L"  Total FEC Parity Bytes Sent : %lld\n"
+                L"  Total FEC Encode Time : %lld us.\n",
+                ctsConfig::Settings->UdpStatusDetails.fec_parity_bits.get() / 8LL,
+                ctsConfig::Settings->UdpStatusDetails.fec_cpu_ticks.get() * 1000000LL / ctl::ctTimer::ctSnapQpf());
         }
     }
     ctsConfig::PrintSummary(
         L"  Total Time : %lld ms.\n",
         static_cast<long long>(total_time_run));
+    ctsConfig::PrintLocalPortStatistics();
+    ctsConfig::PrintBufferPlacementStatistics();
+    ctsConfig::PrintConnectionFootprint();
+    ctsConfig::PrintDroppedLogMessages();
 
     long long error_count =
         ctsConfig::Settings->ConnectionStatusDetails.connection_error_count.get() +
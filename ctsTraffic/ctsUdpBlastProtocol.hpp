@@ -0,0 +1,182 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <cstring>
+#include <vector>
+// os headers
+#include <Windows.h>
+
+namespace ctsTraffic
+{
+    //
+    // Every -Pattern:UdpBlast datagram starts with this header, followed by the payload from the shared buffer
+    //
+    // Stream Id                 (8 bytes) : unique to each sending connection - a receiver can be sent several streams at once
+    // Sequence Number           (8 bytes) : the datagram's position in its stream, from 0
+    // Stream Datagram Count     (8 bytes) : the datagrams in the stream - gives the loss at the tail of the stream
+    //
+    constexpr unsigned long UdpBlastStreamIdLength = 8;
+    constexpr unsigned long UdpBlastSequenceNumberLength = 8;
+    constexpr unsigned long UdpBlastDatagramCountLength = 8;
+    constexpr unsigned long UdpBlastHeaderLength =
+        UdpBlastStreamIdLength +
+        UdpBlastSequenceNumberLength +
+        UdpBlastDatagramCountLength;
+
+    // the largest UDP payload over IPv4
+    constexpr unsigned long UdpBlastMaximumDatagramSize = 65507UL;
+    // small datagrams: the point of the pattern is the per-packet cost
+    constexpr unsigned long UdpBlastDefaultDatagramSize = 64UL;
+
+    struct ctsUdpBlastHeader
+    {
+        unsigned long long stream_id = 0ULL;
+        long long sequence_number = 0LL;
+        long long datagram_count = 0LL;
+
+        void write(_Out_writes_bytes_(UdpBlastHeaderLength) char* _buffer) const noexcept
+        {
+            memcpy(_buffer, &stream_id, UdpBlastStreamIdLength);
+            memcpy(_buffer + UdpBlastStreamIdLength, &sequence_number, UdpBlastSequenceNumberLength);
+            memcpy(_buffer + UdpBlastStreamIdLength + UdpBlastSequenceNumberLength, &datagram_count, UdpBlastDatagramCountLength);
+        }
+
+        static ctsUdpBlastHeader Read(_In_reads_bytes_(UdpBlastHeaderLength) const char* _buffer) noexcept
+        {
+            ctsUdpBlastHeader header;
+            memcpy(&header.stream_id, _buffer, UdpBlastStreamIdLength);
+            memcpy(&header.sequence_number, _buffer + UdpBlastStreamIdLength, UdpBlastSequenceNumberLength);
+            memcpy(&header.datagram_count, _buffer + UdpBlastStreamIdLength + UdpBlastSequenceNumberLength, UdpBlastDatagramCountLength);
+            return header;
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ///
+    /// ctsUdpBlastSequenceTracker
+    ///
+    /// Counts the datagrams lost from each stream by the gaps in the sequence numbers received
+    /// - a gap is counted as dropped as soon as a later datagram arrives
+    /// - a datagram older than the next expected is late: it takes back one dropped datagram of its stream,
+    ///   as long as the stream has gaps left to fill
+    ///   (a duplicate of a datagram already received cannot be told apart from a late one)
+    /// - the datagrams never received at the tail of each stream are only known once the streams are finished
+    ///
+    /// Not thread-safe: the caller serializes access
+    ///
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ctsUdpBlastSequenceTracker
+    {
+    public:
+        struct Result
+        {
+            // false if the header could not have come from a UdpBlast sender
+            bool valid = false;
+            // the datagram arrived after later datagrams of its stream
+            bool late = false;
+            // the change in the datagrams counted as dropped: the gap before this datagram, or -1 for a late datagram
+            long long dropped_change = 0LL;
+        };
+
+        ctsUdpBlastSequenceTracker() = default;
+        ~ctsUdpBlastSequenceTracker() = default;
+
+        ctsUdpBlastSequenceTracker(const ctsUdpBlastSequenceTracker&) = delete;
+        ctsUdpBlastSequenceTracker& operator=(const ctsUdpBlastSequenceTracker&) = delete;
+        ctsUdpBlastSequenceTracker(ctsUdpBlastSequenceTracker&&) = delete;
+        ctsUdpBlastSequenceTracker& operator=(ctsUdpBlastSequenceTracker&&) = delete;
+
+        //
+        // Counts the datagram toward its stream
+        // - can throw std::bad_alloc the first time a stream is seen
+        //
+        Result record(const ctsUdpBlastHeader& _header)
+        {
+            Result result;
+            if (_header.datagram_count <= 0 || _header.sequence_number < 0 || _header.sequence_number >= _header.datagram_count)
+            {
+                return result;
+            }
+
+            Stream& stream = find_stream(_header);
+            if (stream.datagram_count != _header.datagram_count)
+            {
+                return result;
+            }
+            result.valid = true;
+
+            if (_header.sequence_number >= stream.next_sequence_number)
+            {
+                result.dropped_change = _header.sequence_number - stream.next_sequence_number;
+                stream.gaps += result.dropped_change;
+                stream.next_sequence_number = _header.sequence_number + 1;
+            }
+            else
+            {
+                result.late = true;
+                if (stream.gaps > 0)
+                {
+                    --stream.gaps;
+                    result.dropped_change = -1LL;
+                }
+            }
+            return result;
+        }
+
+        [[nodiscard]] size_t stream_count() const noexcept
+        {
+            return streams.size();
+        }
+
+        //
+        // Returns the datagrams never received at the tail of every stream, and forgets the streams
+        //
+        long long finish() noexcept
+        {
+            long long tail_dropped = 0LL;
+            for (const auto& stream : streams)
+            {
+                tail_dropped += stream.datagram_count - stream.next_sequence_number;
+            }
+            streams.clear();
+            return tail_dropped;
+        }
+
+    private:
+        struct Stream
+        {
+            unsigned long long stream_id;
+            long long datagram_count;
+            long long next_sequence_number;
+            long long gaps;
+        };
+        // a receiver is usually sent a single stream: a vector is searched faster than a map is hashed
+        std::vector<Stream> streams;
+
+        Stream& find_stream(const ctsUdpBlastHeader& _header)
+        {
+            for (auto& stream : streams)
+            {
+                if (stream.stream_id == _header.stream_id)
+                {
+                    return stream;
+                }
+            }
+            streams.push_back(Stream{ _header.stream_id, _header.datagram_count, 0LL, 0LL });
+            return streams.back();
+        }
+    };
+}
@@ -0,0 +1,182 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+// cpp headers
+#include <memory>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <exception>
+// os headers
+#include <Windows.h>
+#include <WinSock2.h>
+// wil headers
+#include <wil/resource.h>
+// ctl headers
+#include <ctException.hpp>
+#include <ctSockaddr.hpp>
+// project headers
+#include "ctsConfig.h"
+#include "ctsSocket.h"
+#include "ctsUdpBlastReceiver.h"
+
+
+namespace ctsTraffic
+{
+    //
+    // A UdpBlast receiver has no connection to accept: each ctsSocket is bound to one of the listening addresses,
+    // and receives every datagram sent to that address until the datagrams stop
+    // - only one socket can be bound to each address at a time
+    // - sockets created while every address is held wait until a receiver is closed
+    //
+    namespace ctsUdpBlastReceiverImpl
+    {
+        static wil::critical_section s_AddressLock;
+        // the socket holding each of the listening addresses, by index into ListenAddresses
+        _Guarded_by_(s_AddressLock) static std::vector<const ctsSocket*> s_AddressOwners;
+        _Guarded_by_(s_AddressLock) static std::deque<std::weak_ptr<ctsSocket>> s_WaitingSockets;
+
+        static void bind_socket(const std::shared_ptr<ctsSocket>& _shared_socket, const ctl::ctSockaddr& _listen_addr) noexcept
+        {
+            int gle = NO_ERROR;
+            PCSTR function_name = "CreateSocket";
+
+            auto socket = INVALID_SOCKET;
+            try
+            {
+                socket = ctsConfig::CreateSocket(_listen_addr.family(), SOCK_DGRAM, IPPROTO_UDP, ctsConfig::Settings->SocketFlags);
+            }
+            catch (const std::exception& e)
+            {
+                gle = ctl::ctErrorCode(e);
+            }
+
+            if (NO_ERROR == gle)
+            {
+                function_name = "SetPreBindOptions";
+                gle = ctsConfig::SetPreBindOptions(socket, _listen_addr);
+            }
+
+            if (NO_ERROR == gle)
+            {
+                function_name = "bind";
+                if (SOCKET_ERROR == bind(socket, _listen_addr.sockaddr(), _listen_addr.length()))
+                {
+                    gle = WSAGetLastError();
+                }
+            }
+
+            // store whatever values we have: for accurate logging
+            _shared_socket->set_socket(socket);
+            _shared_socket->set_local_address(_listen_addr);
+
+            if (NO_ERROR == gle)
+            {
+                PrintDebugInfo(L"\t\tctsUdpBlastReceiver : receiving on %ws\n", _listen_addr.WriteCompleteAddress().c_str());
+            }
+            else
+            {
+                ctsConfig::PrintErrorIfFailed(function_name, gle);
+            }
+            _shared_socket->complete_state(gle);
+        }
+    }
+
+    void ctsUdpBlastReceiverBind(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
+    {
+        using namespace ctsUdpBlastReceiverImpl;
+
+        const auto shared_socket(_weak_socket.lock());
+        if (!shared_socket)
+        {
+            return;
+        }
+
+        size_t address_index = 0;
+        try
+        {
+            const auto lock = s_AddressLock.lock();
+            if (s_AddressOwners.empty())
+            {
+                s_AddressOwners.resize(ctsConfig::Settings->ListenAddresses.size());
+            }
+
+            const auto found_address = std::find(std::begin(s_AddressOwners), std::end(s_AddressOwners), nullptr);
+            if (found_address == std::end(s_AddressOwners))
+            {
+                // bound once another receiver is closed
+                s_WaitingSockets.push_back(_weak_socket);
+                return;
+            }
+            *found_address = shared_socket.get();
+            address_index = static_cast<size_t>(found_address - std::begin(s_AddressOwners));
+        }
+        catch (const std::exception& e)
+        {
+            ctsConfig::PrintException(e);
+            shared_socket->complete_state(ERROR_OUTOFMEMORY);
+            return;
+        }
+
+        // never bind under the lock: completing the state can close other sockets
+        bind_socket(shared_socket, ctsConfig::Settings->ListenAddresses[address_index]);
+    }
+
+    void ctsUdpBlastReceiverClose(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
+    {
+        using namespace ctsUdpBlastReceiverImpl;
+
+        const auto shared_socket(_weak_socket.lock());
+        if (!shared_socket)
+        {
+            return;
+        }
+
+        std::shared_ptr<ctsSocket> next_socket;
+        size_t address_index = 0;
+        {
+            const auto lock = s_AddressLock.lock();
+            const auto found_address = std::find(std::begin(s_AddressOwners), std::end(s_AddressOwners), shared_socket.get());
+            if (found_address == std::end(s_AddressOwners))
+            {
+                // closing before it was ever bound: it must no longer wait for an address
+                // - also removing the sockets which were already deleted
+                s_WaitingSockets.erase(
+                    std::remove_if(std::begin(s_WaitingSockets), std::end(s_WaitingSockets), [&](const std::weak_ptr<ctsSocket>& waiting_socket) noexcept {
+                        const auto shared_waiting_socket(waiting_socket.lock());
+                        return !shared_waiting_socket || shared_waiting_socket == shared_socket;
+                    }),
+                    std::end(s_WaitingSockets));
+                return;
+            }
+
+            // hand the address to the next socket still waiting for one
+            *found_address = nullptr;
+            address_index = static_cast<size_t>(found_address - std::begin(s_AddressOwners));
+            while (!next_socket && !s_WaitingSockets.empty())
+            {
+                next_socket = s_WaitingSockets.front().lock();
+                s_WaitingSockets.pop_front();
+            }
+            if (next_socket)
+            {
+                *found_address = next_socket.get();
+            }
+        }
+
+        if (next_socket)
+        {
+            bind_socket(next_socket, ctsConfig::Settings->ListenAddresses[address_index]);
+        }
+    }
+} // namespace
@@ -0,0 +1,30 @@
+/*
+
+Copyright (c) Microsoft Corporation
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the ""License""); you may not use this file except in compliance with the License. You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+
+THIS CODE IS PROVIDED ON AN  *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+
+See the Apache Version 2.0 License for specific language governing permissions and limitations under the License.
+
+*/
+
+#pragma once
+
+// cpp headers
+#include <memory>
+// local headers
+#include "ctsSocket.h"
+
+namespace ctsTraffic
+{
+    // The function that is registered to 'accept' for -Pattern:UdpBlast
+    // - binds the ctsSocket to a listening address not already held by another receiver
+    // - or completes it once the receiver holding an address is closed
+    void ctsUdpBlastReceiverBind(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
+
+    // The function that is registered to release the listening address held by the closing ctsSocket
+    void ctsUdpBlastReceiverClose(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept;
+} // namespace
@@ -26,7 +26,6 @@ namespace ctsTraffic
 {
     static long long s_BindCounter = 0LL;
     static long long s_TargetCounter = 0LL;
-    static long long s_PortCounter = 0LL;
 
     void ctsWSASocket(const std::weak_ptr<ctsSocket>& _weak_socket) noexcept
     {
@@ -36,23 +35,39 @@ namespace ctsTraffic
             return;
         }
 
+        //
+        // Find a bind and target address by moving to the next address in the respective vectors
+        //
+        const auto bind_size = ctsConfig::Settings->BindAddresses.size();
+        auto socket_counter = ctl::ctMemoryGuardIncrement(&s_BindCounter);
+        const auto bind_index = static_cast<size_t>(socket_counter % bind_size);
+        ctl::ctSockaddr local_addr(ctsConfig::Settings->BindAddresses[bind_index]);
+
+        int gle = 0;
+        PCSTR function_name = "CreateWSASocket";
+
+        //
+        // A -LocalPort range leases a free port for this bind address
+        // - otherwise bind to the one specified port, or to an ephemeral port
+        //
+        ctsConfig::LocalPortLease port_lease;
         USHORT next_port = 0;
         if (ctsConfig::Settings->LocalPortHigh != 0 && ctsConfig::Settings->LocalPortLow != 0)
         {
-            const auto port_counter = ctl::ctMemoryGuardIncrement(&s_PortCounter);
-            next_port = static_cast<USHORT>(port_counter % (ctsConfig::Settings->LocalPortHigh - ctsConfig::Settings->LocalPortLow + 1)) + ctsConfig::Settings->LocalPortLow;
+            if (ctsConfig::AcquireLocalPort(bind_index, port_lease))
+            {
+                next_port = port_lease.port;
+            }
+            else
+            {
+                function_name = "AcquireLocalPort";
+                gle = WSAEADDRINUSE;
+            }
         }
         else
         {
             next_port = ctsConfig::Settings->LocalPortLow;
         }
-
-        //
-        // Find a bind and target address by moving to the next address in the respective vectors
-        //
-        const auto bind_size = ctsConfig::Settings->BindAddresses.size();
-        auto socket_counter = ctl::ctMemoryGuardIncrement(&s_BindCounter);
-        ctl::ctSockaddr local_addr(ctsConfig::Settings->BindAddresses[socket_counter % bind_size]);
         local_addr.SetPort(next_port);
 
         ctl::ctSockaddr target_addr;
@@ -73,30 +88,31 @@ namespace ctsTraffic
         }
 
         auto socket = INVALID_SOCKET;
-        int gle = 0;
-        PCSTR function_name = "CreateWSASocket";
-        try
+        if (NO_ERROR == gle)
         {
-            switch (ctsConfig::Settings->Protocol)
+            try
             {
-                case ctsConfig::ProtocolType::TCP:
-                    socket = ctsConfig::CreateSocket(local_addr.family(), SOCK_STREAM, IPPROTO_TCP, ctsConfig::Settings->SocketFlags);
-                    break;
-
-                case ctsConfig::ProtocolType::UDP:
-                    socket = ctsConfig::CreateSocket(local_addr.family(), SOCK_DGRAM, IPPROTO_UDP, ctsConfig::Settings->SocketFlags);
-                    break;
-
-                default:
-                    ctsConfig::PrintErrorInfo(
-                        ctl::ctString::ctFormatString("Unknown socket protocol (%u)",
-                            static_cast<unsigned>(ctsConfig::Settings->Protocol)).c_str());
-                    gle = WSAEINVAL;
+                switch (ctsConfig::Settings->Protocol)
+                {
+                    case ctsConfig::ProtocolType::TCP:
+                        socket = ctsConfig::CreateSocket(local_addr.family(), SOCK_STREAM, IPPROTO_TCP, ctsConfig::Settings->SocketFlags);
+                        break;
+
+                    case ctsConfig::ProtocolType::UDP:
+                        socket = ctsConfig::CreateSocket(local_addr.family(), SOCK_DGRAM, IPPROTO_UDP, ctsConfig::Settings->SocketFlags);
+                        break;
+
+                    default:
+                        ctsConfig::PrintErrorInfo(
+                            ctl::ctString::ctFormatString("Unknown socket protocol (%u)",
+                                static_cast<unsigned>(ctsConfig::Settings->Protocol)).c_str());
+                        gle = WSAEINVAL;
+                }
+            }
+            catch (const std::exception& e)
+            {
+                gle = ctl::ctErrorCode(e);
             }
-        }
-        catch (const std::exception& e)
-        {
-            gle = ctl::ctErrorCode(e);
         }
 
         if (NO_ERROR == gle)
@@ -116,6 +132,35 @@ namespace ctsTraffic
                     gle = WSAGetLastError();
                 }
             }
+            else if (port_lease.port != 0)
+            {
+                // a port still held by TCP (e.g. in TIME_WAIT) goes to the back of the range
+                // - immediately retry with the next free port instead of waiting for this one
+                constexpr unsigned long BindConflictRetryCount = 16;
+
+                for (unsigned long bind_retry = 0; bind_retry < BindConflictRetryCount; ++bind_retry)
+                {
+                    if (0 == bind(socket, local_addr.sockaddr(), local_addr.length()))
+                    {
+                        gle = NO_ERROR;
+                        break;
+                    }
+
+                    gle = WSAGetLastError();
+                    if (gle != WSAEADDRINUSE)
+                    {
+                        break;
+                    }
+
+                    PrintDebugInfo(L"\t\tctsWSASocket : bind failed on port %u (attempt %lu), trying the next free port\n", port_lease.port, bind_retry + 1);
+                    ctsConfig::ReleaseLocalPort(port_lease, true);
+                    if (!ctsConfig::AcquireLocalPort(bind_index, port_lease))
+                    {
+                        break;
+                    }
+                    local_addr.SetPort(port_lease.port);
+                }
+            }
             else
             {
                 // sleep up to 5 seconds to allow TCP to cleanup its internal state
@@ -148,6 +193,8 @@ namespace ctsTraffic
         shared_socket->set_socket(socket);
         shared_socket->set_local_address(local_addr);
         shared_socket->set_target_address(target_addr);
+        // the socket returns the leased port to the range once it is closed
+        shared_socket->set_local_port_lease(port_lease);
 
         if (0 == gle)
         {
@@ -20,6 +20,7 @@ See the Apache Version 2.0 License for specific language governing permissions a
 // ctl headers
 #include <ctSockaddr.hpp>
 #include <ctThreadIocp.hpp>
+#include <ctSocketExtensions.hpp>
 // project headers
 #include "ctsWinsockLayer.h"
 #include "ctsIOTask.hpp"
@@ -51,12 +52,21 @@ namespace ctsTraffic
             const auto& io_thread_pool = _shared_socket->thread_pool();
             OVERLAPPED* pov = io_thread_pool->new_request(std::move(_callback));
 
-            WSABUF wsabuf;
-            wsabuf.buf = _task.buffer + _task.buffer_offset;
-            wsabuf.len = _task.buffer_length;
+            WSABUF wsabufs[ctsIOTask::MaxBufferSegments];
+            const auto wsabuf_count = _task.fill_wsabufs(wsabufs);
 
-            DWORD flags = 0;
-            if (WSARecvFrom(socket, &wsabuf, 1, nullptr, &flags, nullptr, nullptr, pov, nullptr) != 0)
+            int error;
+            if (_task.recv_message)
+            {
+                // WSARecvMsg returns the datagram's control data with it (e.g. its kernel receive timestamp)
+                error = ctl::ctWSARecvMsg(socket, _task.recv_message->prepare(wsabufs[0]), nullptr, pov, nullptr);
+            }
+            else
+            {
+                DWORD flags = 0;
+                error = WSARecvFrom(socket, wsabufs, wsabuf_count, nullptr, &flags, nullptr, nullptr, pov, nullptr);
+            }
+            if (error != 0)
             {
                 return_result.error_code = WSAGetLastError();
                 // IO pended == successfully initiating the IO
@@ -115,11 +125,10 @@ namespace ctsTraffic
             const auto& io_thread_pool = _shared_socket->thread_pool();
             OVERLAPPED* pov = io_thread_pool->new_request(std::move(_callback));
 
-            WSABUF wsabuf;
-            wsabuf.buf = _task.buffer + _task.buffer_offset;
-            wsabuf.len = _task.buffer_length;
+            WSABUF wsabufs[ctsIOTask::MaxBufferSegments];
+            const auto wsabuf_count = _task.fill_wsabufs(wsabufs);
 
-            if (WSASendTo(socket, &wsabuf, 1, nullptr, 0, targetAddress.sockaddr(), targetAddress.length(), pov, nullptr) != 0)
+            if (WSASendTo(socket, wsabufs, wsabuf_count, nullptr, 0, targetAddress.sockaddr(), targetAddress.length(), pov, nullptr) != 0)
             {
                 return_result.error_code = WSAGetLastError();
                 // IO pended == successfully initiating the IO